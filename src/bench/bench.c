@@ -0,0 +1,169 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+/* Microbenchmark harness for the path translation layer, built with
+ * "make bench".  It exercises canonicalize(), substitute_binding()
+ * and read_string() in isolation -- against the current process's
+ * own memory, no tracee involved -- and reports ns/op, so that
+ * regressions in these hot loops are caught by numbers rather than
+ * guesswork.
+ *
+ * Usage: bench [nb-bindings] [path-depth] [nb-ops]
+ */
+
+#include <stdio.h>        /* printf(3), snprintf(3), */
+#include <stdlib.h>       /* strtoul(3), */
+#include <string.h>       /* strcpy(3), strcat(3), strlen(3), */
+#include <stdint.h>       /* uint64_t, uintmax_t, */
+#include <stdbool.h>      /* bool, */
+#include <time.h>         /* clock_gettime(2), */
+#include <unistd.h>       /* getpid(2), */
+#include <talloc.h>       /* talloc_*, */
+#include <linux/limits.h> /* PATH_MAX, */
+
+#include "tracee/tracee.h"
+#include "tracee/mem.h"
+#include "path/path.h"
+#include "path/canon.h"
+#include "path/binding.h"
+#include "path/cache.h"
+#include "cli/note.h"
+#include "arch.h"
+
+/* Normally defined by cli/cli.c, which provides the real main() and
+ * is not linked into this harness.  */
+bool exit_failure = true;
+
+static uint64_t now_nsecs(void)
+{
+	struct timespec now;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * UINT64_C(1000000000) + now.tv_nsec;
+}
+
+static void report(const char *name, uint64_t nsecs, uint64_t nb_ops)
+{
+	printf("%-48s %8ju ns/op  (%ju ops)\n", name,
+		(uintmax_t) (nsecs / nb_ops), (uintmax_t) nb_ops);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t nb_bindings  = (argc > 1 ? strtoul(argv[1], NULL, 0) : 16);
+	size_t path_depth   = (argc > 2 ? strtoul(argv[2], NULL, 0) : 8);
+	uint64_t nb_ops     = (argc > 3 ? strtoul(argv[3], NULL, 0) : 100000);
+
+	char deep_path[PATH_MAX];
+	char result[PATH_MAX];
+	char path[PATH_MAX];
+	char label[128];
+	uint64_t start;
+	Tracee *tracee;
+	uint64_t op;
+	size_t i;
+	int status;
+
+	global_tool_name = "bench";
+
+	tracee = new_dummy_tracee(NULL);
+	if (tracee == NULL) {
+		fprintf(stderr, "bench: out of memory\n");
+		return 1;
+	}
+
+	/* The memory benchmarks read from our own address space.  */
+	tracee->pid = getpid();
+	tracee->fs->cwd = talloc_strdup(tracee->fs, "/");
+
+	/* Guest rootfs is the real "/", plus synthetic bindings to
+	 * populate the lookup lists.  */
+	if (new_binding(tracee, "/", "/", true) == NULL)
+		return 1;
+
+	for (i = 0; i < nb_bindings; i++) {
+		snprintf(path, sizeof(path), "/bench-binding-%zu", i);
+		if (new_binding(tracee, "/tmp", path, false) == NULL)
+			return 1;
+	}
+
+	status = initialize_bindings(tracee);
+	if (status < 0)
+		return 1;
+
+	/* A @path_depth components long path that exists on any host:
+	 * "/usr/../usr/../.../usr".  */
+	strcpy(deep_path, "/usr");
+	for (i = 1; i < path_depth && strlen(deep_path) + 8 < sizeof(deep_path); i++)
+		strcat(deep_path, "/../usr");
+
+	/* 1. canonicalize(), cold translation cache.  */
+	start = now_nsecs();
+	for (op = 0; op < nb_ops; op++) {
+		invalidate_path_cache();
+		status = canonicalize(tracee, deep_path, true, result, 0);
+		if (status < 0) {
+			fprintf(stderr, "bench: canonicalize: %s\n", strerror(-status));
+			return 1;
+		}
+		talloc_free_children(tracee->ctx);
+	}
+	snprintf(label, sizeof(label), "canonicalize, depth %zu, %zu bindings, cold",
+		path_depth, nb_bindings);
+	report(label, now_nsecs() - start, nb_ops);
+
+	/* 2. canonicalize(), warm translation cache.  */
+	start = now_nsecs();
+	for (op = 0; op < nb_ops; op++) {
+		status = canonicalize(tracee, deep_path, true, result, 0);
+		if (status < 0)
+			return 1;
+		talloc_free_children(tracee->ctx);
+	}
+	snprintf(label, sizeof(label), "canonicalize, depth %zu, %zu bindings, warm",
+		path_depth, nb_bindings);
+	report(label, now_nsecs() - start, nb_ops);
+
+	/* 3. substitute_binding(), last binding of the list.  */
+	start = now_nsecs();
+	for (op = 0; op < nb_ops; op++) {
+		snprintf(path, sizeof(path), "/bench-binding-%zu/x", nb_bindings - 1);
+		status = substitute_binding(tracee, GUEST, path);
+		if (status < 0)
+			return 1;
+	}
+	snprintf(label, sizeof(label), "substitute_binding, %zu bindings", nb_bindings);
+	report(label, now_nsecs() - start, nb_ops);
+
+	/* 4. read_string() against our own memory.  */
+	start = now_nsecs();
+	for (op = 0; op < nb_ops; op++) {
+		status = read_string(tracee, result, (word_t) deep_path, PATH_MAX);
+		if (status < 0)
+			return 1;
+	}
+	snprintf(label, sizeof(label), "read_string, %zu bytes", strlen(deep_path) + 1);
+	report(label, now_nsecs() - start, nb_ops);
+
+	talloc_free(tracee);
+	return 0;
+}
@@ -32,6 +32,8 @@
 #include <errno.h>         /* errno(3), */
 #include <execinfo.h>      /* backtrace_symbols(3), */
 #include <limits.h>        /* INT_MAX, */
+#include <stdint.h>        /* uint64_t, uintmax_t, */
+#include <time.h>          /* clock_gettime(2), */
 
 #include "cli/cli.h"
 #include "cli/note.h"
@@ -280,6 +282,25 @@ static int initialize_exe(Tracee *tracee, const char *exe)
 	return 0;
 }
 
+/**
+ * Return the number of µs elapsed since @start, then reset @start to
+ * the current time.  Used to report the startup time budget, phase by
+ * phase, at -v; short-lived PRoot invocations pay it in full.
+ */
+static uint64_t elapsed_usecs(struct timespec *start)
+{
+	struct timespec now;
+	uint64_t usecs;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+	usecs = (now.tv_sec - start->tv_sec) * UINT64_C(1000000)
+		+ (now.tv_nsec - start->tv_nsec) / 1000;
+	*start = now;
+
+	return usecs;
+}
+
 /**
  * Configure @tracee according to the command-line arguments stored in
  * @argv[].  This function returns the index in @argv[] of the command
@@ -288,12 +309,20 @@ static int initialize_exe(Tracee *tracee, const char *exe)
 static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 {
 	option_handler_t handler = NULL;
+	uint64_t options_usecs;
+	uint64_t bindings_usecs;
+	uint64_t cwd_usecs;
+	uint64_t exe_usecs;
+	struct timespec phase_start;
+	const Argument *ambiguity;
 	const Option *options;
 	const Cli *cli = NULL;
 	size_t argc_offset;
 	size_t i, j, k;
 	int status;
 
+	(void) clock_gettime(CLOCK_MONOTONIC, &phase_start);
+
 	if (get_care_cli != NULL) {
 		/* Check if it's an self-extracting CARE archive.  */
 		status = extract_archive_from_file("/proc/self/exe");
@@ -334,6 +363,7 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 			break; /* End of PRoot options. */
 
 		options = cli->options;
+		ambiguity = NULL;
 		for (j = 0; options[j].class != NULL; j++) {
 			const Option *option = &options[j];
 
@@ -352,11 +382,15 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 				if (strncmp(arg, argument->name, length) != 0)
 					continue;
 
-				/* Avoid ambiguities.  */
+				/* Not this argument if another option
+				 * merely shares its prefix, as with
+				 * "--bind" and "--bindings-file";
+				 * remember the ambiguity in case no
+				 * option matches at all.  */
 				if (strlen(arg) > length
 				    && arg[length] != argument->separator) {
-					print_error_separator(tracee, argument);
-					return -1;
+					ambiguity = argument;
+					continue;
 				}
 
 				/* No option value.  */
@@ -388,6 +422,11 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 			}
 		}
 
+		if (ambiguity != NULL) {
+			print_error_separator(tracee, ambiguity);
+			return -1;
+		}
+
 		note(tracee, ERROR, USER, "unknown option '%s'.", arg);
 		return -1;
 
@@ -399,6 +438,10 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 	}
 	argc_offset = i;
 
+	/* Option handlers also initialize extensions (-k, -i, ...), so
+	 * this phase accounts for them too.  */
+	options_usecs = elapsed_usecs(&phase_start);
+
 #define HOOK_CONFIG(callback)						\
 	do {								\
 		if (cli->callback != NULL) {				\
@@ -418,6 +461,9 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 		return -1;
 
 	HOOK_CONFIG(post_initialize_bindings);
+
+	bindings_usecs = elapsed_usecs(&phase_start);
+
 	HOOK_CONFIG(pre_initialize_cwd);
 
 	/* Bindings are now installed (tracee->bindings.guest &
@@ -428,6 +474,9 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 		return -1;
 
 	HOOK_CONFIG(post_initialize_cwd);
+
+	cwd_usecs = elapsed_usecs(&phase_start);
+
 	HOOK_CONFIG(pre_initialize_exe);
 
 	/* Bindings are now installed and the current working
@@ -440,6 +489,12 @@ static int parse_config(Tracee *tracee, size_t argc, char *const argv[])
 	HOOK_CONFIG(post_initialize_exe);
 #undef HOOK_CONFIG
 
+	exe_usecs = elapsed_usecs(&phase_start);
+
+	VERBOSE(tracee, 1, "startup: options = %juus, bindings = %juus, cwd = %juus, exe = %juus",
+		(uintmax_t) options_usecs, (uintmax_t) bindings_usecs,
+		(uintmax_t) cwd_usecs, (uintmax_t) exe_usecs);
+
 	print_config(tracee, &argv[argc_offset]);
 
 	return argc_offset;
@@ -449,6 +504,7 @@ bool exit_failure = true;
 
 int main(int argc, char *const argv[])
 {
+	struct timespec phase_start;
 	Tracee *tracee;
 	int status;
 
@@ -463,7 +519,7 @@ int main(int argc, char *const argv[])
 	tracee = get_tracee(NULL, 0, true);
 	if (tracee == NULL)
 		goto error;
-	tracee->pid = getpid();
+	set_tracee_pid(tracee, getpid());
 
 	/* Pre-configure the first tracee.  */
 	status = parse_config(tracee, argc, argv);
@@ -471,11 +527,14 @@ int main(int argc, char *const argv[])
 		goto error;
 
 	/* Start the first tracee.  */
+	(void) clock_gettime(CLOCK_MONOTONIC, &phase_start);
 	status = launch_process(tracee, &argv[status]);
 	if (status < 0) {
 		print_execve_help(tracee, tracee->exe, status);
 		goto error;
 	}
+	VERBOSE(tracee, 1, "startup: launch (incl. seccomp program) = %juus",
+		(uintmax_t) elapsed_usecs(&phase_start));
 
 	/* Start tracing the first tracee and all its children.  */
 	exit(event_loop());
@@ -21,10 +21,17 @@
  */
 
 #include <errno.h>  /* errno, */
-#include <string.h> /* strerror(3), */
+#include <string.h> /* strerror(3), memcpy(3), */
 #include <stdarg.h> /* va_*, */
-#include <stdio.h>  /* vfprintf(3), */
+#include <stdio.h>  /* vsnprintf(3), */
 #include <limits.h> /* INT_MAX, */
+#include <stdbool.h> /* bool, true, false, */
+#include <stdlib.h> /* atexit(3), */
+#include <unistd.h> /* write(2), STDERR_FILENO, */
+#include <time.h>   /* nanosleep(2), clock_gettime(2), */
+#include <stdint.h> /* uintptr_t, */
+#include <signal.h> /* sig_atomic_t, */
+#include <pthread.h> /* pthread_*, */
 
 #include "cli/note.h"
 #include "tracee/tracee.h"
@@ -32,15 +39,227 @@
 int global_verbose_level;
 const char *global_tool_name;
 
+/* Non-fatal notes are not written to stderr from the event loop:
+ * they are pushed into the ring below and drained by a dedicated
+ * writer thread, so a verbose run is delayed by a formatting plus a
+ * memcpy(3) instead of a terminal or file round-trip per message.
+ * Formatting stays on the caller side -- deferring it would require
+ * copying every string argument anyway, and it is the I/O, not
+ * vsnprintf(3), that costs milliseconds.  Each slot is published by
+ * storing its unique sequence number, hence several threads (the
+ * CARE archiver, typically) can push concurrently without a lock.  */
+
+#define NOTE_RING_NB_SLOTS 256	/* power of two */
+#define NOTE_SLOT_SIZE 512
+
+typedef struct {
+	unsigned sequence;
+	unsigned short length;
+	char text[NOTE_SLOT_SIZE];
+} NoteSlot;
+
+static struct {
+	NoteSlot slots[NOTE_RING_NB_SLOTS];
+	unsigned head;
+	unsigned tail;
+	bool writer_started;
+	bool writer_failed;
+} note_ring;
+
+/* Depth of signal handlers currently executing, see
+ * note_enter_signal_handler().  The ring must not be touched from
+ * there: pthread_create(3) is not async-signal-safe, and _exit(2) --
+ * the usual end of a fatal handler -- skips the atexit flush, losing
+ * the very diagnostic that explains the crash.  */
+static volatile sig_atomic_t in_signal_handler;
+
+void note_enter_signal_handler(void)
+{
+	in_signal_handler++;
+}
+
+void note_leave_signal_handler(void)
+{
+	in_signal_handler--;
+}
+
+/**
+ * Disable the deferred writer in a forked child: the writer thread
+ * does not survive fork(2), and the inherited ring may hold notes the
+ * parent is about to write anyway; the child falls back to
+ * synchronous writes.  Registered with pthread_atfork(3).
+ */
+static void disable_writer_after_fork(void)
+{
+	note_ring.writer_started = false;
+	note_ring.writer_failed  = true;
+}
+
+/**
+ * Wait until every queued note was written to stderr.
+ */
+static void flush_queued_notes(void)
+{
+	const struct timespec delay = { .tv_sec = 0, .tv_nsec = 100000 };
+
+	if (!note_ring.writer_started)
+		return;
+
+	while (__atomic_load_n(&note_ring.tail, __ATOMIC_ACQUIRE)
+	    != __atomic_load_n(&note_ring.head, __ATOMIC_ACQUIRE))
+		nanosleep(&delay, NULL);
+}
+
+/**
+ * Entry point of the note writer thread: write queued notes to
+ * stderr, in order.
+ */
+static void *note_writer_main(void *private UNUSED)
+{
+	const struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000000 };
+	unsigned tail = 0;
+
+	while (1) {
+		NoteSlot *slot = &note_ring.slots[tail % NOTE_RING_NB_SLOTS];
+
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != tail + 1) {
+			nanosleep(&delay, NULL);
+			continue;
+		}
+
+		(void) write(STDERR_FILENO, slot->text, slot->length);
+
+		tail++;
+		__atomic_store_n(&note_ring.tail, tail, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+/**
+ * Push @text (@length bytes) into the ring.  This function returns
+ * false if the ring is full or the writer thread is not available,
+ * in which case the caller shall write @text itself.
+ */
+static bool enqueue_note(const char *text, size_t length)
+{
+	NoteSlot *slot;
+	unsigned head;
+	unsigned tail;
+
+	if (!note_ring.writer_started) {
+		pthread_t writer;
+
+		if (note_ring.writer_failed)
+			return false;
+
+		if (pthread_create(&writer, NULL, note_writer_main, NULL) != 0) {
+			note_ring.writer_failed = true;
+			return false;
+		}
+		(void) pthread_detach(writer);
+
+		note_ring.writer_started = true;
+		atexit(flush_queued_notes);
+		(void) pthread_atfork(NULL, NULL, disable_writer_after_fork);
+	}
+
+	do {
+		head = __atomic_load_n(&note_ring.head, __ATOMIC_RELAXED);
+		tail = __atomic_load_n(&note_ring.tail, __ATOMIC_ACQUIRE);
+		if (head - tail >= NOTE_RING_NB_SLOTS)
+			return false;
+	} while (!__atomic_compare_exchange_n(&note_ring.head, &head, head + 1,
+					false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	slot = &note_ring.slots[head % NOTE_RING_NB_SLOTS];
+	memcpy(slot->text, text, length);
+	slot->length = length;
+
+	/* Publish the slot; the writer thread consumes sequence
+	 * numbers in order, so notes never get reordered.  */
+	__atomic_store_n(&slot->sequence, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/* A misbehaving tracee can trigger the very same warning thousands
+ * of times per second.  Each call site -- identified by the address
+ * of its format string literal -- owns a token bucket: warnings pass
+ * while tokens remain, then are counted instead of written, and a
+ * one-line summary restores the count once the bucket refills.
+ * Buckets are direct-mapped; a collision merely resets the slot,
+ * which only lets a few extra warnings through.  */
+
+#define NOTE_NB_BUCKETS 64
+#define NOTE_BUCKET_CAPACITY 10
+#define NOTE_BUCKET_REFILL_PER_SEC 10
+
+typedef struct {
+	const char *message;
+	time_t last_refill;
+	unsigned tokens;
+	unsigned nb_suppressed;
+} NoteBucket;
+
+static NoteBucket note_buckets[NOTE_NB_BUCKETS];
+
+/**
+ * Tell whether the warning identified by @message may be written,
+ * according to its token bucket.  On success, *@nb_suppressed is the
+ * number of identical warnings that were suppressed since the last
+ * written one.
+ */
+static bool warning_allowed(const char *message, unsigned *nb_suppressed)
+{
+	NoteBucket *bucket;
+	struct timespec now;
+
+	bucket = &note_buckets[((uintptr_t) message / sizeof(void *)) % NOTE_NB_BUCKETS];
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (bucket->message != message) {
+		bucket->message       = message;
+		bucket->last_refill   = now.tv_sec;
+		bucket->tokens        = NOTE_BUCKET_CAPACITY;
+		bucket->nb_suppressed = 0;
+	}
+	else if (now.tv_sec > bucket->last_refill) {
+		unsigned long refill;
+
+		refill = (now.tv_sec - bucket->last_refill) * NOTE_BUCKET_REFILL_PER_SEC;
+		bucket->tokens = (refill > NOTE_BUCKET_CAPACITY - bucket->tokens
+				? NOTE_BUCKET_CAPACITY
+				: bucket->tokens + refill);
+		bucket->last_refill = now.tv_sec;
+	}
+
+	if (bucket->tokens == 0) {
+		bucket->nb_suppressed++;
+		return false;
+	}
+
+	bucket->tokens--;
+	*nb_suppressed = bucket->nb_suppressed;
+	bucket->nb_suppressed = 0;
+
+	return true;
+}
+
 /**
  * Print @message to the standard error stream according to its
  * @severity and @origin.
  */
 void note(const Tracee *tracee, Severity severity, Origin origin, const char *message, ...)
 {
+	char formatted[NOTE_SLOT_SIZE];
 	const char *tool_name;
 	va_list extra_params;
 	int verbose_level;
+	int saved_errno;
+	size_t length;
+	int status;
 
 	if (tracee == NULL) {
 		verbose_level = global_verbose_level;
@@ -54,32 +273,67 @@ void note(const Tracee *tracee, Severity severity, Origin origin, const char *me
 	if (verbose_level < 0 && severity != ERROR)
 		return;
 
+	saved_errno = errno;
+
+	if (severity == WARNING) {
+		unsigned nb_suppressed = 0;
+
+		if (!warning_allowed(message, &nb_suppressed))
+			return;
+
+		if (nb_suppressed > 0) {
+			char summary[128];
+
+			status = snprintf(summary, sizeof(summary),
+				"%s warning: (%u similar warnings were suppressed)\n",
+				tool_name, nb_suppressed);
+			if (status > 0 && (in_signal_handler != 0
+					|| !enqueue_note(summary, status)))
+				(void) write(STDERR_FILENO, summary, status);
+		}
+	}
+
+	length = 0;
+
+#define APPEND(...) do {						\
+		status = snprintf(formatted + length,			\
+				sizeof(formatted) - length, __VA_ARGS__); \
+		if (status > 0)						\
+			length += status;				\
+		if (length >= sizeof(formatted))			\
+			length = sizeof(formatted) - 1;			\
+	} while (0)
+
 	switch (severity) {
 	case WARNING:
-		fprintf(stderr, "%s warning: ", tool_name);
+		APPEND("%s warning: ", tool_name);
 		break;
 
 	case ERROR:
-		fprintf(stderr, "%s error: ", tool_name);
+		APPEND("%s error: ", tool_name);
 		break;
 
 	case INFO:
 	default:
-		fprintf(stderr, "%s info: ", tool_name);
+		APPEND("%s info: ", tool_name);
 		break;
 	}
 
 	if (origin == TALLOC)
-		fprintf(stderr, "talloc: ");
+		APPEND("talloc: ");
 
 	va_start(extra_params, message);
-	vfprintf(stderr, message, extra_params);
+	status = vsnprintf(formatted + length, sizeof(formatted) - length,
+			message, extra_params);
 	va_end(extra_params);
+	if (status > 0)
+		length += status;
+	if (length >= sizeof(formatted))
+		length = sizeof(formatted) - 1;
 
 	switch (origin) {
 	case SYSTEM:
-		fprintf(stderr, ": ");
-		perror(NULL);
+		APPEND(": %s\n", strerror(saved_errno));
 		break;
 
 	case TALLOC:
@@ -88,9 +342,24 @@ void note(const Tracee *tracee, Severity severity, Origin origin, const char *me
 	case INTERNAL:
 	case USER:
 	default:
-		fprintf(stderr, "\n");
+		APPEND("\n");
 		break;
 	}
+#undef APPEND
+
+	/* Errors are written synchronously -- they often immediately
+	 * precede the end of the process -- and in order with respect
+	 * to the notes already queued.  A signal handler can't wait
+	 * for the queue, its write simply jumps ahead.  */
+	if (severity == ERROR) {
+		if (in_signal_handler == 0)
+			flush_queued_notes();
+		(void) write(STDERR_FILENO, formatted, length);
+		return;
+	}
+
+	if (in_signal_handler != 0 || !enqueue_note(formatted, length))
+		(void) write(STDERR_FILENO, formatted, length);
 
 	return;
 }
@@ -42,12 +42,21 @@ typedef enum {
 } Severity;
 
 #define VERBOSE(tracee, level, message, args...) do {			\
-		if (tracee == NULL || tracee->verbose >= (level))	\
-			note(tracee, INFO, INTERNAL, (message), ## args); \
+		const Tracee *tracee_ = (tracee);			\
+		if ((tracee_ == NULL					\
+			? global_verbose_level				\
+			: tracee_->verbose) >= (level))			\
+			note(tracee_, INFO, INTERNAL, (message), ## args); \
 	} while (0)
 
 extern void note(const Tracee *tracee, Severity severity, Origin origin, const char *message, ...) FORMAT(printf, 4, 5);
 
+/* Bracket the body of a signal handler that may call note(): notes
+ * emitted in between bypass the deferred writer and are written
+ * synchronously.  */
+extern void note_enter_signal_handler(void);
+extern void note_leave_signal_handler(void);
+
 extern int global_verbose_level;
 extern const char *global_tool_name;
 
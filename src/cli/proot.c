@@ -24,11 +24,20 @@
 #include <assert.h>    /* assert(3), */
 #include <stdio.h>     /* printf(3), fflush(3), */
 #include <unistd.h>    /* write(2), */
+#include <stdlib.h>    /* strtoul(3), */
+#include <sched.h>     /* sched_set*(2), CPU_*, */
 
 #include "cli/cli.h"
 #include "cli/note.h"
 #include "extension/extension.h"
 #include "path/binding.h"
+#include "execve/disk_cache.h"
+#include "execve/ldcache.h"
+#include "execve/execve.h"
+#include "syscall/seccomp.h"
+#include "syscall/notif.h"
+#include "tracee/trace.h"
+#include "tracee/event.h"
 #include "attribute.h"
 
 /* These should be included last.  */
@@ -69,6 +78,27 @@ static int handle_option_b(Tracee *tracee, const Cli *cli UNUSED, const char *va
 	return 0;
 }
 
+static int handle_option_bind_ci(Tracee *tracee, const Cli *cli UNUSED, const char *value)
+{
+	char *host;
+	char *guest;
+
+	host = talloc_strdup(tracee->ctx, value);
+	if (host == NULL) {
+		note(tracee, ERROR, INTERNAL, "can't allocate memory");
+		return -1;
+	}
+
+	guest = strchr(host, ':');
+	if (guest != NULL) {
+		*guest = '\0';
+		guest++;
+	}
+
+	new_binding2(tracee, host, guest, true, true);
+	return 0;
+}
+
 static int handle_option_q(Tracee *tracee, const Cli *cli UNUSED, const char *value)
 {
 	const char *ptr;
@@ -156,7 +186,9 @@ static int handle_option_k(Tracee *tracee, const Cli *cli UNUSED, const char *va
 {
 	int status;
 
-	status = initialize_extension(tracee, kompat_callback, value);
+	/* Deferred: kompat is often loaded defensively, its actual
+	 * initialization can wait until the tracee really runs.  */
+	status = initialize_extension_deferred(tracee, kompat_callback, value);
 	if (status < 0)
 		note(tracee, WARNING, INTERNAL, "option \"-k %s\" discarded", value);
 
@@ -165,7 +197,7 @@ static int handle_option_k(Tracee *tracee, const Cli *cli UNUSED, const char *va
 
 static int handle_option_i(Tracee *tracee, const Cli *cli UNUSED, const char *value)
 {
-	(void) initialize_extension(tracee, fake_id0_callback, value);
+	(void) initialize_extension_deferred(tracee, fake_id0_callback, value);
 	return 0;
 }
 
@@ -178,6 +210,16 @@ static int handle_option_v(Tracee *tracee, const Cli *cli UNUSED, const char *va
 {
 	int status;
 
+	/* "-v binary:<file>" records fixed-size binary records
+	 * instead of text, see tracee/trace.h.  */
+	if (strncmp(value, "binary:", strlen("binary:")) == 0) {
+		status = open_regs_trace(value + strlen("binary:"));
+		if (status < 0)
+			note(tracee, ERROR, SYSTEM, "can't open binary trace '%s'",
+				value + strlen("binary:"));
+		return status;
+	}
+
 	status = parse_integer_option(tracee, &tracee->verbose, value, "-v");
 	if (status < 0)
 		return status;
@@ -186,6 +228,13 @@ static int handle_option_v(Tracee *tracee, const Cli *cli UNUSED, const char *va
 	return 0;
 }
 
+static int handle_option_seccomp_notif(Tracee *tracee UNUSED, const Cli *cli UNUSED,
+				const char *value UNUSED)
+{
+	seccomp_notif_wanted = true;
+	return 0;
+}
+
 extern unsigned char WEAK _binary_licenses_start;
 extern unsigned char WEAK _binary_licenses_end;
 
@@ -257,8 +306,175 @@ static int handle_option_S(Tracee *tracee, const Cli *cli, const char *value)
 	return 0;
 }
 
+/* Path to the on-disk exec cache, specified with --exec-cache.  It
+ * can't be opened right from the option handler since the guest
+ * rootfs -- which decides whether the cache content is reusable -- is
+ * not known yet at that point.  */
+static const char *exec_cache_path = NULL;
+
+static int handle_option_exec_cache(Tracee *tracee UNUSED, const Cli *cli UNUSED, const char *value)
+{
+	exec_cache_path = value;
+	return 0;
+}
+
+static int handle_option_trace(Tracee *tracee, const Cli *cli UNUSED, const char *value)
+{
+	return initialize_extension(tracee, trace_callback, value);
+}
+
+static int handle_option_bindings_file(Tracee *tracee, const Cli *cli UNUSED, const char *value)
+{
+	int status;
+
+	status = read_bindings_file(tracee, value);
+	if (status < 0) {
+		note(tracee, ERROR, SYSTEM, "can't read bindings file \"%s\"", value);
+		return -1;
+	}
+
+	set_bindings_file(value);
+	return 0;
+}
+
+static int handle_option_bindings_cache(Tracee *tracee UNUSED, const Cli *cli UNUSED,
+					const char *value)
+{
+	set_bindings_cache(value);
+	return 0;
+}
+
+static int handle_option_session_cache(Tracee *tracee, const Cli *cli UNUSED, const char *value)
+{
+	const char *bindings;
+	const char *seccomp;
+	const char *loader;
+	const char *capabilities;
+
+	bindings     = talloc_asprintf(talloc_autofree_context(), "%s/bindings", value);
+	seccomp      = talloc_asprintf(talloc_autofree_context(), "%s/seccomp.bpf", value);
+	loader       = talloc_asprintf(talloc_autofree_context(), "%s/loader", value);
+	capabilities = talloc_asprintf(talloc_autofree_context(), "%s/capabilities", value);
+	if (bindings == NULL || seccomp == NULL || loader == NULL || capabilities == NULL) {
+		note(tracee, ERROR, INTERNAL, "can't allocate memory");
+		return -1;
+	}
+
+	set_bindings_cache(bindings);
+	set_seccomp_cache(seccomp);
+	set_loader_cache(loader);
+	set_capability_cache(capabilities);
+
+	return 0;
+}
+
+static int handle_option_cpus(Tracee *tracee, const Cli *cli UNUSED, const char *value)
+{
+	const char *ptr = value;
+	cpu_set_t mask;
+	int status;
+
+	CPU_ZERO(&mask);
+
+	/* Comma-separated CPU numbers and ranges, as in "0,2,4-7".  */
+	while (*ptr != '\0') {
+		unsigned long first;
+		unsigned long last;
+		char *end;
+
+		first = strtoul(ptr, &end, 10);
+		if (end == ptr || first >= CPU_SETSIZE)
+			goto invalid;
+		last = first;
+
+		ptr = end;
+		if (*ptr == '-') {
+			ptr++;
+			last = strtoul(ptr, &end, 10);
+			if (end == ptr || last >= CPU_SETSIZE || last < first)
+				goto invalid;
+			ptr = end;
+		}
+
+		for (; first <= last; first++)
+			CPU_SET(first, &mask);
+
+		if (*ptr == ',')
+			ptr++;
+		else if (*ptr != '\0')
+			goto invalid;
+	}
+
+	if (CPU_COUNT(&mask) == 0)
+		goto invalid;
+
+	/* Threads spawned later -- the trace flusher for instance --
+	 * inherit this mask; tracees don't, see launch_process().  */
+	status = sched_setaffinity(0, sizeof(mask), &mask);
+	if (status < 0) {
+		note(tracee, ERROR, SYSTEM, "option \"--cpus %s\"", value);
+		return -1;
+	}
+
+	tracer_cpus_pinned = true;
+	return 0;
+
+invalid:
+	note(tracee, ERROR, USER, "option \"--cpus %s\": invalid CPU list", value);
+	return -1;
+}
+
+static int handle_option_sched_fifo(Tracee *tracee, const Cli *cli UNUSED, const char *value)
+{
+	struct sched_param param;
+	int priority;
+	int status;
+
+	status = parse_integer_option(tracee, &priority, value, "--sched-fifo");
+	if (status < 0)
+		return status;
+
+	if (   priority < sched_get_priority_min(SCHED_FIFO)
+	    || priority > sched_get_priority_max(SCHED_FIFO)) {
+		note(tracee, ERROR, USER,
+			"option \"--sched-fifo %s\": priority out of range", value);
+		return -1;
+	}
+
+	/* SCHED_RESET_ON_FORK: tracees revert to SCHED_OTHER on
+	 * fork, only PRoot and the threads it spawns keep the
+	 * real-time class.  */
+	param.sched_priority = priority;
+	status = sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param);
+	if (status < 0) {
+		note(tracee, ERROR, SYSTEM, "option \"--sched-fifo %s\"", value);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Generation is deferred to post_initialize_exe(): the bindings have
+ * to be installed before the guest library directories can be
+ * translated.  */
+static bool shadow_ldcache_wanted = false;
+
+static int handle_option_shadow_ldcache(Tracee *tracee UNUSED, const Cli *cli UNUSED,
+				const char *value UNUSED)
+{
+	shadow_ldcache_wanted = true;
+	return 0;
+}
+
+static int handle_option_analyze_bindings(Tracee *tracee UNUSED, const Cli *cli UNUSED,
+				const char *value UNUSED)
+{
+	enable_binding_profile();
+	return 0;
+}
+
 /**
- * Initialize @tracee->qemu.
+ * Initialize @tracee->qemu and the on-disk exec cache.
  */
 static int post_initialize_exe(Tracee *tracee, const Cli *cli UNUSED,
 			size_t argc UNUSED, char *const argv[] UNUSED, size_t cursor UNUSED)
@@ -266,6 +482,22 @@ static int post_initialize_exe(Tracee *tracee, const Cli *cli UNUSED,
 	char path[PATH_MAX];
 	int status;
 
+	if (exec_cache_path != NULL) {
+		status = open_exec_cache(tracee, exec_cache_path);
+		if (status < 0)
+			note(tracee, WARNING, INTERNAL,
+				"option \"--exec-cache %s\" discarded: %s",
+				exec_cache_path, strerror(-status));
+	}
+
+	if (shadow_ldcache_wanted) {
+		status = generate_shadow_ldcache(tracee);
+		if (status < 0)
+			note(tracee, WARNING, INTERNAL,
+				"option \"--shadow-ldcache\" discarded: %s",
+				strerror(-status));
+	}
+
 	/* Nothing else to do ?  */
 	if (tracee->qemu == NULL)
 		return 0;
@@ -288,6 +520,14 @@ static int post_initialize_exe(Tracee *tracee, const Cli *cli UNUSED,
 	if (tracee->qemu[0] == NULL)
 		return -1;
 
+	/* Validate once what expand_runner() relies on for every
+	 * exec: the runner never changes during a session.  */
+	if (tracee->qemu[0][0] != '/'
+	    || strlen(tracee->qemu[0]) + strlen(HOST_ROOTFS) >= PATH_MAX) {
+		note(tracee, ERROR, USER, "invalid runner path \"%s\"", tracee->qemu[0]);
+		return -1;
+	}
+
 	return 0;
 }
 
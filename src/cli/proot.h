@@ -50,9 +50,11 @@ static const char *recommended_su_bindings[] = {
 
 static int handle_option_r(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_b(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_bind_ci(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_q(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_w(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_v(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_seccomp_notif(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_V(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_h(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_k(Tracee *tracee, const Cli *cli, const char *value);
@@ -60,6 +62,15 @@ static int handle_option_0(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_i(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_R(Tracee *tracee, const Cli *cli, const char *value);
 static int handle_option_S(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_exec_cache(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_trace(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_bindings_file(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_bindings_cache(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_session_cache(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_cpus(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_sched_fifo(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_shadow_ldcache(Tracee *tracee, const Cli *cli, const char *value);
+static int handle_option_analyze_bindings(Tracee *tracee, const Cli *cli, const char *value);
 
 static int pre_initialize_bindings(Tracee *, const Cli *, size_t, char *const *, size_t);
 static int post_initialize_exe(Tracee *, const Cli *, size_t, char *const *, size_t);
@@ -116,6 +127,22 @@ Copyright (C) 2014 STMicroelectronics, licensed under GPL v2 or later.",
 \tbehavior shouldn't be a problem, although it is possible to\n\
 \texplicitly not dereference the guest location by appending it the\n\
 \t! character: -b *host_path*:*guest_location!*.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--bind-ci", .separator = '=', .value = "path" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_bind_ci,
+	  .description = "Like --bind, but paths below it are matched without case.",
+	  .detail = "\tThis option accepts the same *host_path*:*guest_location*\n\
+\tsyntax as -b, and additionally makes every path below the binding\n\
+\tcase-insensitive: a component that does not exist with the exact\n\
+\tcase is looked up in its directory without case, and resolves to\n\
+\tthe on-disk spelling if exactly such an entry exists.  This\n\
+\tprovides Windows-like path semantics to programs run through\n\
+\tWine, without a case-folding file-system.  Probe results are\n\
+\tcached per directory; paths outside such bindings keep the\n\
+\tregular, case-sensitive resolution.",
 	},
 	{ .class = "Regular options",
 	  .arguments = {
@@ -153,6 +180,144 @@ Copyright (C) 2014 STMicroelectronics, licensed under GPL v2 or later.",
 	  .detail = "\tThe higher the integer value is, the more detailed debug\n\
 \tinformation is printed to the standard error stream.  A negative\n\
 \tvalue makes PRoot quiet except on fatal errors.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--seccomp-notif", .separator = '\0', .value = NULL },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_seccomp_notif,
+	  .description = "Emulate read-only path syscalls through seccomp user-notification.",
+	  .detail = "\tSyscalls that rewrite no register in the tracee (stat, lstat,\n\
+\taccess, statfs) are emulated by PRoot upon a seccomp notification\n\
+\tinstead of two ptrace stops each, which lowers their overhead.\n\
+\tThis requires Linux 5.0 or later; syscalls handled by an\n\
+\textension stay on the ptrace engine.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--exec-cache", .separator = '=', .value = "path" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_exec_cache,
+	  .description = "Persist exec-related caches into the file *path*.",
+	  .detail = "\tThe results of the ELF, shebang and ld.so analyses performed\n\
+\tat each execve(2) are kept in *path*, a file mapped in memory and\n\
+\tshared across PRoot invocations, so a fresh PRoot process starts\n\
+\twith a warm exec pipeline.  Entries are keyed by file identity\n\
+\tand validated lazily, thus the file may be reused as long as the\n\
+\tsame guest rootfs is in use; it is reset automatically otherwise.\n\
+\tConcurrent PRoot instances may share the same cache file.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--trace", .separator = '=', .value = "path" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_trace,
+	  .description = "Record one compact binary record per syscall into *path*.",
+	  .detail = "\tEach intercepted syscall is recorded -- timestamp, pid, sysnum,\n\
+\tlatency and a hash of the translated path -- into a ring buffer\n\
+\tthat a dedicated thread flushes to *path*, so recording barely\n\
+\tdistorts the traced workload.  See trace2json.py in the sources\n\
+\tto convert the result into the Chrome trace-event format, which\n\
+\tspeedscope and Perfetto can load.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--bindings-file", .separator = '=', .value = "path" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_bindings_file,
+	  .description = "Read bindings from the file *path*, re-read on SIGHUP.",
+	  .detail = "\tEach line of *path* declares one binding, with the same\n\
+\thost_path[:guest_location] syntax as the -b option; empty lines\n\
+\tand # comments are skipped.  The file is read once at start-up,\n\
+\tthen re-read each time PRoot receives a SIGHUP: the new set of\n\
+\tbindings -- the file content plus the rootfs -- atomically\n\
+\treplaces the current one, in between two tracee stops.  This\n\
+\tlets long-lived sessions add and remove bindings without being\n\
+\trestarted, and without over-provisioning bindings up front.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--bindings-cache", .separator = '=', .value = "path" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_bindings_cache,
+	  .description = "Compile the initialized bindings into the file *path*.",
+	  .detail = "\tOnce the bindings are initialized -- that is, canonicalized\n\
+\tand sorted -- they are compiled into *path*, a binary file that\n\
+\tthe next invocation maps in memory and adopts as-is, skipping\n\
+\tthe per-binding canonicalization; this matters for wrappers that\n\
+\tpass hundreds of -b options.  The file records a digest of the\n\
+\traw binding options it was compiled from and is rebuilt\n\
+\tautomatically whenever these options, the rootfs or the current\n\
+\tworking directory change.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--session-cache", .separator = '=', .value = "dir" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_session_cache,
+	  .description = "Cache the initialized session state into *dir*.",
+	  .detail = "\tShort-lived sessions launched over and over with the same\n\
+\tconfiguration pay the same start-up costs every time.  This\n\
+\toption persists the expensive artifacts into *dir* -- the\n\
+\tcompiled bindings (as with --bindings-cache), the compiled\n\
+\tseccomp program, the extracted loader, and the syscall\n\
+\tcapability probes made by -k -- so subsequent invocations adopt\n\
+\tthem as-is instead of rebuilding them.  Each\n\
+\tartifact records a digest of its inputs and is rebuilt\n\
+\tautomatically when the configuration changes.  The directory\n\
+\tmust exist and should not be shared between users: the cached\n\
+\tloader is executed by the tracees.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--cpus", .separator = '=', .value = "list" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_cpus,
+	  .description = "Pin PRoot itself to the CPUs in *list*, e.g. \"0,2,4-7\".",
+	  .detail = "\tWhen PRoot shares the machine with the workload it traces, its\n\
+\tscheduling latency inflates every syscall stop.  This option pins\n\
+\tthe event loop -- and every thread PRoot spawns later, like the\n\
+\t--trace flusher -- to dedicated CPUs.  The traced programs are\n\
+\tnot pinned: their affinity is reset to the whole machine when the\n\
+\tfirst one is launched.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--sched-fifo", .separator = '=', .value = "priority" },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_sched_fifo,
+	  .description = "Run PRoot under SCHED_FIFO at the given *priority*.",
+	  .detail = "\tPuts the event loop in the real-time FIFO scheduling class so\n\
+\tit preempts the traced workload as soon as a tracee stops,\n\
+\tinstead of waiting for a time-share slot.  The class is not\n\
+\tinherited: traced programs revert to the standard scheduler\n\
+\t(SCHED_RESET_ON_FORK).  Requires CAP_SYS_NICE or a matching\n\
+\tRLIMIT_RTPRIO.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--shadow-ldcache", .separator = '\0', .value = NULL },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_shadow_ldcache,
+	  .description = "Generate a \"/etc/ld.so.cache\" that matches the guest view.",
+	  .detail = "\tWithout an up-to-date cache in the guest rootfs, ld.so probes\n\
+\tevery library directory at each exec: dozens of failed open(2)\n\
+\tattempts, each paying the translation cost.  This option scans\n\
+\tthe guest library directories -- bound-in ones included -- once\n\
+\tat startup, then binds the generated cache over\n\
+\t\"/etc/ld.so.cache\"; the rootfs itself is left untouched.",
+	},
+	{ .class = "Regular options",
+	  .arguments = {
+		{ .name = "--analyze-bindings", .separator = '\0', .value = NULL },
+		{ .name = NULL, .separator = '\0', .value = NULL } },
+	  .handler = handle_option_analyze_bindings,
+	  .description = "Report per-binding lookup counters on exit.",
+	  .detail = "\tEach binding match is counted during the session; the report\n\
+\tprinted on exit lists the bindings most matched first and flags\n\
+\tthe ones that never matched.  Run a representative workload\n\
+\tunder this option to spot dead bindings: every configured\n\
+\tbinding costs translation work whether it is used or not.",
 	},
 	{ .class = "Regular options",
 	  .arguments = {
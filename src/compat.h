@@ -234,6 +234,9 @@
 #    ifndef O_CLOEXEC
 #        define O_CLOEXEC		02000000
 #    endif
+#    ifndef O_PATH
+#        define O_PATH			010000000
+#    endif
 #    ifndef MAP_PRIVATE
 #        define MAP_PRIVATE			0x02
 #    endif
@@ -243,5 +246,14 @@
 #    ifndef MAP_ANONYMOUS
 #        define MAP_ANONYMOUS			0x20
 #    endif
+#    ifndef SYS_pidfd_send_signal
+#        define SYS_pidfd_send_signal	424
+#    endif
+#    ifndef SYS_pidfd_open
+#        define SYS_pidfd_open		434
+#    endif
+#    ifndef P_PIDFD
+#        define P_PIDFD			3
+#    endif
 
 #endif /* COMPAT_H */
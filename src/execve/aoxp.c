@@ -130,6 +130,76 @@ end:
 	return 0;
 }
 
+/**
+ * Cache locally all the strings pointed to by @array in one bulk
+ * read.  At execve-time argv[] and envp[] strings lie contiguously
+ * near the top of the stack, so fetching the whole span costs a
+ * single transfer instead of one round trip per entry.  Entries whose
+ * string is not fully covered by the fetched block are simply left to
+ * the usual lazy per-entry reads, as is the whole array when its
+ * pointees do not look contiguous.  This function returns -errno if
+ * an error occured, otherwise 0; a skipped prefetch is not an error.
+ */
+int prefetch_xpointees_as_strings(ArrayOfXPointers *array)
+{
+	word_t min = 0;
+	word_t max = 0;
+	size_t size;
+	char *block;
+	size_t i;
+	int status;
+
+	for (i = 0; i < array->length; i++) {
+		word_t remote = array->_xpointers[i].remote;
+
+		if (array->_xpointers[i].local != NULL || remote == 0)
+			continue;
+
+		if (min == 0 || remote < min)
+			min = remote;
+		if (remote > max)
+			max = remote;
+	}
+
+	/* Nothing to prefetch.  */
+	if (min == 0)
+		return 0;
+
+	/* The last string extends past @max by an unknown length;
+	 * over-read up to the end of its page, no further -- the next
+	 * page might not be mapped.  */
+	size = max - min + 4096 - (max % 4096);
+	if (size > ARG_MAX)
+		return 0;
+
+	block = talloc_size(array, size);
+	if (block == NULL)
+		return -ENOMEM;
+
+	status = read_data(TRACEE(array), block, min, size);
+	if (status < 0) {
+		/* Not fatal: fall back to lazy reads.  */
+		talloc_free(block);
+		return 0;
+	}
+
+	for (i = 0; i < array->length; i++) {
+		word_t remote = array->_xpointers[i].remote;
+		size_t offset;
+
+		if (array->_xpointers[i].local != NULL || remote == 0)
+			continue;
+
+		offset = remote - min;
+		if (memchr(block + offset, '\0', size - offset) == NULL)
+			continue;
+
+		array->_xpointers[i].local = block + offset;
+	}
+
+	return 0;
+}
+
 /**
  * This function returns the number of bytes of the string pointed to
  * by @array[@index], otherwise -errno if an error occured.
@@ -318,18 +388,60 @@ int fetch_array_of_xpointers(Tracee *tracee, ArrayOfXPointers **array_, Reg reg,
 
 	address = peek_reg(tracee, CURRENT, reg);
 
-	for (i = 0; nb_entries != 0 ? i < nb_entries : pointer != 0; i++) {
-		void *tmp = talloc_realloc(array, array->_xpointers, XPointer, i + 1);
+	/* Fetch the pointer table by page-bounded blocks instead of
+	 * one word at a time: a typical compiler invocation has
+	 * hundreds of argv/envp entries.  */
+	i = 0;
+	while (nb_entries != 0 ? i < nb_entries : pointer != 0) {
+		const size_t ptr_size = sizeof_word(tracee);
+		const word_t block_address = address + i * ptr_size;
+		uint8_t block[4096];
+		size_t nb_pointers;
+		void *tmp;
+		size_t j;
+		int status;
+
+		nb_pointers = (sizeof(block) - (block_address % sizeof(block))) / ptr_size;
+		if (nb_pointers == 0)
+			nb_pointers = 1;
+		if (nb_entries != 0 && nb_pointers > nb_entries - i)
+			nb_pointers = nb_entries - i;
+
+		tmp = talloc_realloc(array, array->_xpointers, XPointer, i + nb_pointers);
 		if (tmp == NULL)
 			return -ENOMEM;
 		array->_xpointers = tmp;
 
-		pointer = peek_word(tracee, address + i * sizeof_word(tracee));
-		if (errno != 0)
-			return -errno;
-
-		array->_xpointers[i].remote = pointer;
-		array->_xpointers[i].local = NULL;
+		status = read_data(tracee, block, block_address, nb_pointers * ptr_size);
+		if (status < 0) {
+			/* The block may straddle an unmapped page even
+			 * though the terminator lies before it:
+			 * degrade to a single word.  */
+			pointer = peek_word(tracee, block_address);
+			if (errno != 0)
+				return -errno;
+
+			array->_xpointers[i].remote = pointer;
+			array->_xpointers[i].local = NULL;
+			i++;
+			continue;
+		}
+
+		for (j = 0; j < nb_pointers; j++) {
+			if (is_32on64_mode(tracee))
+				pointer = ((uint32_t *) block)[j];
+			else
+				pointer = ((word_t *) block)[j];
+
+			array->_xpointers[i + j].remote = pointer;
+			array->_xpointers[i + j].local = NULL;
+
+			if (nb_entries == 0 && pointer == 0) {
+				j++;
+				break;
+			}
+		}
+		i += j;
 	}
 	array->length = i;
 
@@ -353,10 +465,10 @@ int fetch_array_of_xpointers(Tracee *tracee, ArrayOfXPointers **array_, Reg reg,
 int push_array_of_xpointers(ArrayOfXPointers *array, Reg reg)
 {
 	Tracee *tracee;
-	struct iovec *local;
-	size_t local_count;
+	size_t nb_modified;
 	size_t total_size;
-	word_t *pod_array;
+	ssize_t *sizes;
+	uint8_t *buffer;
 	word_t tracee_ptr;
 	int status;
 	size_t i;
@@ -367,25 +479,16 @@ int push_array_of_xpointers(ArrayOfXPointers *array, Reg reg)
 
 	tracee = TRACEE(array);
 
-	/* The pointer table is a POD array in the tracee's memory.  */
-	pod_array = talloc_zero_size(tracee->ctx, array->length * sizeof_word(tracee));
-	if (pod_array == NULL)
-		return -ENOMEM;
-
-	/* There's one vector per modified pointee + one vector for the
-	 * pod array.  */
-	local = talloc_zero_array(tracee->ctx, struct iovec, array->length + 1);
-	if (local == NULL)
+	sizes = talloc_zero_array(tracee->ctx, ssize_t, array->length);
+	if (sizes == NULL)
 		return -ENOMEM;
 
 	/* The pod array is expected to be at the beginning of the
-	 * allocated memory by the caller.  */
+	 * allocated memory by the caller, all the modified pointees
+	 * lie contiguously right after it.  */
 	total_size = array->length * sizeof_word(tracee);
-	local[0].iov_base = pod_array;
-	local[0].iov_len  = total_size;
-	local_count = 1;
 
-	/* Create one vector for each modified pointee.  */
+	nb_modified = 0;
 	for (i = 0; i < array->length; i++) {
 		ssize_t size;
 
@@ -401,15 +504,21 @@ int push_array_of_xpointers(ArrayOfXPointers *array, Reg reg)
 			return size;
 		total_size += size;
 
-		local[local_count].iov_base = array->_xpointers[i].local;
-		local[local_count].iov_len  = size;
-		local_count++;
+		sizes[i] = size;
+		nb_modified++;
 	}
 
 	/* Nothing has changed, don't update anything.  */
-	if (local_count == 1)
+	if (nb_modified == 0)
 		return 0;
-	assert(local_count < array->length + 1);
+
+	/* Lay the pod array and the modified pointees out in one
+	 * contiguous local buffer, pushed with a single transfer:
+	 * exec'ing a script with a large environment used to produce
+	 * one small write per string, at the worst possible time.  */
+	buffer = talloc_zero_size(tracee->ctx, total_size);
+	if (buffer == NULL)
+		return -ENOMEM;
 
 	/* Modified pointees and the pod array are stored in a tracee's
 	 * memory block.  */
@@ -420,17 +529,21 @@ int push_array_of_xpointers(ArrayOfXPointers *array, Reg reg)
 	/* Now, we know the absolute addresses in the tracee's
 	 * memory.  */
 	for (i = 0; i < array->length; i++) {
-		if (array->_xpointers[i].local != NULL)
+		if (array->_xpointers[i].local != NULL) {
+			memcpy(buffer + array->_xpointers[i].remote,
+				array->_xpointers[i].local, sizes[i]);
+
 			array->_xpointers[i].remote += tracee_ptr;
+		}
 
 		if (is_32on64_mode(tracee))
-			((uint32_t *) pod_array)[i] = array->_xpointers[i].remote;
+			((uint32_t *) buffer)[i] = array->_xpointers[i].remote;
 		else
-			pod_array[i] = array->_xpointers[i].remote;
+			((word_t *) buffer)[i] = array->_xpointers[i].remote;
 	}
 
 	/* Write all the modified pointees and the pod array at once.  */
-	status = writev_data(tracee, tracee_ptr, local, local_count);
+	status = write_data(tracee, tracee_ptr, buffer, total_size);
 	if (status < 0)
 		return status;
 
@@ -72,6 +72,7 @@ extern int push_array_of_xpointers(ArrayOfXPointers *array, Reg reg);
 
 extern int read_xpointee_as_object(ArrayOfXPointers *array, size_t index, void **object);
 extern int read_xpointee_as_string(ArrayOfXPointers *array, size_t index, char **string);
+extern int prefetch_xpointees_as_strings(ArrayOfXPointers *array);
 extern int write_xpointee_as_string(ArrayOfXPointers *array, size_t index, const char *string);
 extern int write_xpointees(ArrayOfXPointers *array, size_t index, size_t nb_xpointees, ...);
 extern int compare_xpointee_generic(ArrayOfXPointers *array, size_t index, const void *reference);
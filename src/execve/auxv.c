@@ -22,6 +22,7 @@
 
 #include <linux/auxvec.h>  /* AT_*,  */
 #include <assert.h>        /* assert(3),  */
+#include <stdint.h>        /* uint*_t,  */
 #include <errno.h>         /* E*,  */
 #include <unistd.h>        /* write(3), close(3), */
 #include <sys/types.h>     /* open(2), */
@@ -116,6 +117,7 @@ word_t get_elf_aux_vectors_address(const Tracee *tracee)
  */
 ElfAuxVector *fetch_elf_aux_vectors(const Tracee *tracee, word_t address)
 {
+	const size_t entry_size = 2 * sizeof_word(tracee);
 	ElfAuxVector *vectors = NULL;
 	ElfAuxVector vector;
 	int status;
@@ -128,25 +130,59 @@ ElfAuxVector *fetch_elf_aux_vectors(const Tracee *tracee, word_t address)
 	vectors[0].value = 0;
 
 	while (1) {
-		vector.type = peek_word(tracee, address);
-		if (errno != 0)
-			return NULL;
-		address += sizeof_word(tracee);
-
-		if (vector.type == AT_NULL)
-			break; /* Already added.  */
-
-		vector.value = peek_word(tracee, address);
-		if (errno != 0)
-			return NULL;
-		address += sizeof_word(tracee);
-
-		status = add_elf_aux_vector(&vectors, vector.type, vector.value);
-		if (status < 0)
-			return NULL;
+		uint8_t block[4096];
+		size_t nb_entries;
+		size_t i;
+
+		/* Fetch whole page-bounded blocks of vectors at once
+		 * instead of one word per transfer.  */
+		nb_entries = (sizeof(block) - (address % sizeof(block))) / entry_size;
+		if (nb_entries == 0)
+			nb_entries = 1;
+
+		status = read_data(tracee, block, address, nb_entries * entry_size);
+		if (status < 0) {
+			/* The block may straddle an unmapped page:
+			 * degrade to a single entry.  */
+			vector.type = peek_word(tracee, address);
+			if (errno != 0)
+				return NULL;
+
+			vector.value = peek_word(tracee, address + sizeof_word(tracee));
+			if (errno != 0)
+				return NULL;
+
+			if (vector.type == AT_NULL)
+				return vectors; /* Already added.  */
+
+			status = add_elf_aux_vector(&vectors, vector.type, vector.value);
+			if (status < 0)
+				return NULL;
+
+			address += entry_size;
+			continue;
+		}
+
+		for (i = 0; i < nb_entries; i++) {
+			if (is_32on64_mode(tracee)) {
+				vector.type  = ((uint32_t *) block)[2 * i];
+				vector.value = ((uint32_t *) block)[2 * i + 1];
+			}
+			else {
+				vector.type  = ((word_t *) block)[2 * i];
+				vector.value = ((word_t *) block)[2 * i + 1];
+			}
+
+			if (vector.type == AT_NULL)
+				return vectors; /* Already added.  */
+
+			status = add_elf_aux_vector(&vectors, vector.type, vector.value);
+			if (status < 0)
+				return NULL;
+		}
+
+		address += nb_entries * entry_size;
 	}
-
-	return vectors;
 }
 
 /**
@@ -156,29 +192,30 @@ ElfAuxVector *fetch_elf_aux_vectors(const Tracee *tracee, word_t address)
  */
 int push_elf_aux_vectors(const Tracee* tracee, ElfAuxVector *vectors, word_t address)
 {
+	const size_t entry_size = 2 * sizeof_word(tracee);
+	size_t nb_vectors;
+	uint8_t *block;
 	size_t i;
 
-	for (i = 0; vectors[i].type != AT_NULL; i++) {
-		poke_word(tracee, address, vectors[i].type);
-		if (errno != 0)
-			return -errno;
-		address += sizeof_word(tracee);
-
-		poke_word(tracee, address, vectors[i].value);
-		if (errno != 0)
-			return -errno;
-		address += sizeof_word(tracee);
-	}
+	for (nb_vectors = 0; vectors[nb_vectors].type != AT_NULL; nb_vectors++)
+		;
 
-	poke_word(tracee, address, AT_NULL);
-	if (errno != 0)
-		return -errno;
-	address += sizeof_word(tracee);
+	/* Lay the whole table out -- sentinel included -- in the
+	 * tracee's ABI, then push it back with a single transfer.  */
+	block = talloc_zero_size(tracee->ctx, (nb_vectors + 1) * entry_size);
+	if (block == NULL)
+		return -ENOMEM;
 
-	poke_word(tracee, address, 0);
-	if (errno != 0)
-		return -errno;
-	address += sizeof_word(tracee);
+	for (i = 0; i < nb_vectors; i++) {
+		if (is_32on64_mode(tracee)) {
+			((uint32_t *) block)[2 * i]     = vectors[i].type;
+			((uint32_t *) block)[2 * i + 1] = vectors[i].value;
+		}
+		else {
+			((word_t *) block)[2 * i]     = vectors[i].type;
+			((word_t *) block)[2 * i + 1] = vectors[i].value;
+		}
+	}
 
-	return 0;
+	return write_data(tracee, address, block, (nb_vectors + 1) * entry_size);
 }
@@ -0,0 +1,214 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <sys/mman.h>  /* mmap(2), munmap(2), */
+#include <sys/types.h> /* open(2), fstat(2), */
+#include <sys/stat.h>  /* open(2), fstat(2), */
+#include <fcntl.h>     /* open(2), */
+#include <sys/file.h>  /* flock(2), */
+#include <unistd.h>    /* close(2), ftruncate(2), */
+#include <stdlib.h>    /* getenv(3), */
+#include <string.h>    /* strcmp(3), memset(3), */
+#include <errno.h>     /* -E*, */
+
+#include "execve/disk_cache.h"
+#include "path/binding.h"
+
+/* The exec cache is an optional mmap-ed file shared across PRoot
+ * invocations (see the --exec-cache option).  It persists the results
+ * of the in-memory exec caches -- ELF load info, shebang extraction,
+ * host ld.so paths -- so a fresh PRoot process starts with a warm
+ * exec pipeline; this matters for workloads made of many short
+ * sessions over the same rootfs.
+ *
+ * Records are keyed by file identity (dev, ino, size, mtime) and
+ * validated lazily on lookup, thus the file never has to be flushed
+ * or rebuilt eagerly.  The translated paths it contains (ELF
+ * interpreter, ld.so search list) are only guaranteed against the
+ * guest rootfs recorded in the header: the whole cache is reset when
+ * it was built for another rootfs.  Sessions whose extra bindings
+ * remap these paths should not share a cache file.  */
+
+#define EXEC_CACHE_MAGIC   0x45584543	/* "EXEC" */
+#define EXEC_CACHE_VERSION 3
+
+#define NB_DISK_LOAD_INFO  64
+#define NB_DISK_SHEBANG    128
+#define NB_DISK_LDSO_PATHS 32
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	char root[PATH_MAX];
+
+	/* Initial LD_LIBRARY_PATH the ldso_paths records below were
+	 * merged with (see rebuild_host_ldso_paths()): a session
+	 * started with another value must not reuse them.  Only these
+	 * records embed it, hence the partial reset in
+	 * open_exec_cache().  */
+	char ldso_env[DISK_LDSO_PATHS_SIZE];
+
+	DiskLoadInfo load_info[NB_DISK_LOAD_INFO];
+	DiskShebang shebang[NB_DISK_SHEBANG];
+	DiskLdsoPaths ldso_paths[NB_DISK_LDSO_PATHS];
+} ExecCache;
+
+static ExecCache *exec_cache;
+
+/* Cleared when this session's LD_LIBRARY_PATH is too long to be
+ * recorded in the header: the ldso_paths records are then neither
+ * served nor filled, like over-long path lists themselves.  */
+static bool ldso_records_usable = true;
+
+/**
+ * Map the exec cache file @path into memory, creating or resetting it
+ * as needed.  This function returns -errno if an error occured,
+ * otherwise 0.
+ */
+int open_exec_cache(Tracee *tracee, const char *path)
+{
+	const char *ldso_env;
+	const char *root;
+	struct stat statl;
+	void *mapping;
+	int status;
+	int fd;
+
+	root = get_root(tracee);
+	if (root == NULL || strlen(root) >= sizeof(exec_cache->root))
+		return -EINVAL;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return -errno;
+
+	/* Serialize the creation and reset sequence below: many
+	 * sessions typically start concurrently over the same cache
+	 * file, and a reset must neither wipe records another
+	 * instance is filling, nor race with its ftruncate(2).  The
+	 * lock is dropped before any record is served, lookups stay
+	 * lock-free.  */
+	(void) flock(fd, LOCK_EX);
+
+	status = fstat(fd, &statl);
+	if (status < 0) {
+		status = -errno;
+		close(fd);
+		return status;
+	}
+
+	if (statl.st_size != sizeof(ExecCache)) {
+		status = ftruncate(fd, sizeof(ExecCache));
+		if (status < 0) {
+			status = -errno;
+			close(fd);
+			return status;
+		}
+	}
+
+	mapping = mmap(NULL, sizeof(ExecCache), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED) {
+		status = -errno;
+		close(fd);
+		return status;
+	}
+
+	exec_cache = mapping;
+
+	/* Reset on format change, and when the recorded translated
+	 * paths were computed against another guest rootfs.  */
+	if (exec_cache->magic != EXEC_CACHE_MAGIC
+	    || exec_cache->version != EXEC_CACHE_VERSION
+	    || strcmp(exec_cache->root, root) != 0) {
+		memset(exec_cache, 0, sizeof(ExecCache));
+		strcpy(exec_cache->root, root);
+		exec_cache->version = EXEC_CACHE_VERSION;
+		exec_cache->magic = EXEC_CACHE_MAGIC;
+	}
+
+	/* The ldso_paths records embed the initial LD_LIBRARY_PATH of
+	 * the session that filled them; reset them -- and only them --
+	 * when this session starts with another value.  The default
+	 * mirrors rebuild_host_ldso_paths().  */
+	ldso_env = getenv("LD_LIBRARY_PATH") ?: "/";
+	if (strlen(ldso_env) >= sizeof(exec_cache->ldso_env)) {
+		memset(exec_cache->ldso_paths, 0, sizeof(exec_cache->ldso_paths));
+		exec_cache->ldso_env[0] = '\0';
+		ldso_records_usable = false;
+	}
+	else if (strcmp(exec_cache->ldso_env, ldso_env) != 0) {
+		memset(exec_cache->ldso_paths, 0, sizeof(exec_cache->ldso_paths));
+		strcpy(exec_cache->ldso_env, ldso_env);
+	}
+
+	close(fd);
+
+	return 0;
+}
+
+/**
+ * Check whether the record owning @key belongs to the file described
+ * by @statl.
+ */
+bool disk_cache_hit(const DiskCacheKey *key, const struct stat *statl)
+{
+	return (key->valid != 0
+		&& key->dev == statl->st_dev
+		&& key->ino == statl->st_ino
+		&& key->size == statl->st_size
+		&& key->mtime == statl->st_mtime);
+}
+
+/**
+ * Fill @key from @statl, then mark the record valid.  The caller
+ * shall have cleared @key->valid before overwriting the payload, so
+ * concurrent readers see a half-written record as a miss.
+ */
+void seal_disk_cache_entry(DiskCacheKey *key, const struct stat *statl)
+{
+	key->dev   = statl->st_dev;
+	key->ino   = statl->st_ino;
+	key->size  = statl->st_size;
+	key->mtime = statl->st_mtime;
+	key->valid = 1;
+}
+
+DiskLoadInfo *find_disk_load_info(const struct stat *statl)
+{
+	if (exec_cache == NULL)
+		return NULL;
+	return &exec_cache->load_info[statl->st_ino % NB_DISK_LOAD_INFO];
+}
+
+DiskShebang *find_disk_shebang(const struct stat *statl)
+{
+	if (exec_cache == NULL)
+		return NULL;
+	return &exec_cache->shebang[statl->st_ino % NB_DISK_SHEBANG];
+}
+
+DiskLdsoPaths *find_disk_ldso_paths(const struct stat *statl)
+{
+	if (exec_cache == NULL || !ldso_records_usable)
+		return NULL;
+	return &exec_cache->ldso_paths[statl->st_ino % NB_DISK_LDSO_PATHS];
+}
@@ -0,0 +1,98 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <sys/types.h>     /* dev_t, ino_t, off_t, time_t, */
+#include <sys/stat.h>      /* struct stat, */
+#include <stdint.h>        /* uint32_t, */
+#include <stdbool.h>       /* bool, */
+#include <linux/limits.h>  /* PATH_MAX, */
+#include <linux/binfmts.h> /* BINPRM_BUF_SIZE, */
+
+#include "tracee/tracee.h"
+#include "execve/execve.h"
+#include "execve/elf.h"
+
+/* Key of an on-disk record.  @valid is written last when a record is
+ * filled (see seal_disk_cache_entry()), so a record overwritten by a
+ * concurrent PRoot instance is seen as a miss at worst.  */
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	uint32_t valid;
+} DiskCacheKey;
+
+/* Binaries with more mappings than this are simply not cached on
+ * disk; in practice an ELF object has a handful of PT_LOAD
+ * segments.  */
+#define NB_DISK_MAPPINGS 16
+
+typedef struct {
+	DiskCacheKey key;
+	ElfHeader elf_header;
+	uint32_t nb_mappings;
+	Mapping mappings[NB_DISK_MAPPINGS];
+	uint32_t has_interp;
+	char interp_host_path[PATH_MAX];
+	char interp_user_path[PATH_MAX];
+	ElfHeader interp_elf_header;
+	uint32_t interp_nb_mappings;
+	Mapping interp_mappings[NB_DISK_MAPPINGS];
+
+	/* Freshness of the interpreter the mappings above were parsed
+	 * from: the record is keyed by the main binary, but ld.so can
+	 * be replaced -- a glibc upgrade -- without the binaries that
+	 * point to it changing.  Meaningless when @has_interp is 0.  */
+	DiskCacheKey interp_key;
+} DiskLoadInfo;
+
+typedef struct {
+	DiskCacheKey key;
+	uint32_t has_shebang;
+	char user_path[BINPRM_BUF_SIZE];
+	char argument[BINPRM_BUF_SIZE];
+} DiskShebang;
+
+/* Host ld.so path lists are typically a few hundred bytes; longer
+ * ones are simply not cached on disk.  */
+#define DISK_LDSO_PATHS_SIZE 4096
+
+typedef struct {
+	DiskCacheKey key;
+	uint32_t rpath_found;
+	char host_ldso_paths[DISK_LDSO_PATHS_SIZE];
+} DiskLdsoPaths;
+
+extern int open_exec_cache(Tracee *tracee, const char *path);
+
+extern DiskLoadInfo *find_disk_load_info(const struct stat *statl);
+extern DiskShebang *find_disk_shebang(const struct stat *statl);
+extern DiskLdsoPaths *find_disk_ldso_paths(const struct stat *statl);
+
+extern bool disk_cache_hit(const DiskCacheKey *key, const struct stat *statl);
+extern void seal_disk_cache_entry(DiskCacheKey *key, const struct stat *statl);
+
+#endif /* DISK_CACHE_H */
@@ -21,7 +21,9 @@
  */
 
 #include <fcntl.h>  /* open(2), */
-#include <unistd.h> /* read(2), close(2), */
+#include <unistd.h> /* read(2), close(2), sysconf(3), */
+#include <sys/mman.h> /* mmap(2), munmap(2), */
+#include <sys/stat.h> /* stat(2), */
 #include <errno.h>  /* EACCES, ENOTSUP, */
 #include <stdint.h> /* UINT64_MAX, */
 #include <limits.h> /* PATH_MAX, */
@@ -88,6 +90,76 @@ end:
 	return fd;
 }
 
+/* Cache of ELF headers keyed by the identity (device, inode) of the
+ * underlying file: builds re-exec the same compilers, shells and
+ * tools over and over, each inspection costing an open(2) + read(2)
+ * + close(2) otherwise.  Entries are validated against the file's
+ * size and mtime so a recompiled binary is re-read; non-ELF results
+ * (-ENOEXEC typically) are cached too.  */
+#define NB_ELF_HEADER_CACHE_ENTRIES 64
+
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+
+	/* 0, or the -errno returned by open_elf().  */
+	int status;
+
+	ElfHeader elf_header;
+	bool valid;
+} ElfHeaderCacheEntry;
+
+static ElfHeaderCacheEntry elf_header_cache[NB_ELF_HEADER_CACHE_ENTRIES];
+
+/**
+ * Copy into @elf_header the ELF header of the file @t_path, reusing
+ * a previous read of the very same file when possible.  Unlike
+ * open_elf() no file descriptor is returned; this is for callers
+ * that only inspect the header.  This function returns -errno if an
+ * error occurred, otherwise 0.
+ */
+int read_elf_header(const char *t_path, ElfHeader *elf_header)
+{
+	ElfHeaderCacheEntry *entry;
+	struct stat statl;
+	int status;
+	int fd;
+
+	status = stat(t_path, &statl);
+	if (status < 0)
+		return -errno;
+
+	entry = &elf_header_cache[statl.st_ino % NB_ELF_HEADER_CACHE_ENTRIES];
+	if (   entry->valid
+	    && entry->dev   == statl.st_dev
+	    && entry->ino   == statl.st_ino
+	    && entry->size  == statl.st_size
+	    && entry->mtime == statl.st_mtime) {
+		if (entry->status < 0)
+			return entry->status;
+
+		memcpy(elf_header, &entry->elf_header, sizeof(ElfHeader));
+		return 0;
+	}
+
+	fd = open_elf(t_path, elf_header);
+	if (fd >= 0)
+		close(fd);
+
+	entry->dev    = statl.st_dev;
+	entry->ino    = statl.st_ino;
+	entry->size   = statl.st_size;
+	entry->mtime  = statl.st_mtime;
+	entry->status = (fd >= 0 ? 0 : fd);
+	if (fd >= 0)
+		memcpy(&entry->elf_header, elf_header, sizeof(ElfHeader));
+	entry->valid = true;
+
+	return entry->status;
+}
+
 /**
  * Invoke @callback(..., @data) for each program headers from the
  * specified ELF file (referenced by @fd, with the given @elf_header).
@@ -103,6 +175,12 @@ int iterate_program_headers(const Tracee *tracee, int fd, const ElfHeader *elf_h
 	uint16_t elf_phentsize;
 	uint16_t elf_phnum;
 
+	uint64_t page_offset;
+	size_t mapping_size;
+	long page_size;
+	struct stat statl;
+	void *mapping;
+
 	int status;
 	int i;
 
@@ -126,6 +204,42 @@ int iterate_program_headers(const Tracee *tracee, int fd, const ElfHeader *elf_h
 		return -ENOTSUP;
 	}
 
+	/* Walk the program header table from a read-only mapping
+	 * instead of one read(2) per entry: fewer syscalls per exec,
+	 * and the pages are shared with every other process that
+	 * inspects or executes the same binary.  */
+	status = fstat(fd, &statl);
+	if (status < 0)
+		return -errno;
+
+	if (elf_phoff > (uint64_t) statl.st_size
+	    || (uint64_t) elf_phnum * elf_phentsize > statl.st_size - elf_phoff)
+		return -ENOEXEC;
+
+	page_size   = sysconf(_SC_PAGESIZE);
+	page_offset = elf_phoff & ~((uint64_t) page_size - 1);
+	mapping_size = (elf_phoff - page_offset) + elf_phnum * elf_phentsize;
+
+	mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, page_offset);
+	if (mapping != MAP_FAILED) {
+		const uint8_t *cursor = (uint8_t *) mapping + (elf_phoff - page_offset);
+
+		for (i = 0; i < elf_phnum; i++) {
+			memcpy(&program_header, cursor + i * elf_phentsize, elf_phentsize);
+
+			status = callback(elf_header, &program_header, data);
+			if (status != 0) {
+				munmap(mapping, mapping_size);
+				return status;
+			}
+		}
+
+		munmap(mapping, mapping_size);
+		return 0;
+	}
+
+	/* Fall back to lseek(2) + read(2), for the unlikely case the
+	 * underlying file-system does not support mmap(2).  */
 	status = (int) lseek(fd, elf_phoff, SEEK_SET);
 	if (status < 0)
 		return -errno;
@@ -152,7 +266,6 @@ bool is_host_elf(const Tracee *tracee, const char *host_path)
 	static int force_foreign = -1;
 	ElfHeader elf_header;
 	uint16_t elf_machine;
-	int fd;
 	int i;
 
 	if (force_foreign < 0)
@@ -161,10 +274,8 @@ bool is_host_elf(const Tracee *tracee, const char *host_path)
 	if (force_foreign > 0 || !tracee->qemu)
 		return false;
 
-	fd = open_elf(host_path, &elf_header);
-	if (fd < 0)
+	if (read_elf_header(host_path, &elf_header) < 0)
 		return false;
-	close(fd);
 
 	elf_machine = ELF_FIELD(elf_header, machine);
 	for (i = 0; host_elf_machine[i] != 0; i++) {
@@ -166,6 +166,7 @@ typedef enum {
 #include "tracee/tracee.h"
 
 extern int open_elf(const char *t_path, ElfHeader *elf_header);
+extern int read_elf_header(const char *t_path, ElfHeader *elf_header);
 
 extern bool is_host_elf(const Tracee *tracee, const char *t_path);
 
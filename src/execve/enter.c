@@ -23,6 +23,7 @@
 #include <sys/types.h>  /* lstat(2), lseek(2), */
 #include <sys/stat.h>   /* lstat(2), lseek(2), fchmod(2), */
 #include <unistd.h>     /* access(2), lstat(2), close(2), read(2), */
+#include <fcntl.h>      /* fcntl(2), F_*, */
 #include <errno.h>      /* E*, */
 #include <assert.h>     /* assert(3), */
 #include <talloc.h>     /* talloc*, */
@@ -30,6 +31,7 @@
 #include <string.h>     /* strlen(3), strcpy(3), */
 #include <stdlib.h>     /* getenv(3), */
 #include <stdio.h>      /* fwrite(3), */
+#include <time.h>       /* clock_gettime(2), */
 #include <assert.h>     /* assert(3), */
 
 #include "execve/execve.h"
@@ -37,7 +39,10 @@
 #include "execve/aoxp.h"
 #include "execve/ldso.h"
 #include "execve/elf.h"
+#include "execve/disk_cache.h"
+#include "execve/profile.h"
 #include "path/path.h"
+#include "path/cache.h"
 #include "path/temp.h"
 #include "tracee/tracee.h"
 #include "syscall/syscall.h"
@@ -299,6 +304,213 @@ end:
 	return status;
 }
 
+/* Cache of parsed load info, keyed by file identity: a warm exec of
+ * an already-seen binary skips re-opening and re-parsing the ELF
+ * header and program headers of both the program and its ELF
+ * interpreter.  The interpreter path embeds a translated guest path,
+ * hence each entry also records which file-system name-space it was
+ * computed in, and goes stale at the same points the path cache is
+ * flushed.  */
+#define NB_LOAD_INFO_CACHE 32
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	const FileSystemNameSpace *fs;
+	uint64_t generation;
+	LoadInfo *load_info;
+
+	/* Freshness of the recorded ELF interpreter, meaningless when
+	 * @load_info has none; like the on-disk records, the entry is
+	 * keyed by the main binary only, see disk_interp_fresh().  */
+	DiskCacheKey interp_key;
+} LoadInfoCacheEntry;
+
+static LoadInfoCacheEntry load_info_cache[NB_LOAD_INFO_CACHE];
+
+/**
+ * Check whether the ELF interpreter recorded by @entry is still the
+ * one on disk; c.f. disk_interp_fresh() for the rationale.
+ */
+static bool cached_interp_fresh(const LoadInfoCacheEntry *entry)
+{
+	struct stat statl;
+
+	if (entry->load_info->interp == NULL)
+		return true;
+
+	return (stat(entry->load_info->interp->host_path, &statl) == 0
+		&& disk_cache_hit(&entry->interp_key, &statl));
+}
+
+/**
+ * Copy into @dest the parsed fields of @source: ELF header, mappings,
+ * and ELF interpreter -- everything but the paths of the program
+ * itself, which change from one exec to the next.  This function
+ * returns -errno if an error occured, otherwise 0.
+ */
+static int copy_load_info(LoadInfo *dest, const LoadInfo *source)
+{
+	dest->elf_header = source->elf_header;
+
+	if (source->mappings != NULL) {
+		dest->mappings = talloc_memdup(dest, source->mappings,
+					talloc_get_size(source->mappings));
+		if (dest->mappings == NULL)
+			return -ENOMEM;
+	}
+
+	if (source->interp == NULL)
+		return 0;
+
+	dest->interp = talloc_zero(dest, LoadInfo);
+	if (dest->interp == NULL)
+		return -ENOMEM;
+
+	dest->interp->elf_header = source->interp->elf_header;
+
+	dest->interp->host_path = talloc_strdup(dest->interp, source->interp->host_path);
+	if (dest->interp->host_path == NULL)
+		return -ENOMEM;
+
+	dest->interp->user_path = talloc_strdup(dest->interp, source->interp->user_path);
+	if (dest->interp->user_path == NULL)
+		return -ENOMEM;
+
+	if (source->interp->mappings != NULL) {
+		dest->interp->mappings = talloc_memdup(dest->interp,
+						source->interp->mappings,
+						talloc_get_size(source->interp->mappings));
+		if (dest->interp->mappings == NULL)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * Check whether the fixed-format on-disk record @disk can be turned
+ * back into a LoadInfo without truncation.
+ */
+static bool disk_load_info_usable(const DiskLoadInfo *disk)
+{
+	if (disk->nb_mappings == 0 || disk->nb_mappings > NB_DISK_MAPPINGS)
+		return false;
+
+	if (disk->has_interp == 0)
+		return true;
+
+	return (disk->interp_nb_mappings > 0
+		&& disk->interp_nb_mappings <= NB_DISK_MAPPINGS
+		&& strnlen(disk->interp_host_path, PATH_MAX) < PATH_MAX
+		&& strnlen(disk->interp_user_path, PATH_MAX) < PATH_MAX);
+}
+
+/**
+ * Check whether the interpreter whose mappings are recorded in @disk
+ * is still the one on disk: the record is keyed by the main binary,
+ * but a glibc upgrade replaces ld.so without touching the binaries
+ * that point to it, and stale interpreter mappings would make the
+ * loader mmap wrong offsets from the new one.
+ */
+static bool disk_interp_fresh(const DiskLoadInfo *disk)
+{
+	struct stat statl;
+
+	if (disk->has_interp == 0)
+		return true;
+
+	return (stat(disk->interp_host_path, &statl) == 0
+		&& disk_cache_hit(&disk->interp_key, &statl));
+}
+
+/**
+ * Rebuild into @load_info the parsed fields recorded in @disk, which
+ * shall have been validated with disk_load_info_usable().  This
+ * function returns -errno if an error occured, otherwise 0.
+ */
+static int import_disk_load_info(LoadInfo *load_info, const DiskLoadInfo *disk)
+{
+	load_info->elf_header = disk->elf_header;
+
+	load_info->mappings = talloc_memdup(load_info, disk->mappings,
+					disk->nb_mappings * sizeof(Mapping));
+	if (load_info->mappings == NULL)
+		return -ENOMEM;
+
+	if (disk->has_interp == 0)
+		return 0;
+
+	load_info->interp = talloc_zero(load_info, LoadInfo);
+	if (load_info->interp == NULL)
+		return -ENOMEM;
+
+	load_info->interp->elf_header = disk->interp_elf_header;
+
+	load_info->interp->host_path = talloc_strdup(load_info->interp,
+						disk->interp_host_path);
+	if (load_info->interp->host_path == NULL)
+		return -ENOMEM;
+
+	load_info->interp->user_path = talloc_strdup(load_info->interp,
+						disk->interp_user_path);
+	if (load_info->interp->user_path == NULL)
+		return -ENOMEM;
+
+	load_info->interp->mappings = talloc_memdup(load_info->interp,
+					disk->interp_mappings,
+					disk->interp_nb_mappings * sizeof(Mapping));
+	if (load_info->interp->mappings == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * Record into @disk the parsed fields of @load_info, unless they
+ * don't fit the fixed on-disk format.
+ */
+static void export_disk_load_info(DiskLoadInfo *disk, const LoadInfo *load_info,
+				const struct stat *statl)
+{
+	struct stat interp_statl;
+	size_t nb_mappings;
+
+	nb_mappings = talloc_array_length(load_info->mappings);
+	if (nb_mappings == 0 || nb_mappings > NB_DISK_MAPPINGS)
+		return;
+
+	if (load_info->interp != NULL
+	    && (talloc_array_length(load_info->interp->mappings) == 0
+		|| talloc_array_length(load_info->interp->mappings) > NB_DISK_MAPPINGS
+		|| strlen(load_info->interp->host_path) >= PATH_MAX
+		|| strlen(load_info->interp->user_path) >= PATH_MAX
+		|| stat(load_info->interp->host_path, &interp_statl) < 0))
+		return;
+
+	disk->key.valid = 0;
+
+	disk->elf_header  = load_info->elf_header;
+	disk->nb_mappings = nb_mappings;
+	memcpy(disk->mappings, load_info->mappings, nb_mappings * sizeof(Mapping));
+
+	disk->has_interp = (load_info->interp != NULL);
+	if (disk->has_interp) {
+		nb_mappings = talloc_array_length(load_info->interp->mappings);
+
+		strcpy(disk->interp_host_path, load_info->interp->host_path);
+		strcpy(disk->interp_user_path, load_info->interp->user_path);
+		disk->interp_elf_header  = load_info->interp->elf_header;
+		disk->interp_nb_mappings = nb_mappings;
+		memcpy(disk->interp_mappings, load_info->interp->mappings,
+			nb_mappings * sizeof(Mapping));
+		seal_disk_cache_entry(&disk->interp_key, &interp_statl);
+	}
+
+	seal_disk_cache_entry(&disk->key, statl);
+}
+
 /**
  * Add @load_base to each adresses of @load_info.
  */
@@ -360,6 +572,7 @@ static void compute_load_addresses(Tracee *tracee)
  */
 static int expand_runner(Tracee* tracee, char host_path[PATH_MAX], char user_path[PATH_MAX])
 {
+	static char runner_user_path[PATH_MAX];
 	ArrayOfXPointers *envp;
 	char *argv0;
 	int status;
@@ -429,14 +642,20 @@ static int expand_runner(Tracee* tracee, char host_path[PATH_MAX], char user_pat
 			return status;
 
 		/* Launch the runner in lieu of the initial
-		 * program. */
-		assert(strlen(tracee->qemu[0]) + strlen(HOST_ROOTFS) < PATH_MAX);
-		assert(tracee->qemu[0][0] == '/');
+		 * program.  The runner was resolved and validated
+		 * once at startup (see post_initialize_exe() in
+		 * cli/proot.c) and never changes during a session, so
+		 * its guest-visible path is built only once.  */
+		if (runner_user_path[0] == '\0') {
+			assert(strlen(tracee->qemu[0]) + strlen(HOST_ROOTFS) < PATH_MAX);
+			assert(tracee->qemu[0][0] == '/');
+
+			strcpy(runner_user_path, HOST_ROOTFS);
+			strcat(runner_user_path, tracee->qemu[0]);
+		}
 
 		strcpy(host_path, tracee->qemu[0]);
-
-		strcpy(user_path, HOST_ROOTFS);
-		strcat(user_path, host_path);
+		strcpy(user_path, runner_user_path);
 	}
 
 	/* Provide information to the host dynamic linker to find host
@@ -453,12 +672,93 @@ static int expand_runner(Tracee* tracee, char host_path[PATH_MAX], char user_pat
 	return 0;
 }
 
+/* File sealing appeared in Linux 3.17, but older C libraries don't
+ * declare it.  */
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS	1033
+#define F_SEAL_SEAL	0x0001
+#define F_SEAL_SHRINK	0x0002
+#define F_SEAL_GROW	0x0004
+#define F_SEAL_WRITE	0x0008
+#endif
+
 extern unsigned char _binary_loader_exe_start;
 extern unsigned char _binary_loader_exe_size;
 
 extern unsigned char WEAK _binary_loader_m32_exe_start;
 extern unsigned char WEAK _binary_loader_m32_exe_size;
 
+/* Path prefix of the persistent loader cache, specified with
+ * --session-cache; see cached_loader().  */
+static const char *loader_cache_path;
+
+/**
+ * Remember @path as the loader cache file (its 32-bit variant gets a
+ * "-m32" suffix).  The string is not copied, it has to remain valid
+ * for the whole session.
+ */
+void set_loader_cache(const char *path)
+{
+	loader_cache_path = path;
+}
+
+/**
+ * Return the path to the loader cached by a previous invocation,
+ * extracting it first if needed.  This function returns NULL if no
+ * cache was requested or if an error occurred; the caller then falls
+ * back to a per-session extraction.
+ */
+static char *cached_loader(const Tracee *tracee, bool wants_32bit_version)
+{
+	char path[PATH_MAX];
+	struct stat statl;
+	void *start;
+	size_t size;
+	int status;
+	int fd;
+
+	if (loader_cache_path == NULL)
+		return NULL;
+
+	if (wants_32bit_version) {
+		start = (void *) &_binary_loader_m32_exe_start;
+		size  = (size_t) &_binary_loader_m32_exe_size;
+	}
+	else {
+		start = (void *) &_binary_loader_exe_start;
+		size  = (size_t) &_binary_loader_exe_size;
+	}
+
+	status = snprintf(path, PATH_MAX, "%s%s", loader_cache_path,
+			wants_32bit_version ? "-m32" : "");
+	if (status < 0 || status >= PATH_MAX)
+		return NULL;
+
+	/* Already extracted by a previous invocation?  A stale loader
+	 * -- from another PRoot version, typically -- is unlikely to
+	 * have the exact same size, and is rewritten otherwise.  */
+	status = stat(path, &statl);
+	if (status == 0 && S_ISREG(statl.st_mode) && statl.st_size == (off_t) size)
+		goto end;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IXUSR);
+	if (fd < 0)
+		return NULL;
+
+	if (write(fd, start, size) != (ssize_t) size) {
+		(void) close(fd);
+		(void) unlink(path);
+		return NULL;
+	}
+	(void) close(fd);
+
+end:
+	if (tracee->verbose >= 2)
+		note(tracee, INFO, INTERNAL, "cached loader: %s", path);
+
+	return talloc_strdup(talloc_autofree_context(), path);
+}
+
 /**
  * Extract the built-in loader.  This function returns NULL if an
  * error occurred, otherwise it returns the path to the extracted
@@ -476,10 +776,18 @@ static char *extract_loader(const Tracee *tracee, bool wants_32bit_version)
 	char *loader_path = NULL;
 	FILE *file = NULL;
 
-	file = open_temp_file(NULL, "prooted");
-	if (file == NULL)
-		goto end;
-	fd = fileno(file);
+	/* An anonymous file is preferred: there's nothing to unlink on
+	 * exit, the loader simply vanishes with its last descriptor --
+	 * kept open on purpose for the whole session -- and it never
+	 * leaks into "/tmp" if PRoot is killed.  Tracees reach it
+	 * through "/proc/<proot-pid>/fd/<fd>".  */
+	fd = open_temp_anonymous_file();
+	if (fd < 0) {
+		file = open_temp_file(NULL, "prooted");
+		if (file == NULL)
+			goto end;
+		fd = fileno(file);
+	}
 
 	if (wants_32bit_version) {
 		start = (void *) &_binary_loader_m32_exe_start;
@@ -502,10 +810,26 @@ static char *extract_loader(const Tracee *tracee, bool wants_32bit_version)
 		goto end;
 	}
 
-	status = readlink_proc_pid_fd(getpid(), fd, path);
-	if (status < 0) {
-		note(tracee, ERROR, INTERNAL, "can't retrieve loader path (/proc/self/fd/)");
-		goto end;
+	/* The loader is now complete: seal it so nothing -- not even
+	 * PRoot itself -- can alter or truncate it for the rest of the
+	 * session, and so the kernel can share its pages read-only
+	 * between every tracee that executes it.  Only memfds support
+	 * sealing, hence errors are expectable and ignored.  */
+	(void) fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+	/* An anonymous file has no name to read back: the magic link
+	 * itself is the only path to it.  */
+	if (file == NULL) {
+		status = snprintf(path, PATH_MAX, "/proc/%d/fd/%d", getpid(), fd);
+		if (status < 0 || status >= PATH_MAX)
+			goto end;
+	}
+	else {
+		status = readlink_proc_pid_fd(getpid(), fd, path);
+		if (status < 0) {
+			note(tracee, ERROR, INTERNAL, "can't retrieve loader path (/proc/self/fd/)");
+			goto end;
+		}
 	}
 
 	loader_path = talloc_strdup(talloc_autofree_context(), path);
@@ -523,6 +847,11 @@ end:
 		if (status < 0)
 			note(tracee, WARNING, SYSTEM, "can't close loader file");
 	}
+	else if (loader_path == NULL && fd >= 0) {
+		/* Failed extraction: the anonymous loader is simply
+		 * dropped with its only descriptor.  */
+		close(fd);
+	}
 
 	return loader_path;
 }
@@ -539,13 +868,15 @@ static inline const char *get_loader_path(const Tracee *tracee)
 	static char *loader32_path = NULL;
 
 	if (IS_CLASS32(tracee->load_info->elf_header)) {
-		loader32_path = loader32_path ?: getenv("PROOT_LOADER_32") ?: extract_loader(tracee, true);
+		loader32_path = loader32_path ?: getenv("PROOT_LOADER_32")
+			?: cached_loader(tracee, true) ?: extract_loader(tracee, true);
 		return loader32_path;
 	}
 	else
 #endif
 	{
-		loader_path = loader_path ?: getenv("PROOT_LOADER") ?: extract_loader(tracee, false);
+		loader_path = loader_path ?: getenv("PROOT_LOADER")
+			?: cached_loader(tracee, false) ?: extract_loader(tracee, false);
 		return loader_path;
 	}
 }
@@ -562,6 +893,9 @@ int translate_execve_enter(Tracee *tracee)
 	char new_exe[PATH_MAX];
 	char *raw_path;
 	const char *loader_path;
+	LoadInfoCacheEntry *entry = NULL;
+	struct timespec profile_start;
+	struct stat statl;
 	int status;
 
 	if (IS_NOTIFICATION_PTRACED_LOAD_DONE(tracee)) {
@@ -574,6 +908,8 @@ int translate_execve_enter(Tracee *tracee)
 		return 0;
 	}
 
+	(void) clock_gettime(CLOCK_MONOTONIC, &profile_start);
+
 	status = get_sysarg_path(tracee, user_path, SYSARG_1);
 	if (status < 0)
 		return status;
@@ -596,6 +932,9 @@ int translate_execve_enter(Tracee *tracee)
 	if (status == 0 && tracee->qemu == NULL)
 		TALLOC_FREE(raw_path);
 
+	account_exec(user_path);
+	account_exec_phase(user_path, EXEC_PHASE_TRANSLATION, &profile_start);
+
 	/* Remember the new value for "/proc/self/exe".  It points to
 	 * a canonicalized guest path, hence detranslate_path()
 	 * instead of using user_path directly.  */
@@ -634,23 +973,102 @@ int translate_execve_enter(Tracee *tracee)
 	if (tracee->load_info->raw_path == NULL)
 		return -ENOMEM;
 
-	status = extract_load_info(tracee, tracee->load_info);
-	if (status < 0)
-		return status;
-
-	if (tracee->load_info->interp != NULL) {
-		status = extract_load_info(tracee, tracee->load_info->interp);
+	(void) clock_gettime(CLOCK_MONOTONIC, &profile_start);
+
+	/* The parsing below is cacheable only when its result depends
+	 * on the file content alone: a QEMU runner changes how the
+	 * interpreter path is computed, and extensions may alter path
+	 * translation.  */
+	if (tracee->qemu == NULL && tracee->extensions == NULL
+	    && stat(host_path, &statl) == 0)
+		entry = &load_info_cache[statl.st_ino % NB_LOAD_INFO_CACHE];
+
+	if (entry != NULL
+	    && entry->load_info != NULL
+	    && entry->dev == statl.st_dev
+	    && entry->ino == statl.st_ino
+	    && entry->size == statl.st_size
+	    && entry->mtime == statl.st_mtime
+	    && entry->fs == tracee->fs
+	    && entry->generation == path_cache_generation()
+	    && cached_interp_fresh(entry)) {
+		status = copy_load_info(tracee->load_info, entry->load_info);
 		if (status < 0)
 			return status;
+	}
+	else {
+		DiskLoadInfo *disk = NULL;
+
+		/* Second level: the optional on-disk cache shared
+		 * across PRoot invocations.  */
+		if (entry != NULL)
+			disk = find_disk_load_info(&statl);
+
+		if (disk != NULL && disk_cache_hit(&disk->key, &statl)
+		    && disk_load_info_usable(disk) && disk_interp_fresh(disk)) {
+			status = import_disk_load_info(tracee->load_info, disk);
+			if (status < 0)
+				return status;
+		}
+		else {
+			status = extract_load_info(tracee, tracee->load_info);
+			if (status < 0)
+				return status;
+
+			if (tracee->load_info->interp != NULL) {
+				status = extract_load_info(tracee, tracee->load_info->interp);
+				if (status < 0)
+					return status;
 
-		/* An ELF interpreter is supposed to be
-		 * standalone.  */
-		if (tracee->load_info->interp->interp != NULL)
-			return -EINVAL;
+				/* An ELF interpreter is supposed to be
+				 * standalone.  */
+				if (tracee->load_info->interp->interp != NULL)
+					return -EINVAL;
+			}
+
+			if (disk != NULL)
+				export_disk_load_info(disk, tracee->load_info, &statl);
+		}
+
+		if (entry != NULL) {
+			struct stat interp_statl;
+			LoadInfo *copy;
+
+			/* An entry whose interpreter can't be
+			 * fingerprinted could outlive an ld.so
+			 * upgrade: don't cache it.  */
+			if (tracee->load_info->interp != NULL
+			    && stat(tracee->load_info->interp->host_path,
+					&interp_statl) < 0)
+				entry = NULL;
+
+			copy = (entry == NULL ? NULL
+				: talloc_zero(talloc_autofree_context(), LoadInfo));
+			if (copy != NULL && copy_load_info(copy, tracee->load_info) == 0) {
+				TALLOC_FREE(entry->load_info);
+				entry->load_info  = copy;
+				entry->dev        = statl.st_dev;
+				entry->ino        = statl.st_ino;
+				entry->size       = statl.st_size;
+				entry->mtime      = statl.st_mtime;
+				entry->fs         = tracee->fs;
+				entry->generation = path_cache_generation();
+
+				if (tracee->load_info->interp != NULL)
+					seal_disk_cache_entry(&entry->interp_key,
+							&interp_statl);
+				else
+					entry->interp_key.valid = 0;
+			}
+			else
+				TALLOC_FREE(copy);
+		}
 	}
 
 	compute_load_addresses(tracee);
 
+	account_exec_phase(tracee->load_info->user_path, EXEC_PHASE_ELF, &profile_start);
+
 	/* Execute the loader instead of the program.  */
 	loader_path = get_loader_path(tracee);
 	if (loader_path == NULL)
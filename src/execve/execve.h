@@ -32,6 +32,7 @@
 extern int translate_execve_enter(Tracee *tracee);
 extern void translate_execve_exit(Tracee *tracee);
 extern int translate_and_check_exec(Tracee *tracee, char host_path[PATH_MAX], const char *user_path);
+extern void set_loader_cache(const char *path);
 
 typedef struct mapping {
 	word_t addr;
@@ -23,15 +23,19 @@
 #include <linux/auxvec.h>  /* AT_*,  */
 #include <talloc.h>     /* talloc*, */
 #include <sys/mman.h>   /* MAP_*, */
+#include <sys/stat.h>   /* stat(2), */
+#include <stdbool.h>    /* bool, true, false, */
 #include <assert.h>     /* assert(3), */
 #include <string.h>     /* strlen(3), strerror(3), */
 #include <strings.h>    /* bzero(3), */
 #include <signal.h>     /* kill(2), SIG*, */
 #include <unistd.h>     /* write(2), */
 #include <errno.h>      /* E*, */
+#include <time.h>       /* clock_gettime(2), */
 
 #include "execve/execve.h"
 #include "execve/elf.h"
+#include "execve/profile.h"
 #include "loader/script.h"
 #include "tracee/reg.h"
 #include "tracee/abi.h"
@@ -167,6 +171,80 @@ static void *transcript_mappings(void *cursor, const Mapping *mappings)
 	return cursor;
 }
 
+/* Cache of serialized load scripts, keyed by file identity like the
+ * load-info cache.  The statement sequence only depends on the
+ * binary: mappings and entry point are deterministic (no ASLR in the
+ * loader).  The few per-exec fields -- string addresses, stack
+ * pointer, traced-or-not start action -- are patched in place on a
+ * warm exec, so re-executing a known binary is one memcpy, a handful
+ * of patches, and the usual single transfer.  Entries are kept in
+ * the generic 64-bit format; the 32-bit compaction, which depends on
+ * the tracee's ABI, happens after patching as usual.  */
+#define NB_LOAD_SCRIPT_CACHE 32
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	void *script;
+	size_t script_size;
+	ssize_t open2_offset;	/* -1 when there's no ELF interpreter.  */
+	size_t start_offset;
+
+	/* Identity of the ELF interpreter whose open and mmap
+	 * statements are embedded in @script: the entry is keyed by
+	 * the main binary, but ld.so can be replaced -- a glibc
+	 * upgrade -- without the binaries that point to it changing
+	 * (cf. the load-info caches).  Meaningless when @open2_offset
+	 * is negative.  */
+	dev_t interp_dev;
+	ino_t interp_ino;
+	off_t interp_size;
+	time_t interp_mtime;
+} LoadScriptCacheEntry;
+
+static LoadScriptCacheEntry load_script_cache[NB_LOAD_SCRIPT_CACHE];
+
+/* The interpreter portion of a load script -- the "open next"
+ * statement plus the interpreter's mmap statements -- is identical
+ * for every binary run through that interpreter, i.e. nearly all of
+ * them (there's one ld-linux per system).  It is cached separately,
+ * keyed by the interpreter's identity, so even a cold exec of a
+ * never-seen binary reuses the serialized ld-linux blob: only the
+ * string address of its "open next" statement has to be patched.  */
+#define NB_INTERP_SCRIPT_CACHE 4
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	void *script;
+	size_t script_size;
+} InterpScriptCacheEntry;
+
+static InterpScriptCacheEntry interp_script_cache[NB_INTERP_SCRIPT_CACHE];
+
+/**
+ * Check the interpreter statements embedded in the cached script
+ * @entry are still those of the current exec: same "has an ELF
+ * interpreter or not" shape, and -- when there is one -- the same
+ * file as when the entry was filled.  @interp_statl is the stat of
+ * the current interpreter, or NULL when there is none or it could
+ * not be stat'ed.
+ */
+static bool script_interp_fresh(const LoadScriptCacheEntry *entry,
+				const Tracee *tracee, const struct stat *interp_statl)
+{
+	if (entry->open2_offset < 0)
+		return (tracee->load_info->interp == NULL);
+
+	return (interp_statl != NULL
+		&& entry->interp_dev   == interp_statl->st_dev
+		&& entry->interp_ino   == interp_statl->st_ino
+		&& entry->interp_size  == interp_statl->st_size
+		&& entry->interp_mtime == interp_statl->st_mtime);
+}
+
 /**
  * Convert @tracee->load_info into a load script, then transfer this
  * latter into @tracee's memory.
@@ -194,6 +272,14 @@ static int transfer_load_script(Tracee *tracee)
 	void *cursor;
 	int status;
 
+	LoadScriptCacheEntry *entry = NULL;
+	InterpScriptCacheEntry *interp_entry = NULL;
+	ssize_t open2_offset = -1;
+	size_t start_offset = 0;
+	bool interp_stat_ok = false;
+	struct stat interp_statl;
+	struct stat statl;
+
 	/* Strings addresses are required to generate the load script,
 	 * for "open" actions.  Since I want to generate it in one
 	 * pass, these strings will be put right below the current
@@ -220,6 +306,52 @@ static int transfer_load_script(Tracee *tracee)
 			? string1_address
 			: stack_pointer - strings_size + string1_size + string2_size);
 
+	if (tracee->load_info->interp != NULL)
+		interp_stat_ok = (stat(tracee->load_info->interp->host_path,
+					&interp_statl) == 0);
+
+	if (stat(tracee->load_info->host_path, &statl) == 0)
+		entry = &load_script_cache[statl.st_ino % NB_LOAD_SCRIPT_CACHE];
+
+	if (entry != NULL
+	    && entry->script != NULL
+	    && entry->dev == statl.st_dev
+	    && entry->ino == statl.st_ino
+	    && entry->size == statl.st_size
+	    && entry->mtime == statl.st_mtime
+	    && script_interp_fresh(entry, tracee,
+				interp_stat_ok ? &interp_statl : NULL)) {
+		/* Warm exec: reuse the cached statement sequence, then
+		 * patch the few per-exec fields in place.  */
+		script_size = entry->script_size;
+
+		buffer_size = script_size + strings_size;
+		buffer = talloc_zero_size(tracee->ctx, buffer_size);
+		if (buffer == NULL)
+			return -ENOMEM;
+
+		memcpy(buffer, entry->script, script_size);
+		cursor = buffer + script_size;
+
+		statement = buffer;
+		statement->open.string_address = string1_address;
+
+		if (entry->open2_offset >= 0) {
+			statement = buffer + entry->open2_offset;
+			statement->open.string_address = string2_address;
+		}
+
+		statement = buffer + entry->start_offset;
+		if (tracee->as_ptracee.ptracer != NULL)
+			statement->action = LOAD_ACTION_START_TRACED;
+		else
+			statement->action = LOAD_ACTION_START;
+		statement->start.stack_pointer = stack_pointer;
+		statement->start.at_execfn     = string3_address;
+
+		goto strings;
+	}
+
 	/* Compute the size of the load script.  */
 	script_size =
 		LOAD_STATEMENT_SIZE(*statement, open)
@@ -251,15 +383,57 @@ static int transfer_load_script(Tracee *tracee)
 	cursor = transcript_mappings(cursor, tracee->load_info->mappings);
 
 	if (tracee->load_info->interp != NULL) {
-		/* Load script statement: open.  */
-		statement = cursor;
-		statement->action = LOAD_ACTION_OPEN_NEXT;
-		statement->open.string_address = string2_address;
-
-		cursor += LOAD_STATEMENT_SIZE(*statement, open);
-
-		/* Load script statements: mmap.  */
-		cursor = transcript_mappings(cursor, tracee->load_info->interp->mappings);
+		const size_t interp_script_size = LOAD_STATEMENT_SIZE(*statement, open)
+			+ (LOAD_STATEMENT_SIZE(*statement, mmap)
+				* talloc_array_length(tracee->load_info->interp->mappings));
+
+		open2_offset = cursor - buffer;
+
+		if (interp_stat_ok)
+			interp_entry = &interp_script_cache[interp_statl.st_ino
+							% NB_INTERP_SCRIPT_CACHE];
+
+		if (interp_entry != NULL
+		    && interp_entry->script != NULL
+		    && interp_entry->dev == interp_statl.st_dev
+		    && interp_entry->ino == interp_statl.st_ino
+		    && interp_entry->size == interp_statl.st_size
+		    && interp_entry->mtime == interp_statl.st_mtime
+		    && interp_entry->script_size == interp_script_size) {
+			/* Known interpreter: reuse the serialized blob,
+			 * only its string address is per-exec.  */
+			memcpy(cursor, interp_entry->script, interp_script_size);
+			statement = cursor;
+			statement->open.string_address = string2_address;
+			cursor += interp_script_size;
+		}
+		else {
+			/* Load script statement: open.  */
+			statement = cursor;
+			statement->action = LOAD_ACTION_OPEN_NEXT;
+			statement->open.string_address = string2_address;
+
+			cursor += LOAD_STATEMENT_SIZE(*statement, open);
+
+			/* Load script statements: mmap.  */
+			cursor = transcript_mappings(cursor, tracee->load_info->interp->mappings);
+
+			if (interp_entry != NULL) {
+				void *copy;
+
+				copy = talloc_memdup(talloc_autofree_context(),
+						buffer + open2_offset, interp_script_size);
+				if (copy != NULL) {
+					TALLOC_FREE(interp_entry->script);
+					interp_entry->script      = copy;
+					interp_entry->script_size = interp_script_size;
+					interp_entry->dev         = interp_statl.st_dev;
+					interp_entry->ino         = interp_statl.st_ino;
+					interp_entry->size        = interp_statl.st_size;
+					interp_entry->mtime       = interp_statl.st_mtime;
+				}
+			}
+		}
 
 		entry_point = ELF_FIELD(tracee->load_info->interp->elf_header, entry);
 	}
@@ -267,6 +441,7 @@ static int transfer_load_script(Tracee *tracee)
 		entry_point = ELF_FIELD(tracee->load_info->elf_header, entry);
 
 	/* Load script statement: start.  */
+	start_offset = cursor - buffer;
 	statement = cursor;
 
 	/* Start of the program slightly differs when ptraced.  */
@@ -289,6 +464,34 @@ static int transfer_load_script(Tracee *tracee)
 	/* Sanity check.  */
 	assert((uintptr_t) cursor - (uintptr_t) buffer == script_size);
 
+	/* Don't cache a script whose embedded interpreter statements
+	 * can't be fingerprinted: a stale entry would outlive an
+	 * ld.so update.  */
+	if (entry != NULL && (open2_offset < 0 || interp_stat_ok)) {
+		void *copy;
+
+		copy = talloc_memdup(talloc_autofree_context(), buffer, script_size);
+		if (copy != NULL) {
+			TALLOC_FREE(entry->script);
+			entry->script       = copy;
+			entry->script_size  = script_size;
+			entry->open2_offset = open2_offset;
+			entry->start_offset = start_offset;
+			entry->dev          = statl.st_dev;
+			entry->ino          = statl.st_ino;
+			entry->size         = statl.st_size;
+			entry->mtime        = statl.st_mtime;
+			if (open2_offset >= 0) {
+				entry->interp_dev   = interp_statl.st_dev;
+				entry->interp_ino   = interp_statl.st_ino;
+				entry->interp_size  = interp_statl.st_size;
+				entry->interp_mtime = interp_statl.st_mtime;
+			}
+		}
+	}
+
+strings:
+
 	/* Convert the load script to the expected format.  */
 	if (is_32on64_mode(tracee)) {
 		int i;
@@ -372,6 +575,7 @@ static int transfer_load_script(Tracee *tracee)
 void translate_execve_exit(Tracee *tracee)
 {
 	word_t syscall_result;
+	struct timespec profile_start;
 	int status;
 
 	if (IS_NOTIFICATION_PTRACED_LOAD_DONE(tracee)) {
@@ -436,10 +640,17 @@ void translate_execve_exit(Tracee *tracee)
 	/* New processes have no heap.  */
 	bzero(tracee->heap, sizeof(Heap));
 
+	/* The scratch arena did not survive execve(2) either.  */
+	bzero(&tracee->scratch, sizeof(tracee->scratch));
+
 	/* Transfer the load script to the loader.  */
+	(void) clock_gettime(CLOCK_MONOTONIC, &profile_start);
+
 	status = transfer_load_script(tracee);
 	if (status < 0)
 		note(tracee, ERROR, INTERNAL, "can't transfer load script: %s", strerror(-status));
 
+	account_exec_phase(tracee->load_info->user_path, EXEC_PHASE_INJECTION, &profile_start);
+
 	return;
 }
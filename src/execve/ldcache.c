@@ -0,0 +1,563 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <stdio.h>      /* fopen(3), fwrite(3), */
+#include <stdint.h>     /* uint32_t, uint64_t, */
+#include <stdbool.h>    /* bool, true, false, */
+#include <string.h>     /* strstr(3), strcmp(3), */
+#include <dirent.h>     /* opendir(3), readdir(3), */
+#include <fcntl.h>      /* AT_FDCWD, */
+#include <fnmatch.h>    /* fnmatch(3), */
+#include <endian.h>     /* __BYTE_ORDER, */
+#include <errno.h>      /* E*, errno, */
+#include <assert.h>     /* assert(3), */
+#include <talloc.h>     /* talloc_*, */
+
+#include "execve/ldcache.h"
+#include "execve/elf.h"
+#include "path/path.h"
+#include "path/binding.h"
+#include "path/temp.h"
+#include "cli/note.h"
+
+/* A guest rootfs without an up-to-date "/etc/ld.so.cache" makes
+ * ld.so fall back to scanning every library directory: dozens of
+ * open(2)/stat(2) attempts per exec, each a translated stop.  This
+ * module rebuilds that cache from the guest point of view -- the
+ * translation machinery sees through bindings, so bound-in library
+ * directories are indexed too -- and binds the result over
+ * "/etc/ld.so.cache", leaving the rootfs itself untouched.
+ *
+ * Only the "new" cache format is emitted (glibc >= 2.2, the embedded
+ * format ldconfig has generated ever since); the layout below mirrors
+ * glibc's dl-cache.h.  */
+
+#define CACHE_MAGIC_NEW   "glibc-ld.so.cache"
+#define CACHE_VERSION_NEW "1.1"
+
+typedef struct {
+	char magic[sizeof(CACHE_MAGIC_NEW) - 1];
+	char version[sizeof(CACHE_VERSION_NEW) - 1];
+	uint32_t nb_libs;
+	uint32_t len_strings;
+	uint8_t flags;
+	uint8_t unused1[3];
+	uint32_t extension_offset;
+	uint32_t unused2[3];
+} CacheHeader;
+
+typedef struct {
+	int32_t flags;
+	uint32_t key;		/* Offset of the library name.  */
+	uint32_t value;		/* Offset of the library path.  */
+	uint32_t os_version;
+	uint64_t hwcap;
+} CacheEntry;
+
+/* Values for CacheHeader.flags.  */
+#if __BYTE_ORDER == __BIG_ENDIAN
+#define CACHE_ENDIAN_CURRENT 3
+#else
+#define CACHE_ENDIAN_CURRENT 2
+#endif
+
+/* Values for CacheEntry.flags, from glibc's ldconfig.  */
+#define FLAG_ELF_LIBC6		0x0003
+#define FLAG_X8664_LIB64	0x0300
+#define FLAG_ARM_LIBSF		0x0400
+#define FLAG_X8664_LIBX32	0x0800
+#define FLAG_ARM_LIBHF		0x0900
+#define FLAG_AARCH64_LIB64	0x0a00
+
+/* ELF machines of the architectures PRoot supports.  */
+#define EM_386		3
+#define EM_ARM		40
+#define EM_SH		42
+#define EM_X86_64	62
+#define EM_AARCH64	183
+
+#define EF_ARM_ABI_FLOAT_HARD 0x400
+
+typedef struct {
+	const char *name;	/* Library name, the cache key.  */
+	const char *path;	/* Guest path, the cache value.  */
+	int32_t flags;
+} Library;
+
+typedef struct {
+	TALLOC_CTX *context;
+
+	const char **directories;
+	size_t nb_directories;
+
+	Library *libraries;
+	size_t nb_libraries;
+} LdCache;
+
+/**
+ * Return the CacheEntry flags for the library behind @elf_header, or
+ * -1 if this architecture doesn't belong to any known cache.
+ */
+static int32_t elf_header_flags(const ElfHeader *elf_header)
+{
+	switch (ELF_FIELD(*elf_header, machine)) {
+	case EM_386:
+		return FLAG_ELF_LIBC6;
+
+	case EM_ARM:
+		if ((ELF_FIELD(*elf_header, flags) & EF_ARM_ABI_FLOAT_HARD) != 0)
+			return FLAG_ELF_LIBC6 | FLAG_ARM_LIBHF;
+		return FLAG_ELF_LIBC6;
+
+	case EM_SH:
+		return FLAG_ELF_LIBC6;
+
+	case EM_X86_64:
+		if (IS_CLASS32(*elf_header))
+			return FLAG_ELF_LIBC6 | FLAG_X8664_LIBX32;
+		return FLAG_ELF_LIBC6 | FLAG_X8664_LIB64;
+
+	case EM_AARCH64:
+		return FLAG_ELF_LIBC6 | FLAG_AARCH64_LIB64;
+
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Append @guest_path to @cache's list of library directories, unless
+ * it is already there.  This function returns -errno if an error
+ * occurred, otherwise 0.
+ */
+static int add_directory(LdCache *cache, const char *guest_path)
+{
+	size_t i;
+
+	for (i = 0; i < cache->nb_directories; i++)
+		if (strcmp(cache->directories[i], guest_path) == 0)
+			return 0;
+
+	cache->directories = talloc_realloc(cache->context, cache->directories,
+					const char *, cache->nb_directories + 1);
+	if (cache->directories == NULL)
+		return -ENOMEM;
+
+	cache->directories[cache->nb_directories] = talloc_strdup(cache->context, guest_path);
+	if (cache->directories[cache->nb_directories] == NULL)
+		return -ENOMEM;
+	cache->nb_directories++;
+
+	return 0;
+}
+
+static int parse_ld_so_conf(Tracee *tracee, LdCache *cache, const char *guest_path, int depth);
+
+/**
+ * Handle an "include" directive from a "ld.so.conf" file: @pattern is
+ * a guest glob, each guest file that matches it is parsed in turn.
+ */
+static void parse_ld_so_conf_glob(Tracee *tracee, LdCache *cache,
+				const char *pattern, int depth)
+{
+	char host_path[PATH_MAX];
+	char guest_path[PATH_MAX];
+	struct dirent *entry;
+	const char *separator;
+	const char *base;
+	char *directory;
+	int status;
+	DIR *dir;
+
+	separator = strrchr(pattern, '/');
+	if (separator == NULL)
+		return;
+	base = separator + 1;
+
+	directory = talloc_strndup(cache->context, pattern,
+				separator == pattern ? 1 : (size_t) (separator - pattern));
+	if (directory == NULL)
+		return;
+
+	status = translate_path(tracee, host_path, AT_FDCWD, directory, true);
+	if (status < 0)
+		return;
+
+	dir = opendir(host_path);
+	if (dir == NULL)
+		return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (fnmatch(base, entry->d_name, 0) != 0)
+			continue;
+
+		status = join_paths(2, guest_path, directory, entry->d_name);
+		if (status < 0)
+			continue;
+
+		(void) parse_ld_so_conf(tracee, cache, guest_path, depth);
+	}
+
+	closedir(dir);
+}
+
+/**
+ * Collect into @cache the library directories declared by the guest
+ * file @guest_path ("/etc/ld.so.conf" initially, then its includes).
+ * Errors are not fatal: a missing or unreadable file simply
+ * contributes no directory.  This function returns -errno if an
+ * error occurred, otherwise 0.
+ */
+static int parse_ld_so_conf(Tracee *tracee, LdCache *cache, const char *guest_path, int depth)
+{
+	char host_path[PATH_MAX];
+	char line[PATH_MAX];
+	int status;
+	FILE *file;
+
+	/* Protection against "include" cycles.  */
+	if (depth > 4)
+		return 0;
+
+	status = translate_path(tracee, host_path, AT_FDCWD, guest_path, true);
+	if (status < 0)
+		return 0;
+
+	file = fopen(host_path, "re");
+	if (file == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *cursor;
+
+		/* Strip comments and surrounding spaces.  */
+		cursor = strchr(line, '#');
+		if (cursor != NULL)
+			*cursor = '\0';
+
+		cursor = line + strspn(line, " \t");
+		cursor[strcspn(cursor, " \t\r\n")] = '\0';
+		if (cursor[0] == '\0')
+			continue;
+
+		if (strcmp(cursor, "include") == 0) {
+			char *pattern = cursor + strlen(cursor) + 1;
+
+			pattern += strspn(pattern, " \t");
+			pattern[strcspn(pattern, " \t\r\n")] = '\0';
+			if (pattern[0] != '\0')
+				parse_ld_so_conf_glob(tracee, cache, pattern, depth + 1);
+			continue;
+		}
+
+		if (cursor[0] != '/')
+			continue;
+
+		status = add_directory(cache, cursor);
+		if (status < 0) {
+			fclose(file);
+			return status;
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+/**
+ * Append to @cache every shared library found in the guest directory
+ * @guest_path.  The first directory that provides a given name wins,
+ * as with ldconfig.  This function returns -errno if an error
+ * occurred, otherwise 0.
+ */
+static int scan_directory(Tracee *tracee, LdCache *cache, const char *guest_path)
+{
+	char host_path[PATH_MAX];
+	char host_entry[PATH_MAX];
+	char guest_entry[PATH_MAX];
+	ElfHeader elf_header;
+	struct dirent *entry;
+	int status;
+	DIR *dir;
+
+	status = translate_path(tracee, host_path, AT_FDCWD, guest_path, true);
+	if (status < 0)
+		return 0;
+
+	dir = opendir(host_path);
+	if (dir == NULL)
+		return 0;
+
+	while ((entry = readdir(dir)) != NULL) {
+		Library *library;
+		int32_t flags;
+		size_t i;
+
+		/* Same filter as ldconfig: the name has to contain
+		 * ".so", what doesn't parse as ELF is skipped
+		 * below.  */
+		if (strstr(entry->d_name, ".so") == NULL)
+			continue;
+
+		status = join_paths(2, host_entry, host_path, entry->d_name);
+		if (status < 0)
+			continue;
+
+		status = read_elf_header(host_entry, &elf_header);
+		if (status < 0)
+			continue;
+
+		if (ELF_FIELD(elf_header, type) != ET_DYN)
+			continue;
+
+		flags = elf_header_flags(&elf_header);
+		if (flags < 0)
+			continue;
+
+		/* An earlier directory already provides this name
+		 * for this architecture.  */
+		for (i = 0; i < cache->nb_libraries; i++)
+			if (cache->libraries[i].flags == flags
+			    && strcmp(cache->libraries[i].name, entry->d_name) == 0)
+				break;
+		if (i < cache->nb_libraries)
+			continue;
+
+		status = join_paths(2, guest_entry, guest_path, entry->d_name);
+		if (status < 0)
+			continue;
+
+		cache->libraries = talloc_realloc(cache->context, cache->libraries,
+						Library, cache->nb_libraries + 1);
+		if (cache->libraries == NULL) {
+			closedir(dir);
+			return -ENOMEM;
+		}
+
+		library = &cache->libraries[cache->nb_libraries];
+		library->name  = talloc_strdup(cache->context, entry->d_name);
+		library->path  = talloc_strdup(cache->context, guest_entry);
+		library->flags = flags;
+		if (library->name == NULL || library->path == NULL) {
+			closedir(dir);
+			return -ENOMEM;
+		}
+		cache->nb_libraries++;
+	}
+
+	closedir(dir);
+	return 0;
+}
+
+/**
+ * Compare two cache keys the way glibc's _dl_cache_libcmp() does:
+ * embedded version numbers are compared numerically, so "libfoo.so.9"
+ * sorts before "libfoo.so.10".  ld.so searches the cache by bisection
+ * with this very ordering, anything else would make lookups fail.
+ */
+static int compare_keys(const char *key1, const char *key2)
+{
+	while (*key1 != '\0') {
+		if (*key1 >= '0' && *key1 <= '9') {
+			if (*key2 >= '0' && *key2 <= '9') {
+				unsigned long value1 = 0;
+				unsigned long value2 = 0;
+
+				while (*key1 >= '0' && *key1 <= '9')
+					value1 = value1 * 10 + (unsigned long) (*key1++ - '0');
+				while (*key2 >= '0' && *key2 <= '9')
+					value2 = value2 * 10 + (unsigned long) (*key2++ - '0');
+
+				if (value1 != value2)
+					return value1 < value2 ? -1 : 1;
+			}
+			else
+				return 1;
+		}
+		else if (*key2 >= '0' && *key2 <= '9')
+			return -1;
+		else if (*key1 != *key2)
+			return *key1 < *key2 ? -1 : 1;
+		else {
+			key1++;
+			key2++;
+		}
+	}
+	return -(*key2 != '\0');
+}
+
+static int compare_libraries(const void *pointer1, const void *pointer2)
+{
+	const Library *library1 = pointer1;
+	const Library *library2 = pointer2;
+
+	return compare_keys(library1->name, library2->name);
+}
+
+/**
+ * Write @cache to the host file @host_path, in the format ld.so
+ * expects for "/etc/ld.so.cache".  This function returns -errno if an
+ * error occurred, otherwise 0.
+ */
+static int write_cache_file(const LdCache *cache, const char *host_path)
+{
+	CacheHeader header;
+	uint32_t offset;
+	size_t status2;
+	size_t i;
+	FILE *file;
+
+	file = fopen(host_path, "we");
+	if (file == NULL)
+		return -errno;
+
+	bzero(&header, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC_NEW, sizeof(header.magic));
+	memcpy(header.version, CACHE_VERSION_NEW, sizeof(header.version));
+	header.nb_libs = cache->nb_libraries;
+	header.flags = CACHE_ENDIAN_CURRENT;
+
+	/* The string table follows the entries; key/value offsets are
+	 * relative to the start of the file.  */
+	offset = sizeof(CacheHeader) + cache->nb_libraries * sizeof(CacheEntry);
+	for (i = 0; i < cache->nb_libraries; i++)
+		header.len_strings += strlen(cache->libraries[i].name) + 1
+				    + strlen(cache->libraries[i].path) + 1;
+
+	status2 = fwrite(&header, sizeof(header), 1, file);
+	if (status2 != 1)
+		goto error;
+
+	for (i = 0; i < cache->nb_libraries; i++) {
+		const Library *library = &cache->libraries[i];
+		CacheEntry entry;
+
+		bzero(&entry, sizeof(entry));
+		entry.flags = library->flags;
+		entry.key   = offset;
+		offset += strlen(library->name) + 1;
+		entry.value = offset;
+		offset += strlen(library->path) + 1;
+
+		status2 = fwrite(&entry, sizeof(entry), 1, file);
+		if (status2 != 1)
+			goto error;
+	}
+
+	for (i = 0; i < cache->nb_libraries; i++) {
+		const Library *library = &cache->libraries[i];
+
+		status2 = fwrite(library->name, strlen(library->name) + 1, 1, file);
+		if (status2 != 1)
+			goto error;
+
+		status2 = fwrite(library->path, strlen(library->path) + 1, 1, file);
+		if (status2 != 1)
+			goto error;
+	}
+
+	if (fclose(file) != 0)
+		return -errno;
+	return 0;
+
+error:
+	fclose(file);
+	return -EIO;
+}
+
+/**
+ * Generate a "ld.so.cache" that matches the guest view of the
+ * file-system -- the guest's "ld.so.conf" hierarchy plus the default
+ * library directories -- then bind it over "/etc/ld.so.cache".  The
+ * rootfs is left untouched, so it may be read-only.  This function
+ * returns -errno if an error occurred, otherwise 0.
+ */
+int generate_shadow_ldcache(Tracee *tracee)
+{
+	static const char *default_directories[] = {
+		"/lib", "/lib64", "/usr/lib", "/usr/lib64", NULL
+	};
+
+	char guest_path[PATH_MAX];
+	const char *host_path;
+	LdCache cache;
+	int status;
+	size_t i;
+
+	bzero(&cache, sizeof(cache));
+	cache.context = talloc_new(tracee->ctx);
+	if (cache.context == NULL)
+		return -ENOMEM;
+
+	/* Same search order as ldconfig: "ld.so.conf" directories
+	 * first, then the built-in defaults.  */
+	status = parse_ld_so_conf(tracee, &cache, "/etc/ld.so.conf", 0);
+	if (status < 0)
+		goto end;
+
+	for (i = 0; default_directories[i] != NULL; i++) {
+		status = add_directory(&cache, default_directories[i]);
+		if (status < 0)
+			goto end;
+	}
+
+	for (i = 0; i < cache.nb_directories; i++) {
+		status = scan_directory(tracee, &cache, cache.directories[i]);
+		if (status < 0)
+			goto end;
+	}
+
+	/* An empty cache would make ld.so worse off than no cache at
+	 * all -- keep whatever the rootfs provides in that case.  */
+	if (cache.nb_libraries == 0) {
+		status = 0;
+		goto end;
+	}
+
+	qsort(cache.libraries, cache.nb_libraries, sizeof(Library), compare_libraries);
+
+	/* The temporary file is unlinked on exit, once nothing uses
+	 * the binding anymore.  */
+	host_path = create_temp_file(tracee->fs, "ldcache");
+	if (host_path == NULL) {
+		status = -ENOMEM;
+		goto end;
+	}
+
+	status = write_cache_file(&cache, host_path);
+	if (status < 0)
+		goto end;
+
+	strcpy(guest_path, "/etc/ld.so.cache");
+	if (insort_binding3(tracee, tracee->fs, host_path, guest_path) == NULL) {
+		status = -ENOMEM;
+		goto end;
+	}
+
+	VERBOSE(tracee, 1, "shadow ld.so.cache: %zu libraries from %zu directories",
+		cache.nb_libraries, cache.nb_directories);
+	status = 0;
+
+end:
+	TALLOC_FREE(cache.context);
+	return status;
+}
@@ -26,11 +26,17 @@
 #include <assert.h>  /* assert(3), */
 #include <errno.h>   /* ENOMEM, */
 #include <unistd.h>  /* close(2), */
+#include <sys/stat.h> /* stat(2), fstat(2), */
+#include <sys/mman.h> /* mmap(2), munmap(2), */
+#include <stdint.h>  /* uint8_t, uint64_t, UINT64_MAX, */
+#include <talloc.h>  /* talloc_*, */
 #include <linux/limits.h>  /* PATH_MAX, ARG_MAX, */
 
 #include "execve/ldso.h"
 #include "execve/elf.h"
 #include "execve/aoxp.h"
+#include "execve/disk_cache.h"
+#include "execve/profile.h"
 #include "tracee/tracee.h"
 #include "cli/note.h"
 
@@ -104,6 +110,15 @@ int ldso_env_passthru(const Tracee *tracee, ArrayOfXPointers *envp, ArrayOfXPoin
 	int status;
 	size_t i;
 
+	/* Fetch the whole environment block at once: the loop below
+	 * reads every single variable just to find the LD_* ones,
+	 * which would cost one round trip per variable otherwise --
+	 * per exec, even when there is no LD_* variable at all.  Only
+	 * the entries actually modified are written back.  */
+	status = prefetch_xpointees_as_strings(envp);
+	if (status < 0)
+		return status;
+
 	for (i = 0; i < envp->length; i++) {
 		bool is_known = false;
 		char *env;
@@ -269,40 +284,24 @@ static int find_program_header(const ElfHeader *elf_header,
 }
 
 /**
- * Add to @xpaths the paths (':'-separated list) from the file
- * referenced by @fd at the given @offset.  This function returns
- * -errno if an error occured, otherwise 0.
+ * Add to @xpaths the paths (':'-separated list) located at @offset in
+ * the mapped @file of @file_size bytes.  This function returns -errno
+ * if an error occured, otherwise 0.
  */
-static int add_xpaths(const Tracee *tracee, int fd, uint64_t offset, char **xpaths)
+static int add_xpaths(const Tracee *tracee, const uint8_t *file, size_t file_size,
+		uint64_t offset, char **xpaths)
 {
-	char *paths = NULL;
-	char *tmp;
-
+	const char *paths;
 	size_t length;
-	size_t size;
-	int status;
-
-	status = (int) lseek(fd, offset, SEEK_SET);
-	if (status < 0)
-		return -errno;
-
-	/* Read the complete list of paths.  */
-	length = 0;
-	paths = NULL;
-	do {
-		size = length + 1024;
-
-		tmp = talloc_realloc(tracee->ctx, paths, char, size);
-		if (!tmp)
-			return -ENOMEM;
-		paths = tmp;
+	char *tmp;
 
-		status = read(fd, paths + length, 1024);
-		if (status < 0)
-			return status;
+	if (offset >= file_size)
+		return -ENOEXEC;
 
-		length += strnlen(paths + length, 1024);
-	} while (length == size);
+	paths = (const char *) file + offset;
+	length = strnlen(paths, file_size - offset);
+	if (length == file_size - offset)
+		return -ENOEXEC; /* Not null-terminated.  */
 
 	/* Concatene this list of paths to xpaths.  */
 	if (!*xpaths) {
@@ -344,6 +343,9 @@ static int read_ldso_rpaths(const Tracee* tracee, int fd, const ElfHeader *elf_h
 	struct find_program_header_data data;
 	uint64_t strtab_address = (uint64_t) -1;
 	off_t strtab_offset;
+	struct stat statl;
+	const uint8_t *file;
+	size_t file_size;
 	int status;
 	size_t i;
 
@@ -370,6 +372,26 @@ static int read_ldso_rpaths(const Tracee* tracee, int fd, const ElfHeader *elf_h
 	if (sizeof_dynamic_segment % sizeof_dynamic_entry != 0)
 		return -ENOEXEC;
 
+	/* Parse the dynamic section and the string table from a
+	 * read-only mapping of the file: no per-entry lseek(2) +
+	 * read(2), and the pages are shared with every other process
+	 * inspecting the same binary.  An executable is mmap-able by
+	 * definition, so a failure here is a genuine error.  */
+	status = fstat(fd, &statl);
+	if (status < 0)
+		return -errno;
+	file_size = statl.st_size;
+
+	if (offsetof_dynamic_segment > file_size
+	    || sizeof_dynamic_segment > file_size - offsetof_dynamic_segment)
+		return -ENOEXEC;
+
+	file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (file == MAP_FAILED)
+		return -errno;
+
+	status = 0;
+
 /**
  * Invoke @embedded_code on each dynamic entry of the given @type.
  */
@@ -378,15 +400,9 @@ static int read_ldso_rpaths(const Tracee* tracee, int fd, const ElfHeader *elf_h
 		DynamicEntry dynamic_entry;						\
 		uint64_t value;								\
 											\
-		/* embedded_code may change the file offset.  */			\
-		status = (int) lseek(fd, offsetof_dynamic_segment + i * sizeof_dynamic_entry, \
-				SEEK_SET);						\
-		if (status < 0)								\
-			return -errno;							\
-											\
-		status = read(fd, &dynamic_entry, sizeof_dynamic_entry);		\
-		if (status < 0)								\
-			return status;							\
+		memcpy(&dynamic_entry, file + offsetof_dynamic_segment			\
+					+ i * sizeof_dynamic_entry,			\
+			sizeof_dynamic_entry);						\
 											\
 		if (DYNAMIC_FIELD(*elf_header, dynamic_entry, tag) != type)		\
 			continue;							\
@@ -405,7 +421,7 @@ static int read_ldso_rpaths(const Tracee* tracee, int fd, const ElfHeader *elf_h
 	})
 
 	if (strtab_address == (uint64_t) -1)
-		return 0;
+		goto end;
 
 	data.program_header = &strtab_segment;
 	data.type = PT_LOAD;
@@ -414,34 +430,59 @@ static int read_ldso_rpaths(const Tracee* tracee, int fd, const ElfHeader *elf_h
 	/* Search the program header that contains the given string table.  */
 	status = iterate_program_headers(tracee, fd, elf_header, find_program_header, &data);
 	if (status < 0)
-		return status;
+		goto end;
+	status = 0;
 
 	strtab_offset = PROGRAM_FIELD(*elf_header, strtab_segment, offset)
 		+ (strtab_address - PROGRAM_FIELD(*elf_header, strtab_segment, vaddr));
 
 	FOREACH_DYNAMIC_ENTRY(DT_RPATH,	{
-		if (strtab_offset < 0 || (uint64_t) strtab_offset > UINT64_MAX - value)
-			return -ENOEXEC;
+		if (strtab_offset < 0 || (uint64_t) strtab_offset > UINT64_MAX - value) {
+			status = -ENOEXEC;
+			goto end;
+		}
 
-		status = add_xpaths(tracee, fd, strtab_offset + value, rpaths);
+		status = add_xpaths(tracee, file, file_size, strtab_offset + value, rpaths);
 		if (status < 0)
-			return status;
+			goto end;
 	})
 
 	FOREACH_DYNAMIC_ENTRY(DT_RUNPATH, {
-		if (strtab_offset < 0 || (uint64_t) strtab_offset > UINT64_MAX - value)
-			return -ENOEXEC;
+		if (strtab_offset < 0 || (uint64_t) strtab_offset > UINT64_MAX - value) {
+			status = -ENOEXEC;
+			goto end;
+		}
 
-		status = add_xpaths(tracee, fd, strtab_offset + value, runpaths);
+		status = add_xpaths(tracee, file, file_size, strtab_offset + value, runpaths);
 		if (status < 0)
-			return status;
+			goto end;
 	})
 
 #undef FOREACH_DYNAMIC_ENTRY
 
-	return 0;
+end:
+	munmap((void *) file, file_size);
+	return status;
 }
 
+/* Cache of computed host LD_LIBRARY_PATH values: the RPATH/RUNPATH
+ * entries are deterministic per binary, and the initial
+ * LD_LIBRARY_PATH is latched once for the whole session, so the path
+ * list to splice into @envp only depends on the executed file.  A
+ * warm exec copies the cached string instead of re-reading the ELF
+ * dynamic section.  */
+#define NB_LDSO_CACHE 16
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	bool rpath_found;
+	char *host_ldso_paths;
+} HostLdsoCacheEntry;
+
+static HostLdsoCacheEntry ldso_cache[NB_LDSO_CACHE];
+
 /**
  * Rebuild the variable LD_LIBRARY_PATH in @envp for the program
  * @host_path according to its RPATH, RUNPATH, and the initial
@@ -462,10 +503,44 @@ int rebuild_host_ldso_paths(Tracee *tracee, const char host_path[PATH_MAX], Arra
 	size_t length1;
 	size_t length2;
 
+	HostLdsoCacheEntry *entry = NULL;
+	DiskLdsoPaths *disk = NULL;
+	struct timespec profile_start;
+	struct stat statl;
+
 	size_t index;
 	int status;
 	int fd;
 
+	(void) clock_gettime(CLOCK_MONOTONIC, &profile_start);
+
+	if (stat(host_path, &statl) == 0)
+		entry = &ldso_cache[statl.st_ino % NB_LDSO_CACHE];
+
+	if (entry != NULL
+	    && entry->host_ldso_paths != NULL
+	    && entry->dev == statl.st_dev
+	    && entry->ino == statl.st_ino
+	    && entry->size == statl.st_size
+	    && entry->mtime == statl.st_mtime
+	    && strlen(entry->host_ldso_paths) < ARG_MAX) {
+		strcpy(host_ldso_paths, entry->host_ldso_paths);
+		rpath_found = entry->rpath_found;
+		goto splice;
+	}
+
+	/* Second level: the optional on-disk cache shared across
+	 * PRoot invocations.  */
+	if (entry != NULL)
+		disk = find_disk_ldso_paths(&statl);
+	if (disk != NULL && disk_cache_hit(&disk->key, &statl)
+	    && strnlen(disk->host_ldso_paths, sizeof(disk->host_ldso_paths))
+						< sizeof(disk->host_ldso_paths)) {
+		strcpy(host_ldso_paths, disk->host_ldso_paths);
+		rpath_found = (disk->rpath_found != 0);
+		goto store;
+	}
+
 	fd = open_elf(host_path, &elf_header);
 	if (fd < 0)
 		return fd;
@@ -521,6 +596,32 @@ int rebuild_host_ldso_paths(Tracee *tracee, const char host_path[PATH_MAX], Arra
 	if (status < 0)
 		return 0; /* Not fatal.  */
 
+	if (disk != NULL && strlen(host_ldso_paths) < sizeof(disk->host_ldso_paths)) {
+		disk->key.valid = 0;
+		disk->rpath_found = rpath_found;
+		strcpy(disk->host_ldso_paths, host_ldso_paths);
+		seal_disk_cache_entry(&disk->key, &statl);
+	}
+
+store:
+	if (entry != NULL) {
+		char *copy;
+
+		copy = talloc_strdup(talloc_autofree_context(), host_ldso_paths);
+		if (copy != NULL) {
+			talloc_free(entry->host_ldso_paths);
+			entry->host_ldso_paths = copy;
+			entry->dev         = statl.st_dev;
+			entry->ino         = statl.st_ino;
+			entry->size        = statl.st_size;
+			entry->mtime       = statl.st_mtime;
+			entry->rpath_found = rpath_found;
+		}
+	}
+
+splice:
+	account_exec_phase(host_path, EXEC_PHASE_LDSO, &profile_start);
+
 	status = find_xpointee(envp, "LD_LIBRARY_PATH");
 	if (status < 0)
 		return 0; /* Not fatal.  */
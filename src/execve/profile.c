@@ -0,0 +1,184 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <stdio.h>        /* fprintf(3), */
+#include <stdlib.h>       /* getenv(3), qsort(3), */
+#include <string.h>       /* strcmp(3), strcpy(3), strlen(3), */
+#include <stdint.h>       /* uint*_t, uintmax_t, */
+#include <stdbool.h>      /* bool, */
+#include <time.h>         /* clock_gettime(2), */
+#include <linux/limits.h> /* PATH_MAX, */
+
+#include "execve/profile.h"
+
+/* Per-executable profile of the exec pipeline, enabled with
+ * $PROOT_PROFILE_EXECVE: time spent translating paths and expanding
+ * shebangs, parsing ELF structures, rebuilding host ld.so paths, and
+ * injecting the load script, aggregated per executed program.
+ * Dumped on SIGUSR1/SIGUSR2 along with the other statistics (see
+ * print_talloc_hierarchy() in tracee/event.c), and once the event
+ * loop ends.  */
+
+static const char *exec_phase_names[NB_EXEC_PHASES] = {
+	[EXEC_PHASE_TRANSLATION] = "translation",
+	[EXEC_PHASE_ELF]         = "elf",
+	[EXEC_PHASE_LDSO]        = "ldso",
+	[EXEC_PHASE_INJECTION]   = "injection",
+};
+
+#define NB_EXEC_PROFILES 64
+
+typedef struct {
+	char path[PATH_MAX];
+	uint64_t nb_execs;
+	uint64_t nsecs[NB_EXEC_PHASES];
+} ExecProfile;
+
+static ExecProfile exec_profiles[NB_EXEC_PROFILES];
+
+/* Catch-all for paths that collide with an already profiled one.  */
+static ExecProfile other_execs = { .path = "(other)" };
+
+/* -1: $PROOT_PROFILE_EXECVE not checked yet.  */
+static int exec_profiling = -1;
+
+static bool exec_profiling_enabled(void)
+{
+	if (exec_profiling < 0)
+		exec_profiling = (getenv("PROOT_PROFILE_EXECVE") != NULL);
+	return exec_profiling > 0;
+}
+
+/**
+ * Return the profile of the executable @path; collisions fold into a
+ * single catch-all profile instead of evicting recorded data.
+ */
+static ExecProfile *get_exec_profile(const char *path)
+{
+	uint32_t hash = 5381;
+	const char *cursor;
+	ExecProfile *profile;
+
+	for (cursor = path; *cursor != '\0'; cursor++)
+		hash = hash * 33 + (uint8_t) *cursor;
+
+	profile = &exec_profiles[hash % NB_EXEC_PROFILES];
+	if (profile->path[0] == '\0') {
+		if (strlen(path) >= sizeof(profile->path))
+			return &other_execs;
+		strcpy(profile->path, path);
+	}
+	else if (strcmp(profile->path, path) != 0)
+		return &other_execs;
+
+	return profile;
+}
+
+/**
+ * Account one exec of @path.
+ */
+void account_exec(const char *path)
+{
+	if (!exec_profiling_enabled() || path == NULL)
+		return;
+
+	get_exec_profile(path)->nb_execs++;
+}
+
+/**
+ * Account to @path the time spent since @start in the given @phase.
+ */
+void account_exec_phase(const char *path, ExecPhase phase, const struct timespec *start)
+{
+	struct timespec end;
+
+	if (!exec_profiling_enabled() || path == NULL)
+		return;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &end);
+	get_exec_profile(path)->nsecs[phase] +=
+		(end.tv_sec - start->tv_sec) * UINT64_C(1000000000)
+		+ (end.tv_nsec - start->tv_nsec);
+}
+
+static uint64_t total_nsecs(const ExecProfile *profile)
+{
+	uint64_t total = 0;
+	int phase;
+
+	for (phase = 0; phase < NB_EXEC_PHASES; phase++)
+		total += profile->nsecs[phase];
+
+	return total;
+}
+
+/**
+ * Compare two profiles, most expensive first.
+ */
+static int compare_exec_profiles(const void *a, const void *b)
+{
+	uint64_t nsecs_a = total_nsecs(*(const ExecProfile *const *) a);
+	uint64_t nsecs_b = total_nsecs(*(const ExecProfile *const *) b);
+
+	return (nsecs_a < nsecs_b) - (nsecs_a > nsecs_b);
+}
+
+/* Print on stderr the per-executable exec pipeline profile, most
+ * expensive program first.  No-op unless $PROOT_PROFILE_EXECVE is
+ * set.  */
+void print_exec_profile(void)
+{
+	const ExecProfile *profiles[NB_EXEC_PROFILES + 1];
+	size_t nb_profiles = 0;
+	size_t i;
+	int phase;
+
+	if (exec_profiling <= 0)
+		return;
+
+	for (i = 0; i < NB_EXEC_PROFILES; i++) {
+		if (exec_profiles[i].path[0] != '\0')
+			profiles[nb_profiles++] = &exec_profiles[i];
+	}
+	if (other_execs.nb_execs != 0 || total_nsecs(&other_execs) != 0)
+		profiles[nb_profiles++] = &other_execs;
+
+	if (nb_profiles == 0)
+		return;
+
+	qsort(profiles, nb_profiles, sizeof(ExecProfile *), compare_exec_profiles);
+
+	fprintf(stderr, "exec pipeline profile:\n");
+
+	for (i = 0; i < nb_profiles; i++) {
+		const ExecProfile *profile = profiles[i];
+
+		fprintf(stderr, "\t%s: %ju execs", profile->path,
+			(uintmax_t) profile->nb_execs);
+
+		for (phase = 0; phase < NB_EXEC_PHASES; phase++)
+			fprintf(stderr, ", %s: %juus", exec_phase_names[phase],
+				(uintmax_t) (profile->nsecs[phase] / 1000));
+
+		fprintf(stderr, "\n");
+	}
+}
@@ -0,0 +1,42 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#ifndef EXECVE_PROFILE_H
+#define EXECVE_PROFILE_H
+
+#include <time.h> /* struct timespec, */
+
+/* Phases of the exec pipeline, in traversal order.  */
+typedef enum {
+	EXEC_PHASE_TRANSLATION = 0,	/* path translation + shebang expansion */
+	EXEC_PHASE_ELF,			/* ELF header/segments parsing */
+	EXEC_PHASE_LDSO,		/* host ld.so paths rebuilding */
+	EXEC_PHASE_INJECTION,		/* load script transfer */
+	NB_EXEC_PHASES
+} ExecPhase;
+
+extern void account_exec(const char *path);
+extern void account_exec_phase(const char *path, ExecPhase phase,
+			const struct timespec *start);
+extern void print_exec_profile(void);
+
+#endif /* EXECVE_PROFILE_H */
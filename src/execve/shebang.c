@@ -29,10 +29,12 @@
 #include <errno.h>         /* -E*, */
 #include <sys/param.h>     /* MAXSYMLINKS, */
 #include <stdbool.h>       /* bool, */
+#include <string.h>        /* strcpy(3), strlen(3), */
 #include <assert.h>        /* assert(3), */
 
 #include "execve/shebang.h"
 #include "execve/execve.h"
+#include "execve/disk_cache.h"
 #include "execve/aoxp.h"
 #include "tracee/tracee.h"
 #include "attribute.h"
@@ -197,6 +199,103 @@ end:
 	return 1;
 }
 
+/* Cache of shebang extractions, keyed by file identity.  Both
+ * outcomes are remembered: build systems re-exec the same wrapper
+ * scripts constantly, and every ELF exec pays an open/read just to
+ * find out there is no "#!" at all.  The extracted interpreter path
+ * always fits in BINPRM_BUF_SIZE, see extract_shebang().  */
+#define NB_SHEBANG_CACHE 32
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	bool valid;
+	bool has_shebang;
+	char user_path[BINPRM_BUF_SIZE];
+	char argument[BINPRM_BUF_SIZE];
+} ShebangCacheEntry;
+
+static ShebangCacheEntry shebang_cache[NB_SHEBANG_CACHE];
+
+/**
+ * Same as extract_shebang(), except the result is remembered: a
+ * re-exec of an already-seen file skips the open/read/parse sequence
+ * entirely.
+ */
+static int extract_shebang_cached(const Tracee *tracee, const char *host_path,
+		char user_path[PATH_MAX], char argument[BINPRM_BUF_SIZE])
+{
+	ShebangCacheEntry *entry = NULL;
+	DiskShebang *disk = NULL;
+	struct stat statl;
+	int status;
+
+	if (stat(host_path, &statl) == 0)
+		entry = &shebang_cache[statl.st_ino % NB_SHEBANG_CACHE];
+
+	if (entry != NULL
+	    && entry->valid
+	    && entry->dev == statl.st_dev
+	    && entry->ino == statl.st_ino
+	    && entry->size == statl.st_size
+	    && entry->mtime == statl.st_mtime) {
+		if (!entry->has_shebang)
+			return 0;
+
+		strcpy(user_path, entry->user_path);
+		strcpy(argument, entry->argument);
+		return 1;
+	}
+
+	/* Second level: the optional on-disk cache shared across
+	 * PRoot invocations.  */
+	if (entry != NULL)
+		disk = find_disk_shebang(&statl);
+	if (disk != NULL && disk_cache_hit(&disk->key, &statl)) {
+		status = (disk->has_shebang ? 1 : 0);
+		if (status > 0) {
+			strcpy(user_path, disk->user_path);
+			strcpy(argument, disk->argument);
+		}
+	}
+	else {
+		status = extract_shebang(tracee, host_path, user_path, argument);
+		if (status < 0 || entry == NULL)
+			return status;
+
+		if (disk != NULL
+		    && (status == 0 || strlen(user_path) < sizeof(disk->user_path))) {
+			disk->key.valid = 0;
+			disk->has_shebang = (status > 0);
+			if (status > 0) {
+				strcpy(disk->user_path, user_path);
+				strcpy(disk->argument, argument);
+			}
+			seal_disk_cache_entry(&disk->key, &statl);
+		}
+	}
+
+	/* Defensive: don't cache what can't be restored verbatim.  */
+	if (status > 0 && strlen(user_path) >= sizeof(entry->user_path)) {
+		entry->valid = false;
+		return status;
+	}
+
+	entry->dev         = statl.st_dev;
+	entry->ino         = statl.st_ino;
+	entry->size        = statl.st_size;
+	entry->mtime       = statl.st_mtime;
+	entry->has_shebang = (status > 0);
+	if (status > 0) {
+		strcpy(entry->user_path, user_path);
+		strcpy(entry->argument, argument);
+	}
+	entry->valid = true;
+
+	return status;
+}
+
 /**
  * Expand in argv[] the shebang of @user_path, if any.  This function
  * returns -errno if an error occurred, 1 if a shebang was found and
@@ -242,7 +341,7 @@ int expand_shebang(Tracee *tracee, char host_path[PATH_MAX], char user_path[PATH
 			return -ENOMEM;
 
 		/* Extract into user_path and argument the shebang from host_path.  */
-		status = extract_shebang(tracee, host_path, user_path, argument);
+		status = extract_shebang_cached(tracee, host_path, user_path, argument);
 		if (status < 0)
 			return status;
 
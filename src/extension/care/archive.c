@@ -24,17 +24,23 @@
 #include <sys/stat.h>    /* open(2), */
 #include <fcntl.h>       /* open(2), */
 #include <unistd.h>      /* read(2), readlink(2), close(2), lseek(2), */
+#include <sys/mman.h>    /* mmap(2), munmap(2), */
 #include <errno.h>       /* errno, EACCES, */
 #include <assert.h>      /* assert(3), */
 #include <linux/limits.h> /* PATH_MAX, */
 #include <string.h>      /* strlen(3), strcmp(3), */
 #include <stdbool.h>     /* bool, true, false, */
+#include <stdlib.h>      /* getenv(3), strtoul(3), */
+#include <stdio.h>       /* snprintf(3), */
+#include <stdint.h>      /* uint*_t, */
 #include <talloc.h>      /* talloc(3), */
+#include <uthash.h>      /* ut*, UT*, HASH*, */
 #include <archive.h>     /* archive_*(3), */
 #include <archive_entry.h> /* archive_entry*(3), */
 
 #include "extension/care/archive.h"
 #include "tracee/tracee.h"
+#include "path/temp.h"
 #include "cli/note.h"
 
 typedef struct {
@@ -122,12 +128,32 @@ parse_filter:
 		goto parse_format;
 	}
 
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+	/* "zstd:threads=0" spreads the compression over every
+	 * available core.  */
+	found = slurp_suffix(string, &cursor, ".zst");
+	if (found) {
+		format->add_filter = archive_write_add_filter_zstd;
+		format->options    = "zstd:compression-level=3,zstd:threads=0";
+		goto parse_format;
+	}
+
+	found = slurp_suffix(string, &cursor, ".tzst");
+	if (found) {
+		format->add_filter = archive_write_add_filter_zstd;
+		format->options    = "zstd:compression-level=3,zstd:threads=0";
+		format->set_format = archive_write_set_format_pax_restricted;
+		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_PAX_RESTRICTED;
+		goto sanity_checks;
+	}
+#endif
+
 	found = slurp_suffix(string, &cursor, ".tgz");
 	if (found) {
 		format->add_filter = archive_write_add_filter_gzip;
 		format->options    = "gzip:compression-level=1";
-		format->set_format = archive_write_set_format_gnutar;
-		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_GNUTAR;
+		format->set_format = archive_write_set_format_pax_restricted;
+		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_PAX_RESTRICTED;
 		goto sanity_checks;
 	}
 
@@ -135,8 +161,8 @@ parse_filter:
 	if (found) {
 		format->add_filter = archive_write_add_filter_lzop;
 		format->options    = "lzop:compression-level=1";
-		format->set_format = archive_write_set_format_gnutar;
-		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_GNUTAR;
+		format->set_format = archive_write_set_format_pax_restricted;
+		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_PAX_RESTRICTED;
 		goto sanity_checks;
 	}
 
@@ -153,8 +179,8 @@ parse_format:
 
 	found = slurp_suffix(string, &cursor, ".tar");
 	if (found) {
-		format->set_format = archive_write_set_format_gnutar;
-		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_GNUTAR;
+		format->set_format = archive_write_set_format_pax_restricted;
+		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_PAX_RESTRICTED;
 		goto sanity_checks;
 	}
 
@@ -165,8 +191,8 @@ sanity_checks:
 	if (no_filter_found && no_format_found) {
 		format->add_filter = archive_write_add_filter_lzop;
 		format->options	  = "lzop:compression-level=1";
-		format->set_format = archive_write_set_format_gnutar;
-		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_GNUTAR;
+		format->set_format = archive_write_set_format_pax_restricted;
+		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_PAX_RESTRICTED;
 
 #if defined(CARE_BINARY_IS_PORTABLE)
 		format->special = SELF_EXTRACTING;
@@ -187,8 +213,8 @@ sanity_checks:
 
 	if (no_format_found) {
 		note(tracee, WARNING, USER, "unknown format, assuming tar format.");
-		format->set_format = archive_write_set_format_gnutar;
-		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_GNUTAR;
+		format->set_format = archive_write_set_format_pax_restricted;
+		format->hardlink_resolver_strategy = ARCHIVE_FORMAT_TAR_PAX_RESTRICTED;
 
 		no_format_found = false;
 	}
@@ -257,6 +283,460 @@ end:
 	return output_fd;
 }
 
+/* Default size of the userland buffer that sits between libarchive
+ * and the output file descriptor.  libarchive emits block-sized
+ * writes -- a few dozen kilo-bytes -- so coalescing them cuts the
+ * number of write(2)s by two orders of magnitude for large archives.
+ * It can be overridden (in bytes) with the CARE_WRITE_BUFFER_SIZE
+ * environment variable.  */
+#define DEFAULT_WRITE_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ * Write the buffered content of @archive to its output file
+ * descriptor.  This function returns -1 if an error occurred,
+ * otherwise 0.
+ */
+static int flush_write_buffer(Archive *archive)
+{
+	size_t sent;
+	ssize_t size;
+
+	for (sent = 0; sent < archive->buffer_used; sent += size) {
+		size = write(archive->fd, archive->buffer + sent,
+			archive->buffer_used - sent);
+		if (size < 0) {
+			if (errno == EINTR) {
+				size = 0;
+				continue;
+			}
+			return -1;
+		}
+	}
+
+	archive->buffer_used = 0;
+	return 0;
+}
+
+/**
+ * Callback invoked by libarchive each time it emits a block: the
+ * block is appended to the buffer of @archive_, which reaches the
+ * output file descriptor only once full.
+ */
+static ssize_t buffered_write_callback(struct archive *handle, void *archive_,
+				const void *data, size_t size)
+{
+	Archive *archive = archive_;
+
+	if (archive->buffer_used + size > archive->buffer_size
+	    && flush_write_buffer(archive) < 0)
+		goto error;
+
+	/* Blocks at least as large as the buffer bypass it; it was
+	 * flushed right above so the output stays in order.  */
+	if (size >= archive->buffer_size) {
+		size_t sent;
+		ssize_t status;
+
+		for (sent = 0; sent < size; sent += status) {
+			status = write(archive->fd, (const uint8_t *) data + sent,
+				size - sent);
+			if (status < 0) {
+				if (errno == EINTR) {
+					status = 0;
+					continue;
+				}
+				goto error;
+			}
+		}
+		return size;
+	}
+
+	memcpy(archive->buffer + archive->buffer_used, data, size);
+	archive->buffer_used += size;
+	return size;
+
+error:
+	archive_set_error(handle, errno, "can't write archive");
+	return -1;
+}
+
+/**
+ * Callback invoked by libarchive once the archive is complete: the
+ * tail of the buffer is flushed.  The file descriptor is left open
+ * when extracting information still has to be appended to it
+ * (self-extracting and raw formats, see finalize_care()).
+ */
+static int buffered_close_callback(struct archive *handle, void *archive_)
+{
+	Archive *archive = archive_;
+
+	if (flush_write_buffer(archive) < 0) {
+		archive_set_error(handle, errno, "can't write archive");
+		return ARCHIVE_FATAL;
+	}
+
+	if (archive->offset == 0) {
+		(void) close(archive->fd);
+		archive->fd = -1;
+	}
+
+	return ARCHIVE_OK;
+}
+
+/**
+ * Attach the buffered write callbacks above to @archive, whose output
+ * file descriptor is expected to be valid.  This function returns the
+ * status of archive_write_open(3).
+ */
+static int open_archive_buffered(const Tracee *tracee, Archive *archive)
+{
+	const char *variable;
+
+	archive->buffer_size = DEFAULT_WRITE_BUFFER_SIZE;
+
+	variable = getenv("CARE_WRITE_BUFFER_SIZE");
+	if (variable != NULL && strtoul(variable, NULL, 10) > 0)
+		archive->buffer_size = strtoul(variable, NULL, 10);
+
+	archive->buffer = talloc_size(archive, archive->buffer_size);
+	if (archive->buffer == NULL) {
+		note(tracee, WARNING, INTERNAL, "can't allocate write buffer");
+		return archive_write_open_fd(archive->handle, archive->fd);
+	}
+
+	return archive_write_open(archive->handle, archive, NULL,
+				buffered_write_callback, buffered_close_callback);
+}
+
+/* For tar formats, hardlinks are resolved with the bounded index
+ * below instead of libarchive's resolver: the latter retains a whole
+ * archive_entry -- several hundred bytes plus strings -- for every
+ * partially seen hardlink group, and groups whose remaining links are
+ * never captured (as with ostree-style deployments, where each file
+ * has many links but only one is accessed) are retained forever.  The
+ * index keeps only (device, inode) -> archive-path records; once
+ * HARDLINK_INDEX_MEMORY_CAP bytes are in memory, further records
+ * spill to an open-addressed table backed by temporary files.  */
+
+#define HARDLINK_INDEX_MEMORY_CAP (32 * 1024 * 1024)
+#define SPILL_INITIAL_NB_SLOTS (UINT64_C(1) << 20)
+
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+} HardlinkKey;
+
+typedef struct hardlink_entry {
+	HardlinkKey key;
+	UT_hash_handle hh;
+	char path[];
+} HardlinkEntry;
+
+/* On-disk slot of the spill table; empty iff path_length == 0.  */
+typedef struct {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t path_offset;
+	uint32_t path_length;
+	uint32_t padding;
+} HardlinkRecord;
+
+typedef struct hardlink_index {
+	HardlinkEntry *entries;
+	size_t memory_usage;
+
+	int slots_fd;
+	int paths_fd;
+	uint64_t nb_slots;
+	uint64_t nb_slots_used;
+	uint64_t paths_size;
+} HardlinkIndex;
+
+/**
+ * Close the spill files of @index.  This function always returns 0.
+ *
+ * Note: this is a talloc destructor.
+ */
+static int close_hardlink_index(HardlinkIndex *index)
+{
+	if (index->slots_fd >= 0)
+		(void) close(index->slots_fd);
+	if (index->paths_fd >= 0)
+		(void) close(index->paths_fd);
+	return 0;
+}
+
+/**
+ * Allocate a new hardlink index attached to @context.  This function
+ * returns NULL on error.
+ */
+static HardlinkIndex *new_hardlink_index(TALLOC_CTX *context)
+{
+	HardlinkIndex *index;
+
+	index = talloc_zero(context, HardlinkIndex);
+	if (index == NULL)
+		return NULL;
+
+	index->slots_fd = -1;
+	index->paths_fd = -1;
+	talloc_set_destructor(index, close_hardlink_index);
+
+	return index;
+}
+
+static uint64_t hash_hardlink_key(uint64_t dev, uint64_t ino)
+{
+	uint64_t hash;
+
+	hash = dev ^ (ino * UINT64_C(0x9E3779B97F4A7C15));
+	hash ^= hash >> 32;
+	return hash;
+}
+
+/**
+ * Store @record into the table of @nb_slots slots backed by
+ * @slots_fd, probing linearly from its hash.  The caller shall ensure
+ * the key is not in the table yet and that a free slot exists.  This
+ * function returns -1 if an error occurred, otherwise 0.
+ */
+static int spill_store(int slots_fd, uint64_t nb_slots, const HardlinkRecord *record)
+{
+	uint64_t slot;
+
+	slot = hash_hardlink_key(record->dev, record->ino) % nb_slots;
+	while (1) {
+		HardlinkRecord probed;
+		ssize_t size;
+
+		bzero(&probed, sizeof(probed));
+		size = pread(slots_fd, &probed, sizeof(probed), slot * sizeof(probed));
+		if (size < 0)
+			return -1;
+
+		/* A short read means the sparse file was never
+		 * extended this far, ie. the slot is empty.  */
+		if (size < (ssize_t) sizeof(probed) || probed.path_length == 0)
+			break;
+
+		slot = (slot + 1) % nb_slots;
+	}
+
+	if (pwrite(slots_fd, record, sizeof(*record), slot * sizeof(*record))
+	    != sizeof(*record))
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Double the spill table of @index, re-inserting every record.  This
+ * function returns -1 if an error occurred, otherwise 0.
+ */
+static int grow_spill_table(HardlinkIndex *index)
+{
+	const char *name;
+	uint64_t nb_slots;
+	uint64_t slot;
+	int fd;
+
+	name = create_temp_file(index, "care-hardlinks");
+	if (name == NULL)
+		return -1;
+
+	fd = open(name, O_RDWR);
+	if (fd < 0)
+		return -1;
+
+	nb_slots = 2 * index->nb_slots;
+	for (slot = 0; slot < index->nb_slots; slot++) {
+		HardlinkRecord record;
+		ssize_t size;
+
+		bzero(&record, sizeof(record));
+		size = pread(index->slots_fd, &record, sizeof(record),
+			slot * sizeof(record));
+		if (size < 0) {
+			(void) close(fd);
+			return -1;
+		}
+		if (size < (ssize_t) sizeof(record) || record.path_length == 0)
+			continue;
+
+		if (spill_store(fd, nb_slots, &record) < 0) {
+			(void) close(fd);
+			return -1;
+		}
+	}
+
+	(void) close(index->slots_fd);
+	index->slots_fd = fd;
+	index->nb_slots = nb_slots;
+
+	return 0;
+}
+
+/**
+ * Search the spill table of @index for (@dev, @ino); on success the
+ * recorded archive path is copied into @path.  This function returns
+ * 1 if the record was found, 0 if it was not, -1 if an error
+ * occurred.
+ */
+static int spill_lookup(HardlinkIndex *index, uint64_t dev, uint64_t ino,
+			char path[PATH_MAX])
+{
+	uint64_t slot;
+
+	if (index->slots_fd < 0)
+		return 0;
+
+	slot = hash_hardlink_key(dev, ino) % index->nb_slots;
+	while (1) {
+		HardlinkRecord record;
+		ssize_t size;
+
+		bzero(&record, sizeof(record));
+		size = pread(index->slots_fd, &record, sizeof(record),
+			slot * sizeof(record));
+		if (size < 0)
+			return -1;
+		if (size < (ssize_t) sizeof(record) || record.path_length == 0)
+			return 0;
+
+		if (record.dev == dev && record.ino == ino) {
+			if (record.path_length >= PATH_MAX)
+				return -1;
+
+			size = pread(index->paths_fd, path, record.path_length,
+				record.path_offset);
+			if (size != (ssize_t) record.path_length)
+				return -1;
+
+			path[record.path_length] = '\0';
+			return 1;
+		}
+
+		slot = (slot + 1) % index->nb_slots;
+	}
+}
+
+/**
+ * Record (@dev, @ino) -> @path into the spill table of @index, which
+ * is created on first use and doubled once 3/4 full.  This function
+ * returns -1 if an error occurred, otherwise 0.
+ */
+static int spill_insert(HardlinkIndex *index, uint64_t dev, uint64_t ino,
+			const char *path)
+{
+	HardlinkRecord record;
+	size_t length;
+
+	if (index->slots_fd < 0) {
+		const char *name;
+
+		name = create_temp_file(index, "care-hardlinks");
+		if (name == NULL)
+			return -1;
+		index->slots_fd = open(name, O_RDWR);
+
+		name = create_temp_file(index, "care-hardlinks");
+		if (name == NULL)
+			return -1;
+		index->paths_fd = open(name, O_RDWR);
+
+		if (index->slots_fd < 0 || index->paths_fd < 0)
+			return -1;
+
+		index->nb_slots = SPILL_INITIAL_NB_SLOTS;
+	}
+
+	if (4 * index->nb_slots_used >= 3 * index->nb_slots
+	    && grow_spill_table(index) < 0)
+		return -1;
+
+	length = strlen(path);
+	if (pwrite(index->paths_fd, path, length, index->paths_size)
+	    != (ssize_t) length)
+		return -1;
+
+	bzero(&record, sizeof(record));
+	record.dev = dev;
+	record.ino = ino;
+	record.path_offset = index->paths_size;
+	record.path_length = length;
+
+	if (spill_store(index->slots_fd, index->nb_slots, &record) < 0)
+		return -1;
+
+	index->paths_size += length;
+	index->nb_slots_used++;
+
+	return 0;
+}
+
+/**
+ * Substitute for archive_entry_linkify(3): if (@statl->st_dev,
+ * @statl->st_ino) was already archived, turn @entry into a hardlink
+ * to the recorded archive path, otherwise record where this first
+ * link lands.  Errors only degrade the archive -- a link is stored as
+ * a plain copy -- so they are not reported.
+ */
+static void resolve_hardlink(Archive *archive, struct archive_entry *entry,
+			const struct stat *statl)
+{
+	char spilled_path[PATH_MAX];
+	HardlinkIndex *index = archive->hardlink_index;
+	HardlinkEntry *known;
+	HardlinkKey key;
+	size_t length;
+	int status;
+
+	if (statl->st_nlink <= 1 || !S_ISREG(statl->st_mode))
+		return;
+
+	bzero(&key, sizeof(key));
+	key.dev = statl->st_dev;
+	key.ino = statl->st_ino;
+
+	HASH_FIND(hh, index->entries, &key, sizeof(key), known);
+	if (known != NULL) {
+		archive_entry_set_hardlink(entry, known->path);
+		archive_entry_set_size(entry, 0);
+		return;
+	}
+
+	status = spill_lookup(index, key.dev, key.ino, spilled_path);
+	if (status > 0) {
+		archive_entry_set_hardlink(entry, spilled_path);
+		archive_entry_set_size(entry, 0);
+		return;
+	}
+	if (status < 0)
+		return;
+
+	/* First link of its group: record where it lands.  */
+	length = strlen(archive_entry_pathname(entry));
+
+	if (index->memory_usage + sizeof(HardlinkEntry) + length + 1
+	    > HARDLINK_INDEX_MEMORY_CAP) {
+		(void) spill_insert(index, key.dev, key.ino,
+				archive_entry_pathname(entry));
+		return;
+	}
+
+	known = talloc_size(index, sizeof(HardlinkEntry) + length + 1);
+	if (known == NULL)
+		return;
+
+	bzero(&known->key, sizeof(known->key));
+	known->key.dev = key.dev;
+	known->key.ino = key.ino;
+	memcpy(known->path, archive_entry_pathname(entry), length + 1);
+
+	HASH_ADD(hh, index->entries, key, sizeof(known->key), known);
+	index->memory_usage += sizeof(HardlinkEntry) + length + 1;
+}
+
 /**
  * Create a new archive structure (memory allocation attached to
  * @context) for the given @output file.  This function returns NULL
@@ -335,7 +815,16 @@ Archive *new_archive(TALLOC_CTX *context, const Tracee* tracee,
 		return NULL;
 	}
 
-	if (format.hardlink_resolver_strategy != 0) {
+	if (format.hardlink_resolver_strategy == ARCHIVE_FORMAT_TAR_PAX_RESTRICTED) {
+		/* Tar hardlinks fit the bounded index, see
+		 * resolve_hardlink().  */
+		archive->hardlink_index = new_hardlink_index(archive);
+
+		/* Only the pax writer can describe file holes, see
+		 * build_sparse_map().  */
+		archive->supports_sparse = true;
+	}
+	if (archive->hardlink_index == NULL && format.hardlink_resolver_strategy != 0) {
 		archive->hardlink_resolver = archive_entry_linkresolver_new();
 		if (archive->hardlink_resolver != NULL)
 			archive_entry_linkresolver_set_strategy(archive->hardlink_resolver,
@@ -369,7 +858,7 @@ Archive *new_archive(TALLOC_CTX *context, const Tracee* tracee,
 		/* Remember where the CARE binary ends.  */
 		archive->offset = lseek(archive->fd, 0, SEEK_CUR);
 
-		status = archive_write_open_fd(archive->handle, archive->fd);
+		status = open_archive_buffered(tracee, archive);
 		break;
 
 	case RAW:
@@ -389,11 +878,18 @@ Archive *new_archive(TALLOC_CTX *context, const Tracee* tracee,
 		/* Remember where the "RAW" string ends.  */
 		archive->offset = lseek(archive->fd, 0, SEEK_CUR);
 
-		status = archive_write_open_fd(archive->handle, archive->fd);
+		status = open_archive_buffered(tracee, archive);
 		break;
 
 	default:
-		status = archive_write_open_filename(archive->handle, output);
+		archive->fd = open(output, O_WRONLY|O_CREAT|O_TRUNC,
+				S_IRUSR|S_IWUSR|S_IRGRP);
+		if (archive->fd < 0) {
+			note(tracee, ERROR, SYSTEM, "can't open/create '%s'", output);
+			return NULL;
+		}
+
+		status = open_archive_buffered(tracee, archive);
 		break;
 	}
 	if (status != ARCHIVE_OK) {
@@ -430,19 +926,107 @@ int finalize_archive(Archive *archive)
 	return 0;
 }
 
+/* Data region of a sparse file, see build_sparse_map().  */
+typedef struct {
+	off_t start;
+	off_t length;
+} SparseRegion;
+
+/**
+ * Scan the first @size bytes of @fd with lseek(2) SEEK_DATA/SEEK_HOLE
+ * and store its data regions into *@regions (malloc'ed, it is left
+ * for the caller to free).  This function returns the number of
+ * regions if @fd actually contains holes, otherwise 0: dense files,
+ * fully-hole files, and file-systems without hole support are
+ * archived the regular way.  The file offset of @fd is rewound to 0.
+ */
+static size_t build_sparse_map(int fd, off_t size, SparseRegion **regions_)
+{
+	SparseRegion *regions = NULL;
+	size_t nb_regions = 0;
+	size_t capacity = 0;
+	off_t total_data = 0;
+	off_t cursor = 0;
+
+	while (cursor < size) {
+		off_t data;
+		off_t hole;
+
+		data = lseek(fd, cursor, SEEK_DATA);
+		if (data < 0) {
+			/* ENXIO means a trailing hole.  */
+			if (errno == ENXIO)
+				break;
+			goto dense;
+		}
+		if (data >= size)
+			break;
+
+		hole = lseek(fd, data, SEEK_HOLE);
+		if (hole < 0)
+			goto dense;
+		if (hole > size)
+			hole = size;
+
+		if (nb_regions == capacity) {
+			SparseRegion *tmp;
+
+			capacity = (capacity == 0 ? 16 : 2 * capacity);
+			tmp = realloc(regions, capacity * sizeof(SparseRegion));
+			if (tmp == NULL)
+				goto dense;
+			regions = tmp;
+		}
+		regions[nb_regions].start  = data;
+		regions[nb_regions].length = hole - data;
+		nb_regions++;
+
+		total_data += hole - data;
+		cursor = hole;
+	}
+
+	/* Not sparse at all?  */
+	if (nb_regions == 0 || total_data >= size)
+		goto dense;
+
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		goto dense;
+
+	*regions_ = regions;
+	return nb_regions;
+
+dense:
+	free(regions);
+	(void) lseek(fd, 0, SEEK_SET);
+	return 0;
+}
+
 /**
  * Put the content of @path into @archive, with the specified @statl
- * status, at the given @alternate_path (NULL if unchanged).  This
- * function returns -1 if an error occurred, otherwise 0.  Note: this
- * function can be called with @tracee == NULL.
+ * status, at the given @alternate_path (NULL if unchanged).  When
+ * @held_fd is not -1, it is an O_PATH descriptor captured when @path
+ * was stat'ed: the content is then read through it -- it is left for
+ * the caller to close -- so the archive matches the recorded
+ * metadata even if @path was replaced in between.  When
+ * @inlined_content is not NULL, it points to the @inlined_size bytes
+ * of the content, captured by the caller: @path is then not read at
+ * all.  This function returns -1 if an error occurred, otherwise 0.
+ * Note: this function can be called with @tracee == NULL.
  */
 int archive(const Tracee* tracee, Archive *archive,
-	const char *path, const char *alternate_path, const struct stat *statl)
+	const char *path, const char *alternate_path,
+	const struct stat *statl, int held_fd,
+	const void *inlined_content, size_t inlined_size)
 {
 	struct archive_entry *entry = NULL;
+	SparseRegion *regions = NULL;
+	size_t nb_regions = 0;
+	bool use_inline = false;
 	ssize_t status;
 	mode_t type;
 	size_t size;
+	size_t i;
+	void *map;
 	int fd = -1;
 
 	if (archive == NULL || archive->handle == NULL)
@@ -459,7 +1043,9 @@ int archive(const Tracee* tracee, Archive *archive,
 	archive_entry_set_pathname(entry, alternate_path ?: path);
 	archive_entry_copy_stat(entry, statl);
 
-	if (archive->hardlink_resolver != NULL) {
+	if (archive->hardlink_index != NULL)
+		resolve_hardlink(archive, entry, statl);
+	else if (archive->hardlink_resolver != NULL) {
 		struct archive_entry *unused;
 		archive_entry_linkify(archive->hardlink_resolver, &entry, &unused);
 	}
@@ -486,6 +1072,35 @@ int archive(const Tracee* tracee, Archive *archive,
 		archive_entry_set_symlink(entry, target);
 	}
 
+	/* The content descriptor is needed before the header is
+	 * written: sparse maps are part of pax extended headers.  */
+	use_inline = (inlined_content != NULL && inlined_size == size);
+	if (type == AE_IFREG && size > 0 && !use_inline) {
+		/* An O_PATH descriptor can not be read directly, it has
+		 * to be re-opened through procfs; this does not walk
+		 * @path again.  */
+		if (held_fd >= 0) {
+			char procfs_link[32];
+			snprintf(procfs_link, sizeof(procfs_link), "/proc/self/fd/%d", held_fd);
+			fd = open(procfs_link, O_RDONLY);
+		}
+		if (fd < 0)
+			fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			if (errno != EACCES)
+				note(tracee, WARNING, SYSTEM, "can't open '%s'", path);
+			status = -1;
+			goto end;
+		}
+
+		if (archive->supports_sparse) {
+			nb_regions = build_sparse_map(fd, size, &regions);
+			for (i = 0; i < nb_regions; i++)
+				archive_entry_sparse_add_entry(entry,
+					regions[i].start, regions[i].length);
+		}
+	}
+
 	status = archive_write_header(archive->handle, entry);
 	if (status != ARCHIVE_OK) {
 		note(tracee, WARNING, INTERNAL, "can't write header for '%s': %s",
@@ -500,17 +1115,71 @@ int archive(const Tracee* tracee, Archive *archive,
 		goto end;
 	}
 
-	fd = open(path, O_RDONLY);
-	if (fd < 0) {
-		if (errno != EACCES)
-			note(tracee, WARNING, SYSTEM, "can't open '%s'", path);
-		status = -1;
+	/* Content captured by the caller?  The size check guards
+	 * against a file truncated or replaced since then.  */
+	if (use_inline) {
+		status = (archive_write_data(archive->handle, inlined_content, size)
+			== (ssize_t) size ? 0 : -1);
+		if (status < 0)
+			note(tracee, WARNING, INTERNAL, "can't archive '%s' content: %s",
+				path, archive_error_string(archive->handle));
+		goto end;
+	}
+
+	/* Sparse file?  Feed only its data regions; the reader
+	 * recreates the holes from the pax sparse map.  */
+	if (nb_regions > 0) {
+		for (i = 0; i < nb_regions; i++) {
+			off_t offset = regions[i].start;
+			off_t remaining = regions[i].length;
+
+			while (remaining > 0) {
+				uint8_t buffer[64 * 1024];
+				size_t chunk = (remaining < (off_t) sizeof(buffer)
+						? (size_t) remaining : sizeof(buffer));
+
+				status = pread(fd, buffer, chunk, offset);
+				if (status <= 0) {
+					note(tracee, WARNING, SYSTEM, "can't read '%s'", path);
+					status = -1;
+					goto end;
+				}
+
+				if (archive_write_data(archive->handle, buffer, status)
+					!= status) {
+					note(tracee, WARNING, INTERNAL,
+						"can't archive '%s' content: %s", path,
+						archive_error_string(archive->handle));
+					status = -1;
+					goto end;
+				}
+
+				offset    += status;
+				remaining -= status;
+			}
+		}
+		status = 0;
 		goto end;
 	}
 
-	/* Copy the content from the file into the archive.  */
+	/* Feed the whole content to libarchive straight from the page
+	 * cache: this avoids one copy -- and one read(2) per chunk --
+	 * compared with bouncing it through a user-space buffer.  */
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map != MAP_FAILED) {
+		status = (archive_write_data(archive->handle, map, size)
+			== (ssize_t) size ? 0 : -1);
+		(void) munmap(map, size);
+		if (status < 0)
+			note(tracee, WARNING, INTERNAL, "can't archive '%s' content: %s",
+				path, archive_error_string(archive->handle));
+		goto end;
+	}
+
+	/* Fall back to a copy loop; mmap(2) fails on pseudo
+	 * file-systems for instance.  */
 	do {
-		uint8_t buffer[4096];
+		uint8_t buffer[64 * 1024];
 
 		status = read(fd, buffer, sizeof(buffer));
 		if (status < 0) {
@@ -530,6 +1199,8 @@ int archive(const Tracee* tracee, Archive *archive,
 	status = 0;
 
 end:
+	free(regions);
+
 	if (fd >= 0)
 		(void) close(fd);
 
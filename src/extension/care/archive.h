@@ -33,15 +33,32 @@ typedef struct {
 	struct archive *handle;
 	struct archive_entry_linkresolver *hardlink_resolver;
 
+	/* Bounded (device, inode) -> archive-path index used instead
+	 * of @hardlink_resolver for tar formats, see
+	 * resolve_hardlink() in archive.c.  */
+	struct hardlink_index *hardlink_index;
+
+	/* Whether the format can describe file holes (pax sparse
+	 * maps), see build_sparse_map() in archive.c.  */
+	bool supports_sparse;
+
 	/* Information used to create an self-extracting archive.  */
 	off_t offset;
 	int fd;
+
+	/* Userland buffer sitting between libarchive and the output
+	 * file descriptor, see buffered_write_callback().  */
+	uint8_t *buffer;
+	size_t buffer_size;
+	size_t buffer_used;
 } Archive;
 
 extern Archive *new_archive(TALLOC_CTX *context, const Tracee* tracee,
 				const char *output, size_t *prefix_length);
 extern int finalize_archive(Archive *archive);
 extern int archive(const Tracee* tracee, Archive *archive,
-		const char *path, const char *alternate_path, const struct stat *statl);
+		const char *path, const char *alternate_path,
+		const struct stat *statl, int held_fd,
+		const void *inlined_content, size_t inlined_size);
 
 #endif /* ARCHIVE_H */
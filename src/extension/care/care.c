@@ -22,9 +22,12 @@
 
 #include <sys/types.h>    /* struct stat, */
 #include <sys/stat.h>     /* struct stat, */
-#include <unistd.h>       /* lstat(2), */
+#include <unistd.h>       /* lstat(2), close(2), */
+#include <fcntl.h>        /* open(2), O_PATH, */
 #include <linux/limits.h> /* PATH_MAX, */
 #include <string.h>       /* strlen(3), */
+#include <stdlib.h>       /* malloc(3), free(3), */
+#include <pthread.h>      /* pthread_*, */
 #include <assert.h>       /* assert(3), */
 #include <time.h>         /* time(2), localtime(3), */
 #include <stddef.h>       /* offsetof(3), */
@@ -52,11 +55,202 @@
 #define uthash_malloc(size) talloc_size(care, size)
 #define uthash_free(pointer, size) TALLOC_FREE(pointer)
 
-/* Hash entry.  */
-typedef struct Entry {
-	UT_hash_handle hh;
-	char *path;
-} Entry;
+/* Content of regular files up to this size is captured inline in the
+ * work item, while the dentry is still hot in the cache; the archiver
+ * thread then never touches the file-system for them.  See
+ * handle_host_path().  */
+#define INLINE_CONTENT_MAX (16 * 1024)
+
+/* Unit of work for the archiver thread.  It is allocated with
+ * malloc(3) since talloc contexts must not be shared between
+ * threads; @path, @location and @content (NULL when the content was
+ * not captured inline) point into the trailing buffer.  */
+typedef struct work_item {
+	struct work_item *next;
+	struct stat statl;
+	int fd;
+	char *location;
+	char *content;
+	size_t content_size;
+	char path[];
+} WorkItem;
+
+/* Number of work items archived in one go; this bounds the stack
+ * usage of the archiver thread, not the queue itself.  */
+#define ARCHIVER_BATCH_CAPACITY 1024
+
+/**
+ * Write @item into @care->archive, then release it.
+ */
+static void archive_work_item(Care *care, WorkItem *item)
+{
+	int status;
+
+	status = archive(NULL, care->archive, item->path, item->location,
+			&item->statl, item->fd, item->content, item->content_size);
+	if (status == 0 && global_verbose_level >= 1)
+		note(NULL, INFO, INTERNAL, "archived: %s", item->path);
+
+	if (item->fd >= 0)
+		(void) close(item->fd);
+	free(item);
+}
+
+/**
+ * Compare two work items by content size, for qsort(3).
+ */
+static int compare_work_items(const void *item1_, const void *item2_)
+{
+	const WorkItem *item1 = *(WorkItem *const *) item1_;
+	const WorkItem *item2 = *(WorkItem *const *) item2_;
+
+	if (item1->statl.st_size < item2->statl.st_size)
+		return -1;
+	if (item1->statl.st_size > item2->statl.st_size)
+		return 1;
+	return 0;
+}
+
+/**
+ * Archive the @nb_items entries of @batch with a two-stream layout:
+ * metadata-only entries (directories, symlinks, empty or special
+ * files) are written first, in their arrival order, then regular file
+ * contents follow sorted by size.  Tar members can appear in any
+ * order so this costs nothing, and it stops tiny interleaved headers
+ * from breaking up the large sequential writes -- also, contents of
+ * similar sizes tend to compress better side by side.
+ */
+static void archive_batch(Care *care, WorkItem *batch[], size_t nb_items)
+{
+	WorkItem *contents[ARCHIVER_BATCH_CAPACITY];
+	size_t nb_contents = 0;
+	size_t i;
+
+	for (i = 0; i < nb_items; i++) {
+		if (S_ISREG(batch[i]->statl.st_mode) && batch[i]->statl.st_size > 0)
+			contents[nb_contents++] = batch[i];
+		else
+			archive_work_item(care, batch[i]);
+	}
+
+	qsort(contents, nb_contents, sizeof(WorkItem *), compare_work_items);
+
+	for (i = 0; i < nb_contents; i++)
+		archive_work_item(care, contents[i]);
+}
+
+/**
+ * Entry point of the archiver thread: dequeue the work items pushed
+ * by handle_host_path() and write them into @care->archive, one batch
+ * at a time (see archive_batch()).  Note: nothing else shall use this
+ * archive until finalize_archiver() has joined this thread.
+ */
+static void *archiver_main(void *private)
+{
+	Care *care = private;
+
+	while (1) {
+		WorkItem *batch[ARCHIVER_BATCH_CAPACITY];
+		size_t nb_items = 0;
+
+		pthread_mutex_lock(&care->work_lock);
+		while (care->work_head == NULL && !care->archiver_stopping)
+			pthread_cond_wait(&care->work_cond, &care->work_lock);
+
+		if (care->work_head == NULL) {
+			/* The queue is drained and no more items will
+			 * ever be pushed.  */
+			pthread_mutex_unlock(&care->work_lock);
+			return NULL;
+		}
+
+		/* Drain every pending item -- up to the batch
+		 * capacity -- in one go, so archive_batch() sees as
+		 * much of the stream as possible.  */
+		while (care->work_head != NULL && nb_items < ARCHIVER_BATCH_CAPACITY) {
+			WorkItem *item = care->work_head;
+
+			care->work_head = item->next;
+			if (care->work_head == NULL)
+				care->work_tail = NULL;
+			batch[nb_items++] = item;
+		}
+		pthread_mutex_unlock(&care->work_lock);
+
+		archive_batch(care, batch, nb_items);
+	}
+}
+
+/**
+ * Push (@path, @location, @statl, @fd) to the archiver thread, which
+ * becomes responsible for closing @fd (when not -1).  When @content
+ * is not NULL, it points to the @content_size bytes of the file
+ * content, captured by the caller.  This function returns -1 if an
+ * error occurred, otherwise 0.
+ */
+static int enqueue_archiving(Care *care, const char *path,
+			const char *location, const struct stat *statl, int fd,
+			const void *content, size_t content_size)
+{
+	size_t location_size;
+	size_t path_size;
+	WorkItem *item;
+
+	path_size     = strlen(path) + 1;
+	location_size = strlen(location) + 1;
+
+	item = malloc(sizeof(WorkItem) + path_size + location_size
+		+ (content != NULL ? content_size : 0));
+	if (item == NULL)
+		return -1;
+
+	item->next  = NULL;
+	item->statl = *statl;
+	item->fd    = fd;
+	memcpy(item->path, path, path_size);
+	item->location = item->path + path_size;
+	memcpy(item->location, location, location_size);
+
+	if (content != NULL) {
+		item->content = item->location + location_size;
+		item->content_size = content_size;
+		memcpy(item->content, content, content_size);
+	}
+	else {
+		item->content = NULL;
+		item->content_size = 0;
+	}
+
+	pthread_mutex_lock(&care->work_lock);
+	if (care->work_tail != NULL)
+		care->work_tail->next = item;
+	else
+		care->work_head = item;
+	care->work_tail = item;
+	pthread_cond_signal(&care->work_cond);
+	pthread_mutex_unlock(&care->work_lock);
+
+	return 0;
+}
+
+/**
+ * Wait until every queued work item was archived, then join the
+ * archiver thread.  Once this function has returned, @care->archive
+ * can be safely used from the calling thread again.
+ */
+void finalize_archiver(Care *care)
+{
+	if (!care->archiver_started)
+		return;
+
+	pthread_mutex_lock(&care->work_lock);
+	care->archiver_stopping = true;
+	pthread_cond_signal(&care->work_cond);
+	pthread_mutex_unlock(&care->work_lock);
+
+	pthread_join(care->archiver, NULL);
+	care->archiver_started = false;
+}
 
 /**
  * Add a copy of @value at the end if the given @list.  All the newly
@@ -235,6 +429,17 @@ static int generate_care(Extension *extension, const Options *options)
 	 * handle_host_path().  */
 	care->max_size = options->max_size * 1024 * 1024;
 
+	/* Archive asynchronously: the tracee is resumed as soon as a
+	 * work item is queued instead of staying stopped while
+	 * libarchive reads and compresses the file content.  */
+	pthread_mutex_init(&care->work_lock, NULL);
+	pthread_cond_init(&care->work_cond, NULL);
+	care->archiver_started =
+		(pthread_create(&care->archiver, NULL, archiver_main, care) == 0);
+	if (!care->archiver_started)
+		note(tracee, WARNING, SYSTEM, "can't start the archiver thread, "
+			"falling back to synchronous archiving");
+
 	/* handle_host_path() can now be safely used.  */
 	care->is_ready = true;
 
@@ -243,13 +448,16 @@ static int generate_care(Extension *extension, const Options *options)
 }
 
 /**
- * Add @path_ to the list of @care->concealed_accesses.  This function
- * does *not* check for duplicated entries.
+ * Add @path_ to the registry of @care->concealed_entries, unless it
+ * was already registered or is covered by a registered ancestor.
  */
 static void register_concealed_access(const Tracee *tracee, Care *care, const char *path_)
 {
+	char ancestor[PATH_MAX];
 	char path[PATH_MAX];
 	size_t length;
+	Entry *entry;
+	char *cursor;
 	int status;
 
 	length = strlen(path_);
@@ -262,6 +470,26 @@ static void register_concealed_access(const Tracee *tracee, Care *care, const ch
 	status = substitute_binding(tracee, HOST, path);
 	if (status != 1)
 		return;
+	length = strlen(path);
+
+	/* Don't register -- nor check on the file-system -- a path
+	 * that was already registered; the same missing path is
+	 * typically probed over and over during a build.  */
+	HASH_FIND_STR(care->concealed_entries, path, entry);
+	if (entry != NULL)
+		return;
+
+	/* Nor a path covered by a registered ancestor: once this
+	 * latter is concealed, everything below it is unreachable
+	 * anyway, so registering each probed descendant of a
+	 * concealed tree would only burn memory.  */
+	memcpy(ancestor, path, length + 1);
+	while ((cursor = strrchr(ancestor, '/')) != NULL && cursor != ancestor) {
+		*cursor = '\0';
+		HASH_FIND_STR(care->concealed_entries, ancestor, entry);
+		if (entry != NULL)
+			return;
+	}
 
 	/* Do not register accesses that would not succeed even if the
 	 * path was revealed, i.e. the path does not exist at all.  */
@@ -269,7 +497,20 @@ static void register_concealed_access(const Tracee *tracee, Care *care, const ch
 	if (status < 0)
 		return;
 
-	queue_item(care, &care->concealed_accesses, path);
+	/* One block for the entry and its path: the per-entry
+	 * overhead matters for captures that conceal a huge number of
+	 * paths.  */
+	entry = talloc_zero_size(care, sizeof(Entry) + length + 1);
+	if (entry == NULL) {
+		note(tracee, WARNING, INTERNAL, "can't allocate entry for '%s'", path);
+		return;
+	}
+
+	entry->path = (char *) entry + sizeof(Entry);
+	memcpy(entry->path, path, length + 1);
+
+	HASH_ADD_KEYPTR(hh, care->concealed_entries, entry->path, length, entry);
+
 	VERBOSE(tracee, 1, "concealed: %s", path);
 }
 
@@ -278,13 +519,17 @@ static void register_concealed_access(const Tracee *tracee, Care *care, const ch
  */
 static void handle_host_path(Extension *extension, const char *path)
 {
+	char content_buffer[INLINE_CONTENT_MAX];
+	size_t content_size;
 	struct stat statl;
 	bool as_dentries;
 	char *location;
 	Tracee *tracee;
+	void *content;
 	Entry *entry;
 	Care *care;
 	int status;
+	int fd;
 
 	care = talloc_get_type_abort(extension->config, Care);
 	tracee = TRACEE(extension);
@@ -394,6 +639,11 @@ static void handle_host_path(Extension *extension, const char *path)
 		statl.st_size = 0;
 	}
 
+	/* Entries that land with their content make up the prefetch
+	 * manifest, in this very access order; see
+	 * archive_prefetch_manifest_txt().  */
+	entry->has_content = (S_ISREG(statl.st_mode) && statl.st_size > 0);
+
 	/* Format the location within the archive.  */
 	location = NULL;
 	assert(path[0] == '/');
@@ -403,7 +653,60 @@ static void handle_host_path(Extension *extension, const char *path)
 		return;
 	}
 
-	status = archive(tracee, care->archive, path, location, &statl);
+	/* Capture the content of small files right away, while their
+	 * dentry is still hot in the cache; the archiver then never
+	 * re-opens them.  For bigger files, hold a descriptor to the
+	 * path instead: the archiver then reads exactly the file that
+	 * was just stat'ed, without walking the path a second time.
+	 * A failed open -- too many held descriptors, typically --
+	 * only falls back to the second walk.  */
+	fd = -1;
+	content = NULL;
+	content_size = 0;
+	if (S_ISREG(statl.st_mode) && statl.st_size > 0) {
+		if (statl.st_size <= INLINE_CONTENT_MAX) {
+			fd = open(path, O_RDONLY | O_NOFOLLOW);
+			if (fd >= 0) {
+				ssize_t size;
+
+				size = read(fd, content_buffer, statl.st_size);
+				if (size == statl.st_size) {
+					content = content_buffer;
+					content_size = size;
+					(void) close(fd);
+					fd = -1;
+				}
+				/* On a short read -- the file changed
+				 * since lstat(2) -- the descriptor is
+				 * kept and the archiver reads through
+				 * it, as for bigger files.  */
+			}
+		}
+		if (fd < 0 && content == NULL)
+			fd = open(path, O_PATH | O_NOFOLLOW);
+	}
+
+	if (care->archiver_started) {
+		status = enqueue_archiving(care, path, location, &statl, fd,
+					content, content_size);
+		if (status != 0) {
+			/* Archiving synchronously here would make this
+			 * thread a second, unsynchronized writer of
+			 * @care->archive while the archiver drains the
+			 * queue; losing one entry under memory
+			 * pressure is the lesser evil.  */
+			note(tracee, WARNING, INTERNAL,
+				"can't allocate work item for '%s', not archived", path);
+			if (fd >= 0)
+				(void) close(fd);
+		}
+		return;
+	}
+
+	status = archive(tracee, care->archive, path, location, &statl, fd,
+			content, content_size);
+	if (fd >= 0)
+		(void) close(fd);
 	if (status == 0)
 		VERBOSE(tracee, 1, "archived: %s", path);
 }
@@ -436,10 +739,12 @@ typedef struct {
 static void handle_getdents(Tracee *tracee, bool is_new_getdents)
 {
 	char component[PATH_MAX];
+	char dir_guest[PATH_MAX];
 	char path[PATH_MAX];
 	uint64_t offset;
 	int status;
 
+	uint8_t *dentries;
 	word_t result;
 	word_t buffer;
 	word_t fd;
@@ -449,20 +754,47 @@ static void handle_getdents(Tracee *tracee, bool is_new_getdents)
 	NewDirent new_dirent;
 
 	result = peek_reg(tracee, CURRENT, SYSARG_RESULT);
-	if ((int) result < 0)
+	if ((int) result <= 0)
 		return;
 
 	fd     = peek_reg(tracee, ORIGINAL, SYSARG_1);
 	buffer = peek_reg(tracee, ORIGINAL, SYSARG_2);
 
+	/* Resolve the directory's path once: each entry then costs a
+	 * mere concatenation plus a binding substitution, instead of a
+	 * readlink of /proc/<pid>/fd/<fd> and a full canonicalization
+	 * through translate_path().  */
+	status = readlink_proc_pid_fd(tracee->pid, fd, dir_guest);
+	if (status < 0)
+		return;
+	if (dir_guest[0] != '/')
+		return;
+	status = detranslate_path(tracee, dir_guest, NULL);
+	if (status < 0)
+		return;
+
+	/* Fetch the whole dentry table at once: reading each header
+	 * and name through the ptrace boundary costs a round trip per
+	 * entry, which gets painful on huge directories.  */
+	dentries = talloc_size(tracee->ctx, result);
+	if (dentries == NULL) {
+		note(tracee, WARNING, INTERNAL, "can't allocate dentry table");
+		return;
+	}
+
+	status = read_data(tracee, dentries, buffer, result);
+	if (status < 0) {
+		note(tracee, WARNING, INTERNAL, "can't read dentry table");
+		return;
+	}
+
 	offset = 0;
 	while (offset < result) {
 		word_t name_offset;
-		word_t address;
+		size_t name_length;
+		size_t name_max;
 		size_t size;
 
-		address = buffer + offset;
-
 		if (!is_new_getdents) {
 #if defined(ARCH_X86_64)
 			const bool is_32bit = is_32on64_mode(tracee);
@@ -471,39 +803,74 @@ static void handle_getdents(Tracee *tracee, bool is_new_getdents)
 #endif
 			if (is_32bit) {
 				name_offset = offsetof(Dirent32, name);
-				status = read_data(tracee, &dirent32, address, sizeof(dirent32));
+				if (result - offset < name_offset)
+					goto out_of_sync;
+				memcpy(&dirent32, dentries + offset, name_offset);
 				size = dirent32.size;
 			}
 			else {
 				name_offset = offsetof(Dirent64, name);
-				status = read_data(tracee, &dirent64, address, sizeof(dirent64));
+				if (result - offset < name_offset)
+					goto out_of_sync;
+				memcpy(&dirent64, dentries + offset, name_offset);
 				size = dirent64.size;
 			}
 		} else {
 			name_offset = offsetof(NewDirent, name);
-			status = read_data(tracee, &new_dirent, address, sizeof(new_dirent));
+			if (result - offset < name_offset)
+				goto out_of_sync;
+			memcpy(&new_dirent, dentries + offset, name_offset);
 			size = new_dirent.size;
 		}
-		if (status < 0) {
-			note(tracee, WARNING, INTERNAL, "can't read dentry");
-			break;
-		}
 
-		status = read_string(tracee, component, address + name_offset, PATH_MAX);
-		if (status < 0 || status >= PATH_MAX) {
+		name_max = result - offset - name_offset;
+		name_max = (name_max < PATH_MAX ? name_max : PATH_MAX);
+
+		name_length = strnlen((char *) dentries + offset + name_offset, name_max);
+		if (name_length >= name_max) {
 			note(tracee, WARNING, INTERNAL, "can't read dentry" );
 			goto next;
 		}
+		memcpy(component, dentries + offset + name_offset, name_length + 1);
+
+		/* Archive through the host_path notification.  The
+		 * final component of a dentry is never dereferenced,
+		 * so joining it to the (canonical) directory path
+		 * yields a canonical guest path.  */
+		if (strcmp(component, ".") == 0)
+			strcpy(path, dir_guest);
+		else if (strcmp(component, "..") == 0) {
+			char *slash;
+
+			strcpy(path, dir_guest);
+			slash = strrchr(path, '/');
+			if (slash == path)
+				path[1] = '\0';
+			else
+				*slash = '\0';
+		}
+		else {
+			status = join_paths(2, path, dir_guest, component);
+			if (status < 0)
+				goto next;
+		}
 
-		/* Archive through the host_path notification. */
-		strcpy(path, "/");
-		translate_path(tracee, path, fd, component, false);
+		status = substitute_binding(tracee, GUEST, path);
+		if (status < 0)
+			goto next;
+
+		notify_extensions(tracee, HOST_PATH, (intptr_t) path, true);
 	next:
+		if (size == 0)
+			goto out_of_sync;
 		offset += size;
 	}
 
-	if (offset != result)
-		note(tracee, WARNING, INTERNAL, "dentry table out of sync.");
+	if (offset == result)
+		return;
+
+out_of_sync:
+	note(tracee, WARNING, INTERNAL, "dentry table out of sync.");
 }
 
 /**
@@ -556,6 +923,9 @@ int care_callback(Extension *extension, ExtensionEvent event,
 	switch (event) {
 	case INITIALIZATION:
 		extension->filtered_sysnums = filtered_sysnums;
+		extension->event_mask = EVENT_MASK(NEW_STATUS)
+				      | EVENT_MASK(HOST_PATH)
+				      | EVENT_MASK(SYSCALL_EXIT_START);
 		return generate_care(extension, (Options *) data1);
 
 	case NEW_STATUS: {
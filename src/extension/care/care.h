@@ -25,9 +25,18 @@
 
 #include <stdbool.h>
 #include <sys/queue.h> /* STAILQ_*, */
+#include <pthread.h>   /* pthread_*, */
+#include <uthash.h>    /* ut*, UT*, HASH*, */
 
 #include "extension/care/archive.h"
 
+/* Hash entry.  */
+typedef struct Entry {
+	UT_hash_handle hh;
+	char *path;
+	bool has_content;
+} Entry;
+
 /* Generic item for a STAILQ list.  */
 typedef struct item {
 	const void *load;
@@ -55,11 +64,11 @@ typedef struct {
 typedef struct {
 	struct Entry *entries;
 	struct Entry *dentries;
+	struct Entry *concealed_entries;
 
 	char *const *command;
 	List *volatile_paths;
 	List *volatile_envars;
-	List *concealed_accesses;
 
 	const char *prefix;
 	const char *output;
@@ -69,12 +78,23 @@ typedef struct {
 	Archive *archive;
 	int64_t max_size;
 
+	/* Work queue of the archiver thread; this latter is the only
+	 * user of @archive until finalize_archiver() has joined it.  */
+	struct work_item *work_head;
+	struct work_item *work_tail;
+	pthread_mutex_t work_lock;
+	pthread_cond_t work_cond;
+	pthread_t archiver;
+	bool archiver_started;
+	bool archiver_stopping;
+
 	int last_exit_status;
 
 	bool is_ready;
 } Care;
 
 extern Item *queue_item(TALLOC_CTX *context, List **list, const char *value);
+extern void finalize_archiver(Care *care);
 
 #endif /* CARE_H */
 
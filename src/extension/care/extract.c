@@ -33,21 +33,219 @@
 #include <string.h>     /* strerror(3), */
 #include <inttypes.h>   /* PRI*, */
 #include <endian.h>     /* be64toh(3), */
+#include <stdlib.h>     /* malloc(3), free(3), */
+#include <pthread.h>    /* pthread_*, */
+#include <strings.h>    /* bzero(3), */
 #include <archive.h>    /* archive_*(3), */
 #include <archive_entry.h> /* archive_entry*(3), */
 
 #include "extension/care/extract.h"
+#include "attribute.h"
 #include "cli/note.h"
 
+/* Upper bounds for the parallel extraction, see extract_archive().  */
+#define MAX_EXTRACT_WORKERS 8
+#define MAX_QUEUED_CONTENT (32 * 1024 * 1024)
+
+/* Unit of work for the extraction workers: a cloned entry plus its
+ * whole content, read up-front by the de-multiplexing thread since a
+ * libarchive stream is inherently serial.  */
+typedef struct extract_item {
+	struct extract_item *next;
+	struct archive_entry *entry;
+	uint8_t *content;
+	size_t size;
+} ExtractItem;
+
+/* State shared between the de-multiplexing thread and its workers.  */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t more;
+	pthread_cond_t drained;
+	ExtractItem *head;
+	ExtractItem *tail;
+	size_t nb_pending;
+	bool stopping;
+	int flags;
+	int result;
+} ExtractQueue;
+
+/**
+ * Create a new "write to disk" handle with the given extraction
+ * @flags.  This function returns NULL on error.
+ */
+static struct archive *new_write_disk(int flags)
+{
+	struct archive *disk;
+
+	disk = archive_write_disk_new();
+	if (disk == NULL)
+		return NULL;
+
+	archive_write_disk_set_options(disk, flags);
+	archive_write_disk_set_standard_lookup(disk);
+
+	return disk;
+}
+
+/**
+ * Create on @disk the file described by @entry, with the given
+ * @content.  This function returns -1 if an error occurred,
+ * otherwise 0.
+ */
+static int extract_entry(struct archive *disk, struct archive_entry *entry,
+			const uint8_t *content, size_t size)
+{
+	int status;
+
+	status = archive_write_header(disk, entry);
+	if (status != ARCHIVE_OK)
+		return -1;
+
+	if (content != NULL && size > 0) {
+		ssize_t written = archive_write_data(disk, content, size);
+		if (written < 0 || (size_t) written != size)
+			return -1;
+	}
+
+	status = archive_write_finish_entry(disk);
+	if (status != ARCHIVE_OK)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Create on @disk the file described by @entry, streaming its content
+ * from @archive.  The content is transferred block by block with its
+ * offsets, so the holes of a sparse entry are recreated instead of
+ * being written out as zeroes.  This function returns -1 if an error
+ * occurred, otherwise 0.
+ */
+static int extract_entry_stream(struct archive *archive, struct archive *disk,
+				struct archive_entry *entry)
+{
+	int status;
+
+	status = archive_write_header(disk, entry);
+	if (status != ARCHIVE_OK)
+		return -1;
+
+	while (1) {
+		const void *buffer;
+		size_t size;
+		off_t offset;
+
+		status = archive_read_data_block(archive, &buffer, &size, &offset);
+		if (status == ARCHIVE_EOF)
+			break;
+		if (status < ARCHIVE_OK)
+			return -1;
+
+		status = archive_write_data_block(disk, buffer, size, offset);
+		if (status < ARCHIVE_OK)
+			return -1;
+	}
+
+	status = archive_write_finish_entry(disk);
+	if (status != ARCHIVE_OK)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Entry point of the extraction workers: dequeue the items pushed by
+ * extract_archive() and create the corresponding files.  Each worker
+ * owns its "write to disk" handle, these are independent.
+ */
+static void *extract_worker_main(void *private)
+{
+	ExtractQueue *queue = private;
+	struct archive *disk;
+
+	disk = new_write_disk(queue->flags);
+
+	while (1) {
+		ExtractItem *item;
+		int status;
+
+		pthread_mutex_lock(&queue->lock);
+		while (queue->head == NULL && !queue->stopping)
+			pthread_cond_wait(&queue->more, &queue->lock);
+
+		item = queue->head;
+		if (item == NULL) {
+			pthread_mutex_unlock(&queue->lock);
+			break;
+		}
+
+		queue->head = item->next;
+		if (queue->head == NULL)
+			queue->tail = NULL;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (disk == NULL)
+			status = -1;
+		else
+			status = extract_entry(disk, item->entry, item->content, item->size);
+
+		if (status < 0)
+			note(NULL, ERROR, INTERNAL, "can't extract '%s'",
+				archive_entry_pathname(item->entry));
+		else
+			note(NULL, INFO, USER, "extracted: %s",
+				archive_entry_pathname(item->entry));
+
+		archive_entry_free(item->entry);
+		free(item->content);
+		free(item);
+
+		pthread_mutex_lock(&queue->lock);
+		if (status < 0)
+			queue->result = -1;
+		queue->nb_pending--;
+		if (queue->nb_pending == 0)
+			pthread_cond_signal(&queue->drained);
+		pthread_mutex_unlock(&queue->lock);
+	}
+
+	if (disk != NULL)
+		archive_write_free(disk);
+
+	return NULL;
+}
+
+/**
+ * Wait until every queued item was extracted.
+ */
+static void drain_queue(ExtractQueue *queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	while (queue->nb_pending > 0)
+		pthread_cond_wait(&queue->drained, &queue->lock);
+	pthread_mutex_unlock(&queue->lock);
+}
+
 /**
  * Extract the given @archive into the current working directory.
- * This function returns -1 if an error occured, otherwise 0.
+ * Regular files and symlinks are de-multiplexed to worker threads;
+ * directories are created in order by this thread so their children
+ * never wait on them, and hardlinks are created once the queue is
+ * drained since their target may still be in flight.  This function
+ * returns -1 if an error occured, otherwise 0.
  */
 static int extract_archive(struct archive *archive)
 {
+	pthread_t workers[MAX_EXTRACT_WORKERS];
 	struct archive_entry *entry;
+	struct archive *disk;
+	ExtractQueue queue;
+	size_t nb_workers;
+	long nb_cores;
 	int result = 0;
 	int status;
+	size_t i;
 
 	int flags = ARCHIVE_EXTRACT_PERM
 		  | ARCHIVE_EXTRACT_TIME
@@ -60,32 +258,160 @@ static int extract_archive(struct archive *archive)
 	if (geteuid() == 0)
 		flags |= ARCHIVE_EXTRACT_OWNER;
 
-	while (archive_read_next_header(archive, &entry) == ARCHIVE_OK) {
-		status = archive_read_extract(archive, entry, flags);
-		switch (status) {
-		case ARCHIVE_OK:
-			note(NULL, INFO, USER, "extracted: %s", archive_entry_pathname(entry));
+	disk = new_write_disk(flags);
+	if (disk == NULL) {
+		note(NULL, ERROR, INTERNAL, "can't initialize archive structure");
+		return -1;
+	}
+
+	bzero(&queue, sizeof(queue));
+	pthread_mutex_init(&queue.lock, NULL);
+	pthread_cond_init(&queue.more, NULL);
+	pthread_cond_init(&queue.drained, NULL);
+	queue.flags = flags;
+
+	nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+	nb_workers = (nb_cores > 1
+		? (nb_cores < MAX_EXTRACT_WORKERS ? (size_t) nb_cores : MAX_EXTRACT_WORKERS)
+		: 0);
+	for (i = 0; i < nb_workers; i++) {
+		if (pthread_create(&workers[i], NULL, extract_worker_main, &queue) != 0)
 			break;
+	}
+	nb_workers = i;
 
-		default:
+	while (archive_read_next_header(archive, &entry) == ARCHIVE_OK) {
+		ExtractItem *item;
+		uint8_t *content;
+		mode_t type;
+		size_t size;
+
+		type = archive_entry_filetype(entry);
+		size = archive_entry_size(entry);
+
+		/* Entries not worth -- or not safe to -- queueing are
+		 * extracted from this thread: directories (children
+		 * might be queued right after), hardlinks (their
+		 * target may still be in flight), and contents too
+		 * large to be buffered.  */
+		if (nb_workers == 0
+		    || type == AE_IFDIR
+		    || archive_entry_hardlink(entry) != NULL
+		    || (type == AE_IFREG && size > MAX_QUEUED_CONTENT)) {
+			if (archive_entry_hardlink(entry) != NULL)
+				drain_queue(&queue);
+
+			status = extract_entry_stream(archive, disk, entry);
+			if (status < 0) {
+				result = -1;
+				note(NULL, ERROR, INTERNAL, "%s: %s",
+					archive_error_string(disk),
+					strerror(archive_errno(disk)));
+			}
+			else
+				note(NULL, INFO, USER, "extracted: %s",
+					archive_entry_pathname(entry));
+			continue;
+		}
+
+		content = NULL;
+		if (type == AE_IFREG && size > 0) {
+			size_t total = 0;
+
+			content = malloc(size);
+			if (content == NULL) {
+				result = -1;
+				note(NULL, ERROR, SYSTEM, "can't allocate content for '%s'",
+					archive_entry_pathname(entry));
+				continue;
+			}
+
+			while (total < size) {
+				ssize_t chunk;
+
+				chunk = archive_read_data(archive, content + total,
+							size - total);
+				if (chunk <= 0)
+					break;
+				total += chunk;
+			}
+
+			if (total != size) {
+				result = -1;
+				note(NULL, ERROR, INTERNAL, "%s: %s",
+					archive_error_string(archive),
+					strerror(archive_errno(archive)));
+				free(content);
+				continue;
+			}
+		}
+
+		item = malloc(sizeof(ExtractItem));
+		if (item == NULL || (item->entry = archive_entry_clone(entry)) == NULL) {
 			result = -1;
-			note(NULL, ERROR, INTERNAL, "%s: %s",
-				archive_error_string(archive),
-				strerror(archive_errno(archive)));
-			break;
+			note(NULL, ERROR, SYSTEM, "can't allocate item for '%s'",
+				archive_entry_pathname(entry));
+			free(content);
+			free(item);
+			continue;
 		}
+		item->next    = NULL;
+		item->content = content;
+		item->size    = size;
+
+		pthread_mutex_lock(&queue.lock);
+		if (queue.tail != NULL)
+			queue.tail->next = item;
+		else
+			queue.head = item;
+		queue.tail = item;
+		queue.nb_pending++;
+		pthread_cond_signal(&queue.more);
+		pthread_mutex_unlock(&queue.lock);
 	}
 
+	pthread_mutex_lock(&queue.lock);
+	queue.stopping = true;
+	pthread_cond_broadcast(&queue.more);
+	pthread_mutex_unlock(&queue.lock);
+
+	for (i = 0; i < nb_workers; i++)
+		pthread_join(workers[i], NULL);
+
+	if (queue.result < 0)
+		result = -1;
+
+	archive_write_free(disk);
+
+	pthread_mutex_destroy(&queue.lock);
+	pthread_cond_destroy(&queue.more);
+	pthread_cond_destroy(&queue.drained);
+
 	return result;
 }
 
-/* Data used by archive_[open/read/close] callbacks.  */
+/* Largest block handed to libarchive from the input mapping; this
+ * only bounds how often read_callback() is re-invoked, the blocks are
+ * pointers into the mapping either way.  */
+#define MMAP_BLOCK_SIZE (16 * 1024 * 1024)
+
+/* Data used by archive_[open/read/skip/close] callbacks.  */
 typedef struct
 {
 	uint8_t buffer[4096];
 	const char *path;
 	size_t size;
 	int fd;
+
+	/* Private mapping of the input file; when it is available the
+	 * read callback hands out zero-copy pointers into it, between
+	 * @position and @end (which excludes the self-extracting
+	 * footer).  NULL when mmap(2) failed, in which case the
+	 * read(2)-based fall back is used.  */
+	uint8_t *map;
+	size_t map_size;
+	size_t position;
+	size_t end;
 } CallbackData;
 
 /**
@@ -163,6 +489,24 @@ static int open_callback(struct archive *archive, void *data_)
 		return ARCHIVE_FATAL;
 	}
 
+	/* Feed libarchive straight from the page cache when possible:
+	 * blocks are handed out as pointers into a private mapping of
+	 * the file, removing the bounce buffer from the read side.  A
+	 * failed mmap(2) -- pseudo file-system, empty file -- only
+	 * falls back to read(2), the descriptor is positioned for
+	 * that already.  */
+	data->map_size = statf.st_size;
+	data->map = mmap(NULL, data->map_size, PROT_READ, MAP_PRIVATE, data->fd, 0);
+	if (data->map == MAP_FAILED) {
+		data->map = NULL;
+		return ARCHIVE_OK;
+	}
+
+	(void) madvise(data->map, data->map_size, MADV_SEQUENTIAL);
+
+	data->position = offset;
+	data->end = (data->size != 0 ? offset + data->size : data->map_size);
+
 	return ARCHIVE_OK;
 }
 
@@ -184,6 +528,17 @@ static ssize_t read_callback(struct archive *archive, void *data_, const void **
 	CallbackData *data = talloc_get_type_abort(data_, CallbackData);
 	ssize_t size;
 
+	if (data->map != NULL) {
+		size_t remaining = data->end - data->position;
+
+		if (remaining > MMAP_BLOCK_SIZE)
+			remaining = MMAP_BLOCK_SIZE;
+
+		*buffer = data->map + data->position;
+		data->position += remaining;
+		return remaining;
+	}
+
 	size = read(data->fd, data->buffer, sizeof(data->buffer));
 	if (size < 0) {
 		archive_set_error(archive, errno, "can't read archive");
@@ -194,6 +549,28 @@ static ssize_t read_callback(struct archive *archive, void *data_, const void **
 	return size;
 }
 
+/**
+ * This callback is invoked when the library wants to ignore a block
+ * of data.  It returns the number of bytes actually skipped, which
+ * may be zero; the library then falls back to reading and discarding
+ * data through the read callback.
+ *
+ *  -- man 3 archive_read_open.
+ */
+static int64_t skip_callback(struct archive *archive UNUSED, void *data_, int64_t request)
+{
+	CallbackData *data = talloc_get_type_abort(data_, CallbackData);
+
+	if (data->map == NULL)
+		return 0;
+
+	if (request > (int64_t) (data->end - data->position))
+		request = data->end - data->position;
+
+	data->position += request;
+	return request;
+}
+
 /**
  * This callback is invoked by archive_close() when the archive
  * processing is complete.  The callback returns ARCHIVE_OK on
@@ -207,6 +584,11 @@ static int close_callback(struct archive *archive, void *data_)
 	CallbackData *data = talloc_get_type_abort(data_, CallbackData);
 	int status;
 
+	if (data->map != NULL) {
+		(void) munmap(data->map, data->map_size);
+		data->map = NULL;
+	}
+
 	status = close(data->fd);
 	if (status < 0) {
 		archive_set_error(archive, errno, "can't close archive");
@@ -282,7 +664,8 @@ int extract_archive_from_file(const char *path)
 
 	}
 
-	status = archive_read_open(archive, data, open_callback, read_callback, close_callback);
+	status = archive_read_open2(archive, data, open_callback, read_callback,
+				skip_callback, close_callback);
 	if (status != ARCHIVE_OK) {
 		/* Don't complain if no error message were registered,
 		 * ie. when testing for a self-extracting archive.  */
@@ -100,7 +100,7 @@ static int archive_close_file(const Care *care, FILE *file, const char *name)
 		goto end;
 	}
 
-	status = archive(NULL, care->archive, path, location, &statl);
+	status = archive(NULL, care->archive, path, location, &statl, -1, NULL, 0);
 end:
 	(void) fclose(file);
 	return status;
@@ -203,6 +203,16 @@ static int archive_re_execute_sh(Care *care)
 	N("fi");
 	N("");
 
+	N("# Warm the page cache with the archived files, in the order the");
+	N("# original execution first used them; this overlaps the cold-cache");
+	N("# reads with the start of the workload.");
+	N("if [ -r \"$(dirname $0)/prefetch-manifest.txt\" ]; then");
+	N("    ( cd \"$(dirname $0)\" &&");
+	N("      while read -r file; do cat -- \"$file\"; done \\");
+	N("          < prefetch-manifest.txt ) > /dev/null 2>&1 &");
+	N("fi");
+	N("");
+
 	C("env --ignore-environment");
 	C("PROOT_IGNORE_MISSING_BINDINGS=1");
 	C("$PROOT_NO_SECCOMP");
@@ -278,18 +288,60 @@ static int archive_re_execute_sh(Care *care)
 	return archive_close_file(care, file, "re-execute.sh");
 }
 
+/**
+ * Archive the "prefetch-manifest.txt" file in @care->archive: the
+ * files whose content was archived, one per line relative to the
+ * archive root, in their original first-access order.  re-execute.sh
+ * reads it back to warm the page cache before the workload starts.
+ * This function returns < 0 if an error occured, 0 otherwise.  Note:
+ * this function is called in @care's destructor.
+ */
+static int archive_prefetch_manifest_txt(const Care *care)
+{
+	Entry *entry;
+	Entry *next;
+	FILE *file;
+
+	if (care->entries == NULL)
+		return 0;
+
+	file = open_temp_file(NULL, "care");
+	if (file == NULL) {
+		note(NULL, WARNING, INTERNAL,
+			"can't create temporary file for 'prefetch-manifest.txt'");
+		return -1;
+	}
+
+	HASH_ITER(hh, care->entries, entry, next) {
+		if (entry->has_content)
+			N("rootfs%s", entry->path);
+	}
+
+	return archive_close_file(care, file, "prefetch-manifest.txt");
+}
+
+/**
+ * Compare two concealed entries by path, for HASH_SRT().
+ */
+static int compare_concealed_entries(Entry *entry1, Entry *entry2)
+{
+	return strcmp(entry1->path, entry2->path);
+}
+
 /**
  * Archive the "concealed-accesses.txt" file in @care->archive,
- * according to the content of @care->concealed_accesses.  This
+ * according to the content of @care->concealed_entries.  This
  * function returns < 0 if an error occured, 0 otherwise.  Note: this
  * function is called in @care's destructor.
  */
-static int archive_concealed_accesses_txt(const Care *care)
+static int archive_concealed_accesses_txt(Care *care)
 {
-	const Item *item;
+	const char *ancestor;
+	Entry *entry;
+	Entry *next;
 	FILE *file;
 
-	if (care->concealed_accesses == NULL)
+	if (care->concealed_entries == NULL)
 		return 0;
 
 	file = open_temp_file(NULL, "care");
@@ -299,8 +351,22 @@ static int archive_concealed_accesses_txt(const Care *care)
 		return -1;
 	}
 
-	STAILQ_FOREACH(item, care->concealed_accesses, link)
-		N("%s", (char *) item->load);
+	/* Sorted output is deterministic -- hash order is not -- and
+	 * puts each concealed ancestor right before its descendants,
+	 * so the loop below can prune these latter: a tree concealed
+	 * after some of its content was registered is then emitted as
+	 * a single line.  */
+	HASH_SRT(hh, care->concealed_entries, compare_concealed_entries);
+
+	ancestor = NULL;
+	HASH_ITER(hh, care->concealed_entries, entry, next) {
+		if (ancestor != NULL
+		    && compare_paths(ancestor, entry->path) == PATH1_IS_PREFIX)
+			continue;
+
+		N("%s", entry->path);
+		ancestor = entry->path;
+	}
 
 	return archive_close_file(care, file, "concealed-accesses.txt");
 }
@@ -351,6 +417,12 @@ static int archive_readme_txt(const Care *care)
 	N("    should be revealed if the the original execution didn't go as");
 	N("    expected.  It is absolutely useless for the reproduced execution.");
 	N("");
+	N("prefetch-manifest.txt");
+	N("    list of the archived files, in the order the original execution");
+	N("    first used them.  re-execute.sh reads them in the background to");
+	N("    warm the page cache, so a cold-cache reproduced execution does");
+	N("    not stall on random reads.  Removing it only disables this.");
+	N("");
 
 	return archive_close_file(care, file, "README.txt");
 }
@@ -397,7 +469,7 @@ static int archive_myself(const Care *care)
 		return -1;
 	}
 
-	return archive(NULL, care->archive, path, location, &statl);
+	return archive(NULL, care->archive, path, location, &statl, -1, NULL, 0);
 }
 
 /**
@@ -409,6 +481,9 @@ int finalize_care(Care *care)
 	char *extractor;
 	int status;
 
+	/* From now on the archive is used from this thread only.  */
+	finalize_archiver(care);
+
 	/* Generate & archive the "re-execute.sh" script. */
 	status = archive_re_execute_sh(care);
 	if (status < 0)
@@ -419,6 +494,11 @@ int finalize_care(Care *care)
 	if (status < 0)
 		note(NULL, WARNING, INTERNAL, "can't archive 'concealed-accesses.txt'");
 
+	/* Generate & archive the "prefetch-manifest.txt" file. */
+	status = archive_prefetch_manifest_txt(care);
+	if (status < 0)
+		note(NULL, WARNING, INTERNAL, "can't archive 'prefetch-manifest.txt'");
+
 	/* Generate & archive the "README.txt" file. */
 	status = archive_readme_txt(care);
 	if (status < 0)
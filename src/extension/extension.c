@@ -51,10 +51,17 @@ static int remove_extension(Extension *extension)
  * its @tracee.  This function returns NULL on error, otherwise the
  * new extension.
  */
+/* Whether at least one extension was ever attached to a tracee: a
+ * one-way latch used by event_loop() to select a dispatch variant
+ * without the extension notification branches.  */
+bool extensions_in_use = false;
+
 static Extension *new_extension(Tracee *tracee, extension_callback_t callback)
 {
 	Extension *extension;
 
+	extensions_in_use = true;
+
 	/* Lazy allocation of the list head. */
 	if (tracee->extensions == NULL) {
 		tracee->extensions = talloc_zero(tracee, Extensions);
@@ -68,6 +75,10 @@ static Extension *new_extension(Tracee *tracee, extension_callback_t callback)
 		return NULL;
 	extension->callback = callback;
 
+	/* Subscribed to everything until the extension says
+	 * otherwise, during its initialization.  */
+	extension->event_mask = (uint32_t) -1;
+
 	/* Attach it to its tracee. */
 	LIST_INSERT_HEAD(tracee->extensions, extension, link);
 	talloc_set_destructor(extension, remove_extension);
@@ -102,6 +113,116 @@ int initialize_extension(Tracee *tracee, extension_callback_t callback, const ch
 	return 0;
 }
 
+/**
+ * Like initialize_extension() except the actual initialization is
+ * deferred until the first event delivered to @tracee, or until just
+ * before the seccomp filter snapshots the extensions (see
+ * launch_process()).  This shaves startup for extensions that are
+ * loaded defensively but whose functionality may never trigger.
+ * This function returns -1 if an error occurred, otherwise 0.
+ */
+int initialize_extension_deferred(Tracee *tracee, extension_callback_t callback, const char *cli)
+{
+	DeferredExtension *deferred;
+
+	if (tracee->deferred_extensions == NULL) {
+		tracee->deferred_extensions = talloc_zero(tracee, DeferredExtensions);
+		if (tracee->deferred_extensions == NULL)
+			return initialize_extension(tracee, callback, cli);
+		STAILQ_INIT(tracee->deferred_extensions);
+	}
+
+	deferred = talloc_zero(tracee->deferred_extensions, DeferredExtension);
+	if (deferred == NULL)
+		return initialize_extension(tracee, callback, cli);
+
+	deferred->callback = callback;
+	if (cli != NULL) {
+		deferred->cli = talloc_strdup(deferred, cli);
+		if (deferred->cli == NULL)
+			return initialize_extension(tracee, callback, cli);
+	}
+
+	STAILQ_INSERT_TAIL(tracee->deferred_extensions, deferred, link);
+
+	return 0;
+}
+
+/**
+ * Initialize the extensions of @tracee whose activation was deferred
+ * by initialize_extension_deferred().
+ */
+void activate_deferred_extensions(Tracee *tracee)
+{
+	DeferredExtensions *pending = tracee->deferred_extensions;
+	DeferredExtension *deferred;
+
+	if (pending == NULL)
+		return;
+
+	/* Detach the list first: an initialization may deliver events
+	 * itself.  */
+	tracee->deferred_extensions = NULL;
+
+	STAILQ_FOREACH(deferred, pending, link) {
+		int status;
+
+		status = initialize_extension(tracee, deferred->callback, deferred->cli);
+		if (status < 0)
+			note(tracee, WARNING, INTERNAL,
+				"deferred extension \"%s\" discarded", deferred->cli ?: "");
+	}
+
+	TALLOC_FREE(pending);
+}
+
+/**
+ * Collect the filtered sysnums of @tracee's deferred extensions
+ * without activating them: the seccomp filter has to trap their
+ * syscalls from the start -- a filter can never be widened once
+ * installed -- but full initialization can still wait until the
+ * extension is really needed.  A deferred extension that doesn't
+ * support the FILTERED_SYSNUMS event is activated for real, as
+ * before.
+ */
+void snapshot_deferred_filtered_sysnums(Tracee *tracee)
+{
+	DeferredExtensions *pending = tracee->deferred_extensions;
+	DeferredExtension *deferred;
+	DeferredExtension *next;
+
+	if (pending == NULL)
+		return;
+
+	for (deferred = STAILQ_FIRST(pending); deferred != NULL; deferred = next) {
+		Extension *extension;
+		int status = -1;
+
+		next = STAILQ_NEXT(deferred, link);
+
+		/* The transient extension only carries the answer; it
+		 * is never attached to any tracee.  */
+		extension = talloc_zero(deferred, Extension);
+		if (extension != NULL) {
+			extension->callback = deferred->callback;
+			status = deferred->callback(extension, FILTERED_SYSNUMS,
+						(intptr_t) deferred->cli, 0);
+		}
+
+		if (status >= 0 && extension != NULL && extension->filtered_sysnums != NULL) {
+			deferred->filtered_sysnums = extension->filtered_sysnums;
+			continue;
+		}
+
+		STAILQ_REMOVE(pending, deferred, deferred_extension, link);
+		status = initialize_extension(tracee, deferred->callback, deferred->cli);
+		if (status < 0)
+			note(tracee, WARNING, INTERNAL,
+				"deferred extension \"%s\" discarded", deferred->cli ?: "");
+		TALLOC_FREE(deferred);
+	}
+}
+
 /**
  * Rebuild a new list of extensions for this @child from its @parent.
  * The inheritance model is controlled by the @parent.
@@ -112,6 +233,11 @@ void inherit_extensions(Tracee *child, Tracee *parent, word_t clone_flags)
 	Extension *child_extension;
 	int status;
 
+	/* Pending extensions are activated by the first delivered
+	 * event, thus before any clone; this is merely a safety
+	 * net.  */
+	activate_deferred_extensions(parent);
+
 	if (parent->extensions == NULL)
 		return;
 
@@ -136,6 +262,8 @@ void inherit_extensions(Tracee *child, Tracee *parent, word_t clone_flags)
 			continue;
 		}
 
+		child_extension->event_mask = parent_extension->event_mask;
+
 		if (status == 0) {
 			/* ... with a shared config or ...  */
 			child_extension->config =
@@ -29,6 +29,7 @@
 
 #include "tracee/tracee.h"
 #include "syscall/seccomp.h"
+#include "profile.h"
 
 /* List of possible events.  */
 typedef enum {
@@ -109,6 +110,16 @@ typedef enum {
 	 * syscall.  */
 	SYSCALL_CHAINED_EXIT,
 
+	/* Report the sysnums the extension would filter once
+	 * initialized with "(const char *) data1" -- its command-line
+	 * argument -- by setting its "filtered_sysnums" field, without
+	 * initializing anything else.  Delivered to a transient,
+	 * tracee-less extension before the seccomp filter snapshots
+	 * the deferred extensions, see
+	 * snapshot_deferred_filtered_sysnums().  Extensions that
+	 * don't support this event are activated for real instead.  */
+	FILTERED_SYSNUMS,
+
 	/* Initialize the extension: "(const char *) data1" is its
 	 * argument that was passed to the command-line interface.  If
 	 * the extension returns < 0, then PRoot removed it.  */
@@ -129,6 +140,9 @@ typedef enum {
 
 #define CLONE_RECONF ((word_t) -1)
 
+/* Bit of @event in an extension's event mask.  */
+#define EVENT_MASK(event) (UINT32_C(1) << (event))
+
 struct extension;
 typedef int (*extension_callback_t)(struct extension *extension, ExtensionEvent event,
 				intptr_t data1, intptr_t data2);
@@ -144,6 +158,13 @@ typedef struct extension {
 	/* List of sysnum handled by this extension.  */
 	const FilteredSysnum *filtered_sysnums;
 
+	/* Events this extension subscribed to; notify_extensions()
+	 * doesn't even call back for the other ones.  It defaults to
+	 * all events, an extension narrows it during INITIALIZATION
+	 * (control events -- INITIALIZATION, REMOVED, INHERIT_* -- are
+	 * delivered directly, regardless of this mask).  */
+	uint32_t event_mask;
+
 	/* Link to the next and previous extensions.  Note the order
 	 * is *never* garantee.  */
 	LIST_ENTRY(extension) link;
@@ -151,7 +172,27 @@ typedef struct extension {
 
 typedef LIST_HEAD(extensions, extension) Extensions;
 
+/* An extension whose activation was deferred, see
+ * initialize_extension_deferred().  */
+typedef struct deferred_extension {
+	extension_callback_t callback;
+	const char *cli;
+
+	/* Answer to the FILTERED_SYSNUMS event, collected by
+	 * snapshot_deferred_filtered_sysnums(); NULL until then.  */
+	const FilteredSysnum *filtered_sysnums;
+
+	STAILQ_ENTRY(deferred_extension) link;
+} DeferredExtension;
+
+typedef STAILQ_HEAD(deferred_extensions, deferred_extension) DeferredExtensions;
+
 extern int initialize_extension(Tracee *tracee, extension_callback_t callback, const char *cli);
+extern bool extensions_in_use;
+extern int initialize_extension_deferred(Tracee *tracee, extension_callback_t callback,
+					const char *cli);
+extern void activate_deferred_extensions(Tracee *tracee);
+extern void snapshot_deferred_filtered_sysnums(Tracee *tracee);
 extern void inherit_extensions(Tracee *child, Tracee *parent, word_t clone_flags);
 
 /**
@@ -162,22 +203,43 @@ static inline int notify_extensions(Tracee *tracee, ExtensionEvent event,
 				intptr_t data1, intptr_t data2)
 {
 	Extension *extension;
+	uint64_t profile_start;
+	int result = 0;
+
+	/* The first delivered event activates the extensions whose
+	 * initialization was deferred, so they never miss one.  */
+	if (tracee->deferred_extensions != NULL)
+		activate_deferred_extensions(tracee);
 
 	if (tracee->extensions == NULL)
 		return 0;
 
+	profile_start = profile_scope_enter(SCOPE_NOTIFY_EXTENSIONS);
+
 	LIST_FOREACH(extension, tracee->extensions, link) {
-		int status = extension->callback(extension, event, data1, data2);
-		if (status != 0)
-			return status;
+		int status;
+
+		/* This extension didn't subscribe to this event.  */
+		if ((extension->event_mask & EVENT_MASK(event)) == 0)
+			continue;
+
+		status = extension->callback(extension, event, data1, data2);
+		if (status != 0) {
+			result = status;
+			break;
+		}
 	}
 
-	return 0;
+	profile_scope_exit(SCOPE_NOTIFY_EXTENSIONS, profile_start);
+
+	return result;
 }
 
 /* Built-in extensions.  */
 extern int kompat_callback(Extension *extension, ExtensionEvent event, intptr_t d1, intptr_t d2);
+extern void set_capability_cache(const char *path);
 extern int fake_id0_callback(Extension *extension, ExtensionEvent event, intptr_t d1, intptr_t d2);
 extern int care_callback(Extension *extension, ExtensionEvent event, intptr_t d1, intptr_t d2);
+extern int trace_callback(Extension *extension, ExtensionEvent event, intptr_t d1, intptr_t d2);
 
 #endif /* EXTENSION_H */
@@ -31,6 +31,7 @@
 #include <string.h>      /* memcpy(3), */
 #include <stdlib.h>      /* strtol(3), */
 #include <linux/auxvec.h>/* AT_,  */
+#include <sys/param.h>   /* MIN(3), MAX(3), */
 
 #include "extension/extension.h"
 #include "syscall/syscall.h"
@@ -53,6 +54,11 @@ typedef struct {
 	gid_t egid;
 	gid_t sgid;
 	gid_t fsgid;
+
+	/* Actual ids of the PRoot process itself, cached at
+	 * initialization to avoid two syscalls per faked stat.  */
+	uid_t actual_ruid;
+	gid_t actual_rgid;
 } Config;
 
 typedef struct {
@@ -285,9 +291,9 @@ static int handle_sysenter_end(Tracee *tracee, const Config *config)
 		/* Swap actual and emulated ids to get a chance of
 		 * success.  */
 		if (uid == config->ruid)
-			poke_reg(tracee, uid_sysarg, getuid());
+			poke_reg(tracee, uid_sysarg, config->actual_ruid);
 		if (gid == config->rgid)
-			poke_reg(tracee, gid_sysarg, getgid());
+			poke_reg(tracee, gid_sysarg, config->actual_rgid);
 
 		return 0;
 	}
@@ -499,15 +505,73 @@ static int handle_sysenter_end(Tracee *tracee, const Config *config)
 } while (0)
 
 /**
- * Adjust current @tracee's syscall result according to @config.  This
- * function returns -errno if an error occured, otherwise 0.
+ * Return a writable version of @extension's configuration: if it is
+ * still shared with other tracees -- following a fork -- it is
+ * un-shared first (copy-on-write).  This function returns NULL on
+ * error.
  */
-static int handle_sysexit_end(Tracee *tracee, Config *config)
+static Config *writable_config(Extension *extension)
 {
+	Config *config;
+	Config *copy;
+
+	config = talloc_get_type_abort(extension->config, Config);
+	if (talloc_reference_count(config) == 0)
+		return config;
+
+	copy = talloc(extension, Config);
+	if (copy == NULL)
+		return NULL;
+	memcpy(copy, config, sizeof(Config));
+
+	talloc_unlink(extension, config);
+	extension->config = copy;
+
+	return copy;
+}
+
+/**
+ * Adjust current @tracee's syscall result according to @extension's
+ * configuration.  This function returns -errno if an error occured,
+ * otherwise 0.
+ */
+static int handle_sysexit_end(Tracee *tracee, Extension *extension)
+{
+	Config *config;
 	word_t sysnum;
 	word_t result;
 
+	config = talloc_get_type_abort(extension->config, Config);
 	sysnum = get_sysnum(tracee, ORIGINAL);
+
+	/* The emulated ids are about to be modified: un-share a
+	 * configuration possibly still shared with other tracees.  */
+	switch (sysnum) {
+	case PR_setuid:
+	case PR_setuid32:
+	case PR_setgid:
+	case PR_setgid32:
+	case PR_setreuid:
+	case PR_setreuid32:
+	case PR_setregid:
+	case PR_setregid32:
+	case PR_setresuid:
+	case PR_setresuid32:
+	case PR_setresgid:
+	case PR_setresgid32:
+	case PR_setfsuid:
+	case PR_setfsuid32:
+	case PR_setfsgid:
+	case PR_setfsgid32:
+		config = writable_config(extension);
+		if (config == NULL)
+			return -ENOMEM;
+		break;
+
+	default:
+		break;
+	}
+
 	switch (sysnum) {
 
 	case PR_setuid:
@@ -619,10 +683,16 @@ static int handle_sysexit_end(Tracee *tracee, Config *config)
 	case PR_stat:
 	case PR_lstat:
 	case PR_fstat: {
+		uint8_t buffer[16];
+		off_t uid_offset;
+		off_t gid_offset;
 		word_t address;
+		word_t start;
+		bool modified;
+		uint32_t id;
+		size_t size;
 		Reg sysarg;
-		uid_t uid;
-		gid_t gid;
+		int status;
 
 		/* Override only if it succeed.  */
 		result = peek_reg(tracee, CURRENT, SYSARG_RESULT);
@@ -641,22 +711,42 @@ static int handle_sysexit_end(Tracee *tracee, Config *config)
 		assert(__builtin_types_compatible_p(uid_t, uint32_t));
 		assert(__builtin_types_compatible_p(gid_t, uint32_t));
 
-		/* Get the uid & gid values from the 'stat' structure.  */
-		uid = peek_uint32(tracee, address + offsetof_stat_uid(tracee));
-		if (errno != 0)
-			uid = 0; /* Not fatal.  */
+		/* The uid and gid fields sit next to each other on
+		 * every supported ABI: patch them with one
+		 * read-modify-write transfer instead of up to four
+		 * single-word ones.  Errors are not fatal here.  */
+		uid_offset = offsetof_stat_uid(tracee);
+		gid_offset = offsetof_stat_gid(tracee);
 
-		gid = peek_uint32(tracee, address + offsetof_stat_gid(tracee));
-		if (errno != 0)
-			gid = 0; /* Not fatal.  */
+		start = address + MIN(uid_offset, gid_offset);
+		size  = MAX(uid_offset, gid_offset) + sizeof(uint32_t)
+			- MIN(uid_offset, gid_offset);
+		assert(size <= sizeof(buffer));
 
-		/* Override only if the file is owned by the current user.
-		 * Errors are not fatal here.  */
-		if (uid == getuid())
-			poke_uint32(tracee, address + offsetof_stat_uid(tracee), config->ruid);
+		status = read_data(tracee, buffer, start, size);
+		if (status < 0)
+			return 0;
 
-		if (gid == getgid())
-			poke_uint32(tracee, address + offsetof_stat_gid(tracee), config->rgid);
+		/* Override only if the file is owned by the current
+		 * user.  */
+		modified = false;
+
+		memcpy(&id, buffer + (address + uid_offset - start), sizeof(id));
+		if (id == config->actual_ruid) {
+			id = config->ruid;
+			memcpy(buffer + (address + uid_offset - start), &id, sizeof(id));
+			modified = true;
+		}
+
+		memcpy(&id, buffer + (address + gid_offset - start), sizeof(id));
+		if (id == config->actual_rgid) {
+			id = config->rgid;
+			memcpy(buffer + (address + gid_offset - start), &id, sizeof(id));
+			modified = true;
+		}
+
+		if (modified)
+			(void) write_data(tracee, start, buffer, size);
 
 		return 0;
 	}
@@ -758,6 +848,11 @@ static int adjust_elf_auxv(Tracee *tracee, Config *config)
 int fake_id0_callback(Extension *extension, ExtensionEvent event, intptr_t data1, intptr_t data2)
 {
 	switch (event) {
+	case FILTERED_SYSNUMS:
+		/* The list doesn't depend on the configuration.  */
+		extension->filtered_sysnums = filtered_sysnums;
+		return 0;
+
 	case INITIALIZATION: {
 		const char *uid_string = (const char *) data1;
 		const char *gid_string;
@@ -795,7 +890,15 @@ int fake_id0_callback(Extension *extension, ExtensionEvent event, intptr_t data1
 		config->sgid  = gid;
 		config->fsgid = gid;
 
+		config->actual_ruid = getuid();
+		config->actual_rgid = getgid();
+
 		extension->filtered_sysnums = filtered_sysnums;
+
+		extension->event_mask = EVENT_MASK(HOST_PATH)
+				      | EVENT_MASK(SYSCALL_ENTER_END)
+				      | EVENT_MASK(SYSCALL_EXIT_END)
+				      | EVENT_MASK(SYSCALL_EXIT_START);
 		return 0;
 	}
 
@@ -803,24 +906,25 @@ int fake_id0_callback(Extension *extension, ExtensionEvent event, intptr_t data1
 		return 1;
 
 	case INHERIT_CHILD: {
-		/* Copy the parent configuration to the child.  The
-		 * structure should not be shared as uid/gid changes
-		 * in one process should not affect other processes.
-		 * This assertion is not true for POSIX threads
-		 * sharing the same group, however Linux threads never
-		 * share uid/gid information.  As a consequence, the
-		 * GlibC emulates the POSIX behavior on Linux by
-		 * sending a signal to all group threads to cause them
-		 * to invoke the system call too.  Finally, PRoot
-		 * doesn't have to worry about clone flags.
+		/* Share the parent configuration with the child, in a
+		 * copy-on-write fashion: uid/gid changes in one
+		 * process must not affect other processes, but they
+		 * are rare whereas forks are frequent, so the actual
+		 * copy is deferred to the first set*id(2) -- see
+		 * writable_config().  Note that Linux threads never
+		 * share uid/gid information anyway: the GlibC
+		 * emulates the POSIX behavior by sending a signal to
+		 * all group threads to cause them to invoke the
+		 * system call too.  Finally, PRoot doesn't have to
+		 * worry about clone flags.
 		 */
 
 		Extension *parent = (Extension *) data1;
-		extension->config = talloc_zero(extension, Config);
+
+		extension->config = talloc_reference(extension, parent->config);
 		if (extension->config == NULL)
 			return -1;
 
-		memcpy(extension->config, parent->config, sizeof(Config));
 		return 0;
 	}
 
@@ -844,9 +948,8 @@ int fake_id0_callback(Extension *extension, ExtensionEvent event, intptr_t data1
 
 	case SYSCALL_EXIT_END: {
 		Tracee *tracee = TRACEE(extension);
-		Config *config = talloc_get_type_abort(extension->config, Config);
 
-		return handle_sysexit_end(tracee, config);
+		return handle_sysexit_end(tracee, extension);
 	}
 
 	case SYSCALL_EXIT_START: {
@@ -33,6 +33,12 @@
 #include <linux/auxvec.h>  /* AT_,  */
 #include <linux/futex.h>   /* FUTEX_PRIVATE_FLAG */
 #include <sys/param.h>     /* MIN, */
+#include <dirent.h>        /* opendir(3), readdir(3), */
+#include <stdio.h>         /* snprintf(3), fopen(3), fscanf(3), */
+#include <inttypes.h>      /* SCNu64, */
+#include <sys/sendfile.h>  /* sendfile(2), */
+#include <sys/syscall.h>   /* syscall(2), */
+#include <unistd.h>        /* lseek(2), close(2), syscall(2), */
 
 #include "extension/extension.h"
 #include "syscall/seccomp.h"
@@ -49,24 +55,76 @@
 #include "attribute.h"
 #include "compat.h"
 
-#define MAX_ARG_SHIFT 2
+/* From <linux/close_range.h>, not shipped by older libcs.  */
+#ifndef CLOSE_RANGE_UNSHARE
+#define CLOSE_RANGE_UNSHARE	(1U << 1)
+#endif
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC	(1U << 2)
+#endif
+
+/* Operations of the argument shuffle programs interpreted by
+ * apply_modif().  */
+typedef enum {
+	/* End of program.  It must be zero so partially initialized
+	 * programs -- including "NONE" below -- terminate
+	 * themselves.  */
+	SHUFFLE_END = 0,
+
+	/* Copy the initial value of the "value" register into the
+	 * "reg" register.  */
+	SHUFFLE_MOVE,
+
+	/* Store the constant "value" into the "reg" register.  */
+	SHUFFLE_SET,
+} ShuffleOpcode;
+
+#define MAX_SHUFFLE_OPS 4
+typedef struct {
+	uint8_t opcode;	/* ShuffleOpcode.  */
+	uint8_t reg;	/* Destination, SYSARG_1 .. SYSARG_6.  */
+	int16_t value;	/* Source register or constant.  */
+} ShuffleOp;
+
+#define MOVE_ARG(src, dst) { .opcode = SHUFFLE_MOVE, .reg = (dst), .value = (src) }
+#define SET_ARG(dst, cnst) { .opcode = SHUFFLE_SET,  .reg = (dst), .value = (cnst) }
+
 typedef struct {
 	int expected_release;
 	word_t new_sysarg_num;
-	struct {
-		Reg sysarg;     /* first argument to be moved.  */
-		size_t nb_args; /* number of arguments to be moved.  */
-		int offset;     /* offset to be applied.  */
-	} shifts[MAX_ARG_SHIFT];
+	ShuffleOp ops[MAX_SHUFFLE_OPS];
 } Modif;
 
 #define NONE {{0, 0, 0}}
 
+/* How an intercepted syscall has to be handled for the emulated
+ * kernel release; fully decided once this release is known.  */
+typedef enum {
+	/* No modification required, the common case.  */
+	MODIF_NONE = 0,
+
+	/* Apply the precomputed Modif below as-is.  */
+	MODIF_STATIC,
+
+	/* The modification depends on the syscall arguments: go
+	 * through handle_sysenter_end()'s per-syscall code.  */
+	MODIF_DYNAMIC,
+} ModifType;
+
+typedef struct {
+	ModifType type;
+	Modif modif;	/* Valid for MODIF_STATIC only.  */
+} ModifEntry;
+
 typedef struct {
 	int actual_release;
 	int virtual_release;
 	struct utsname utsname;
 	word_t hwcap;
+
+	/* Per-Sysnum decisions, indexed by the result of
+	 * get_sysnum(); see build_modif_entries().  */
+	ModifEntry *modif_entries;
 } Config;
 
 /**
@@ -80,19 +138,18 @@ static bool needs_kompat(const Config *config, int expected_release)
 }
 
 /**
- * Modify the current syscall of @tracee as described by @modif
- * regarding the given @config.  This function returns whether the
- * syscall was modified or not.
+ * Modify the current syscall of @tracee as described by @modif,
+ * without checking the emulated kernel release -- the caller already
+ * did, either through modify_syscall() or when precomputing the
+ * per-Sysnum table.  This function returns whether the syscall was
+ * modified or not.
  */
-static bool modify_syscall(Tracee *tracee, const Config *config, const Modif *modif)
+static bool apply_modif(Tracee *tracee, const Modif *modif)
 {
-	size_t i, j;
+	word_t args[6];
+	word_t results[6];
 	word_t syscall;
-
-	assert(config != NULL);
-
-	if (!needs_kompat(config, modif->expected_release))
-		return false;
+	size_t i;
 
 	/* Check if this syscall is supported on this architecture.  */
 	syscall = detranslate_sysnum(get_abi(tracee), modif->new_sysarg_num);
@@ -101,21 +158,46 @@ static bool modify_syscall(Tracee *tracee, const Config *config, const Modif *mo
 
 	set_sysnum(tracee, modif->new_sysarg_num);
 
-	/* Shift syscall arguments.  */
-	for (i = 0; i < MAX_ARG_SHIFT; i++) {
-		Reg sysarg     = modif->shifts[i].sysarg;
-		size_t nb_args = modif->shifts[i].nb_args;
-		int offset     = modif->shifts[i].offset;
+	if (modif->ops[0].opcode == SHUFFLE_END)
+		return true;
 
-		for (j = 0; j < nb_args; j++) {
-			word_t arg = peek_reg(tracee, CURRENT, sysarg + j);
-			poke_reg(tracee, sysarg + j + offset, arg);
-		}
+	/* Run the shuffle program against a local copy of the
+	 * arguments: every SHUFFLE_MOVE reads the *initial* value of
+	 * its source register, regardless of the program order, and
+	 * each register is written back at most once.  */
+	for (i = 0; i < 6; i++)
+		args[i] = results[i] = peek_reg(tracee, CURRENT, SYSARG_1 + i);
+
+	for (i = 0; i < MAX_SHUFFLE_OPS && modif->ops[i].opcode != SHUFFLE_END; i++) {
+		const ShuffleOp *op = &modif->ops[i];
+
+		results[op->reg - SYSARG_1] = (op->opcode == SHUFFLE_MOVE
+						? args[op->value - SYSARG_1]
+						: (word_t) op->value);
 	}
 
+	for (i = 0; i < 6; i++)
+		if (results[i] != args[i])
+			poke_reg(tracee, SYSARG_1 + i, results[i]);
+
 	return true;
 }
 
+/**
+ * Modify the current syscall of @tracee as described by @modif
+ * regarding the given @config.  This function returns whether the
+ * syscall was modified or not.
+ */
+static bool modify_syscall(Tracee *tracee, const Config *config, const Modif *modif)
+{
+	assert(config != NULL);
+
+	if (!needs_kompat(config, modif->expected_release))
+		return false;
+
+	return apply_modif(tracee, modif);
+}
+
 /**
  * Return the numeric value for the given kernel @release.
  */
@@ -158,6 +240,118 @@ static void discard_fd_flags(Tracee *tracee, const Config *config,
 	poke_reg(tracee, sysarg, flags & ~discarded_flags);
 }
 
+/**
+ * Precompute @config->modif_entries: for each intercepted Sysnum,
+ * decide -- once the emulated kernel release is known -- whether it
+ * requires no modification, a fixed Modif, or argument-dependent
+ * handling, so handle_sysenter_end() does a single table load instead
+ * of repeated release comparisons per stop.  This function returns
+ * -1 if an error occurred, 0 otherwise.
+ */
+static int build_modif_entries(Config *config)
+{
+	ModifEntry *entries;
+
+	entries = talloc_zero_array(config, ModifEntry, PR_NB_SYSNUM);
+	if (entries == NULL)
+		return -1;
+
+	/* Note: syscalls like "openat" can be replaced by "open" since PRoot
+	 * has canonicalized "fd + path" into "path".  */
+#define STATIC_MODIF(sysnum, release, new_sysnum, ...)			\
+	do {								\
+		if (needs_kompat(config, release)) {			\
+			entries[sysnum].type  = MODIF_STATIC;		\
+			entries[sysnum].modif = (Modif) {		\
+				.expected_release = release,		\
+				.new_sysarg_num   = new_sysnum,		\
+				.ops		  = __VA_ARGS__		\
+			};						\
+		}							\
+	} while (0)
+
+#define DYNAMIC_MODIF(sysnum, wanted)					\
+	do {								\
+		if (wanted)						\
+			entries[sysnum].type = MODIF_DYNAMIC;		\
+	} while (0)
+
+	STATIC_MODIF(PR_accept4,	KERNEL_VERSION(2,6,28), PR_accept,	NONE);
+	STATIC_MODIF(PR_epoll_pwait,	KERNEL_VERSION(2,6,19), PR_epoll_wait,	NONE);
+	STATIC_MODIF(PR_inotify_init1,	KERNEL_VERSION(2,6,27), PR_inotify_init, NONE);
+	STATIC_MODIF(PR_pipe2,		KERNEL_VERSION(2,6,27), PR_pipe,	NONE);
+
+	STATIC_MODIF(PR_faccessat, KERNEL_VERSION(2,6,16), PR_access,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_3, SYSARG_2) });
+	STATIC_MODIF(PR_fchmodat, KERNEL_VERSION(2,6,16), PR_chmod,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_3, SYSARG_2) });
+	STATIC_MODIF(PR_futimesat, KERNEL_VERSION(2,6,16), PR_utimes,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_3, SYSARG_2) });
+	STATIC_MODIF(PR_mkdirat, KERNEL_VERSION(2,6,16), PR_mkdir,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_3, SYSARG_2) });
+	STATIC_MODIF(PR_mknodat, KERNEL_VERSION(2,6,16), PR_mknod,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_3, SYSARG_2),
+		  MOVE_ARG(SYSARG_4, SYSARG_3) });
+	STATIC_MODIF(PR_readlinkat, KERNEL_VERSION(2,6,16), PR_readlink,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_3, SYSARG_2),
+		  MOVE_ARG(SYSARG_4, SYSARG_3) });
+	STATIC_MODIF(PR_renameat, KERNEL_VERSION(2,6,16), PR_rename,
+		{ MOVE_ARG(SYSARG_2, SYSARG_1),
+		  MOVE_ARG(SYSARG_4, SYSARG_2) });
+	STATIC_MODIF(PR_symlinkat, KERNEL_VERSION(2,6,16), PR_symlink,
+		{ MOVE_ARG(SYSARG_3, SYSARG_2) });
+
+	/* The extra constants below used to be staged by per-syscall
+	 * code in handle_sysenter_end(); a SHUFFLE_SET op makes these
+	 * substitutions plain table entries.  */
+
+	/* "the size argument is ignored, but must be greater than
+	 * zero" -- man epoll_create */
+	STATIC_MODIF(PR_epoll_create1, KERNEL_VERSION(2,6,27), PR_epoll_create,
+		{ SET_ARG(SYSARG_1, 1) });
+
+	/* "In Linux up to version 2.6.26, the flags argument is
+	 * unused, and must be specified as zero." -- man signalfd */
+	STATIC_MODIF(PR_signalfd4, KERNEL_VERSION(2,6,27), PR_signalfd,
+		{ SET_ARG(SYSARG_4, 0) });
+
+	/* These ones check their arguments even when no replacement is
+	 * required (-EINVAL cases exposed by LTP, dup3's oldfd ==
+	 * newfd), hence unconditionally dynamic.  */
+	DYNAMIC_MODIF(PR_dup3,		true);
+	DYNAMIC_MODIF(PR_newfstatat,	true);
+	DYNAMIC_MODIF(PR_fstatat64,	true);
+	DYNAMIC_MODIF(PR_linkat,	true);
+
+	DYNAMIC_MODIF(PR_close_range,	needs_kompat(config, KERNEL_VERSION(5,9,0)));
+	DYNAMIC_MODIF(PR_copy_file_range, needs_kompat(config, KERNEL_VERSION(4,5,0)));
+	DYNAMIC_MODIF(PR_eventfd2,	needs_kompat(config, KERNEL_VERSION(2,6,27)));
+	DYNAMIC_MODIF(PR_fchownat,	needs_kompat(config, KERNEL_VERSION(2,6,16)));
+	DYNAMIC_MODIF(PR_fcntl,		needs_kompat(config, KERNEL_VERSION(2,6,24)));
+	DYNAMIC_MODIF(PR_futex,		needs_kompat(config, KERNEL_VERSION(2,6,22))
+					&& config->actual_release != 0);
+	DYNAMIC_MODIF(PR_openat,	needs_kompat(config, KERNEL_VERSION(2,6,16))
+					|| needs_kompat(config, KERNEL_VERSION(2,6,23)));
+	DYNAMIC_MODIF(PR_open,		needs_kompat(config, KERNEL_VERSION(2,6,23)));
+	DYNAMIC_MODIF(PR_pselect6,	needs_kompat(config, KERNEL_VERSION(2,6,16)));
+	DYNAMIC_MODIF(PR_socket,	needs_kompat(config, KERNEL_VERSION(2,6,27)));
+	DYNAMIC_MODIF(PR_socketpair,	needs_kompat(config, KERNEL_VERSION(2,6,27)));
+	DYNAMIC_MODIF(PR_timerfd_create, needs_kompat(config, KERNEL_VERSION(2,6,27)));
+	DYNAMIC_MODIF(PR_unlinkat,	needs_kompat(config, KERNEL_VERSION(2,6,16)));
+
+#undef STATIC_MODIF
+#undef DYNAMIC_MODIF
+
+	config->modif_entries = entries;
+	return 0;
+}
+
 /**
  * Replace current @tracee's syscall with an older and compatible one
  * whenever it's required, i.e. when the syscall is supported by the
@@ -166,57 +360,74 @@ static void discard_fd_flags(Tracee *tracee, const Config *config,
  */
 static int handle_sysenter_end(Tracee *tracee, Config *config)
 {
-	/* Note: syscalls like "openat" can be replaced by "open" since PRoot
-	 * has canonicalized "fd + path" into "path".  */
-	switch (get_sysnum(tracee, ORIGINAL)) {
-	case PR_accept4: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,28),
-			.new_sysarg_num   = PR_accept,
-			.shifts		  = NONE
-		};
-		modify_syscall(tracee, config, &modif);
+	Sysnum sysnum = get_sysnum(tracee, ORIGINAL);
+	const ModifEntry *entry;
+
+	assert(sysnum < PR_NB_SYSNUM);
+
+	entry = &config->modif_entries[sysnum];
+	switch (entry->type) {
+	case MODIF_NONE:
+		return 0;
+
+	case MODIF_STATIC:
+		(void) apply_modif(tracee, &entry->modif);
 		return 0;
+
+	case MODIF_DYNAMIC:
+		break;
 	}
 
-	case PR_dup3: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,27),
-			.new_sysarg_num   = PR_dup2,
-			.shifts		  = NONE
-		};
+	switch (sysnum) {
+	case PR_close_range: {
+		word_t first = peek_reg(tracee, CURRENT, SYSARG_1);
+		word_t last  = peek_reg(tracee, CURRENT, SYSARG_2);
+		word_t flags = peek_reg(tracee, CURRENT, SYSARG_3);
 
-		/* "If oldfd equals newfd, then dup3() fails with the
-		 * error EINVAL" -- man dup3 */
-		if (peek_reg(tracee, CURRENT, SYSARG_1) == peek_reg(tracee, CURRENT, SYSARG_2))
+		if (!needs_kompat(config, KERNEL_VERSION(5,9,0)))
+			return 0;
+
+		if (first > last)
 			return -EINVAL;
 
-		modify_syscall(tracee, config, &modif);
+		if ((flags & ~(CLOSE_RANGE_CLOEXEC | CLOSE_RANGE_UNSHARE)) != 0)
+			return -EINVAL;
+
+		/* The sweep is performed at the exit stage, where
+		 * syscalls can be chained; see handle_sysexit_end().
+		 * Note CLOSE_RANGE_UNSHARE is simply ignored, exactly
+		 * like the close(2) fallback loop of the libcs.  */
+		set_sysnum(tracee, PR_void);
 		return 0;
 	}
 
-	case PR_epoll_create1: {
-		bool modified;
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,27),
-			.new_sysarg_num   = PR_epoll_create,
-			.shifts		  = NONE
-		};
+	case PR_copy_file_range: {
+		word_t flags = peek_reg(tracee, CURRENT, SYSARG_6);
 
-		/* "the size argument is ignored, but must be greater
-		 * than zero" -- man epoll_create */
-		modified = modify_syscall(tracee, config, &modif);
-		if (modified)
-			poke_reg(tracee, SYSARG_1, 1);
+		if (!needs_kompat(config, KERNEL_VERSION(4,5,0)))
+			return 0;
+
+		if (flags != 0)
+			return -EINVAL;
+
+		/* The transfer is performed tracer-side at the exit
+		 * stage, see emulate_copy_file_range().  */
+		set_sysnum(tracee, PR_void);
 		return 0;
 	}
 
-	case PR_epoll_pwait: {
+	case PR_dup3: {
 		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,19),
-			.new_sysarg_num   = PR_epoll_wait,
-			.shifts		  = NONE
+			.expected_release = KERNEL_VERSION(2,6,27),
+			.new_sysarg_num   = PR_dup2,
+			.ops		  = NONE
 		};
+
+		/* "If oldfd equals newfd, then dup3() fails with the
+		 * error EINVAL" -- man dup3 */
+		if (peek_reg(tracee, CURRENT, SYSARG_1) == peek_reg(tracee, CURRENT, SYSARG_2))
+			return -EINVAL;
+
 		modify_syscall(tracee, config, &modif);
 		return 0;
 	}
@@ -227,7 +438,7 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,27),
 			.new_sysarg_num   = PR_eventfd,
-			.shifts		  = NONE
+			.ops		  = NONE
 		};
 
 		modified = modify_syscall(tracee, config, &modif);
@@ -240,43 +451,13 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		return 0;
 	}
 
-	case PR_faccessat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_access,
-			.shifts	= { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 2,
-					.offset  = -1 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
-	case PR_fchmodat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_chmod,
-			.shifts	= { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 2,
-					.offset  = -1 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
 	case PR_fchownat: {
 		word_t flags;
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,16),
-			.shifts	= { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 3,
-					.offset  = -1 }
-			}
+			.ops = { MOVE_ARG(SYSARG_2, SYSARG_1),
+				 MOVE_ARG(SYSARG_3, SYSARG_2),
+				 MOVE_ARG(SYSARG_4, SYSARG_3) }
 		};
 
 		flags = peek_reg(tracee, CURRENT, SYSARG_5);
@@ -306,11 +487,8 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		word_t flags;
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,16),
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 2,
-					.offset  = -1 }
-			}
+			.ops = { MOVE_ARG(SYSARG_2, SYSARG_1),
+				 MOVE_ARG(SYSARG_3, SYSARG_2) }
 		};
 
 		flags = peek_reg(tracee, CURRENT, SYSARG_4);
@@ -355,44 +533,13 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		return 0;
 	}
 
-	case PR_futimesat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_utimes,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 2,
-					.offset  = -1 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
-	case PR_inotify_init1: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,27),
-			.new_sysarg_num   = PR_inotify_init,
-			.shifts		  = NONE
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
 	case PR_linkat: {
 		word_t flags;
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,16),
 			.new_sysarg_num   = PR_link,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 1,
-					.offset  = -1 },
-				    [1] = {
-					.sysarg  = SYSARG_4,
-					.nb_args = 1,
-					.offset  = -2 }
-			}
+			.ops = { MOVE_ARG(SYSARG_2, SYSARG_1),
+				 MOVE_ARG(SYSARG_4, SYSARG_2) }
 		};
 
 		flags = peek_reg(tracee, CURRENT, SYSARG_5);
@@ -403,44 +550,14 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		return 0;
 	}
 
-	case PR_mkdirat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_mkdir,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 2,
-					.offset  = -1 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
-	case PR_mknodat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_mknod,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 3,
-					.offset  = -1 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
 	case PR_openat: {
 		bool modified;
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,16),
 			.new_sysarg_num   = PR_open,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 3,
-					.offset  = -1 }
-			}
+			.ops = { MOVE_ARG(SYSARG_2, SYSARG_1),
+				 MOVE_ARG(SYSARG_3, SYSARG_2),
+				 MOVE_ARG(SYSARG_4, SYSARG_3) }
 		};
 		modified = modify_syscall(tracee, config, &modif);
 		discard_fd_flags(tracee, config, O_CLOEXEC, KERNEL_VERSION(2,6,23),
@@ -452,20 +569,10 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		discard_fd_flags(tracee, config, O_CLOEXEC, KERNEL_VERSION(2,6,23), SYSARG_2);
 		return 0;
 
-	case PR_pipe2: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,27),
-			.new_sysarg_num   = PR_pipe,
-			.shifts		  = NONE
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
 	case PR_pselect6: {
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,16),
-			.shifts		  = NONE
+			.ops		  = NONE
 		};
 #if defined(ARCH_X86_64)
 		modif.new_sysarg_num = (get_abi(tracee) != ABI_2 ? PR_select : PR__newselect);
@@ -477,55 +584,6 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 		return 0;
 	}
 
-	case PR_readlinkat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_readlink,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 3,
-					.offset  = -1}
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
-	case PR_renameat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_rename,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 1,
-					.offset  =-1 },
-				    [1] = {
-					    .sysarg  = SYSARG_4,
-					    .nb_args = 1,
-					    .offset  = -2 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
-	case PR_signalfd4: {
-		bool modified;
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,27),
-			.new_sysarg_num   = PR_signalfd,
-			.shifts		  = NONE
-		};
-
-		/* "In Linux up to version 2.6.26, the flags argument
-		 * is unused, and must be specified as zero." -- man
-		 * signalfd */
-		modified = modify_syscall(tracee, config, &modif);
-		if (modified)
-			poke_reg(tracee, SYSARG_4, 0);
-		return 0;
-	}
-
 	case PR_socket:
 	case PR_socketpair:
 	case PR_timerfd_create:
@@ -533,30 +591,11 @@ static int handle_sysenter_end(Tracee *tracee, Config *config)
 				KERNEL_VERSION(2,6,27), SYSARG_2);
 		return 0;
 
-	case PR_symlinkat: {
-		Modif modif = {
-			.expected_release = KERNEL_VERSION(2,6,16),
-			.new_sysarg_num   = PR_symlink,
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_3,
-					.nb_args = 1,
-					.offset  = -1 }
-			}
-		};
-		modify_syscall(tracee, config, &modif);
-		return 0;
-	}
-
 	case PR_unlinkat: {
 		word_t flags;
 		Modif modif = {
 			.expected_release = KERNEL_VERSION(2,6,16),
-			.shifts = { [0] = {
-					.sysarg  = SYSARG_2,
-					.nb_args = 1,
-					.offset  = -1
-				}
-			}
+			.ops = { MOVE_ARG(SYSARG_2, SYSARG_1) }
 		};
 
 		flags = peek_reg(tracee, CURRENT, SYSARG_3);
@@ -693,6 +732,240 @@ static void emulate_fd_flags(Tracee *tracee, word_t fd, Reg sysarg, int emulated
 	force_chain_final_result(tracee, peek_reg(tracee, CURRENT, SYSARG_RESULT));
 }
 
+/**
+ * Register one chained syscall per file descriptor currently opened
+ * by @tracee within [@first, @last], as listed by /proc: close(2), or
+ * fcntl(F_SETFD, FD_CLOEXEC) when @mark_cloexec is required.  Only
+ * the descriptors that actually exist are visited, so a 64k-wide
+ * close_range(2) costs a handful of chained syscalls instead of one
+ * close(2) per possible slot.  This function returns the number of
+ * chained syscalls, or -errno if an error occurred.
+ */
+static int chain_close_range(Tracee *tracee, word_t first, word_t last, bool mark_cloexec)
+{
+	char proc_fd[32];
+	struct dirent *entry;
+	int count = 0;
+	int status;
+	DIR *dir;
+
+	snprintf(proc_fd, sizeof(proc_fd), "/proc/%d/fd", tracee->pid);
+	dir = opendir(proc_fd);
+	if (dir == NULL)
+		return -errno;
+
+	while ((entry = readdir(dir)) != NULL) {
+		unsigned long fd;
+		char *end;
+
+		fd = strtoul(entry->d_name, &end, 10);
+		if (end == entry->d_name || *end != '\0')
+			continue;
+
+		if (fd < first || fd > last)
+			continue;
+
+		status = (mark_cloexec
+			? register_chained_syscall(tracee, PR_fcntl,
+						fd, F_SETFD, FD_CLOEXEC, 0, 0, 0)
+			: register_chained_syscall(tracee, PR_close,
+						fd, 0, 0, 0, 0, 0));
+		if (status < 0) {
+			closedir(dir);
+			return status;
+		}
+
+		count++;
+	}
+
+	closedir(dir);
+	return count;
+}
+
+/* sendfile(2) caps a single transfer at this value.  */
+#define COPY_FILE_RANGE_MAX 0x7ffff000
+
+/**
+ * Read into @pos the current file offset of @fd in process @pid, as
+ * exposed by /proc/@pid/fdinfo/@fd.  This function returns -errno if
+ * an error occurred, otherwise 0.
+ */
+static int read_fdinfo_pos(pid_t pid, word_t fd, uint64_t *pos)
+{
+	char path[64];
+	FILE *file;
+	int matched;
+
+	snprintf(path, sizeof(path), "/proc/%d/fdinfo/%lu", pid, (unsigned long) fd);
+	file = fopen(path, "r");
+	if (file == NULL)
+		return -errno;
+
+	matched = fscanf(file, "pos: %" SCNu64, pos);
+	fclose(file);
+
+	return (matched == 1 ? 0 : -EBADF);
+}
+
+/**
+ * Perform the voided copy_file_range(2) of @tracee tracer-side, with
+ * one single sendfile(2) between its file descriptors -- reopened
+ * through /proc -- instead of the read/write fallback loop the libcs
+ * use when the kernel lacks this syscall.  Explicit offsets are read
+ * from and written back to @tracee's memory; implicit ones are read
+ * from /proc/.../fdinfo and advanced afterwards with a chained
+ * lseek(2), since the reopened descriptors have their own offsets.
+ * This function returns -errno if an error occurred, otherwise 0.
+ */
+static int emulate_copy_file_range(Tracee *tracee)
+{
+	word_t fd_in   = peek_reg(tracee, ORIGINAL, SYSARG_1);
+	word_t off_in  = peek_reg(tracee, ORIGINAL, SYSARG_2);
+	word_t fd_out  = peek_reg(tracee, ORIGINAL, SYSARG_3);
+	word_t off_out = peek_reg(tracee, ORIGINAL, SYSARG_4);
+	word_t length  = peek_reg(tracee, ORIGINAL, SYSARG_5);
+
+	int in_fd = -1;
+	int out_fd = -1;
+	ssize_t copied;
+	uint64_t in_pos;
+	uint64_t out_pos;
+	uint64_t new_pos;
+	off_t sendfile_pos;
+	bool chained = false;
+	char proc_fd[64];
+	int status;
+
+	if (length == 0) {
+		poke_reg(tracee, SYSARG_RESULT, 0);
+		return 0;
+	}
+
+	/* A short count is always legal, the caller simply retries.  */
+	if (length > COPY_FILE_RANGE_MAX)
+		length = COPY_FILE_RANGE_MAX;
+
+	snprintf(proc_fd, sizeof(proc_fd), "/proc/%d/fd/%lu",
+		tracee->pid, (unsigned long) fd_in);
+	in_fd = open(proc_fd, O_RDONLY);
+	if (in_fd < 0) {
+		copied = -EBADF;
+		goto end;
+	}
+
+	snprintf(proc_fd, sizeof(proc_fd), "/proc/%d/fd/%lu",
+		tracee->pid, (unsigned long) fd_out);
+	out_fd = open(proc_fd, O_WRONLY);
+	if (out_fd < 0) {
+		copied = -EBADF;
+		goto end;
+	}
+
+	/* The offsets are 64-bit whatever the ABI (loff_t).  */
+	if (off_in != 0)
+		status = read_data(tracee, &in_pos, off_in, sizeof(in_pos));
+	else
+		status = read_fdinfo_pos(tracee->pid, fd_in, &in_pos);
+	if (status < 0) {
+		copied = status;
+		goto end;
+	}
+
+	if (off_out != 0)
+		status = read_data(tracee, &out_pos, off_out, sizeof(out_pos));
+	else
+		status = read_fdinfo_pos(tracee->pid, fd_out, &out_pos);
+	if (status < 0) {
+		copied = status;
+		goto end;
+	}
+
+	/* A chained lseek(2) carries the new offset in one register:
+	 * keep it reachable for 32-bit ABIs.  */
+	if (sizeof_word(tracee) == 4) {
+		if (off_in == 0 && in_pos + length > INT32_MAX) {
+			if (in_pos >= INT32_MAX) {
+				copied = -EOVERFLOW;
+				goto end;
+			}
+			length = INT32_MAX - in_pos;
+		}
+		if (off_out == 0 && out_pos + length > INT32_MAX) {
+			if (out_pos >= INT32_MAX) {
+				copied = -EOVERFLOW;
+				goto end;
+			}
+			length = INT32_MAX - out_pos;
+		}
+	}
+
+	/* Only this private descriptor is repositioned, the tracee's
+	 * own offset is left untouched.  */
+	if (lseek(out_fd, out_pos, SEEK_SET) < 0) {
+		copied = -errno;
+		goto end;
+	}
+
+	sendfile_pos = in_pos;
+	copied = sendfile(out_fd, in_fd, &sendfile_pos, length);
+	if (copied < 0) {
+		copied = -errno;
+		goto end;
+	}
+
+	if (off_in != 0) {
+		new_pos = in_pos + copied;
+		status = write_data(tracee, off_in, &new_pos, sizeof(new_pos));
+		if (status < 0) {
+			copied = status;
+			goto end;
+		}
+	}
+	else if (copied > 0) {
+		status = register_chained_syscall(tracee, PR_lseek,
+						fd_in, in_pos + copied, SEEK_SET, 0, 0, 0);
+		if (status < 0) {
+			copied = status;
+			goto end;
+		}
+		chained = true;
+	}
+
+	if (off_out != 0) {
+		new_pos = out_pos + copied;
+		status = write_data(tracee, off_out, &new_pos, sizeof(new_pos));
+		if (status < 0) {
+			copied = status;
+			goto end;
+		}
+	}
+	else if (copied > 0) {
+		status = register_chained_syscall(tracee, PR_lseek,
+						fd_out, out_pos + copied, SEEK_SET, 0, 0, 0);
+		if (status < 0) {
+			copied = status;
+			goto end;
+		}
+		chained = true;
+	}
+
+end:
+	if (in_fd >= 0)
+		(void) close(in_fd);
+	if (out_fd >= 0)
+		(void) close(out_fd);
+
+	if (copied < 0)
+		return (int) copied;
+
+	if (chained)
+		force_chain_final_result(tracee, copied);
+	else
+		poke_reg(tracee, SYSARG_RESULT, copied);
+
+	return 0;
+}
+
 /**
  * Adjust the results/output parameters for syscalls that were
  * modified in handle_sysenter_end().  This function returns -errno if
@@ -707,6 +980,33 @@ static int handle_sysexit_end(Tracee *tracee, Config *config)
 	result = peek_reg(tracee, CURRENT, SYSARG_RESULT);
 	sysnum = get_sysnum(tracee, ORIGINAL);
 
+	/* The voided close_range(2) is completed here -- whatever the
+	 * kernel returned for the voided syscall -- with one single
+	 * /proc sweep.  */
+	if (sysnum == PR_close_range && get_sysnum(tracee, MODIFIED) == PR_void) {
+		word_t first = peek_reg(tracee, ORIGINAL, SYSARG_1);
+		word_t last  = peek_reg(tracee, ORIGINAL, SYSARG_2);
+		word_t flags = peek_reg(tracee, ORIGINAL, SYSARG_3);
+		int count;
+
+		count = chain_close_range(tracee, first, last,
+					(flags & CLOSE_RANGE_CLOEXEC) != 0);
+		if (count < 0)
+			return count;
+
+		if (count == 0)
+			poke_reg(tracee, SYSARG_RESULT, 0);
+		else
+			force_chain_final_result(tracee, 0);
+
+		return 0;
+	}
+
+	/* The voided copy_file_range(2) is performed here, tracer-side,
+	 * whatever the kernel returned for the voided syscall.  */
+	if (sysnum == PR_copy_file_range && get_sysnum(tracee, MODIFIED) == PR_void)
+		return emulate_copy_file_range(tracee);
+
 	/* Error reported by the kernel.  */
 	status = (int) result;
 	if (status < 0)
@@ -942,43 +1242,247 @@ static int parse_utsname(Config *config, const char *string)
 	return 0;
 }
 
-/* List of syscalls handled by this extensions.  */
-static FilteredSysnum filtered_sysnums[] = {
-	{ PR_accept4,		FILTER_SYSEXIT },
-	{ PR_dup3,		FILTER_SYSEXIT },
-	{ PR_epoll_create1,	FILTER_SYSEXIT },
-	{ PR_epoll_pwait, 	0 },
-	{ PR_eventfd2, 		FILTER_SYSEXIT },
-	{ PR_execve, 		FILTER_SYSEXIT },
-	{ PR_faccessat, 	0 },
-	{ PR_fchmodat, 		0 },
-	{ PR_fchownat, 		0 },
-	{ PR_fcntl, 		FILTER_SYSEXIT },
-	{ PR_fstatat64, 	0 },
-	{ PR_futimesat, 	0 },
-	{ PR_futex, 		0 },
-	{ PR_inotify_init1, 	FILTER_SYSEXIT },
-	{ PR_linkat, 		0 },
-	{ PR_mkdirat, 		0 },
-	{ PR_mknodat, 		0 },
-	{ PR_newfstatat, 	0 },
-	{ PR_open, 		FILTER_SYSEXIT },
-	{ PR_openat, 		FILTER_SYSEXIT },
-	{ PR_pipe2, 		FILTER_SYSEXIT },
-	{ PR_pselect6, 		0 },
-	{ PR_readlinkat, 	0 },
-	{ PR_renameat, 		0 },
-	{ PR_setdomainname,	FILTER_SYSEXIT },
-	{ PR_sethostname,	FILTER_SYSEXIT },
-	{ PR_signalfd4, 	FILTER_SYSEXIT },
-	{ PR_socket,		FILTER_SYSEXIT },
-	{ PR_socketpair,	FILTER_SYSEXIT },
-	{ PR_symlinkat, 	0 },
-	{ PR_timerfd_create,	FILTER_SYSEXIT },
-	{ PR_uname, 		FILTER_SYSEXIT },
-	{ PR_unlinkat, 		0 },
-	FILTERED_SYSNUM_END,
+/* List of syscalls handled by this extensions, with the kernel
+ * releases that make each of them worth intercepting: a syscall is
+ * filtered only if one of its releases "needs kompat" (see
+ * needs_kompat()) on the running kernel.  A zero first release means
+ * the syscall is always filtered; the emulation of uname(2) -- and
+ * the set{host,domain}name(2)/execve(2) support it requires -- is the
+ * point of this extension, whatever the kernel.  */
+static const struct {
+	FilteredSysnum filtered;
+	int expected_releases[2];
+} handled_sysnums[] = {
+	{ { PR_accept4,		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,28), 0 } },
+	{ { PR_close_range,	FILTER_SYSEXIT }, { KERNEL_VERSION(5,9,0), 0 } },
+	{ { PR_copy_file_range,	FILTER_SYSEXIT }, { KERNEL_VERSION(4,5,0), 0 } },
+	{ { PR_dup3,		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_epoll_create1,	FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_epoll_pwait, 	0 },		  { KERNEL_VERSION(2,6,19), 0 } },
+	{ { PR_eventfd2, 	FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_execve, 		FILTER_SYSEXIT }, { 0, 0 } },
+	{ { PR_faccessat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_fchmodat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_fchownat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_fcntl, 		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,24), 0 } },
+	{ { PR_fstatat64, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_futimesat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_futex, 		0 },		  { KERNEL_VERSION(2,6,22), 0 } },
+	{ { PR_inotify_init1, 	FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_linkat, 		0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_mkdirat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_mknodat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_newfstatat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_open, 		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,23), 0 } },
+	{ { PR_openat, 		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,16),
+						    KERNEL_VERSION(2,6,23) } },
+	{ { PR_pipe2, 		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_pselect6, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_readlinkat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_renameat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_setdomainname,	FILTER_SYSEXIT }, { 0, 0 } },
+	{ { PR_sethostname,	FILTER_SYSEXIT }, { 0, 0 } },
+	{ { PR_signalfd4, 	FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_socket,		FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_socketpair,	FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_symlinkat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
+	{ { PR_timerfd_create,	FILTER_SYSEXIT }, { KERNEL_VERSION(2,6,27), 0 } },
+	{ { PR_uname, 		FILTER_SYSEXIT }, { 0, 0 } },
+	{ { PR_unlinkat, 	0 },		  { KERNEL_VERSION(2,6,16), 0 } },
 };
+#define NB_HANDLED_SYSNUMS (sizeof(handled_sysnums) / sizeof(handled_sysnums[0]))
+
+/* The kernel release alone does not prove a syscall is actually
+ * reachable: containers commonly run under seccomp policies that
+ * reject newer syscalls, and kernels can be built without some of
+ * them.  Each handled sysnum is thus probed once -- with all
+ * arguments set to -1, which no syscall of the table can act upon --
+ * and a rejected one stays filtered so kompat substitutes it, just as
+ * on an old kernel.  The probe results are persisted into an optional
+ * cache file (see --session-cache), keyed by the uname release and
+ * the boot id, so the fleet of short sessions running in between two
+ * reboots probes only once.  */
+
+#define CAPABILITY_CACHE_MAGIC   0x50434150	/* "PCAP" */
+#define CAPABILITY_CACHE_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nb_sysnums;
+	uint32_t padding;
+	char release[sizeof(((struct utsname *) NULL)->release)];
+	char boot_id[40];
+} CapabilityCacheHeader;
+
+static const char *capability_cache_path;
+
+/**
+ * Remember @path as the capability cache file.  The string is not
+ * copied, it has to remain valid for the whole session.
+ */
+void set_capability_cache(const char *path)
+{
+	capability_cache_path = path;
+}
+
+/**
+ * Copy the kernel boot id into @boot_id, or an empty string if it
+ * can't be read.
+ */
+static void get_boot_id(char boot_id[40])
+{
+	ssize_t size;
+	int fd;
+
+	boot_id[0] = '\0';
+
+	fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+	if (fd < 0)
+		return;
+
+	size = read(fd, boot_id, 39);
+	close(fd);
+	if (size <= 0)
+		return;
+
+	if (boot_id[size - 1] == '\n')
+		size--;
+	boot_id[size] = '\0';
+}
+
+/**
+ * Return whether the running kernel accepts the given @sysnum, that
+ * is, whether invoking it fails with anything but ENOSYS.
+ */
+static bool probe_sysnum(Sysnum sysnum)
+{
+	word_t number;
+	long status;
+
+	number = detranslate_sysnum(ABI_DEFAULT, sysnum);
+	if (number == SYSCALL_AVOIDER)
+		return false;
+
+	status = syscall((long) number, -1L, -1L, -1L, -1L, -1L, -1L);
+	return !(status < 0 && errno == ENOSYS);
+}
+
+/**
+ * Return the acceptance flags of the handled sysnums, in the order of
+ * handled_sysnums[].  They are fetched from the capability cache when
+ * it matches the running kernel, otherwise each sysnum is probed and
+ * the cache is refilled.
+ */
+static const uint8_t *get_accepted_sysnums(void)
+{
+	static uint8_t accepted[NB_HANDLED_SYSNUMS];
+	static bool initialized = false;
+	CapabilityCacheHeader header;
+	struct utsname utsname;
+	char boot_id[40];
+	size_t i;
+	int fd;
+
+	if (initialized)
+		return accepted;
+	initialized = true;
+
+	if (uname(&utsname) < 0)
+		utsname.release[0] = '\0';
+	get_boot_id(boot_id);
+
+	/* Valid cached probes for this very kernel instance?  */
+	if (capability_cache_path != NULL) {
+		fd = open(capability_cache_path, O_RDONLY);
+		if (fd >= 0) {
+			if (   read(fd, &header, sizeof(header)) == (ssize_t) sizeof(header)
+			    && header.magic == CAPABILITY_CACHE_MAGIC
+			    && header.version == CAPABILITY_CACHE_VERSION
+			    && header.nb_sysnums == NB_HANDLED_SYSNUMS
+			    && strncmp(header.release, utsname.release,
+					sizeof(header.release)) == 0
+			    && strncmp(header.boot_id, boot_id, sizeof(header.boot_id)) == 0
+			    && read(fd, accepted, sizeof(accepted))
+					== (ssize_t) sizeof(accepted)) {
+				close(fd);
+				return accepted;
+			}
+			close(fd);
+		}
+	}
+
+	for (i = 0; i < NB_HANDLED_SYSNUMS; i++)
+		accepted[i] = probe_sysnum(handled_sysnums[i].filtered.value);
+
+	if (capability_cache_path == NULL)
+		return accepted;
+
+	bzero(&header, sizeof(header));
+	header.magic      = CAPABILITY_CACHE_MAGIC;
+	header.version    = CAPABILITY_CACHE_VERSION;
+	header.nb_sysnums = NB_HANDLED_SYSNUMS;
+	/* @header was zeroed: bounded memcpy(3) keeps the trailing
+	 * NUL, without the truncation warning strncpy(3) would get.  */
+	memcpy(header.release, utsname.release,
+		strnlen(utsname.release, sizeof(header.release) - 1));
+	memcpy(header.boot_id, boot_id, strnlen(boot_id, sizeof(header.boot_id) - 1));
+
+	fd = open(capability_cache_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return accepted;
+
+	if (   write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)
+	    || write(fd, accepted, sizeof(accepted)) != (ssize_t) sizeof(accepted)) {
+		close(fd);
+		unlink(capability_cache_path);
+		return accepted;
+	}
+
+	close(fd);
+	return accepted;
+}
+
+/**
+ * Build -- on @extension -- the list of filtered sysnums restricted
+ * to the substitutions that can actually trigger on the running
+ * kernel, as specified by @config.  Syscalls the kernel supports
+ * natively this way never trap to PRoot on kompat's behalf.  This
+ * function returns NULL if an error occurred.
+ */
+static FilteredSysnum *prune_filtered_sysnums(Extension *extension, const Config *config)
+{
+	FilteredSysnum *sysnums;
+	size_t length;
+	size_t i;
+
+	/* In forced mode (see parse_utsname()) the actual release is
+	 * unknown: filter everything.  */
+	const bool prune = (config->actual_release != 0);
+	const uint8_t *accepted = (prune ? get_accepted_sysnums() : NULL);
+
+	sysnums = talloc_array(extension, FilteredSysnum, NB_HANDLED_SYSNUMS + 1);
+	if (sysnums == NULL)
+		return NULL;
+
+	length = 0;
+	for (i = 0; i < NB_HANDLED_SYSNUMS; i++) {
+		const int *releases = handled_sysnums[i].expected_releases;
+
+		if (   prune
+		    && releases[0] != 0
+		    && accepted[i]
+		    && !needs_kompat(config, releases[0])
+		    && (releases[1] == 0 || !needs_kompat(config, releases[1])))
+			continue;
+
+		sysnums[length++] = handled_sysnums[i].filtered;
+	}
+
+	sysnums[length] = (FilteredSysnum) FILTERED_SYSNUM_END;
+
+	return sysnums;
+}
 
 /**
  * Handler for this @extension.  It is triggered each time an @event
@@ -990,6 +1494,28 @@ int kompat_callback(Extension *extension, ExtensionEvent event,
 	int status;
 
 	switch (event) {
+	case FILTERED_SYSNUMS: {
+		Config *config;
+
+		/* Only what prune_filtered_sysnums() depends on is
+		 * computed; the Modif machinery waits for the actual
+		 * activation.  */
+		config = talloc_zero(extension, Config);
+		if (config == NULL)
+			return -1;
+
+		status = parse_utsname(config, (const char *) data1);
+		if (status < 0)
+			return -1;
+
+		extension->filtered_sysnums = prune_filtered_sysnums(extension, config);
+		if (extension->filtered_sysnums == NULL)
+			return -1;
+
+		TALLOC_FREE(config);
+		return 0;
+	}
+
 	case INITIALIZATION: {
 		Config *config;
 
@@ -1002,7 +1528,17 @@ int kompat_callback(Extension *extension, ExtensionEvent event,
 		if (status < 0)
 			return -1;
 
-		extension->filtered_sysnums = filtered_sysnums;
+		status = build_modif_entries(config);
+		if (status < 0)
+			return -1;
+
+		extension->filtered_sysnums = prune_filtered_sysnums(extension, config);
+		if (extension->filtered_sysnums == NULL)
+			return -1;
+
+		extension->event_mask = EVENT_MASK(SYSCALL_ENTER_END)
+				      | EVENT_MASK(SYSCALL_EXIT_END)
+				      | EVENT_MASK(SYSCALL_EXIT_START);
 		return 0;
 	}
 
@@ -1028,7 +1564,7 @@ int kompat_callback(Extension *extension, ExtensionEvent event,
 	case SYSCALL_EXIT_START: {
 		Tracee *tracee = TRACEE(extension);
 		Config *config = talloc_get_type_abort(extension->config, Config);
-		word_t result = peek_reg(tracee, CURRENT, SYSARG_RESULT);;
+		word_t result = peek_reg(tracee, CURRENT, SYSARG_RESULT);
 		word_t sysnum = get_sysnum(tracee, ORIGINAL);
 
 		/* Note: this can be done only before PRoot pushes the
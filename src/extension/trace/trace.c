@@ -0,0 +1,332 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <sys/types.h>  /* open(2), */
+#include <sys/stat.h>   /* open(2), */
+#include <fcntl.h>      /* open(2), */
+#include <unistd.h>     /* write(2), close(2), */
+#include <stdint.h>     /* *int*_t, */
+#include <string.h>     /* strlen(3), */
+#include <time.h>       /* clock_gettime(2), nanosleep(2), */
+#include <strings.h>    /* bzero(3), */
+#include <pthread.h>    /* pthread_*, */
+#include <talloc.h>     /* talloc*, */
+
+#include "extension/extension.h"
+#include "syscall/sysnum.h"
+#include "tracee/tracee.h"
+#include "cli/note.h"
+#include "attribute.h"
+
+/* One compact binary record per intercepted syscall.  The file starts
+ * with TraceHeader, followed by PR_NB_SYSNUM null-terminated sysnum
+ * names -- so converters don't have to know PRoot's Sysnum enum --
+ * then records until end-of-file.  */
+#define TRACE_MAGIC "PROOTTRC"
+#define TRACE_VERSION 1
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t nb_sysnums;
+	uint32_t record_size;
+	uint32_t padding;
+} TraceHeader;
+
+typedef struct {
+	uint64_t timestamp;  /* enter time, in nsecs since the trace started */
+	uint64_t latency;    /* nsecs between syscall enter and exit */
+	uint64_t path_hash;  /* hash of the last translated host path, or 0 */
+	uint32_t pid;
+	uint32_t sysnum;     /* Sysnum, an index into the name table */
+} TraceRecord;
+
+/* Number of records in the ring, must be a power of two.  */
+#define TRACE_RING_SIZE 16384
+
+/* Single-producer/single-consumer lock-free ring: every extension
+ * event is handled by the event loop thread (the producer, which only
+ * moves @head) while a dedicated thread (the consumer, which only
+ * moves @tail) writes drained records to disk.  One recorder per
+ * PRoot instance.  */
+static struct {
+	TraceRecord records[TRACE_RING_SIZE];
+	size_t head;
+	size_t tail;
+	size_t nb_dropped;
+	size_t nb_users;
+	uint64_t origin;
+	pthread_t writer;
+	bool stopping;
+	bool active;
+	int fd;
+} ring;
+
+/* Per-tracee state.  */
+typedef struct {
+	uint64_t enter_time;
+	uint64_t path_hash;
+} Config;
+
+/**
+ * Return the current CLOCK_MONOTONIC time, in nanoseconds.
+ */
+static uint64_t now_nsecs(void)
+{
+	struct timespec time;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t) time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+/**
+ * Return the djb2 hash of @string.
+ */
+static uint64_t hash_string(const char *string)
+{
+	uint64_t hash = 5381;
+
+	while (*string != '\0')
+		hash = hash * 33 + (unsigned char) *string++;
+
+	return hash;
+}
+
+/**
+ * Entry point of the writer thread: drain the ring into the trace
+ * file.  Contiguous spans are written straight from the ring, without
+ * any intermediate copy.
+ */
+static void *writer_main(void *private UNUSED)
+{
+	while (1) {
+		const struct timespec delay = { .tv_nsec = 5000000 };
+		size_t head;
+		size_t tail;
+
+		head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+		tail = ring.tail;
+
+		if (tail == head) {
+			if (ring.stopping)
+				return NULL;
+			(void) nanosleep(&delay, NULL);
+			continue;
+		}
+
+		while (tail != head) {
+			size_t start = tail % TRACE_RING_SIZE;
+			size_t count = head - tail;
+
+			/* Don't wrap around the ring's end.  */
+			if (start + count > TRACE_RING_SIZE)
+				count = TRACE_RING_SIZE - start;
+
+			(void) write(ring.fd, &ring.records[start],
+				count * sizeof(TraceRecord));
+			tail += count;
+		}
+
+		__atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * Push one record to the writer thread; the record is dropped -- and
+ * accounted as such -- if the ring is full.
+ */
+static void push_record(uint64_t timestamp, uint64_t latency,
+			uint64_t path_hash, uint32_t pid, uint32_t sysnum)
+{
+	TraceRecord *record;
+	size_t tail;
+
+	tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+	if (ring.head - tail >= TRACE_RING_SIZE) {
+		ring.nb_dropped++;
+		return;
+	}
+
+	record = &ring.records[ring.head % TRACE_RING_SIZE];
+	record->timestamp = timestamp;
+	record->latency   = latency;
+	record->path_hash = path_hash;
+	record->pid       = pid;
+	record->sysnum    = sysnum;
+
+	__atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Open the trace file @path, write its header and name table, then
+ * start the writer thread.  This function returns -1 if an error
+ * occurred, otherwise 0.
+ */
+static int initialize_recorder(const Tracee *tracee, const char *path)
+{
+	TraceHeader header;
+	Sysnum sysnum;
+	int status;
+
+	ring.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (ring.fd < 0) {
+		note(tracee, ERROR, SYSTEM, "can't open trace file '%s'", path);
+		return -1;
+	}
+
+	bzero(&header, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version     = TRACE_VERSION;
+	header.nb_sysnums  = PR_NB_SYSNUM;
+	header.record_size = sizeof(TraceRecord);
+
+	status = write(ring.fd, &header, sizeof(header));
+	if (status != sizeof(header))
+		goto error;
+
+	for (sysnum = 0; sysnum < PR_NB_SYSNUM; sysnum++) {
+		const char *name = stringify_sysnum(sysnum);
+
+		status = write(ring.fd, name, strlen(name) + 1);
+		if (status < 0)
+			goto error;
+	}
+
+	ring.origin = now_nsecs();
+
+	status = pthread_create(&ring.writer, NULL, writer_main, NULL);
+	if (status != 0)
+		goto error;
+
+	ring.active = true;
+	return 0;
+
+error:
+	note(tracee, ERROR, SYSTEM, "can't initialize trace file '%s'", path);
+	(void) close(ring.fd);
+	return -1;
+}
+
+/**
+ * Flush the remaining records, join the writer thread, then close the
+ * trace file.
+ */
+static void finalize_recorder(void)
+{
+	if (!ring.active)
+		return;
+
+	ring.stopping = true;
+	pthread_join(ring.writer, NULL);
+
+	if (ring.nb_dropped > 0)
+		note(NULL, WARNING, INTERNAL,
+			"trace: %zd record(s) dropped (ring was full)",
+			ring.nb_dropped);
+
+	(void) close(ring.fd);
+	ring.active = false;
+}
+
+/**
+ * Handler for this @extension.  It is triggered each time an @event
+ * occurred.  See ExtensionEvent for the meaning of @data1 and @data2.
+ */
+int trace_callback(Extension *extension, ExtensionEvent event,
+		intptr_t data1, intptr_t data2)
+{
+	switch (event) {
+	case INITIALIZATION: {
+		Tracee *tracee = TRACEE(extension);
+		int status;
+
+		if (ring.active) {
+			note(tracee, WARNING, USER, "only one trace recorder at a time");
+			return -1;
+		}
+
+		status = initialize_recorder(tracee, (const char *) data1);
+		if (status < 0)
+			return -1;
+
+		extension->config = talloc_zero(extension, Config);
+		if (extension->config == NULL)
+			return -1;
+
+		ring.nb_users++;
+
+		extension->event_mask = EVENT_MASK(HOST_PATH)
+				      | EVENT_MASK(SYSCALL_ENTER_START)
+				      | EVENT_MASK(SYSCALL_EXIT_END);
+		return 0;
+	}
+
+	case INHERIT_PARENT: /* One private state per tracee.  */
+		return 1;
+
+	case INHERIT_CHILD:
+		extension->config = talloc_zero(extension, Config);
+		if (extension->config == NULL)
+			return -1;
+
+		ring.nb_users++;
+		return 0;
+
+	case REMOVED:
+		ring.nb_users--;
+		if (ring.nb_users == 0)
+			finalize_recorder();
+		return 0;
+
+	case SYSCALL_ENTER_START: {
+		Config *config = talloc_get_type_abort(extension->config, Config);
+
+		config->enter_time = now_nsecs();
+		config->path_hash  = 0;
+		return 0;
+	}
+
+	case HOST_PATH: {
+		Config *config = talloc_get_type_abort(extension->config, Config);
+
+		/* Remember the final -- fully translated -- host path
+		 * of the current syscall only.  */
+		if ((bool) data2)
+			config->path_hash = hash_string((const char *) data1);
+		return 0;
+	}
+
+	case SYSCALL_EXIT_END: {
+		Config *config = talloc_get_type_abort(extension->config, Config);
+		Tracee *tracee = TRACEE(extension);
+
+		push_record(config->enter_time - ring.origin,
+			now_nsecs() - config->enter_time,
+			config->path_hash, tracee->pid,
+			get_sysnum(tracee, ORIGINAL));
+		return 0;
+	}
+
+	default:
+		return 0;
+	}
+}
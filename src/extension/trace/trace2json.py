@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# This file is part of PRoot.
+#
+# Convert a trace file produced by "proot --trace=<path>" into the
+# Chrome trace-event format, which chrome://tracing, Perfetto and
+# speedscope can load:
+#
+#     trace2json.py <path> > trace.json
+#
+# The input starts with a fixed header, followed by a table of
+# null-terminated sysnum names, then 32-byte records; see
+# src/extension/trace/trace.c for the exact layout.
+
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<8sIIII")
+RECORD = struct.Struct("<QQQII")
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: trace2json.py <trace-file>", file=sys.stderr)
+        return 1
+
+    with open(sys.argv[1], "rb") as file:
+        magic, version, nb_sysnums, record_size, _ = HEADER.unpack(
+            file.read(HEADER.size))
+        if magic != b"PROOTTRC" or version != 1 or record_size != RECORD.size:
+            print("not a PRoot trace file", file=sys.stderr)
+            return 1
+
+        names = []
+        while len(names) < nb_sysnums:
+            name = bytearray()
+            while True:
+                byte = file.read(1)
+                if byte in (b"", b"\0"):
+                    break
+                name += byte
+            names.append(name.decode("ascii", "replace"))
+
+        events = []
+        while True:
+            data = file.read(RECORD.size)
+            if len(data) < RECORD.size:
+                break
+            timestamp, latency, path_hash, pid, sysnum = RECORD.unpack(data)
+            event = {
+                "name": names[sysnum] if sysnum < nb_sysnums else str(sysnum),
+                "ph": "X",
+                "ts": timestamp / 1000.0,   # usecs
+                "dur": latency / 1000.0,
+                "pid": pid,
+                "tid": pid,
+            }
+            if path_hash != 0:
+                event["args"] = {"path_hash": "%016x" % path_hash}
+            events.append(event)
+
+    json.dump({"traceEvents": events}, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -127,6 +127,36 @@ void _start(void *cursor)
 		LoadStatement *stmt = cursor;
 
 		switch (stmt->action) {
+		case LOAD_ACTION_MMAP_FILE:
+			/* Almost every script is "open, N mmaps,
+			 * start" repeated for the program and its
+			 * interpreter: consecutive file mmaps are
+			 * consumed by this tight loop, without going
+			 * back through the dispatch switch for each
+			 * of them.  */
+			do {
+				stmt = cursor;
+
+				status = SYSCALL(MMAP, 6, stmt->mmap.addr, stmt->mmap.length,
+						stmt->mmap.prot, MAP_PRIVATE | MAP_FIXED, fd,
+						stmt->mmap.offset >> MMAP_OFFSET_SHIFT);
+				if (unlikely(status != stmt->mmap.addr))
+					FATAL();
+
+				if (stmt->mmap.clear_length != 0)
+					clear(stmt->mmap.addr + stmt->mmap.length
+							- stmt->mmap.clear_length,
+						stmt->mmap.addr + stmt->mmap.length);
+
+				if (reset_at_base) {
+					at_base = stmt->mmap.addr;
+					reset_at_base = false;
+				}
+
+				cursor += LOAD_STATEMENT_SIZE(*stmt, mmap);
+			} while (((LoadStatement *) cursor)->action == LOAD_ACTION_MMAP_FILE);
+			break;
+
 		case LOAD_ACTION_OPEN_NEXT:
 			status = SYSCALL(CLOSE, 1, fd);
 			if (unlikely((int) status < 0))
@@ -143,25 +173,6 @@ void _start(void *cursor)
 			cursor += LOAD_STATEMENT_SIZE(*stmt, open);
 			break;
 
-		case LOAD_ACTION_MMAP_FILE:
-			status = SYSCALL(MMAP, 6, stmt->mmap.addr, stmt->mmap.length,
-					stmt->mmap.prot, MAP_PRIVATE | MAP_FIXED, fd,
-					stmt->mmap.offset >> MMAP_OFFSET_SHIFT);
-			if (unlikely(status != stmt->mmap.addr))
-				FATAL();
-
-			if (stmt->mmap.clear_length != 0)
-				clear(stmt->mmap.addr + stmt->mmap.length - stmt->mmap.clear_length,
-					stmt->mmap.addr + stmt->mmap.length);
-
-			if (reset_at_base) {
-				at_base = stmt->mmap.addr;
-				reset_at_base = false;
-			}
-
-			cursor += LOAD_STATEMENT_SIZE(*stmt, mmap);
-			break;
-
 		case LOAD_ACTION_MMAP_ANON:
 			status = SYSCALL(MMAP, 6, stmt->mmap.addr, stmt->mmap.length,
 					stmt->mmap.prot, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
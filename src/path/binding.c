@@ -21,19 +21,28 @@
  */
 
 #include <sys/stat.h> /* lstat(2), */
-#include <unistd.h>   /* getcwd(2), lstat(2), */
+#include <sys/mman.h> /* mmap(2), munmap(2), */
+#include <fcntl.h>    /* open(2), */
+#include <unistd.h>   /* getcwd(2), lstat(2), write(2), */
 #include <string.h>   /* string(3),  */
 #include <strings.h>  /* bzero(3), */
 #include <assert.h>   /* assert(3), */
 #include <limits.h>   /* PATH_MAX, */
 #include <errno.h>    /* E* */
+#include <stdint.h>   /* uint64_t, */
+#include <inttypes.h> /* PRIu64, */
+#include <stdio.h>    /* fopen(3), fgets(3), */
+#include <stdlib.h>   /* qsort(3), */
+#include <signal.h>   /* sig_atomic_t, */
 #include <sys/queue.h> /* CIRCLEQ_*, */
 #include <talloc.h>   /* talloc_*, */
 
 #include "path/binding.h"
 #include "path/path.h"
 #include "path/canon.h"
+#include "path/cache.h"
 #include "cli/note.h"
+#include "profile.h"
 
 #include "compat.h"
 
@@ -63,6 +72,7 @@
 	default:    CIRCLEQ_INSERT_AFTER(HEAD(tracee, side), previous, binding, link.pending); break; \
 	}								\
 	(void) talloc_reference(HEAD(tracee, side), binding);		\
+	bindings_generation++;						\
 } while (0)
 
 #define CIRCLEQ_INSERT_BEFORE_(tracee, next, binding, side) do {	\
@@ -72,6 +82,7 @@
 	default:    CIRCLEQ_INSERT_BEFORE(HEAD(tracee, side), next, binding, link.pending); break; \
 	}								\
 	(void) talloc_reference(HEAD(tracee, side), binding);		\
+	bindings_generation++;						\
 } while (0)
 
 #define CIRCLEQ_INSERT_HEAD_(tracee, binding, side) do {		\
@@ -81,6 +92,7 @@
 	default:    CIRCLEQ_INSERT_HEAD(HEAD(tracee, side), binding, link.pending); break; \
 	}								\
 	(void) talloc_reference(HEAD(tracee, side), binding);		\
+	bindings_generation++;						\
 } while (0)
 
 #define IS_LINKED(binding, link)					\
@@ -91,8 +103,435 @@
 	(binding)->link.name.cqe_next = NULL;				\
 	(binding)->link.name.cqe_prev = NULL;				\
 	talloc_unlink((tracee)->fs->bindings.name, binding);		\
+	bindings_generation++;						\
 } while (0)
 
+/* Number of modifications made to any list of bindings so far; used
+ * to detect stale binding indexes.  */
+static uint64_t bindings_generation;
+
+/* Number of bindings whose host part still has to be canonicalized;
+ * used to skip the sanitization pass entirely in the common case.  */
+static size_t nb_lazy_host_paths;
+
+/* One-way latch: true once a case-insensitive binding was created.
+ * The sorted index assumes one total order over paths, which folded
+ * and unfolded comparisons can't both provide, so get_binding() falls
+ * back to the ordered linear walk only when such bindings exist; the
+ * common all-sensitive session is not affected at all.  */
+bool case_insensitive_bindings_in_use;
+
+/* Sorted array of bindings used by get_binding() to perform a binary
+ * search instead of walking the whole CIRCLEQ for each translated
+ * path.  Such an index describes the "guest" or "host" list it was
+ * built from, at the generation it was built at; it is rebuilt lazily
+ * once the list has changed.  */
+typedef struct {
+	Binding *binding;
+	const Path *path;
+} BindingIndexEntry;
+
+/* Real workloads follow a power law: a couple of bindings take almost
+ * every lookup.  The hottest ones are kept in a tiny front array that
+ * is tried before the binary search -- usually a single predictable
+ * comparison -- and re-ranked periodically from the per-binding hit
+ * counts.  Only "leaf" bindings are promotable, i.e. bindings with no
+ * other binding below them: a match against such a binding is
+ * necessarily the deepest one, so the front array can short-circuit
+ * the deepest-prefix search without changing its result.  */
+#define NB_HOT_BINDINGS 2
+#define HOT_RERANK_PERIOD 1024
+
+typedef struct {
+	const Bindings *bindings;
+	uint64_t generation;
+
+	BindingIndexEntry *entries;
+	size_t nb_entries;
+
+	/* Hottest promotable entries, see above.  */
+	BindingIndexEntry hot[NB_HOT_BINDINGS];
+	size_t nb_hot;
+	uint64_t nb_hits;
+} BindingIndex;
+
+/* Indexes are cached per list of bindings; a handful of slots is
+ * enough since lists are shared across file-system name-spaces
+ * (except on sub-reconfiguration).  */
+#define NB_BINDING_INDEXES 8
+static BindingIndex binding_indexes[NB_BINDING_INDEXES];
+static size_t next_binding_index;
+
+static void insort_binding(const Tracee *tracee, Side side, Binding *binding);
+
+/* Path to the compiled bindings cache, specified with
+ * --bindings-cache; see adopt_compiled_bindings().  */
+static const char *bindings_cache_path;
+
+/* Digest of the raw option set the pending bindings were built from;
+ * computed by initialize_bindings() before the pending list is
+ * consumed.  */
+static uint64_t pending_bindings_digest;
+
+static uint64_t hash_pending_bindings(const Tracee *tracee);
+static bool adopt_compiled_bindings(Tracee *tracee);
+
+/* Lookup counters for --analyze-bindings: one entry per logical
+ * binding (host:guest pair), shared by every Binding copy across
+ * file-system name-spaces and reloads, and surviving the bindings
+ * themselves so the report can be printed at exit.  */
+struct binding_profile_entry {
+	char *host;
+	char *guest;
+	uint64_t nb_lookups[2];		/* Indexed by Side.  */
+	struct binding_profile_entry *next;
+};
+
+static BindingProfileEntry *binding_profile_entries;
+static bool binding_profile_enabled = false;
+
+void enable_binding_profile(void)
+{
+	binding_profile_enabled = true;
+}
+
+/**
+ * Bind @binding to its lookup counters, creating them on first
+ * sight.  No-op unless --analyze-bindings was specified.
+ */
+static void attach_binding_profile(Binding *binding)
+{
+	BindingProfileEntry *entry;
+
+	if (!binding_profile_enabled || binding->profile != NULL)
+		return;
+
+	for (entry = binding_profile_entries; entry != NULL; entry = entry->next)
+		if (   strcmp(entry->host, binding->host.path) == 0
+		    && strcmp(entry->guest, binding->guest.path) == 0)
+			break;
+
+	if (entry == NULL) {
+		entry = talloc_zero(talloc_autofree_context(), BindingProfileEntry);
+		if (entry == NULL)
+			return;
+
+		entry->host  = talloc_strdup(entry, binding->host.path);
+		entry->guest = talloc_strdup(entry, binding->guest.path);
+		if (entry->host == NULL || entry->guest == NULL) {
+			TALLOC_FREE(entry);
+			return;
+		}
+
+		entry->next = binding_profile_entries;
+		binding_profile_entries = entry;
+	}
+
+	binding->profile = entry;
+}
+
+static int compare_profile_entries(const void *pointer1, const void *pointer2)
+{
+	const BindingProfileEntry *entry1 = *(BindingProfileEntry *const *) pointer1;
+	const BindingProfileEntry *entry2 = *(BindingProfileEntry *const *) pointer2;
+	uint64_t total1 = entry1->nb_lookups[GUEST] + entry1->nb_lookups[HOST];
+	uint64_t total2 = entry2->nb_lookups[GUEST] + entry2->nb_lookups[HOST];
+
+	if (total1 != total2)
+		return total1 < total2 ? 1 : -1;
+	return strcmp(entry1->guest, entry2->guest);
+}
+
+/**
+ * Print the per-binding lookup counters collected for
+ * --analyze-bindings, most used first, never-matched bindings
+ * flagged.  No-op unless that option was specified.
+ */
+void print_binding_profile(void)
+{
+	BindingProfileEntry **sorted;
+	BindingProfileEntry *entry;
+	size_t nb_entries = 0;
+	size_t i;
+
+	if (!binding_profile_enabled)
+		return;
+
+	for (entry = binding_profile_entries; entry != NULL; entry = entry->next)
+		nb_entries++;
+
+	sorted = talloc_array(NULL, BindingProfileEntry *, nb_entries);
+	if (sorted == NULL)
+		return;
+
+	i = 0;
+	for (entry = binding_profile_entries; entry != NULL; entry = entry->next)
+		sorted[i++] = entry;
+	qsort(sorted, nb_entries, sizeof(BindingProfileEntry *), compare_profile_entries);
+
+	note(NULL, INFO, USER, "binding profile (matches as guest path + as host path):");
+	for (i = 0; i < nb_entries; i++) {
+		entry = sorted[i];
+
+		if (entry->nb_lookups[GUEST] == 0 && entry->nb_lookups[HOST] == 0)
+			note(NULL, INFO, USER, "\t%s:%s\tnever matched",
+				entry->host, entry->guest);
+		else
+			note(NULL, INFO, USER, "\t%s:%s\t%" PRIu64 " + %" PRIu64,
+				entry->host, entry->guest,
+				entry->nb_lookups[GUEST], entry->nb_lookups[HOST]);
+	}
+
+	TALLOC_FREE(sorted);
+}
+static void write_compiled_bindings(const Tracee *tracee);
+
+/**
+ * Canonicalize the host part of @binding, deferred from new_binding()
+ * until a detranslation actually needs it.  The binding is re-inserted
+ * into the "host" list when its canonical form differs from the raw
+ * one, since this list is sorted on host paths.
+ */
+static void sanitize_binding_host(const Tracee *tracee, Binding *binding)
+{
+	char path[PATH_MAX];
+	int status;
+
+	assert(nb_lazy_host_paths > 0);
+	nb_lazy_host_paths--;
+	binding->host_sanitized = true;
+
+	status = realpath2(NULL, path, binding->host.path, true);
+	if (status < 0) {
+		/* Keep the raw path: the kernel will report the error,
+		 * if any, once it is actually used.  */
+		return;
+	}
+
+	if (compare_paths(path, binding->host.path) == PATHS_ARE_EQUAL)
+		return;
+
+	strcpy(binding->host.path, path);
+	binding->host.length = strlen(binding->host.path);
+	set_path_prefix(&binding->host);
+
+	binding->need_substitution =
+		compare_paths(binding->host.path, binding->guest.path) != PATHS_ARE_EQUAL;
+
+	if (IS_LINKED(binding, link.host)) {
+		CIRCLEQ_REMOVE_(tracee, binding, host);
+		insort_binding(tracee, HOST, binding);
+	}
+}
+
+/**
+ * Compare @path (@length long, no trailing "/") against the indexed
+ * binding path @ref.  The result is consistent with a lexicographic
+ * sort of the indexed paths.
+ */
+static int compare_with_index_entry(const char *path, size_t length, const Path *ref)
+{
+	size_t ref_length = ref->length;
+	int result;
+
+	/* Same normalization as compare_paths2().  */
+	if (ref_length > 1 && ref->path[ref_length - 1] == '/')
+		ref_length--;
+
+	result = strncmp(path, ref->path, length < ref_length ? length : ref_length);
+	if (result != 0)
+		return result;
+
+	return (length < ref_length ? -1 : length > ref_length ? 1 : 0);
+}
+
+/**
+ * Compare two index entries, used to sort an index.  Entries with
+ * equal paths keep their relative order in the indexed list, as
+ * expected by get_binding().
+ */
+static int compare_index_entries(const void *entry1, const void *entry2)
+{
+	const Path *path1 = ((const BindingIndexEntry *) entry1)->path;
+	const Path *path2 = ((const BindingIndexEntry *) entry2)->path;
+	int result;
+
+	result = compare_with_index_entry(path1->path, path1->length, path2);
+	if (result != 0)
+		return result;
+
+	/* qsort(3) isn't stable: fall back to the list order, ie. the
+	 * order entries were appended in.  */
+	return (entry1 < entry2 ? -1 : 1);
+}
+
+/**
+ * Return whether no other entry of @index lies below the @i-th one,
+ * i.e. whether the latter is the deepest binding on its own path.
+ * Entries sharing a string prefix are contiguous in the sorted index,
+ * so the scan stops as soon as the prefix no longer matches.
+ */
+static bool is_leaf_entry(const BindingIndex *index, size_t i)
+{
+	const Path *path = index->entries[i].path;
+	size_t j;
+
+	for (j = i + 1; j < index->nb_entries; j++) {
+		const Path *next = index->entries[j].path;
+
+		if (   next->length < path->length
+		    || strncmp(next->path, path->path, path->length) != 0)
+			return true;
+
+		/* A binding with the very same path: look further.  */
+		if (next->length == path->length)
+			continue;
+
+		/* A longer string prefix is a deeper binding only on a
+		 * component boundary, e.g. "/usr!" is not below "/usr".  */
+		if (path->length == 1 || next->path[path->length] == '/')
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Re-rank @index->hot: pick the most-hit leaf entries, so the next
+ * lookups try them before the binary search.  Entries that were never
+ * hit are not promoted.
+ */
+static void rerank_hot_bindings(BindingIndex *index)
+{
+	size_t i, j;
+
+	index->nb_hot = 0;
+
+	for (i = 0; i < index->nb_entries; i++) {
+		const BindingIndexEntry *entry = &index->entries[i];
+		uint64_t nb_hits = entry->binding->nb_hits;
+
+		if (nb_hits == 0 || !is_leaf_entry(index, i))
+			continue;
+
+		/* Insert into the front array, hottest first.  */
+		for (j = 0; j < index->nb_hot; j++)
+			if (nb_hits > index->hot[j].binding->nb_hits)
+				break;
+		if (j == NB_HOT_BINDINGS)
+			continue;
+
+		if (index->nb_hot < NB_HOT_BINDINGS)
+			index->nb_hot++;
+		memmove(&index->hot[j + 1], &index->hot[j],
+			(index->nb_hot - j - 1) * sizeof(index->hot[0]));
+		index->hot[j] = *entry;
+	}
+}
+
+/**
+ * Return the index for the @side list of @tracee's bindings, rebuilt
+ * first if it doesn't exist yet or if the list has changed since.
+ * This function returns NULL if an error occurred (ENOMEM), in that
+ * case the caller has to fall back to a linear search.
+ */
+static BindingIndex *get_binding_index(const Tracee *tracee, Side side)
+{
+	const Bindings *bindings = HEAD(tracee, side);
+	BindingIndex *index = NULL;
+	Binding *binding;
+	size_t nb_bindings;
+	size_t i;
+
+	assert(side == GUEST || side == HOST);
+
+	/* Is this list already indexed?  */
+	for (i = 0; i < NB_BINDING_INDEXES; i++) {
+		if (binding_indexes[i].bindings != bindings)
+			continue;
+
+		index = &binding_indexes[i];
+		if (index->generation == bindings_generation)
+			return index;
+		break;
+	}
+
+	/* Otherwise, recycle a slot (round-robin).  */
+	if (index == NULL) {
+		index = &binding_indexes[next_binding_index];
+		next_binding_index = (next_binding_index + 1) % NB_BINDING_INDEXES;
+	}
+
+	TALLOC_FREE(index->entries);
+	index->bindings = NULL;
+
+	/* A detranslation compares kernel-returned paths -- canonical
+	 * by definition -- against host paths, so these all have to be
+	 * canonical by now.  The "guest" list has the same members and
+	 * is not re-ordered by the sanitization.  */
+	if (side == HOST && nb_lazy_host_paths > 0) {
+		CIRCLEQ_FOREACH_(tracee, binding, GUEST) {
+			if (!binding->host_sanitized)
+				sanitize_binding_host(tracee, binding);
+		}
+	}
+
+	nb_bindings = 0;
+	CIRCLEQ_FOREACH_(tracee, binding, side)
+		nb_bindings++;
+
+	index->entries = talloc_array(NULL, BindingIndexEntry, nb_bindings);
+	if (index->entries == NULL)
+		return NULL;
+
+	i = 0;
+	CIRCLEQ_FOREACH_(tracee, binding, side) {
+		index->entries[i].binding = binding;
+		index->entries[i].path = (side == GUEST ? &binding->guest : &binding->host);
+		i++;
+	}
+	assert(i == nb_bindings);
+
+	qsort(index->entries, nb_bindings, sizeof(index->entries[0]), compare_index_entries);
+
+	index->nb_entries = nb_bindings;
+	index->bindings = bindings;
+	index->generation = bindings_generation;
+
+	/* Per-binding hit counts survive the rebuild: warm the front
+	 * array up right away.  */
+	rerank_hot_bindings(index);
+
+	return index;
+}
+
+/**
+ * Search @index for a binding whose path is exactly @path (@length
+ * long, no trailing "/").  When several bindings have this very path,
+ * the one that comes first in the indexed list is returned.  This
+ * function returns NULL if no binding was found.
+ */
+static Binding *search_binding_index(const BindingIndex *index, const char *path, size_t length)
+{
+	size_t low = 0;
+	size_t high = index->nb_entries;
+
+	/* Find the left-most entry that is not lesser than @path.  */
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+
+		if (compare_with_index_entry(path, length, index->entries[middle].path) > 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low == index->nb_entries
+	    || compare_with_index_entry(path, length, index->entries[low].path) != 0)
+		return NULL;
+
+	return index->entries[low].binding;
+}
 
 /**
  * Print all bindings (verbose purpose).
@@ -119,12 +558,111 @@ static void print_bindings(const Tracee *tracee)
  */
 Binding *get_binding(const Tracee *tracee, Side side, const char path[PATH_MAX])
 {
+	BindingIndex *index;
 	Binding *binding;
+	uint64_t path_prefix;
+	size_t norm_length;
 	size_t path_length = strlen(path);
+	size_t i;
 
 	/* Sanity checks.  */
 	assert(path != NULL && path[0] == '/');
 
+	/* Fast path: search the component-wise prefixes of @path --
+	 * from the deepest one up to "/" -- in the sorted index, as
+	 * get_binding() would return the binding for the deepest
+	 * matching prefix.  Case-insensitive bindings don't fit a
+	 * case-sensitively sorted index: the ordered linear walk below
+	 * handles them.  */
+	index = (case_insensitive_bindings_in_use
+		? NULL : get_binding_index(tracee, side));
+	if (index != NULL) {
+		size_t length = path_length;
+
+		/* Hottest bindings first: a promoted binding has no
+		 * binding below it, so a match here is necessarily
+		 * the deepest one.  */
+		for (i = 0; i < index->nb_hot; i++) {
+			const Path *ref = index->hot[i].path;
+			Comparison comparison;
+
+			comparison = compare_paths2(ref->path, ref->length,
+						path, path_length);
+			if (   comparison != PATHS_ARE_EQUAL
+			    && comparison != PATH1_IS_PREFIX)
+				continue;
+
+			/* Same rootfs-prefix check as below.  */
+			if (   side == HOST
+			    && compare_paths(get_root(tracee), "/") != PATHS_ARE_EQUAL
+			    && belongs_to_guestfs(tracee, path))
+				return NULL;
+
+			binding = index->hot[i].binding;
+			binding->nb_hits++;
+			if (++index->nb_hits % HOT_RERANK_PERIOD == 0)
+				rerank_hot_bindings(index);
+			if (binding->profile != NULL)
+				binding->profile->nb_lookups[side]++;
+			return binding;
+		}
+
+		/* Same normalization as compare_paths2().  */
+		if (length > 1 && path[length - 1] == '/')
+			length--;
+
+		while (1) {
+			binding = search_binding_index(index, path, length);
+			if (binding != NULL) {
+				/* Avoid false positive when a prefix
+				 * of the rootfs is used as an
+				 * asymmetric binding; see below.
+				 * Note this check doesn't depend on
+				 * the found binding, thus shallower
+				 * prefixes would be skipped too.  */
+				if (   side == HOST
+				    && compare_paths(get_root(tracee), "/") != PATHS_ARE_EQUAL
+				    && belongs_to_guestfs(tracee, path))
+					return NULL;
+
+				binding->nb_hits++;
+				if (++index->nb_hits % HOT_RERANK_PERIOD == 0)
+					rerank_hot_bindings(index);
+				if (binding->profile != NULL)
+					binding->profile->nb_lookups[side]++;
+				return binding;
+			}
+
+			if (length == 1)
+				return NULL;
+
+			/* Chop the deepest component off.  */
+			do length--;
+			while (length > 1 && path[length] != '/');
+		}
+	}
+
+	/* The index couldn't be built (ENOMEM) or case-insensitive
+	 * bindings are in use: fall back to a linear search over the
+	 * whole list of bindings.  */
+
+	/* A detranslation compares kernel-returned paths -- canonical
+	 * by definition -- against host paths, so these all have to
+	 * be canonical by now; the index rebuild usually runs this
+	 * pass but it is bypassed here.  */
+	if (side == HOST && nb_lazy_host_paths > 0) {
+		CIRCLEQ_FOREACH_(tracee, binding, GUEST) {
+			if (!binding->host_sanitized)
+				sanitize_binding_host(tracee, binding);
+		}
+	}
+
+	norm_length = path_length;
+	if (norm_length > 1 && path[norm_length - 1] == '/')
+		norm_length--;
+
+	path_prefix = load_path_prefix(path, path_length);
+
 	CIRCLEQ_FOREACH_(tracee, binding, side) {
 		Comparison comparison;
 		const Path *ref;
@@ -143,7 +681,17 @@ Binding *get_binding(const Tracee *tracee, Side side, const char path[PATH_MAX])
 			return NULL;
 		}
 
-		comparison = compare_paths2(ref->path, ref->length, path, path_length);
+		/* Cheap prejudgment: @ref can neither be equal to
+		 * @path nor a prefix of it if it is longer, or if
+		 * their first bytes differ.  The byte comparison is
+		 * meaningless for folded matches.  */
+		if (   ref->length > norm_length
+		    || (   !binding->case_insensitive
+			&& ((path_prefix ^ ref->prefix) & ref->prefix_mask) != 0))
+			continue;
+
+		comparison = compare_paths3(ref->path, ref->length, path, path_length,
+					binding->case_insensitive);
 		if (   comparison != PATHS_ARE_EQUAL
 		    && comparison != PATH1_IS_PREFIX)
 			continue;
@@ -158,6 +706,9 @@ Binding *get_binding(const Tracee *tracee, Side side, const char path[PATH_MAX])
 		    && belongs_to_guestfs(tracee, path))
 				continue;
 
+		binding->nb_hits++;
+		if (binding->profile != NULL)
+			binding->profile->nb_lookups[side]++;
 		return binding;
 	}
 
@@ -189,6 +740,45 @@ const char *get_path_binding(const Tracee *tracee, Side side, const char path[PA
 	}
 }
 
+/**
+ * Check whether every binding of @tracee -- the root one included --
+ * is an identity binding, that is, whether it maps a host path onto
+ * the very same guest path.  In such a name-space the whole
+ * translation is the identity function -- symbolic links can only
+ * lead to identity-bound locations too -- so translate_path() passes
+ * lexically canonical paths through unmodified.  The detection relies
+ * on @need_substitution, computed when each binding was inserted (see
+ * insort_binding2()); the aggregated result is cached until the
+ * bindings change.
+ */
+bool all_bindings_are_identity(const Tracee *tracee)
+{
+	static const Bindings *cached_bindings;
+	static uint64_t cached_generation;
+	static bool cached_result;
+	const Binding *binding;
+
+	if (tracee == NULL || tracee->fs == NULL || tracee->fs->bindings.guest == NULL)
+		return false;
+
+	if (   tracee->fs->bindings.guest == cached_bindings
+	    && bindings_generation == cached_generation)
+		return cached_result;
+
+	cached_result = true;
+	CIRCLEQ_FOREACH_(tracee, binding, GUEST) {
+		if (binding->need_substitution) {
+			cached_result = false;
+			break;
+		}
+	}
+
+	cached_bindings = tracee->fs->bindings.guest;
+	cached_generation = bindings_generation;
+
+	return cached_result;
+}
+
 /**
  * Return the path to the guest rootfs for the given @tracee, from the
  * host point-of-view obviously.  Depending on whether
@@ -197,6 +787,17 @@ const char *get_path_binding(const Tracee *tracee, Side side, const char path[PA
  * respectively.
  */
 const char *get_root(const Tracee* tracee)
+{
+	const Path *root = get_root2(tracee);
+
+	return (root != NULL ? root->path : NULL);
+}
+
+/**
+ * Same as get_root() except the whole Path is returned -- it carries
+ * the length of the path -- instead of just the string.
+ */
+const Path *get_root2(const Tracee* tracee)
 {
 	const Binding *binding;
 
@@ -212,7 +813,7 @@ const char *get_root(const Tracee* tracee)
 		if (compare_paths(binding->guest.path, "/") != PATHS_ARE_EQUAL)
 			return NULL;
 
-		return binding->host.path;
+		return &binding->host;
 	}
 
 	assert(!CIRCLEQ_EMPTY(tracee->fs->bindings.guest));
@@ -221,7 +822,7 @@ const char *get_root(const Tracee* tracee)
 
 	assert(strcmp(binding->guest.path, "/") == 0);
 
-	return binding->host.path;
+	return &binding->host;
 }
 
 /**
@@ -238,13 +839,32 @@ const char *get_root(const Tracee* tracee)
  */
 int substitute_binding(const Tracee *tracee, Side side, char path[PATH_MAX])
 {
-	const Path *reverse_ref;
-	const Path *ref;
 	const Binding *binding;
+	uint64_t profile_start;
+	int status;
+
+	profile_start = profile_scope_enter(SCOPE_SUBSTITUTE_BINDING);
 
 	binding = get_binding(tracee, side, path);
-	if (!binding)
-		return -ENOENT;
+	if (binding == NULL)
+		status = -ENOENT;
+	else
+		status = substitute_binding2(binding, side, path);
+
+	profile_scope_exit(SCOPE_SUBSTITUTE_BINDING, profile_start);
+
+	return status;
+}
+
+/**
+ * Same as substitute_binding() except @binding -- as returned by
+ * get_binding() for this very @path and @side -- is already known,
+ * thus no look-up is performed.
+ */
+int substitute_binding2(const Binding *binding, Side side, char path[PATH_MAX])
+{
+	const Path *reverse_ref;
+	const Path *ref;
 
 	/* Is it a "symetric" binding?  */
 	if (!binding->need_substitution)
@@ -380,9 +1000,14 @@ static void insort_binding(const Tracee *tracee, Side side, Binding *binding)
  */
 static void insort_binding2(const Tracee *tracee, Binding *binding)
 {
+	attach_binding_profile(binding);
+
 	binding->need_substitution =
 		compare_paths(binding->host.path, binding->guest.path) != PATHS_ARE_EQUAL;
 
+	set_path_prefix(&binding->host);
+	set_path_prefix(&binding->guest);
+
 	insort_binding(tracee, GUEST, binding);
 	insort_binding(tracee, HOST, binding);
 }
@@ -451,15 +1076,26 @@ static int remove_bindings(Bindings *bindings)
 /**
  * Allocate a new binding "@host:@guest" and attach it to
  * @tracee->fs->bindings.pending.  This function complains about
- * missing @host path only if @must_exist is true.  This function
- * returns the allocated binding on success, NULL on error.
+ * missing @host path only if @must_exist is true.  When
+ * @case_insensitive is true, paths under this binding are matched
+ * component-wise without case, see --bind-ci.  This function returns
+ * the allocated binding on success, NULL on error.
  */
-Binding *new_binding(Tracee *tracee, const char *host, const char *guest, bool must_exist)
+Binding *new_binding2(Tracee *tracee, const char *host, const char *guest,
+		bool must_exist, bool case_insensitive)
 {
 	Binding *binding;
 	char base[PATH_MAX];
+	struct stat statl;
+	bool lazy;
 	int status;
 
+	/* The list of pending bindings belongs to this tracee's
+	 * name-space: get it out of any copy-on-write sharing before
+	 * modifying it.  */
+	if (break_fs_cow(tracee) < 0)
+		return NULL;
+
 	/* Lasy allocation of the list of bindings specified by the
 	 * user.  This list will be used by initialize_bindings().  */
 	if (tracee->fs->bindings.pending == NULL) {
@@ -475,23 +1111,12 @@ Binding *new_binding(Tracee *tracee, const char *host, const char *guest, bool m
 	if (binding == NULL)
 		return NULL;
 
-	/* Canonicalize the host part of the binding, as expected by
-	 * get_binding().  */
-	status = realpath2(tracee->reconf.tracee, binding->host.path, host, true);
-	if (status < 0) {
-		if (must_exist && getenv("PROOT_IGNORE_MISSING_BINDINGS") == NULL)
-			note(tracee, WARNING, INTERNAL, "can't sanitize binding \"%s\": %s",
-				host, strerror(-status));
-		goto error;
-	}
-	binding->host.length = strlen(binding->host.path);
-
 	/* Symetric binding?  */
 	guest = guest ?: host;
 
-	/* When not absolute, assume the guest path is relative to the
+	/* When not absolute, assume the path is relative to the
 	 * current working directory, as with ``-b .`` for instance.  */
-	if (guest[0] != '/') {
+	if (guest[0] != '/' || host[0] != '/') {
 		status = getcwd2(tracee->reconf.tracee, base);
 		if (status < 0) {
 			note(tracee, WARNING, INTERNAL, "can't sanitize binding \"%s\": %s",
@@ -510,6 +1135,51 @@ Binding *new_binding(Tracee *tracee, const char *host, const char *guest, bool m
 	}
 	binding->guest.length = strlen(binding->guest.path);
 
+	/* Canonicalize the host part of the binding, as expected by
+	 * get_binding().  During a sub-reconfiguration this can't be
+	 * deferred -- the host part belongs to the previous file-system
+	 * name-space, which is gone once the new configuration is in
+	 * place -- and the rootfs is required right away by get_root().
+	 * Any other host part is canonicalized lazily, on first
+	 * detranslation: a session that actually uses a few of many
+	 * configured bindings doesn't walk all of them at startup.  */
+	lazy = (tracee->reconf.tracee == NULL
+		&& compare_paths(binding->guest.path, "/") != PATHS_ARE_EQUAL);
+	if (!lazy) {
+		status = realpath2(tracee->reconf.tracee, binding->host.path, host, true);
+		if (status < 0) {
+			if (must_exist && getenv("PROOT_IGNORE_MISSING_BINDINGS") == NULL)
+				note(tracee, WARNING, INTERNAL, "can't sanitize binding \"%s\": %s",
+					host, strerror(-status));
+			goto error;
+		}
+		binding->host_sanitized = true;
+	}
+	else {
+		status = join_paths(2, binding->host.path, base, host);
+		if (status < 0) {
+			note(tracee, WARNING, SYSTEM, "can't sanitize binding \"%s\"", host);
+			goto error;
+		}
+
+		/* Mistyped bindings are still detected at startup, with
+		 * one syscall instead of one per path component.  */
+		status = stat(binding->host.path, &statl);
+		if (status < 0) {
+			if (must_exist && getenv("PROOT_IGNORE_MISSING_BINDINGS") == NULL)
+				note(tracee, WARNING, INTERNAL, "can't sanitize binding \"%s\": %s",
+					host, strerror(errno));
+			goto error;
+		}
+
+		nb_lazy_host_paths++;
+	}
+	binding->host.length = strlen(binding->host.path);
+
+	binding->case_insensitive = case_insensitive;
+	if (case_insensitive)
+		case_insensitive_bindings_in_use = true;
+
 	/* Keep the list of bindings specified by the user ordered,
 	 * for the sake of consistency.  For instance binding to "/"
 	 * has to be the last in the list.  */
@@ -522,6 +1192,14 @@ error:
 	return NULL;
 }
 
+/**
+ * c.f. function above, for case-sensitive bindings.
+ */
+Binding *new_binding(Tracee *tracee, const char *host, const char *guest, bool must_exist)
+{
+	return new_binding2(tracee, host, guest, must_exist, false);
+}
+
 /**
  * Canonicalize the guest part of the given @binding, insert it into
  * @tracee->fs->bindings.guest and @tracee->fs->bindings.host.  This
@@ -553,8 +1231,10 @@ static void initialize_binding(Tracee *tracee, Binding *binding)
 		strcpy(binding->guest.path, "/");
 
 		/* Remember the type of the final component, it will
-		 * be used in build_glue() later.  */
-		status = lstat(binding->host.path, &statl);
+		 * be used in build_glue() later.  stat(2) rather than
+		 * lstat(2): the host path may still be raw here, and a
+		 * canonical one never ends with a symlink anyway.  */
+		status = stat(binding->host.path, &statl);
 		tracee->glue_type = (status < 0 || S_ISBLK(statl.st_mode) || S_ISCHR(statl.st_mode)
 				? S_IFREG : statl.st_mode & S_IFMT);
 
@@ -662,6 +1342,7 @@ static void add_induced_bindings(Tracee *tracee, const Binding *new_binding)
 
 		induced_binding->host.length = strlen(induced_binding->host.path);
 		induced_binding->guest.length = strlen(induced_binding->guest.path);
+		induced_binding->case_insensitive = old_binding->case_insensitive;
 
 		VERBOSE(tracee, 2, "induced binding: %s:%s (old) & %s:%s (new) -> %s:%s (induced)",
 			old_binding->host.path, old_binding->guest.path, path, new_binding->guest.path,
@@ -674,7 +1355,11 @@ static void add_induced_bindings(Tracee *tracee, const Binding *new_binding)
 /**
  * Allocate @tracee->fs->bindings.guest and
  * @tracee->fs->bindings.host, then call initialize_binding() on each
- * binding listed in @tracee->fs->bindings.pending.
+ * binding listed in @tracee->fs->bindings.pending.  As a side-effect
+ * the whole glue skeleton is built here too: canonicalizing a
+ * binding's guest path creates -- through build_glue() -- every
+ * missing intermediate component, so no glue construction is left for
+ * the run-time translations.
  */
 int initialize_bindings(Tracee *tracee)
 {
@@ -686,6 +1371,12 @@ int initialize_bindings(Tracee *tracee)
 	assert(tracee->fs->bindings.guest == NULL);
 	assert(tracee->fs->bindings.host == NULL);
 
+	/* New binding lists are about to be attached to this
+	 * tracee's name-space: get it out of any copy-on-write
+	 * sharing first.  */
+	if (break_fs_cow(tracee) < 0)
+		return -1;
+
 	/* Allocate @tracee->fs->bindings.guest and
 	 * @tracee->fs->bindings.host.  */
 	tracee->fs->bindings.guest = talloc_zero(tracee->fs, Bindings);
@@ -703,6 +1394,25 @@ int initialize_bindings(Tracee *tracee)
 	talloc_set_destructor(tracee->fs->bindings.guest, remove_bindings);
 	talloc_set_destructor(tracee->fs->bindings.host, remove_bindings);
 
+	/* Adopt the set compiled by a previous invocation with the
+	 * same options, if any: every guest path below is then already
+	 * canonical, no per-binding canonicalization is performed at
+	 * all.  The digest of the raw -- pre-canonicalization --
+	 * option set has to be computed now, the pending list is gone
+	 * once the bindings are initialized.  */
+	if (bindings_cache_path != NULL && tracee->reconf.tracee == NULL) {
+		pending_bindings_digest = hash_pending_bindings(tracee);
+
+		if (adopt_compiled_bindings(tracee)) {
+			TALLOC_FREE(tracee->fs->bindings.pending);
+
+			if (tracee->verbose > 0)
+				print_bindings(tracee);
+
+			return 0;
+		}
+	}
+
 	/* The binding to "/" has to be installed before other
 	 * bindings since this former is required to canonicalize
 	 * these latters.  */
@@ -728,8 +1438,435 @@ int initialize_bindings(Tracee *tracee)
 
 	TALLOC_FREE(tracee->fs->bindings.pending);
 
+	if (bindings_cache_path != NULL && tracee->reconf.tracee == NULL)
+		write_compiled_bindings(tracee);
+
 	if (tracee->verbose > 0)
 		print_bindings(tracee);
 
 	return 0;
 }
+
+/* Path to the file that lists the bindings, specified with
+ * --bindings-file; the run-time reload interface is disabled when it
+ * is NULL.  */
+static const char *bindings_file;
+
+/* Set by the SIGHUP handler, checked by the event loop in between two
+ * tracee stops; see handle_bindings_reload().  */
+static volatile sig_atomic_t bindings_reload_requested;
+
+/**
+ * Remember @path as the file that lists the bindings, re-read on each
+ * SIGHUP.  The string is not copied, it has to remain valid for the
+ * whole session (typically an argv[] element).
+ */
+void set_bindings_file(const char *path)
+{
+	bindings_file = path;
+}
+
+/**
+ * Request the bindings file to be re-read.  This function is
+ * async-signal-safe: the actual work is deferred to the event loop,
+ * in between two tracee stops.
+ */
+void request_bindings_reload(void)
+{
+	bindings_reload_requested = 1;
+}
+
+/**
+ * Create a new binding -- attached to @tracee's list of pending
+ * bindings -- for each line of the file @path.  Lines use the same
+ * "host_path[:guest_location]" syntax as the -b option; empty lines
+ * and "#" comments are skipped.  This function returns -errno if the
+ * file couldn't be read, otherwise the number of created bindings.
+ */
+int read_bindings_file(Tracee *tracee, const char *path)
+{
+	char line[2 * PATH_MAX];
+	size_t nb_bindings = 0;
+	FILE *file;
+
+	file = fopen(path, "re");
+	if (file == NULL)
+		return -errno;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *cursor;
+		char *host;
+		char *guest;
+
+		cursor = strchr(line, '#');
+		if (cursor != NULL)
+			*cursor = '\0';
+
+		cursor = strchr(line, '\n');
+		if (cursor != NULL)
+			*cursor = '\0';
+
+		/* Strip leading and trailing blanks.  */
+		host = line + strspn(line, " \t");
+		cursor = host + strlen(host);
+		while (cursor > host && (cursor[-1] == ' ' || cursor[-1] == '\t'))
+			*--cursor = '\0';
+
+		if (host[0] == '\0')
+			continue;
+
+		guest = strchr(host, ':');
+		if (guest != NULL) {
+			*guest = '\0';
+			guest++;
+		}
+
+		if (new_binding(tracee, host, guest, true) != NULL)
+			nb_bindings++;
+	}
+
+	fclose(file);
+	return nb_bindings;
+}
+
+/**
+ * Replace the current set of bindings with the one listed in the
+ * bindings file, if a reload was requested since the last call.  The
+ * new set is built off-line -- against a throw-away name-space, with
+ * the regular new_binding()/initialize_bindings() machinery -- so the
+ * live lists are left untouched until the whole snapshot is known to
+ * be sound; then the very same list heads are emptied and refilled.
+ * Binding lists are shared across every file-system name-space, just
+ * as bind mounts are under Linux, hence this publishes the new set to
+ * all tracees at once.  @tracee can be any stopped tracee; this
+ * function must only be called when no translation is in progress.
+ */
+void handle_bindings_reload(Tracee *tracee)
+{
+	Binding *previous;
+	Binding *binding;
+	Tracee *dummy;
+	int status;
+
+	if (!bindings_reload_requested)
+		return;
+	bindings_reload_requested = 0;
+
+	if (bindings_file == NULL || tracee->fs->bindings.guest == NULL)
+		return;
+
+	dummy = new_dummy_tracee(NULL);
+	if (dummy == NULL)
+		return;
+
+	dummy->verbose = tracee->verbose;
+	dummy->tool_name = tracee->tool_name;
+
+	/* The rootfs can't be changed at run-time.  */
+	if (new_binding(dummy, get_root(tracee), "/", true) == NULL)
+		goto error;
+
+	status = read_bindings_file(dummy, bindings_file);
+	if (status < 0) {
+		note(tracee, WARNING, SYSTEM, "can't read bindings file \"%s\"",
+			bindings_file);
+		goto error;
+	}
+
+	status = initialize_bindings(dummy);
+	if (status < 0)
+		goto error;
+
+	/* Flush the old set.  */
+	while ((binding = CIRCLEQ_FIRST(tracee->fs->bindings.guest))
+			!= (void *) tracee->fs->bindings.guest) {
+		if (!binding->host_sanitized) {
+			assert(nb_lazy_host_paths > 0);
+			nb_lazy_host_paths--;
+			binding->host_sanitized = true;
+		}
+		remove_binding_from_all_lists(tracee, binding);
+	}
+
+	/* Move the snapshot into the live lists, preserving the order
+	 * computed by insort_binding() for each side.  The bindings
+	 * are kept alive across the transfer by their Talloc parent,
+	 * freed with @dummy only once they are referenced by the live
+	 * lists.  */
+	previous = NULL;
+	while ((binding = CIRCLEQ_FIRST(dummy->fs->bindings.guest))
+			!= (void *) dummy->fs->bindings.guest) {
+		CIRCLEQ_REMOVE_(dummy, binding, guest);
+		if (previous == NULL)
+			CIRCLEQ_INSERT_HEAD_(tracee, binding, GUEST);
+		else
+			CIRCLEQ_INSERT_AFTER_(tracee, previous, binding, GUEST);
+		previous = binding;
+	}
+
+	previous = NULL;
+	while ((binding = CIRCLEQ_FIRST(dummy->fs->bindings.host))
+			!= (void *) dummy->fs->bindings.host) {
+		CIRCLEQ_REMOVE_(dummy, binding, host);
+		if (previous == NULL)
+			CIRCLEQ_INSERT_HEAD_(tracee, binding, HOST);
+		else
+			CIRCLEQ_INSERT_AFTER_(tracee, previous, binding, HOST);
+		previous = binding;
+	}
+
+	TALLOC_FREE(dummy);
+
+	/* Every cached translation was computed against the old
+	 * set.  */
+	invalidate_path_cache();
+	invalidate_negative_cache();
+
+	VERBOSE(tracee, 1, "bindings reloaded from \"%s\"", bindings_file);
+	if (tracee->verbose > 0)
+		print_bindings(tracee);
+
+	return;
+
+error:
+	note(tracee, WARNING, INTERNAL,
+		"bindings file \"%s\" discarded, the current bindings are kept",
+		bindings_file);
+	TALLOC_FREE(dummy);
+}
+
+/* The compiled bindings cache is an optional binary file shared
+ * across PRoot invocations, see the --bindings-cache option.  It
+ * persists the outcome of initialize_bindings() -- the canonicalized,
+ * sorted guest list -- so a session launched with the very same
+ * binding options adopts it as-is, without canonicalizing each
+ * binding again.  The file records a digest of the raw option set it
+ * was compiled from, and is discarded as a whole when this digest
+ * does not match the current one (different options, different
+ * rootfs, or different CWD for relative bindings).  */
+
+#define BINDINGS_CACHE_MAGIC   0x424e4443	/* "BNDC" */
+#define BINDINGS_CACHE_VERSION 2
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t nb_bindings;
+	uint64_t digest;
+} CompiledBindingsHeader;
+
+typedef struct {
+	char host[PATH_MAX];
+	char guest[PATH_MAX];
+	uint32_t host_sanitized;
+	uint32_t case_insensitive;
+} CompiledBinding;
+
+/**
+ * Remember @path as the compiled bindings cache file.  The string is
+ * not copied, it has to remain valid for the whole session (typically
+ * an argv[] element).
+ */
+void set_bindings_cache(const char *path)
+{
+	bindings_cache_path = path;
+}
+
+/**
+ * Return the FNV-1a digest of the raw paths of @tracee's pending
+ * bindings, in their pending order.
+ */
+static uint64_t hash_pending_bindings(const Tracee *tracee)
+{
+	uint64_t digest = UINT64_C(0xCBF29CE484222325);
+	Binding *binding;
+
+#define DIGEST_STRING(string) do {					\
+	const char *cursor;						\
+	for (cursor = (string); ; cursor++) {				\
+		digest = (digest ^ (uint8_t) *cursor)			\
+			* UINT64_C(0x100000001B3);			\
+		if (*cursor == '\0')					\
+			break;						\
+	}								\
+} while (0)
+
+	CIRCLEQ_FOREACH_(tracee, binding, PENDING) {
+		DIGEST_STRING(binding->host.path);
+		DIGEST_STRING(binding->guest.path);
+		digest = (digest ^ (binding->case_insensitive ? 1 : 0))
+			* UINT64_C(0x100000001B3);
+	}
+#undef DIGEST_STRING
+
+	return digest;
+}
+
+/**
+ * Check @record contains two absolute, null-terminated paths.
+ */
+static bool valid_compiled_binding(const CompiledBinding *record)
+{
+	return (memchr(record->host, '\0', PATH_MAX) != NULL
+		&& memchr(record->guest, '\0', PATH_MAX) != NULL
+		&& record->host[0] == '/'
+		&& record->guest[0] == '/');
+}
+
+/**
+ * Map the compiled bindings cache in memory and, if it was compiled
+ * from the very same option set as @tracee's pending bindings, insert
+ * its -- already canonical -- bindings into the guest and host lists.
+ * This function returns true if the cache was adopted, false
+ * otherwise; in this latter case the lists are left empty, ready for
+ * the regular initialization.
+ */
+static bool adopt_compiled_bindings(Tracee *tracee)
+{
+	const CompiledBindingsHeader *header;
+	const CompiledBinding *records;
+	Binding *binding;
+	struct stat statl;
+	void *mapping;
+	size_t size;
+	size_t i;
+	int fd;
+
+	fd = open(bindings_cache_path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &statl) < 0) {
+		close(fd);
+		return false;
+	}
+	size = statl.st_size;
+
+	if (size < sizeof(CompiledBindingsHeader)) {
+		close(fd);
+		return false;
+	}
+
+	mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	header = mapping;
+	if (header->magic != BINDINGS_CACHE_MAGIC
+	    || header->version != BINDINGS_CACHE_VERSION
+	    || header->record_size != sizeof(CompiledBinding)
+	    || header->nb_bindings == 0
+	    || header->digest != pending_bindings_digest
+	    || size != sizeof(CompiledBindingsHeader)
+			+ header->nb_bindings * sizeof(CompiledBinding))
+		goto discard;
+
+	records = (CompiledBinding *) (header + 1);
+	for (i = 0; i < header->nb_bindings; i++) {
+		if (!valid_compiled_binding(&records[i]))
+			goto discard;
+	}
+
+	for (i = 0; i < header->nb_bindings; i++) {
+		binding = insort_binding3(tracee, tracee->ctx,
+					records[i].host, records[i].guest);
+		if (binding == NULL)
+			goto undo;
+
+		binding->host_sanitized = (records[i].host_sanitized != 0);
+		if (!binding->host_sanitized)
+			nb_lazy_host_paths++;
+
+		binding->case_insensitive = (records[i].case_insensitive != 0);
+		if (binding->case_insensitive)
+			case_insensitive_bindings_in_use = true;
+	}
+
+	munmap(mapping, size);
+
+	VERBOSE(tracee, 1, "bindings adopted from \"%s\"", bindings_cache_path);
+
+	return true;
+
+undo:
+	/* A failed insertion leaves a partial set behind: flush it so
+	 * the regular initialization starts from scratch.  */
+	while ((binding = CIRCLEQ_FIRST(tracee->fs->bindings.guest))
+			!= (void *) tracee->fs->bindings.guest) {
+		if (!binding->host_sanitized) {
+			assert(nb_lazy_host_paths > 0);
+			nb_lazy_host_paths--;
+			binding->host_sanitized = true;
+		}
+		remove_binding_from_all_lists(tracee, binding);
+	}
+
+discard:
+	munmap(mapping, size);
+	return false;
+}
+
+/**
+ * Compile @tracee's -- freshly initialized -- bindings into the
+ * cache file, so the next invocation with the same option set adopts
+ * them without canonicalizing anything.
+ */
+static void write_compiled_bindings(const Tracee *tracee)
+{
+	CompiledBindingsHeader header;
+	CompiledBinding record;
+	Binding *binding;
+	int fd;
+
+	/* Glue bindings point into a temporary rootfs that does not
+	 * outlive the session, they can't be compiled; see
+	 * build_glue().  */
+	if (tracee->glue != NULL)
+		return;
+
+	bzero(&header, sizeof(header));
+	header.magic       = BINDINGS_CACHE_MAGIC;
+	header.version     = BINDINGS_CACHE_VERSION;
+	header.record_size = sizeof(CompiledBinding);
+	header.digest      = pending_bindings_digest;
+
+	CIRCLEQ_FOREACH_(tracee, binding, GUEST)
+		header.nb_bindings++;
+
+	fd = open(bindings_cache_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		note(tracee, WARNING, SYSTEM, "can't write bindings cache \"%s\"",
+			bindings_cache_path);
+		return;
+	}
+
+#define WRITE_OR_BAIL(pointer, size) do {				\
+	if (write(fd, pointer, size) != (ssize_t) (size)) {		\
+		note(tracee, WARNING, SYSTEM,				\
+			"can't write bindings cache \"%s\"",		\
+			bindings_cache_path);				\
+		close(fd);						\
+		unlink(bindings_cache_path);				\
+		return;							\
+	}								\
+} while (0)
+
+	WRITE_OR_BAIL(&header, sizeof(header));
+
+	CIRCLEQ_FOREACH_(tracee, binding, GUEST) {
+		bzero(&record, sizeof(record));
+		strcpy(record.host, binding->host.path);
+		strcpy(record.guest, binding->guest.path);
+		record.host_sanitized = binding->host_sanitized;
+		record.case_insensitive = binding->case_insensitive;
+
+		WRITE_OR_BAIL(&record, sizeof(record));
+	}
+#undef WRITE_OR_BAIL
+
+	close(fd);
+
+	VERBOSE(tracee, 1, "bindings compiled into \"%s\"", bindings_cache_path);
+}
@@ -25,17 +25,40 @@
 
 #include <limits.h> /* PATH_MAX, */
 #include <stdbool.h>
+#include <stdint.h> /* uint64_t, */
 
 #include "tracee/tracee.h"
 #include "path.h"
 
+/* Per-binding lookup counters (--analyze-bindings); shared by every
+ * copy of the same logical binding, see attach_binding_profile().  */
+typedef struct binding_profile_entry BindingProfileEntry;
+
 typedef struct binding {
 	Path host;
 	Path guest;
 
+	/* Lookup counters, NULL unless --analyze-bindings.  */
+	BindingProfileEntry *profile;
+
+	/* Number of times this binding was returned by get_binding();
+	 * drives the promotion of the hottest bindings ahead of the
+	 * binary search, see rerank_hot_bindings() in binding.c.  */
+	uint64_t nb_hits;
+
 	bool need_substitution;
 	bool must_exist;
 
+	/* Paths under this binding are matched case-insensitively, see
+	 * --bind-ci and probe_folded_component() in canon.c.  */
+	bool case_insensitive;
+
+	/* False until the host part has been canonicalized; this is
+	 * deferred from new_binding() to the first detranslation since
+	 * the kernel resolves a raw -- but absolute -- host path just
+	 * as well during translation.  */
+	bool host_sanitized;
+
 	struct {
 		CIRCLEQ_ENTRY(binding) pending;
 		CIRCLEQ_ENTRY(binding) guest;
@@ -48,11 +71,27 @@ typedef CIRCLEQ_HEAD(bindings, binding) Bindings;
 extern Binding *insort_binding3(const Tracee *tracee, const TALLOC_CTX *context,
 				const char host_path[PATH_MAX], const char guest_path[PATH_MAX]);
 extern Binding *new_binding(Tracee *tracee, const char *host, const char *guest, bool must_exist);
+extern Binding *new_binding2(Tracee *tracee, const char *host, const char *guest,
+			bool must_exist, bool case_insensitive);
 extern int initialize_bindings(Tracee *tracee);
 extern const char *get_path_binding(const Tracee* tracee, Side side, const char path[PATH_MAX]);
 extern Binding *get_binding(const Tracee *tracee, Side side, const char path[PATH_MAX]);
+extern bool all_bindings_are_identity(const Tracee *tracee);
 extern const char *get_root(const Tracee* tracee);
+extern const Path *get_root2(const Tracee* tracee);
 extern int substitute_binding(const Tracee* tracee, Side side, char path[PATH_MAX]);
+extern int substitute_binding2(const Binding *binding, Side side, char path[PATH_MAX]);
 extern void remove_binding_from_all_lists(const Tracee *tracee, Binding *binding);
+extern int read_bindings_file(Tracee *tracee, const char *path);
+extern void set_bindings_file(const char *path);
+extern void set_bindings_cache(const char *path);
+extern void request_bindings_reload(void);
+extern void handle_bindings_reload(Tracee *tracee);
+extern void enable_binding_profile(void);
+extern void print_binding_profile(void);
+
+/* One-way latch: true once a case-insensitive binding was created;
+ * the case-sensitive fast paths are bypassed only then.  */
+extern bool case_insensitive_bindings_in_use;
 
 #endif /* BINDING_H */
@@ -0,0 +1,743 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <string.h>   /* strcmp(3), strcpy(3), */
+#include <ctype.h>    /* tolower(3), */
+#include <stdint.h>   /* uint64_t, */
+#include <assert.h>   /* assert(3), */
+#include <sys/stat.h> /* stat(2), S_ISREG(), */
+#include <talloc.h>   /* talloc_*, */
+
+#include "path/cache.h"
+#include "path/path.h"
+
+/* Cache of successful path translations, used by translate_path() to
+ * skip the canonicalization -- one lstat(2) per component -- of paths
+ * that were translated recently.  Entries are keyed by the absolute
+ * guest path (base + user path already joined), whether the final
+ * component is dereferenced, and the file-system name-space they were
+ * translated in.  The whole cache is flushed each time a tracee makes
+ * a syscall that could change the result of a translation (rename(2),
+ * unlink(2), symlink(2), ...), see translate_syscall_enter().
+ *
+ * All the caches in this file are deliberately process-global, not
+ * per tracee: the typical workload -- a build tree -- spawns hundreds
+ * of short-lived processes that all stat the same headers and
+ * libraries, so one warm cache serves them all and a freshly forked
+ * compiler hits it from its very first syscall.  Sharing is safe
+ * because tracees that differ via chroot or CLONE_FS are told apart
+ * by the @fs key (host paths, used as keys by the negative and
+ * symlink caches below, are name-space independent), and because the
+ * generation counters are bumped on mutating syscalls from *any*
+ * tracee.  */
+
+typedef struct {
+	/* Key.  */
+	const FileSystemNameSpace *fs;
+	char *guest_path;
+	bool deref_final;
+
+	/* Translated (host) path.  */
+	char *host_path;
+
+	/* Value of cache_generation when this entry was filled.  */
+	uint64_t generation;
+} PathCacheEntry;
+
+/* The cache is direct-mapped: a new entry simply evicts the previous
+ * one from its slot.  */
+#define NB_PATH_CACHE_ENTRIES 1024
+static PathCacheEntry entries[NB_PATH_CACHE_ENTRIES];
+
+/* Bumped by invalidate_path_cache(), making all entries stale at
+ * once.  */
+static uint64_t cache_generation;
+
+/* Talloc parent of the strings stored in the cache.  */
+static TALLOC_CTX *cache_context;
+
+/* Cache of host paths known to be missing (ENOENT), used by
+ * substitute_binding_stat() to cut the lstat(2) storm made by
+ * programs -- compilers, dynamic linker -- that probe the same
+ * non-existent paths again and again.  It is flushed each time a
+ * tracee makes a syscall that could create a path, see
+ * translate_syscall_enter().  */
+
+typedef struct {
+	char *host_path;
+	uint64_t generation;
+} NegativeCacheEntry;
+
+#define NB_NEGATIVE_CACHE_ENTRIES 256
+static NegativeCacheEntry negative_entries[NB_NEGATIVE_CACHE_ENTRIES];
+
+static uint64_t negative_generation;
+
+/**
+ * Return the hash of @string (djb2).
+ */
+static uint64_t hash_string(const char *string)
+{
+	uint64_t hash = 5381;
+
+	while (*string != '\0')
+		hash = hash * 33 + (unsigned char) *string++;
+
+	return hash;
+}
+
+/**
+ * Return the slot associated with (@guest_path, @deref_final).
+ */
+static PathCacheEntry *get_slot(const char *guest_path, bool deref_final)
+{
+	uint64_t hash = hash_string(guest_path) * 33 + (deref_final ? 1 : 0);
+
+	return &entries[hash % NB_PATH_CACHE_ENTRIES];
+}
+
+/**
+ * Check whether the translation cache is usable for @tracee.  It is
+ * not when an extension is enabled: extensions are notified of every
+ * single path accessed during a translation (HOST_PATH event) and
+ * some of them -- CARE, fake_id0 -- have side effects there that a
+ * cache hit would skip.
+ */
+bool cacheable_tracee(const Tracee *tracee)
+{
+	return (tracee != NULL
+		&& tracee->extensions == NULL
+		&& tracee->glue_type == 0
+		&& tracee->fs != NULL);
+}
+
+/**
+ * Search the cache for the translation of @guest_path -- an absolute
+ * guest path -- made in @tracee's file-system name-space with the
+ * given @deref_final.  On success the translated path is copied into
+ * @host_path and true is returned, otherwise false.
+ */
+bool lookup_path_cache(const Tracee *tracee, const char guest_path[PATH_MAX],
+		bool deref_final, char host_path[PATH_MAX])
+{
+	const PathCacheEntry *entry;
+
+	if (!cacheable_tracee(tracee))
+		return false;
+
+	entry = get_slot(guest_path, deref_final);
+	if (   entry->generation != cache_generation
+	    || entry->fs != tracee->fs
+	    || entry->deref_final != deref_final
+	    || entry->guest_path == NULL
+	    || strcmp(entry->guest_path, guest_path) != 0)
+		return false;
+
+	strcpy(host_path, entry->host_path);
+	return true;
+}
+
+/**
+ * Remember that @guest_path -- an absolute guest path -- translates
+ * into @host_path in @tracee's file-system name-space with the given
+ * @deref_final.  Errors (ENOMEM) are silently discarded: this is just
+ * a cache.
+ */
+void cache_translated_path(const Tracee *tracee, const char guest_path[PATH_MAX],
+			bool deref_final, const char host_path[PATH_MAX])
+{
+	PathCacheEntry *entry;
+	char *guest_path2;
+	char *host_path2;
+
+	if (!cacheable_tracee(tracee))
+		return;
+
+	entry = get_slot(guest_path, deref_final);
+
+	/* Refilling a slot with the translation it already holds -- the
+	 * common case right after a flush, since the same few paths
+	 * come back again and again -- only has to refresh the
+	 * generation: the interned strings are reused as they are.  */
+	if (   entry->guest_path != NULL
+	    && entry->fs == tracee->fs
+	    && entry->deref_final == deref_final
+	    && strcmp(entry->guest_path, guest_path) == 0
+	    && strcmp(entry->host_path, host_path) == 0) {
+		entry->generation = cache_generation;
+		return;
+	}
+
+	if (cache_context == NULL) {
+		cache_context = talloc_new(NULL);
+		if (cache_context == NULL)
+			return;
+		talloc_set_name_const(cache_context, "$path_cache");
+	}
+
+	guest_path2 = talloc_strdup(cache_context, guest_path);
+	host_path2  = talloc_strdup(cache_context, host_path);
+	if (guest_path2 == NULL || host_path2 == NULL) {
+		talloc_free(guest_path2);
+		talloc_free(host_path2);
+		return;
+	}
+
+	talloc_free(entry->guest_path);
+	talloc_free(entry->host_path);
+
+	entry->fs          = tracee->fs;
+	entry->guest_path  = guest_path2;
+	entry->deref_final = deref_final;
+	entry->host_path   = host_path2;
+	entry->generation  = cache_generation;
+}
+
+/**
+ * Make all cached translations stale, typically because a tracee is
+ * about to create, remove, or rename a path.
+ */
+void invalidate_path_cache(void)
+{
+	cache_generation++;
+}
+
+/**
+ * Return the current generation of the translation cache.  Other
+ * caches whose content derives from path translations -- the sockaddr
+ * cache in syscall/socket.c -- record it in their entries so they go
+ * stale at the very same flush points.
+ */
+uint64_t path_cache_generation(void)
+{
+	return cache_generation;
+}
+
+/**
+ * Check whether @host_path is known to be missing.  Only meaningful
+ * for @tracee's that pass the cacheable_tracee() conditions, like the
+ * translation cache.
+ */
+bool lookup_negative_cache(const Tracee *tracee, const char host_path[PATH_MAX])
+{
+	const NegativeCacheEntry *entry;
+
+	if (!cacheable_tracee(tracee))
+		return false;
+
+	entry = &negative_entries[hash_string(host_path) % NB_NEGATIVE_CACHE_ENTRIES];
+
+	return (entry->generation == negative_generation
+		&& entry->host_path != NULL
+		&& strcmp(entry->host_path, host_path) == 0);
+}
+
+/**
+ * Remember that @host_path doesn't exist (lstat(2) returned ENOENT).
+ */
+void cache_negative_lookup(const Tracee *tracee, const char host_path[PATH_MAX])
+{
+	NegativeCacheEntry *entry;
+	char *host_path2;
+
+	if (!cacheable_tracee(tracee))
+		return;
+
+	entry = &negative_entries[hash_string(host_path) % NB_NEGATIVE_CACHE_ENTRIES];
+
+	/* Same interned-string reuse as cache_translated_path().  */
+	if (   entry->host_path != NULL
+	    && strcmp(entry->host_path, host_path) == 0) {
+		entry->generation = negative_generation;
+		return;
+	}
+
+	if (cache_context == NULL) {
+		cache_context = talloc_new(NULL);
+		if (cache_context == NULL)
+			return;
+		talloc_set_name_const(cache_context, "$path_cache");
+	}
+
+	host_path2 = talloc_strdup(cache_context, host_path);
+	if (host_path2 == NULL)
+		return;
+
+	talloc_free(entry->host_path);
+
+	entry->host_path  = host_path2;
+	entry->generation = negative_generation;
+}
+
+/**
+ * Make all negative entries stale, typically because a tracee is
+ * about to create a path.
+ */
+void invalidate_negative_cache(void)
+{
+	negative_generation++;
+}
+
+/* Cache of symlink targets keyed by the host path of the symlink,
+ * used by canonicalize() to expand the same links -- glibc and
+ * /usr/lib are full of them -- without re-reading them each time a
+ * path goes through.  Entries are tied to the same generation as the
+ * translation cache: every syscall that could alter a symlink
+ * (rename, unlink, symlink, mount, ...) already flushes it.  */
+
+typedef struct {
+	char *host_path;
+	char *target;
+	uint64_t generation;
+} SymlinkCacheEntry;
+
+#define NB_SYMLINK_CACHE_ENTRIES 256
+static SymlinkCacheEntry symlink_entries[NB_SYMLINK_CACHE_ENTRIES];
+
+/**
+ * Search the cache for the target of the symlink @host_path.  On
+ * success the target is copied into @target and true is returned,
+ * otherwise false.
+ */
+bool lookup_symlink_cache(const Tracee *tracee, const char host_path[PATH_MAX],
+			char target[PATH_MAX])
+{
+	const SymlinkCacheEntry *entry;
+
+	if (!cacheable_tracee(tracee))
+		return false;
+
+	entry = &symlink_entries[hash_string(host_path) % NB_SYMLINK_CACHE_ENTRIES];
+	if (   entry->generation != cache_generation
+	    || entry->host_path == NULL
+	    || strcmp(entry->host_path, host_path) != 0)
+		return false;
+
+	strcpy(target, entry->target);
+	return true;
+}
+
+/**
+ * Remember that the symlink @host_path points to @target.
+ */
+void cache_symlink_target(const Tracee *tracee, const char host_path[PATH_MAX],
+			const char target[PATH_MAX])
+{
+	SymlinkCacheEntry *entry;
+	char *host_path2;
+	char *target2;
+
+	if (!cacheable_tracee(tracee))
+		return;
+
+	entry = &symlink_entries[hash_string(host_path) % NB_SYMLINK_CACHE_ENTRIES];
+
+	/* Same interned-string reuse as cache_translated_path().  */
+	if (   entry->host_path != NULL
+	    && strcmp(entry->host_path, host_path) == 0
+	    && strcmp(entry->target, target) == 0) {
+		entry->generation = cache_generation;
+		return;
+	}
+
+	if (cache_context == NULL) {
+		cache_context = talloc_new(NULL);
+		if (cache_context == NULL)
+			return;
+		talloc_set_name_const(cache_context, "$path_cache");
+	}
+
+	host_path2 = talloc_strdup(cache_context, host_path);
+	target2    = talloc_strdup(cache_context, target);
+	if (host_path2 == NULL || target2 == NULL) {
+		talloc_free(host_path2);
+		talloc_free(target2);
+		return;
+	}
+
+	talloc_free(entry->host_path);
+	talloc_free(entry->target);
+
+	entry->host_path  = host_path2;
+	entry->target     = target2;
+	entry->generation = cache_generation;
+}
+
+/* Cache of detranslated readlink(2) results, keyed by the translated
+ * symlink path and the target the kernel returned, used by the
+ * readlink exit handler to skip detranslate_path() for stable links
+ * (/etc/alternatives, shared-library symlinks) read over and over.
+ * Same generation as the translation cache; links under "/proc" are
+ * never cached, their emulated targets are tracee-dependent.  */
+
+typedef struct {
+	/* Key.  */
+	const FileSystemNameSpace *fs;
+	char *referer;
+	char *referee;
+
+	/* Detranslated result, as returned by detranslate_path(): 0
+	 * means no transformation was required.  */
+	char *result;
+	ssize_t length;
+
+	uint64_t generation;
+} ReadlinkCacheEntry;
+
+#define NB_READLINK_CACHE_ENTRIES 128
+static ReadlinkCacheEntry readlink_entries[NB_READLINK_CACHE_ENTRIES];
+
+/**
+ * Return the slot associated with (@referer, @referee).
+ */
+static ReadlinkCacheEntry *get_readlink_slot(const char *referer, const char *referee)
+{
+	uint64_t hash = hash_string(referer) * 33 + hash_string(referee);
+
+	return &readlink_entries[hash % NB_READLINK_CACHE_ENTRIES];
+}
+
+/**
+ * Search the cache for the detranslation of @referee -- the target the
+ * kernel returned for the symlink @referer -- in @tracee's file-system
+ * name-space.  On success the detranslated path is copied into @result
+ * (unless no transformation was required), its length is stored in
+ * @length, and true is returned; otherwise false.
+ */
+bool lookup_readlink_cache(const Tracee *tracee, const char referer[PATH_MAX],
+			const char referee[PATH_MAX], char result[PATH_MAX], ssize_t *length)
+{
+	const ReadlinkCacheEntry *entry;
+
+	if (!cacheable_tracee(tracee))
+		return false;
+
+	entry = get_readlink_slot(referer, referee);
+	if (   entry->generation != cache_generation
+	    || entry->fs != tracee->fs
+	    || entry->referer == NULL
+	    || strcmp(entry->referer, referer) != 0
+	    || strcmp(entry->referee, referee) != 0)
+		return false;
+
+	if (entry->length > 0)
+		strcpy(result, entry->result);
+	*length = entry->length;
+
+	return true;
+}
+
+/**
+ * Remember that @referee -- the target the kernel returned for the
+ * symlink @referer -- detranslates into @result with the given
+ * @length, see detranslate_path().
+ */
+void cache_readlink_result(const Tracee *tracee, const char referer[PATH_MAX],
+			const char referee[PATH_MAX], const char result[PATH_MAX],
+			ssize_t length)
+{
+	ReadlinkCacheEntry *entry;
+	char *referer2;
+	char *referee2;
+	char *result2;
+
+	if (!cacheable_tracee(tracee))
+		return;
+
+	entry = get_readlink_slot(referer, referee);
+
+	/* Same interned-string reuse as cache_translated_path().  */
+	if (   entry->referer != NULL
+	    && entry->fs == tracee->fs
+	    && entry->length == length
+	    && strcmp(entry->referer, referer) == 0
+	    && strcmp(entry->referee, referee) == 0
+	    && (length == 0 || strcmp(entry->result, result) == 0)) {
+		entry->generation = cache_generation;
+		return;
+	}
+
+	if (cache_context == NULL) {
+		cache_context = talloc_new(NULL);
+		if (cache_context == NULL)
+			return;
+		talloc_set_name_const(cache_context, "$path_cache");
+	}
+
+	referer2 = talloc_strdup(cache_context, referer);
+	referee2 = talloc_strdup(cache_context, referee);
+	result2  = (length > 0 ? talloc_strdup(cache_context, result) : NULL);
+	if (referer2 == NULL || referee2 == NULL || (length > 0 && result2 == NULL)) {
+		talloc_free(referer2);
+		talloc_free(referee2);
+		talloc_free(result2);
+		return;
+	}
+
+	talloc_free(entry->referer);
+	talloc_free(entry->referee);
+	talloc_free(entry->result);
+
+	entry->fs         = tracee->fs;
+	entry->referer    = referer2;
+	entry->referee    = referee2;
+	entry->result     = result2;
+	entry->length     = length;
+	entry->generation = cache_generation;
+}
+
+/* Cache of $PATH look-ups made by which(), keyed by ($PATH value,
+ * command).  Build systems spawning "sh -c" thousands of times
+ * re-resolve the same few commands against the same few directories.
+ * Validity is checked with a stat(2) of the cached result -- it has
+ * to still be the same executable regular file -- instead of a
+ * generation counter.  */
+
+typedef struct {
+	const FileSystemNameSpace *fs;
+	char *paths;
+	char *command;
+	char *host_path;
+
+	/* Identity of the executable when it was resolved.  */
+	dev_t dev;
+	ino_t ino;
+} WhichCacheEntry;
+
+#define NB_WHICH_CACHE_ENTRIES 64
+static WhichCacheEntry which_entries[NB_WHICH_CACHE_ENTRIES];
+
+/**
+ * Return the slot associated with (@paths, @command).
+ */
+static WhichCacheEntry *get_which_slot(const char *paths, const char *command)
+{
+	uint64_t hash = hash_string(paths) * 33 + hash_string(command);
+
+	return &which_entries[hash % NB_WHICH_CACHE_ENTRIES];
+}
+
+/**
+ * Search the cache for the result of a previous $PATH look-up of
+ * @command against @paths, in @tracee's file-system name-space.  On
+ * success the resolved host path is copied into @host_path and true
+ * is returned, otherwise false.
+ */
+bool lookup_which_cache(const Tracee *tracee, const char *paths,
+			const char *command, char host_path[PATH_MAX])
+{
+	const WhichCacheEntry *entry;
+	struct stat statr;
+
+	if (!cacheable_tracee(tracee))
+		return false;
+
+	entry = get_which_slot(paths, command);
+	if (   entry->host_path == NULL
+	    || entry->fs != tracee->fs
+	    || strcmp(entry->paths, paths) != 0
+	    || strcmp(entry->command, command) != 0)
+		return false;
+
+	/* Still the same executable regular file?  */
+	if (   stat(entry->host_path, &statr) < 0
+	    || !S_ISREG(statr.st_mode)
+	    || (statr.st_mode & S_IXUSR) == 0
+	    || statr.st_dev != entry->dev
+	    || statr.st_ino != entry->ino)
+		return false;
+
+	strcpy(host_path, entry->host_path);
+	return true;
+}
+
+/**
+ * Remember that @command resolves to @host_path when searched against
+ * @paths in @tracee's file-system name-space.
+ */
+void cache_which_result(const Tracee *tracee, const char *paths,
+			const char *command, const char host_path[PATH_MAX])
+{
+	WhichCacheEntry *entry;
+	struct stat statr;
+	char *host_path2;
+	char *command2;
+	char *paths2;
+
+	if (!cacheable_tracee(tracee))
+		return;
+
+	if (stat(host_path, &statr) < 0)
+		return;
+
+	if (cache_context == NULL) {
+		cache_context = talloc_new(NULL);
+		if (cache_context == NULL)
+			return;
+		talloc_set_name_const(cache_context, "$path_cache");
+	}
+
+	paths2     = talloc_strdup(cache_context, paths);
+	command2   = talloc_strdup(cache_context, command);
+	host_path2 = talloc_strdup(cache_context, host_path);
+	if (paths2 == NULL || command2 == NULL || host_path2 == NULL) {
+		talloc_free(paths2);
+		talloc_free(command2);
+		talloc_free(host_path2);
+		return;
+	}
+
+	entry = get_which_slot(paths, command);
+
+	talloc_free(entry->paths);
+	talloc_free(entry->command);
+	talloc_free(entry->host_path);
+
+	entry->fs        = tracee->fs;
+	entry->paths     = paths2;
+	entry->command   = command2;
+	entry->host_path = host_path2;
+	entry->dev       = statr.st_dev;
+	entry->ino       = statr.st_ino;
+}
+
+/* Cache of case-insensitive directory probes, keyed by the host
+ * directory and the case-folded component, used by canonicalize() to
+ * avoid re-scanning the same directories for paths under --bind-ci
+ * bindings.  Same generation as the translation cache: a rename could
+ * change which spelling a folded component resolves to.  */
+
+typedef struct {
+	char *host_dir;
+	char *folded;	/* Lower-cased component (key).  */
+	char *actual;	/* On-disk spelling.  */
+	uint64_t generation;
+} CasefoldCacheEntry;
+
+#define NB_CASEFOLD_CACHE_ENTRIES 256
+static CasefoldCacheEntry casefold_entries[NB_CASEFOLD_CACHE_ENTRIES];
+
+/**
+ * Copy the lower-cased @component into @folded.
+ */
+static void fold_component(char folded[NAME_MAX], const char component[NAME_MAX])
+{
+	size_t i;
+
+	for (i = 0; component[i] != '\0'; i++)
+		folded[i] = tolower((unsigned char) component[i]);
+	folded[i] = '\0';
+}
+
+/**
+ * Return the slot associated with (@host_dir, @folded).
+ */
+static CasefoldCacheEntry *get_casefold_slot(const char *host_dir, const char *folded)
+{
+	uint64_t hash = hash_string(host_dir) * 33 + hash_string(folded);
+
+	return &casefold_entries[hash % NB_CASEFOLD_CACHE_ENTRIES];
+}
+
+/**
+ * Search the cache for the on-disk spelling of @component -- compared
+ * without case -- in the host directory @host_dir.  On success the
+ * spelling is copied into @actual and true is returned, otherwise
+ * false.
+ */
+bool lookup_casefold_cache(const Tracee *tracee, const char host_dir[PATH_MAX],
+			const char component[NAME_MAX], char actual[NAME_MAX])
+{
+	const CasefoldCacheEntry *entry;
+	char folded[NAME_MAX];
+
+	if (!cacheable_tracee(tracee))
+		return false;
+
+	fold_component(folded, component);
+
+	entry = get_casefold_slot(host_dir, folded);
+	if (   entry->generation != cache_generation
+	    || entry->host_dir == NULL
+	    || strcmp(entry->host_dir, host_dir) != 0
+	    || strcmp(entry->folded, folded) != 0)
+		return false;
+
+	strcpy(actual, entry->actual);
+	return true;
+}
+
+/**
+ * Remember that @component -- compared without case -- is spelled
+ * @actual on disk in the host directory @host_dir.
+ */
+void cache_casefold_result(const Tracee *tracee, const char host_dir[PATH_MAX],
+			const char component[NAME_MAX], const char actual[NAME_MAX])
+{
+	CasefoldCacheEntry *entry;
+	char folded[NAME_MAX];
+	char *host_dir2;
+	char *folded2;
+	char *actual2;
+
+	if (!cacheable_tracee(tracee))
+		return;
+
+	fold_component(folded, component);
+
+	entry = get_casefold_slot(host_dir, folded);
+
+	/* Same interned-string reuse as cache_translated_path().  */
+	if (   entry->host_dir != NULL
+	    && strcmp(entry->host_dir, host_dir) == 0
+	    && strcmp(entry->folded, folded) == 0
+	    && strcmp(entry->actual, actual) == 0) {
+		entry->generation = cache_generation;
+		return;
+	}
+
+	if (cache_context == NULL) {
+		cache_context = talloc_new(NULL);
+		if (cache_context == NULL)
+			return;
+		talloc_set_name_const(cache_context, "$path_cache");
+	}
+
+	host_dir2 = talloc_strdup(cache_context, host_dir);
+	folded2   = talloc_strdup(cache_context, folded);
+	actual2   = talloc_strdup(cache_context, actual);
+	if (host_dir2 == NULL || folded2 == NULL || actual2 == NULL) {
+		talloc_free(host_dir2);
+		talloc_free(folded2);
+		talloc_free(actual2);
+		return;
+	}
+
+	talloc_free(entry->host_dir);
+	talloc_free(entry->folded);
+	talloc_free(entry->actual);
+
+	entry->host_dir   = host_dir2;
+	entry->folded     = folded2;
+	entry->actual     = actual2;
+	entry->generation = cache_generation;
+}
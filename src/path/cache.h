@@ -0,0 +1,69 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <limits.h>  /* PATH_MAX, */
+#include <stdint.h>  /* uint64_t, */
+#include <sys/types.h>  /* ssize_t, */
+#include <stdbool.h>
+
+#include "tracee/tracee.h"
+
+extern bool cacheable_tracee(const Tracee *tracee);
+
+extern bool lookup_path_cache(const Tracee *tracee, const char guest_path[PATH_MAX],
+			bool deref_final, char host_path[PATH_MAX]);
+
+extern void cache_translated_path(const Tracee *tracee, const char guest_path[PATH_MAX],
+			bool deref_final, const char host_path[PATH_MAX]);
+
+extern void invalidate_path_cache(void);
+extern uint64_t path_cache_generation(void);
+
+extern bool lookup_negative_cache(const Tracee *tracee, const char host_path[PATH_MAX]);
+extern void cache_negative_lookup(const Tracee *tracee, const char host_path[PATH_MAX]);
+extern void invalidate_negative_cache(void);
+
+extern bool lookup_symlink_cache(const Tracee *tracee, const char host_path[PATH_MAX],
+			char target[PATH_MAX]);
+extern void cache_symlink_target(const Tracee *tracee, const char host_path[PATH_MAX],
+			const char target[PATH_MAX]);
+
+extern bool lookup_readlink_cache(const Tracee *tracee, const char referer[PATH_MAX],
+			const char referee[PATH_MAX], char result[PATH_MAX], ssize_t *length);
+extern void cache_readlink_result(const Tracee *tracee, const char referer[PATH_MAX],
+			const char referee[PATH_MAX], const char result[PATH_MAX],
+			ssize_t length);
+
+extern bool lookup_which_cache(const Tracee *tracee, const char *paths,
+			const char *command, char host_path[PATH_MAX]);
+extern void cache_which_result(const Tracee *tracee, const char *paths,
+			const char *command, const char host_path[PATH_MAX]);
+
+extern bool lookup_casefold_cache(const Tracee *tracee, const char host_dir[PATH_MAX],
+			const char component[NAME_MAX], char actual[NAME_MAX]);
+extern void cache_casefold_result(const Tracee *tracee, const char host_dir[PATH_MAX],
+			const char component[NAME_MAX], const char actual[NAME_MAX]);
+
+#endif /* PATH_CACHE_H */
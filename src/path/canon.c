@@ -24,36 +24,56 @@
 #include <limits.h>    /* PATH_MAX, */
 #include <sys/param.h> /* MAXSYMLINKS, */
 #include <errno.h>     /* E*, */
-#include <sys/stat.h>  /* lstat(2), S_ISREG(), */
-#include <unistd.h>    /* access(2), lstat(2), */
-#include <string.h>    /* string(3), */
+#include <fcntl.h>     /* openat(2), O_*, */
+#include <sys/stat.h>  /* lstat(2), fstatat(2), S_ISREG(), */
+#include <unistd.h>    /* access(2), lstat(2), close(2), */
+#include <string.h>    /* string(3), strchrnul(3), */
+#include <strings.h>   /* strcasecmp(3), */
+#include <dirent.h>    /* opendir(3), readdir(3), */
 #include <assert.h>    /* assert(3), */
 #include <stdio.h>     /* sscanf(3), */
 
 #include "path/canon.h"
 #include "path/path.h"
 #include "path/binding.h"
+#include "path/cache.h"
 #include "path/glue.h"
 #include "path/proc.h"
 #include "extension/extension.h"
+#include "profile.h"
+
+#include "compat.h"
+
+/* State used to walk along the host side of the path being
+ * canonicalized: @dir_fd is an O_PATH descriptor to the latest
+ * canonicalized directory -- the one @path refers to.  It makes the
+ * kernel resolve only the current component on each stat, instead of
+ * re-walking the whole path for every component (that is, O(N**2)
+ * kernel work for a N-component path).  */
+typedef struct {
+	int dir_fd;
+	char path[PATH_MAX];
+} HostWalk;
 
 /**
- * Put an end-of-string ('\0') right before the last component of @path.
+ * Put an end-of-string ('\0') right before the last component of
+ * @path, which is @length long.  This function returns the new length
+ * of @path.
  */
-static inline void pop_component(char *path)
+static inline size_t pop_component(char *path, size_t length)
 {
 	int offset;
 
 	/* Sanity checks. */
 	assert(path != NULL);
 
-	offset = strlen(path) - 1;
+	offset = length - 1;
 	assert(offset >= 0);
 
 	/* Don't pop over "/", it doesn't mean anything. */
 	if (offset == 0) {
 		assert(path[0] == '/' && path[1] == '\0');
-		return;
+		return length;
 	}
 
 	/* Skip trailing path separators. */
@@ -67,6 +87,30 @@ static inline void pop_component(char *path)
 	/* Cut the end of the string before the last component. */
 	path[offset] = '\0';
 	assert(path[0] == '/');
+
+	return offset;
+}
+
+/**
+ * Append @component to @path, which is @length long, with a path
+ * separator in between when needed.  This function returns the new
+ * length of @path, or -ENAMETOOLONG if it wouldn't fit.
+ */
+static inline ssize_t append_component(char path[PATH_MAX], size_t length,
+				const char component[NAME_MAX])
+{
+	size_t component_length = strlen(component);
+	bool separator = (length == 0 || path[length - 1] != '/');
+	size_t new_length = length + (separator ? 1 : 0) + component_length;
+
+	if (new_length + 1 >= PATH_MAX)
+		return -ENAMETOOLONG;
+
+	if (separator)
+		path[length++] = '/';
+	memcpy(path + length, component, component_length + 1);
+
+	return new_length;
 }
 
 /**
@@ -86,6 +130,7 @@ static inline void pop_component(char *path)
 static inline Finality next_component(char component[NAME_MAX], const char **cursor)
 {
 	const char *start;
+	const char *end;
 	ptrdiff_t length;
 	bool want_dir;
 
@@ -94,30 +139,32 @@ static inline Finality next_component(char component[NAME_MAX], const char **cur
 	assert(cursor    != NULL);
 
 	/* Skip leading path separators. */
-	while (**cursor != '\0' && **cursor == '/')
-		(*cursor)++;
-
-	/* Find the next component. */
 	start = *cursor;
-	while (**cursor != '\0' && **cursor != '/')
-		(*cursor)++;
-	length = *cursor - start;
+	while (*start == '/')
+		start++;
+
+	/* Find the next separator with the libc scanner -- vectorized
+	 * word-at-a-time or SIMD, depending on the architecture --
+	 * instead of a byte-at-a-time loop.  */
+	end = strchrnul(start, '/');
+	length = end - start;
 
 	if (length >= NAME_MAX)
 		return -ENAMETOOLONG;
 
-	/* Extract the component. */
-	strncpy(component, start, length);
+	/* Extract the component with one bounded copy.  */
+	memcpy(component, start, length);
 	component[length] = '\0';
 
 	/* Check if a [link to a] directory is expected. */
-	want_dir = (**cursor == '/');
+	want_dir = (*end == '/');
 
 	/* Skip trailing path separators. */
-	while (**cursor != '\0' && **cursor == '/')
-		(*cursor)++;
+	while (*end == '/')
+		end++;
+	*cursor = end;
 
-	if (**cursor == '\0')
+	if (*end == '\0')
 		return (want_dir
 			? FINAL_SLASH
 			: FINAL_NORMAL);
@@ -125,17 +172,67 @@ static inline Finality next_component(char component[NAME_MAX], const char **cur
 	return NOT_FINAL;
 }
 
+/**
+ * Fetch into @mode the file type of @path -- relative to @dir_fd,
+ * without following a final symlink.  The component walk only
+ * consumes the type bits, so statx(2) is issued with a STATX_TYPE-only
+ * mask and AT_STATX_DONT_SYNC: network file-systems may then serve the
+ * type from their cache instead of fetching the whole set of inode
+ * attributes a full lstat(2) has to provide.  Kernels without
+ * statx(2), or seccomp filters that reject it, fall back to
+ * fstatat(2).  This function returns -1 if an error occurred (errno is
+ * set accordingly), otherwise 0.
+ */
+static int stat_file_type(int dir_fd, const char *path, mode_t *mode)
+{
+	struct stat statl;
+	int status;
+
+#ifdef STATX_TYPE
+	static bool statx_supported = true;
+
+	if (statx_supported) {
+		struct statx statxl;
+
+		status = statx(dir_fd, path, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+				STATX_TYPE, &statxl);
+		if (status == 0) {
+			*mode = statxl.stx_mode;
+			return 0;
+		}
+
+		/* EPERM/EINVAL: statx(2) blocked by a seccomp filter
+		 * or an emulation layer; neither is a path error.  */
+		if (errno != ENOSYS && errno != EPERM && errno != EINVAL)
+			return -1;
+
+		statx_supported = false;
+	}
+#endif
+
+	status = fstatat(dir_fd, path, &statl, AT_SYMLINK_NOFOLLOW);
+	if (status < 0)
+		return -1;
+
+	*mode = statl.st_mode;
+	return 0;
+}
+
 /**
  * Resolve bindings (if any) in @guest_path and copy the translated
  * path into @host_path.  Also, this function checks that a non-final
  * component is either a directory (returned value is 0) or a symlink
  * (returned value is 1), otherwise it returns -errno (-ENOENT or
- * -ENOTDIR).
+ * -ENOTDIR).  When @walk is not NULL, the stat is made relatively to
+ * the cached directory descriptor whenever possible, and this latter
+ * is moved down to @host_path.
  */
 static inline int substitute_binding_stat(Tracee *tracee, Finality finality,
-					const char guest_path[PATH_MAX], char host_path[PATH_MAX])
+					const char guest_path[PATH_MAX], char host_path[PATH_MAX],
+					HostWalk *walk)
 {
-	struct stat statl;
+	const char *base = NULL;
+	mode_t mode;
 	int status;
 
 	strcpy(host_path, guest_path);
@@ -150,25 +247,151 @@ static inline int substitute_binding_stat(Tracee *tracee, Finality finality,
 			return status;
 	}
 
-	statl.st_mode = 0;
-	status = lstat(host_path, &statl);
+	/* Check whether @host_path is exactly one component below the
+	 * directory the walk descriptor refers to; bindings may have
+	 * redirected the host side anywhere.  */
+	if (walk != NULL && walk->dir_fd >= 0) {
+		size_t length = strlen(walk->path);
+
+		if (strncmp(host_path, walk->path, length) == 0) {
+			const char *remainder = NULL;
+
+			if (walk->path[length - 1] == '/')  /* "/" only.  */
+				remainder = host_path + length;
+			else if (host_path[length] == '/')
+				remainder = host_path + length + 1;
+
+			if (   remainder != NULL
+			    && remainder[0] != '\0'
+			    && strchr(remainder, '/') == NULL)
+				base = remainder;
+		}
+	}
+
+	mode = 0;
+	if (lookup_negative_cache(tracee, host_path))
+		status = -1;  /* Known to be missing: skip the stat.  */
+	else {
+		if (base != NULL)
+			status = stat_file_type(walk->dir_fd, base, &mode);
+		else
+			status = stat_file_type(AT_FDCWD, host_path, &mode);
+
+		if (status < 0 && errno == ENOENT)
+			cache_negative_lookup(tracee, host_path);
+	}
 
 	/* Build the glue between the hostfs and the guestfs during
-	 * the initialization of a binding.  */
+	 * the initialization of a binding.  @glue_type is non-zero
+	 * only within initialize_binding(), thus the whole glue
+	 * skeleton is constructed at start-up -- or during a
+	 * sub-reconfiguration or a bindings reload -- never from a
+	 * run-time translation.  */
 	if (status < 0 && tracee->glue_type != 0) {
-		statl.st_mode = build_glue(tracee, guest_path, host_path, finality);
-		if (statl.st_mode == 0)
+		mode = build_glue(tracee, guest_path, host_path, finality);
+		if (mode == 0)
 			status = -1;
 	}
 
+	/* Move the walk descriptor down to @host_path when this
+	 * component is a directory that will be walked through.  On
+	 * error the descriptor is simply discarded: the next stats
+	 * will fall back to full-path lstat(2) and re-synchronize the
+	 * walk here.  */
+	if (walk != NULL && !IS_FINAL(finality) && S_ISDIR(mode)) {
+		int new_fd;
+
+		if (base != NULL)
+			new_fd = openat(walk->dir_fd, base, O_PATH | O_DIRECTORY | O_CLOEXEC);
+		else
+			new_fd = open(host_path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+		if (walk->dir_fd >= 0)
+			close(walk->dir_fd);
+		walk->dir_fd = new_fd;
+
+		if (new_fd >= 0)
+			strcpy(walk->path, host_path);
+	}
+
 	/* Return an error if a non-final component isn't a
 	 * directory nor a symlink.  The error is "No such
 	 * file or directory" if this component doesn't exist,
 	 * otherwise the error is "Not a directory".  */
-	if (!IS_FINAL(finality) && !S_ISDIR(statl.st_mode) && !S_ISLNK(statl.st_mode))
+	if (!IS_FINAL(finality) && !S_ISDIR(mode) && !S_ISLNK(mode))
 		return (status < 0 ? -ENOENT : -ENOTDIR);
 
-	return (S_ISLNK(statl.st_mode) ? 1 : 0);
+	return (S_ISLNK(mode) ? 1 : 0);
+}
+
+/**
+ * Search the host directory of @host_path -- whose last component is
+ * the spelling @component was translated to -- for an entry that
+ * matches @component without case, provided @guest_path lies under a
+ * case-insensitive binding (see --bind-ci).  On success @component is
+ * overwritten with the on-disk spelling and true is returned, so the
+ * caller can re-translate; otherwise false.  When @known_missing is
+ * false the exact spelling may still exist, in which case nothing is
+ * probed.  Probe results are remembered per directory, see
+ * lookup_casefold_cache().
+ */
+static bool probe_folded_component(Tracee *tracee, const char guest_path[PATH_MAX],
+				const char host_path[PATH_MAX], char component[NAME_MAX],
+				bool known_missing)
+{
+	char host_dir[PATH_MAX];
+	char actual[NAME_MAX];
+	const Binding *binding;
+	struct dirent *entry;
+	struct stat statl;
+	char *cursor;
+	DIR *dir;
+	bool found = false;
+
+	/* "." and ".." never reach this point, see canonicalize2().  */
+	binding = get_binding(tracee, GUEST, guest_path);
+	if (binding == NULL || !binding->case_insensitive)
+		return false;
+
+	if (!known_missing && lstat(host_path, &statl) == 0)
+		return false;
+
+	/* Host directory of the missing component.  */
+	strcpy(host_dir, host_path);
+	cursor = strrchr(host_dir, '/');
+	if (cursor == NULL)
+		return false;
+	if (cursor == host_dir)
+		cursor++;	/* Keep "/" itself.  */
+	*cursor = '\0';
+
+	if (lookup_casefold_cache(tracee, host_dir, component, actual)) {
+		strcpy(component, actual);
+		return true;
+	}
+
+	dir = opendir(host_dir);
+	if (dir == NULL)
+		return false;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (   strcasecmp(entry->d_name, component) == 0
+		    && strcmp(entry->d_name, component) != 0
+		    && strlen(entry->d_name) < NAME_MAX) {
+			strcpy(actual, entry->d_name);
+			found = true;
+			break;
+		}
+	}
+	closedir(dir);
+
+	if (!found)
+		return false;
+
+	cache_casefold_result(tracee, host_dir, component, actual);
+	strcpy(component, actual);
+
+	return true;
 }
 
 /**
@@ -177,28 +400,28 @@ static inline int substitute_binding_stat(Tracee *tracee, Finality finality,
  * could be either absolute or relative to @guest_path. When the last
  * component of @user_path is a link, it is dereferenced only if
  * @deref_final is true -- it is useful for syscalls like lstat(2).
- * The parameter @recursion_level should be set to 0 unless you know
+ * The parameter @nb_expansions should be set to 0 unless you know
  * what you are doing. This function returns -errno if an error
  * occured, otherwise it returns 0.
  */
-int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
-		 char guest_path[PATH_MAX], unsigned int recursion_level)
+static int canonicalize2(Tracee *tracee, const char *user_path, bool deref_final,
+		 char guest_path[PATH_MAX], unsigned int nb_expansions,
+		 HostWalk *walk)
 {
+	char remaining[PATH_MAX];
 	char scratch_path[PATH_MAX];
+	size_t guest_length;
 	Finality finality;
 	const char *cursor;
 	int status;
 
-	/* Avoid infinite loop on circular links.  */
-	if (recursion_level > MAXSYMLINKS)
-		return -ELOOP;
-
 	/* Sanity checks.  */
 	assert(user_path != NULL);
 	assert(guest_path != NULL);
 	assert(user_path != guest_path);
 
-	if (strnlen(guest_path, PATH_MAX) >= PATH_MAX)
+	guest_length = strnlen(guest_path, PATH_MAX);
+	if (guest_length >= PATH_MAX)
 		return -ENAMETOOLONG;
 
 	if (user_path[0] != '/') {
@@ -207,16 +430,28 @@ int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
 		if (guest_path[0] != '/')
 			return -EINVAL;
 	}
-	else
+	else {
 		strcpy(guest_path, "/");
+		guest_length = 1;
+	}
+
+	/* The components that remain to be walked; symlink targets
+	 * are spliced in front of @cursor, so the whole
+	 * canonicalization is iterative and bounded to this single
+	 * buffer, instead of one stack frame -- and one fresh
+	 * PATH_MAX buffer -- per symlink level.  */
+	if (strnlen(user_path, PATH_MAX) >= PATH_MAX)
+		return -ENAMETOOLONG;
+	strcpy(remaining, user_path);
+	cursor = remaining;
 
-	/* Canonicalize recursely 'user_path' into 'guest_path'.  */
-	cursor = user_path;
+	/* Canonicalize iteratively 'remaining' into 'guest_path'.  */
 	finality = NOT_FINAL;
 	while (!IS_FINAL(finality)) {
 		Comparison comparison;
 		char component[NAME_MAX];
 		char host_path[PATH_MAX];
+		size_t target_length;
 
 		finality = next_component(component, &cursor);
 		status = (int) finality;
@@ -230,22 +465,43 @@ int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
 		}
 
 		if (strcmp(component, "..") == 0) {
-			pop_component(guest_path);
+			guest_length = pop_component(guest_path, guest_length);
 			if (IS_FINAL(finality))
 				finality = FINAL_SLASH;
 			continue;
 		}
 
-		status = join_paths(2, scratch_path, guest_path, component);
+		/* scratch_path = guest_path + component, lengths are
+		 * known so plain string functions are avoided.  */
+		memcpy(scratch_path, guest_path, guest_length + 1);
+		status = append_component(scratch_path, guest_length, component);
 		if (status < 0)
 			return status;
 
 		/* Resolve bindings and check that a non-final
 		 * component exists and either is a directory or is a
-		 * symlink.  For this latter case, we check that the
-		 * symlink points to a directory once it is
-		 * canonicalized, at the end of this loop.  */
-		status = substitute_binding_stat(tracee, finality, scratch_path, host_path);
+		 * symlink.  For this latter case, its target is
+		 * spliced into the remaining components and thus
+		 * checked by the next iterations.  */
+		status = substitute_binding_stat(tracee, finality, scratch_path, host_path, walk);
+
+		/* A missing component under a case-insensitive binding
+		 * may exist with another case: probe its host directory
+		 * and re-translate with the on-disk spelling.  A missing
+		 * final component returns 0 -- the kernel reports the
+		 * error -- so it is probed on its own lstat(2).  */
+		if (   case_insensitive_bindings_in_use
+		    && (status == -ENOENT || (status == 0 && IS_FINAL(finality)))
+		    && probe_folded_component(tracee, scratch_path, host_path, component,
+					status == -ENOENT)) {
+			memcpy(scratch_path, guest_path, guest_length + 1);
+			status = append_component(scratch_path, guest_length, component);
+			if (status < 0)
+				return status;
+
+			status = substitute_binding_stat(tracee, finality, scratch_path,
+							host_path, walk);
+		}
 		if (status < 0)
 			return status;
 
@@ -256,16 +512,19 @@ int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
 		 * components.  Errors are explicitly ignored since
 		 * they should be handled by the caller. */
 		if (status <= 0 || (finality == FINAL_NORMAL && !deref_final)) {
-			strcpy(scratch_path, guest_path);
-			status = join_paths(2, guest_path, scratch_path, component);
+			status = append_component(guest_path, guest_length, component);
 			if (status < 0)
 				return status;
+			guest_length = status;
 			continue;
 		}
 
 		/* It's a link, so we have to dereference *and*
 		 * canonicalize to ensure we are not going outside the
 		 * new root.  */
+		if (++nb_expansions > MAXSYMLINKS)
+			return -ELOOP;
+
 		comparison = compare_paths("/proc", guest_path);
 		switch (comparison) {
 		case PATHS_ARE_EQUAL:
@@ -279,7 +538,7 @@ int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
 			case CANONICALIZE:
 				/* The symlink is already dereferenced,
 				 * now canonicalize it.  */
-				goto canon;
+				goto splice;
 
 			case DONT_CANONICALIZE:
 				/* If and only very final, this symlink
@@ -299,12 +558,16 @@ int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
 			break;
 		}
 
-		status = readlink(host_path, scratch_path, sizeof(scratch_path));
-		if (status < 0)
-			return status;
-		else if (status == sizeof(scratch_path))
-			return -ENAMETOOLONG;
-		scratch_path[status] = '\0';
+		if (!lookup_symlink_cache(tracee, host_path, scratch_path)) {
+			status = readlink(host_path, scratch_path, sizeof(scratch_path));
+			if (status < 0)
+				return status;
+			else if (status == sizeof(scratch_path))
+				return -ENAMETOOLONG;
+			scratch_path[status] = '\0';
+
+			cache_symlink_target(tracee, host_path, scratch_path);
+		}
 
 		/* Remove the leading "root" part if needed, it's
 		 * useful for "/proc/self/cwd/" for instance.  */
@@ -312,53 +575,93 @@ int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
 		if (status < 0)
 			return status;
 
-	canon:
-		/* Canonicalize recursively the referee in case it
-		 * is/contains a link, moreover if it is not an
-		 * absolute link then it is relative to
-		 * 'guest_path'. */
-		status = canonicalize(tracee, scratch_path, true, guest_path, recursion_level + 1);
+	splice:
+		/* Splice the target in front of the components that
+		 * remain to be walked: they will dereference it --
+		 * and whatever it points to -- on the next
+		 * iterations.  The link component itself was not
+		 * appended to 'guest_path', since the target is
+		 * relative to the link's directory; an absolute
+		 * target restarts from "/".  */
+		target_length = strlen(scratch_path);
+		if (*cursor != '\0') {
+			size_t left = strlen(cursor);
+
+			if (target_length + left + 2 >= PATH_MAX)
+				return -ENAMETOOLONG;
+
+			scratch_path[target_length] = '/';
+			memcpy(scratch_path + target_length + 1, cursor, left + 1);
+		}
+		else if (finality == FINAL_SLASH) {
+			/* Preserve the "expect a directory"
+			 * semantic of the original path.  */
+			if (target_length + 2 >= PATH_MAX)
+				return -ENAMETOOLONG;
+			strcpy(scratch_path + target_length, "/");
+		}
+
+		strcpy(remaining, scratch_path);
+		cursor = remaining;
+
+		if (remaining[0] == '/') {
+			strcpy(guest_path, "/");
+			guest_length = 1;
+		}
+
+		finality = NOT_FINAL;
+	}
+
+	/* Here `guest_path` is fully canonicalized but a terminating
+	 * '/' or a terminating '.' may be required to keep the
+	 * initial semantic of `user_path`.  */
+	switch (finality) {
+	case FINAL_NORMAL:
+		break;
+
+	case FINAL_SLASH:
+		strcpy(scratch_path, guest_path);
+		status = join_paths(2, guest_path, scratch_path, "");
 		if (status < 0)
 			return status;
+		break;
 
-		/* Check that a non-final canonicalized/dereferenced
-		 * symlink exists and is a directory.  */
-		status = substitute_binding_stat(tracee, finality, guest_path, host_path);
+	case FINAL_DOT:
+		strcpy(scratch_path, guest_path);
+		status = join_paths(2, guest_path, scratch_path, ".");
 		if (status < 0)
 			return status;
+		break;
 
-		/* Here, 'guest_path' shouldn't be a symlink anymore,
-		 * unless it is a named file descriptor.  */
-		assert(status != 1 || sscanf(guest_path, "/proc/%*d/fd/%d", &status) == 1);
+	default:
+		assert(0);
 	}
 
-	/* At the exit stage of the first level of recursion,
-	 * `guest_path` is fully canonicalized but a terminating '/'
-	 * or a terminating '.' may be required to keep the initial
-	 * semantic of `user_path`.  */
-	if (recursion_level == 0) {
-		switch (finality) {
-		case FINAL_NORMAL:
-			break;
+	return 0;
+}
 
-		case FINAL_SLASH:
-			strcpy(scratch_path, guest_path);
-			status = join_paths(2, guest_path, scratch_path, "");
-			if (status < 0)
-				return status;
-			break;
+/**
+ * c.f. comment of the function above.  This wrapper just maintains
+ * the host-side walk descriptor for the time of the canonicalization.
+ * The walk is disabled during the initialization of a binding since
+ * build_glue() creates directories along the way.
+ */
+int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
+		 char guest_path[PATH_MAX], unsigned int nb_expansions)
+{
+	HostWalk walk = { .dir_fd = -1, .path = "" };
+	uint64_t profile_start;
+	int status;
 
-		case FINAL_DOT:
-			strcpy(scratch_path, guest_path);
-			status = join_paths(2, guest_path, scratch_path, ".");
-			if (status < 0)
-				return status;
-			break;
+	profile_start = profile_scope_enter(SCOPE_CANONICALIZE);
 
-		default:
-			assert(0);
-		}
-	}
+	status = canonicalize2(tracee, user_path, deref_final, guest_path, nb_expansions,
+			tracee->glue_type == 0 ? &walk : NULL);
 
-	return 0;
+	if (walk.dir_fd >= 0)
+		close(walk.dir_fd);
+
+	profile_scope_exit(SCOPE_CANONICALIZE, profile_start);
+
+	return status;
 }
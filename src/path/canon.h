@@ -29,6 +29,6 @@
 #include "tracee/tracee.h"
 
 extern int canonicalize(Tracee *tracee, const char *user_path, bool deref_final,
-			char guest_path[PATH_MAX], unsigned int nb_recursion);
+			char guest_path[PATH_MAX], unsigned int nb_expansions);
 
 #endif /* CANON_H */
@@ -22,12 +22,16 @@
 
 #include <sys/types.h> /* mkdir(2), lstat(2), */
 #include <sys/stat.h> /* mkdir(2), lstat(2), */
-#include <fcntl.h>    /* mknod(2), */
-#include <unistd.h>   /* mknod(2), lstat(2), unlink(2), rmdir(2), */
+#include <sys/mman.h> /* mmap(2), */
+#include <fcntl.h>    /* mknod(2), open(2), */
+#include <unistd.h>   /* mknod(2), lstat(2), unlink(2), rmdir(2), write(2), */
 #include <string.h>   /* string(3),  */
 #include <assert.h>   /* assert(3), */
 #include <limits.h>   /* PATH_MAX, */
 #include <errno.h>    /* errno, E* */
+#include <stdio.h>    /* snprintf(3), */
+#include <stdint.h>   /* uint32_t, */
+#include <stdlib.h>   /* getenv(3), */
 #include <talloc.h>   /* talloc_*, */
 
 #include "path/binding.h"
@@ -37,6 +41,167 @@
 
 #include "compat.h"
 
+/* On-disk manifest of the glue requirements for a given binding set.
+ * The glue rootfs itself is a temporary directory that can't outlive
+ * the session, however *which* guest components have to be glued only
+ * depends on the binding layout and on the guest rootfs content.
+ * Remembering them across runs makes subsequent start-ups skip the
+ * mkdir(2) probes that are known to fail in the guest rootfs.  */
+
+#define GLUE_MANIFEST_MAGIC   0x50474c55 /* "PGLU" */
+#define GLUE_MANIFEST_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+} GlueManifestHeader;
+
+typedef struct {
+	char guest_path[PATH_MAX];
+} GlueManifestEntry;
+
+static int manifest_fd = -1;
+static const GlueManifestEntry *manifest_entries;
+static size_t nb_manifest_entries;
+static bool manifest_loaded;
+
+/**
+ * Return a hash of the binding set of @tracee.  Two PRoot invocations
+ * with the same binding layout -- at the time the first glue
+ * component is built -- get the same hash.
+ */
+static uint32_t hash_bindings(const Tracee *tracee)
+{
+	uint32_t hash = 5381;
+	const Binding *binding;
+	const Bindings *bindings;
+	const char *cursor;
+
+	bindings = tracee->fs->bindings.pending ?: tracee->fs->bindings.guest;
+	if (bindings == NULL)
+		return hash;
+
+	CIRCLEQ_FOREACH(binding, bindings, link.pending) {
+		for (cursor = binding->host.path; *cursor != '\0'; cursor++)
+			hash = hash * 33 + (unsigned char) *cursor;
+		hash = hash * 33 + '\0';
+		for (cursor = binding->guest.path; *cursor != '\0'; cursor++)
+			hash = hash * 33 + (unsigned char) *cursor;
+		hash = hash * 33 + '\0';
+	}
+
+	return hash;
+}
+
+/**
+ * Map in memory the glue manifest for the binding set of @tracee, if
+ * the user provided a cache directory through the PROOT_GLUE_CACHE
+ * environment variable.  This is a no-op except on its first call.
+ */
+static void load_glue_manifest(const Tracee *tracee)
+{
+	GlueManifestHeader header;
+	char manifest_path[PATH_MAX];
+	struct stat statl;
+	const char *cache_dir;
+	void *mapping;
+	int status;
+
+	if (manifest_loaded)
+		return;
+	manifest_loaded = true;
+
+	cache_dir = getenv("PROOT_GLUE_CACHE");
+	if (cache_dir == NULL)
+		return;
+
+	status = snprintf(manifest_path, PATH_MAX, "%s/glue-%08x",
+			cache_dir, hash_bindings(tracee));
+	if (status < 0 || status >= PATH_MAX)
+		return;
+
+	manifest_fd = open(manifest_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (manifest_fd < 0) {
+		note(tracee, WARNING, SYSTEM, "can't open glue manifest '%s'", manifest_path);
+		return;
+	}
+
+	status = fstat(manifest_fd, &statl);
+	if (status < 0)
+		goto error;
+
+	/* A freshly created manifest only gets its header.  */
+	if (statl.st_size == 0) {
+		header.magic   = GLUE_MANIFEST_MAGIC;
+		header.version = GLUE_MANIFEST_VERSION;
+
+		status = write(manifest_fd, &header, sizeof(header));
+		if (status != sizeof(header))
+			goto error;
+		return;
+	}
+
+	if ((size_t) statl.st_size < sizeof(GlueManifestHeader))
+		goto error;
+
+	mapping = mmap(NULL, statl.st_size, PROT_READ, MAP_PRIVATE, manifest_fd, 0);
+	if (mapping == MAP_FAILED)
+		goto error;
+
+	memcpy(&header, mapping, sizeof(header));
+	if (   header.magic != GLUE_MANIFEST_MAGIC
+	    || header.version != GLUE_MANIFEST_VERSION) {
+		(void) munmap(mapping, statl.st_size);
+		goto error;
+	}
+
+	manifest_entries = (const GlueManifestEntry *)
+		((const char *) mapping + sizeof(GlueManifestHeader));
+
+	/* A truncated trailing entry -- interrupted writer -- is
+	 * ignored thanks to the integer division.  */
+	nb_manifest_entries = (statl.st_size - sizeof(GlueManifestHeader))
+				/ sizeof(GlueManifestEntry);
+	return;
+
+error:
+	close(manifest_fd);
+	manifest_fd = -1;
+}
+
+/**
+ * Check whether @guest_path is known -- from a previous run -- to
+ * require some glue.
+ */
+static bool lookup_glue_manifest(const char *guest_path)
+{
+	size_t i;
+
+	for (i = 0; i < nb_manifest_entries; i++) {
+		if (strncmp(manifest_entries[i].guest_path, guest_path, PATH_MAX) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Remember @guest_path requires some glue.  Thanks to O_APPEND a
+ * whole entry is added atomically, even with concurrent sessions.
+ */
+static void record_glue_manifest(const char *guest_path)
+{
+	GlueManifestEntry entry;
+
+	if (manifest_fd < 0 || lookup_glue_manifest(guest_path))
+		return;
+
+	memset(&entry, 0, sizeof(entry));
+	strncpy(entry.guest_path, guest_path, PATH_MAX - 1);
+
+	(void) write(manifest_fd, &entry, sizeof(entry));
+}
+
 /**
  * Remove @path if it is empty only.
  *
@@ -145,6 +310,13 @@ mode_t build_glue(Tracee *tracee, const char *guest_path, char host_path[PATH_MA
 	if (getenv("PROOT_DONT_POLLUTE_ROOTFS") != NULL && !belongs_to_gluefs)
 		goto create_binding;
 
+	load_glue_manifest(tracee);
+
+	/* A previous run already discovered this component can't be
+	 * created in the guest rootfs: don't even probe it.  */
+	if (!belongs_to_gluefs && !IS_FINAL(finality) && lookup_glue_manifest(guest_path))
+		goto create_binding;
+
 	/* Try to create this component into the "guest" or "glue"
 	 * rootfs (depending if there were a glue previously).  */
 	if (S_ISDIR(type))
@@ -171,6 +343,8 @@ mode_t build_glue(Tracee *tracee, const char *guest_path, char host_path[PATH_MA
 		return 0;
 	}
 
+	record_glue_manifest(guest_path);
+
 create_binding:
 	/* Sanity checks.  */
 	if (   strnlen(tracee->glue, PATH_MAX) >= PATH_MAX
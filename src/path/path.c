@@ -21,6 +21,7 @@
  */
 
 #include <string.h>    /* string(3), */
+#include <strings.h>   /* strncasecmp(3), */
 #include <stdarg.h>    /* va_*(3), */
 #include <assert.h>    /* assert(3), */
 #include <fcntl.h>     /* AT_*,  */
@@ -34,6 +35,7 @@
 
 #include "path/path.h"
 #include "path/binding.h"
+#include "path/cache.h"
 #include "path/canon.h"
 #include "path/proc.h"
 #include "extension/extension.h"
@@ -45,7 +47,8 @@
 /**
  * Copy in @result the concatenation of several paths (@number_paths)
  * and adds a path separator ('/') in between when needed. This
- * function returns -errno if an error occured, otherwise it returns 0.
+ * function returns -errno if an error occured, otherwise it returns
+ * the length of @result (not including the end-of-string terminator).
  */
 int join_paths(int number_paths, char result[PATH_MAX], ...)
 {
@@ -77,8 +80,8 @@ int join_paths(int number_paths, char result[PATH_MAX], ...)
 				status = -ENAMETOOLONG;
 				break;
 			}
-			strcat(result + length, "/");
-			strcat(result + length, path);
+			result[length] = '/';
+			memcpy(result + length + 1, path, path_length + 1);
 			length = new_length;
 		}
 		/* There are already two path separators.  */
@@ -88,8 +91,8 @@ int join_paths(int number_paths, char result[PATH_MAX], ...)
 				status = -ENAMETOOLONG;
 				break;
 			}
-			strcat(result + length, path + 1);
-			length += path_length - 1;
+			memcpy(result + length, path + 1, path_length);
+			length = new_length;
 		}
 		/* There's already one path separator or result[] is empty.  */
 		else {
@@ -98,15 +101,15 @@ int join_paths(int number_paths, char result[PATH_MAX], ...)
 				status = -ENAMETOOLONG;
 				break;
 			}
-			strcat(result + length, path);
-			length += path_length;
+			memcpy(result + length, path, path_length + 1);
+			length = new_length;
 		}
 
 		status = 0;
 	}
 	va_end(paths);
 
-	return status;
+	return (status < 0 ? status : (int) length);
 }
 
 /**
@@ -163,6 +166,10 @@ int which(Tracee *tracee, const char *paths, char host_path[PATH_MAX], const cha
 	if (paths == NULL || strcmp(paths, "") == 0)
 		goto not_found;
 
+	/* Was this very look-up made recently?  */
+	if (lookup_which_cache(tracee, paths, command, host_path))
+		return 0;
+
 	cursor = paths;
 	do {
 		size_t length;
@@ -194,6 +201,8 @@ int which(Tracee *tracee, const char *paths, char host_path[PATH_MAX], const cha
 			/* Don't dereference the final component to preserve
 			 * argv0 in case it is a symlink to script.  */
 			(void) realpath2(tracee, host_path, path, false);
+
+			cache_which_result(tracee, paths, command, host_path);
 			return 0;
 		}
 	} while (*(cursor - 1) != '\0');
@@ -306,6 +315,62 @@ int readlink_proc_pid_fd(pid_t pid, int fd, char path[PATH_MAX])
 	return 0;
 }
 
+/**
+ * Check whether @path -- an absolute path -- is already in canonical
+ * form from a lexical point-of-view: no empty, "." or ".."
+ * components, and no trailing path separator.  Such a path can skip
+ * canonicalize() entirely when the translation is known to be the
+ * identity function.
+ */
+static bool is_lexically_canonical(const char *path)
+{
+	const char *component;
+	const char *end;
+
+	assert(path[0] == '/');
+
+	if (path[1] == '\0')
+		return true;
+
+	component = path + 1;
+	while (1) {
+		end = strchrnul(component, '/');
+
+		/* Empty ("//" or trailing "/"), "." and ".."
+		 * components all require a real canonicalization.  */
+		if (   end == component
+		    || (   end - component <= 2
+			&& component[0] == '.'
+			&& (end - component == 1 || component[1] == '.')))
+			return false;
+
+		if (*end == '\0')
+			return true;
+
+		component = end + 1;
+	}
+}
+
+/**
+ * Check whether an extension of @tracee subscribed to the HOST_PATH
+ * event.  Such an extension expects to see every component walked by
+ * canonicalize(), so the identity bypass below would starve it.
+ */
+static bool extensions_use_host_path_event(const Tracee *tracee)
+{
+	Extension *extension;
+
+	if (tracee == NULL || tracee->extensions == NULL)
+		return false;
+
+	LIST_FOREACH(extension, tracee->extensions, link) {
+		if ((extension->event_mask & EVENT_MASK(HOST_PATH)) != 0)
+			return true;
+	}
+
+	return false;
+}
+
 /**
  * Copy in @result the equivalent of "@tracee->root + canon(@dir_fd +
  * @user_path)".  If @user_path is not absolute then it is relative to
@@ -318,6 +383,7 @@ int translate_path(Tracee *tracee, char result[PATH_MAX], int dir_fd,
 		const char *user_path, bool deref_final)
 {
 	char guest_path[PATH_MAX];
+	uint64_t proc_translations;
 	int status;
 
 	/* Use "/" as the base if it is an absolute guest path. */
@@ -366,6 +432,28 @@ int translate_path(Tracee *tracee, char result[PATH_MAX], int dir_fd,
 	status = join_paths(2, guest_path, result, user_path);
 	if (status < 0)
 		return status;
+
+	/* Fast path for identity name-spaces, i.e. when every binding
+	 * -- the root one included -- maps a path onto itself: the
+	 * translation is the identity function, so a lexically
+	 * canonical path is passed through unmodified.  Entries under
+	 * "/proc" are still canonicalized since some of them are
+	 * emulated, and so is everything when an extension rewrites
+	 * host paths or when glue is being built.  */
+	if (   all_bindings_are_identity(tracee)
+	    && tracee->glue_type == 0
+	    && !extensions_use_host_path_event(tracee)
+	    && compare_paths("/proc", guest_path) == PATHS_ARE_NOT_COMPARABLE
+	    && is_lexically_canonical(guest_path)) {
+		strcpy(result, guest_path);
+		goto skip;
+	}
+
+	/* Was this translation made recently?  */
+	if (lookup_path_cache(tracee, guest_path, deref_final, result))
+		goto skip;
+
+	proc_translations = nb_proc_translations;
 	strcpy(result, "/");
 
 	/* Canonicalize regarding the new root. */
@@ -380,6 +468,11 @@ int translate_path(Tracee *tracee, char result[PATH_MAX], int dir_fd,
 	if (status < 0)
 		return status;
 
+	/* Don't cache translations that went through an emulated
+	 * "/proc" entry since their results depend on the tracee.  */
+	if (proc_translations == nb_proc_translations)
+		cache_translated_path(tracee, guest_path, deref_final, result);
+
 skip:
 	VERBOSE(tracee, 2, "pid %d:          -> \"%s\"",
 		tracee != NULL ? tracee->pid : 0, result);
@@ -398,6 +491,7 @@ int detranslate_path(Tracee *tracee, char path[PATH_MAX], const char t_referrer[
 	size_t prefix_length;
 	ssize_t new_length;
 
+	const Binding *binding = NULL;
 	bool sanity_check;
 	bool follow_binding;
 
@@ -439,11 +533,11 @@ int detranslate_path(Tracee *tracee, char path[PATH_MAX], const char t_referrer[
 			follow_binding = true;
 		}
 		else if (!belongs_to_guestfs(tracee, t_referrer)) {
-			const char *binding_referree;
-			const char *binding_referrer;
+			const Binding *binding_referree;
+			const Binding *binding_referrer;
 
-			binding_referree = get_path_binding(tracee, HOST, path);
-			binding_referrer = get_path_binding(tracee, HOST, t_referrer);
+			binding_referree = get_binding(tracee, HOST, path);
+			binding_referrer = get_binding(tracee, HOST, t_referrer);
 			assert(binding_referrer != NULL);
 
 			/* Resolve bindings for symlinks that belong
@@ -455,8 +549,13 @@ int detranslate_path(Tracee *tracee, char path[PATH_MAX], const char t_referrer[
 			 * guest rootfs namespace for consistency
 			 * reasons.  */
 			if (binding_referree != NULL) {
-				comparison = compare_paths(binding_referree, binding_referrer);
+				comparison = compare_paths(binding_referree->host.path,
+							binding_referrer->host.path);
 				follow_binding = (comparison == PATHS_ARE_EQUAL);
+
+				/* Reuse this look-up for the
+				 * substitution below.  */
+				binding = binding_referree;
 			}
 		}
 	}
@@ -466,7 +565,9 @@ int detranslate_path(Tracee *tracee, char path[PATH_MAX], const char t_referrer[
 	}
 
 	if (follow_binding) {
-		switch (substitute_binding(tracee, HOST, path)) {
+		switch (binding != NULL
+			? substitute_binding2(binding, HOST, path)
+			: substitute_binding(tracee, HOST, path)) {
 		case 0:
 			return 0;
 		case 1:
@@ -514,9 +615,13 @@ int detranslate_path(Tracee *tracee, char path[PATH_MAX], const char t_referrer[
  */
 bool belongs_to_guestfs(const Tracee *tracee, const char *host_path)
 {
+	const Path *root = get_root2(tracee);
 	Comparison comparison;
 
-	comparison = compare_paths(get_root(tracee), host_path);
+	/* The length of the rootfs path is already known: don't
+	 * re-run strlen(3) against it for each examined fd.  */
+	comparison = compare_paths2(root->path, root->length,
+				host_path, strlen(host_path));
 	return (comparison == PATHS_ARE_EQUAL || comparison == PATH1_IS_PREFIX);
 }
 
@@ -527,7 +632,41 @@ bool belongs_to_guestfs(const Tracee *tracee, const char *host_path)
  * This function works only with paths canonicalized in the same
  * namespace (host/guest)!
  */
-Comparison compare_paths2(const char *path1, size_t length1, const char *path2, size_t length2)
+/**
+ * Return the first bytes of @path -- @length long -- packed into one
+ * word, zero-padded.  The packing is endian-agnostic as long as every
+ * word is built by this very function.
+ */
+uint64_t load_path_prefix(const char *path, size_t length)
+{
+	uint64_t prefix = 0;
+
+	memcpy(&prefix, path, length < sizeof(prefix) ? length : sizeof(prefix));
+
+	return prefix;
+}
+
+/**
+ * Precompute the comparison-acceleration attributes of @path --
+ * @path->length is assumed up-to-date -- that is, its packed first
+ * bytes and the mask that covers them; see the prejudgment in
+ * get_binding().
+ */
+void set_path_prefix(Path *path)
+{
+	static const unsigned char ones[sizeof(uint64_t)] = {
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	size_t length;
+
+	length = (path->length < sizeof(uint64_t) ? path->length : sizeof(uint64_t));
+
+	path->prefix = load_path_prefix(path->path, path->length);
+	path->prefix_mask = 0;
+	memcpy(&path->prefix_mask, ones, length);
+}
+
+Comparison compare_paths3(const char *path1, size_t length1, const char *path2, size_t length2,
+			bool case_insensitive)
 {
 	size_t length_min;
 	bool is_prefix;
@@ -564,7 +703,9 @@ Comparison compare_paths2(const char *path1, size_t length1, const char *path2,
 	if (sentinel != '/' && sentinel != '\0')
 		return PATHS_ARE_NOT_COMPARABLE;
 
-	is_prefix = (strncmp(path1, path2, length_min) == 0);
+	is_prefix = ((case_insensitive
+			? strncasecmp(path1, path2, length_min)
+			: strncmp(path1, path2, length_min)) == 0);
 
 	if (!is_prefix)
 		return PATHS_ARE_NOT_COMPARABLE;
@@ -580,6 +721,11 @@ Comparison compare_paths2(const char *path1, size_t length1, const char *path2,
 	return PATHS_ARE_NOT_COMPARABLE;
 }
 
+Comparison compare_paths2(const char *path1, size_t length1, const char *path2, size_t length2)
+{
+	return compare_paths3(path1, length1, path2, length2, false);
+}
+
 Comparison compare_paths(const char *path1, const char *path2)
 {
 	return compare_paths2(path1, strlen(path1), path2, strlen(path2));
@@ -611,20 +757,15 @@ static int foreach_fd(const Tracee *tracee, foreach_fd_t callback)
 		return 0;
 
 	while ((dirent = readdir(dirp)) != NULL) {
-		/* Read the value of this "virtual" link.  Don't use
-		 * readlinkat(2) here since it would require Linux >=
-		 * 2.6.16 and Glibc >= 2.4, whereas PRoot is supposed
-		 * to work on any Linux 2.6 systems.  */
-
-		char tmp[PATH_MAX];
-		if (strlen(proc_fd) + strlen(dirent->d_name) + 1 >= PATH_MAX)
+		/* Only fd entries are expected, skip "." and "..".  */
+		if (dirent->d_name[0] < '0' || dirent->d_name[0] > '9')
 			continue;
 
-		strcpy(tmp, proc_fd);
-		strcat(tmp, "/");
-		strcat(tmp, dirent->d_name);
-
-		status = readlink(tmp, path, PATH_MAX);
+		/* Read the value of this "virtual" link, relatively to
+		 * the already opened directory: this avoids building
+		 * and re-traversing "/proc/<pid>/fd/<fd>" for each
+		 * entry.  */
+		status = readlinkat(dirfd(dirp), dirent->d_name, path, PATH_MAX);
 		if (status < 0 || status >= PATH_MAX)
 			continue;
 		path[status] = '\0';
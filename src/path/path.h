@@ -27,6 +27,7 @@
 #include <fcntl.h> /* AT_FDCWD, */
 #include <limits.h> /* PATH_MAX, */
 #include <stdbool.h>
+#include <stdint.h> /* uint64_t, */
 
 #include "tracee/tracee.h"
 
@@ -51,6 +52,13 @@ typedef struct {
 	char path[PATH_MAX];
 	size_t length;
 	Side side;
+
+	/* First bytes of @path packed into one word -- zero-padded --
+	 * with the matching byte mask, both precomputed by
+	 * set_path_prefix(): get_binding() rejects most candidates
+	 * with two integer comparisons instead of a memcmp.  */
+	uint64_t prefix;
+	uint64_t prefix_mask;
 } Path;
 
 /* Path ending type.  */
@@ -87,6 +95,11 @@ extern int list_open_fd(const Tracee *tracee);
 
 extern Comparison compare_paths(const char *path1, const char *path2);
 extern Comparison compare_paths2(const char *path1, size_t length1, const char *path2, size_t length2);
+extern Comparison compare_paths3(const char *path1, size_t length1, const char *path2, size_t length2,
+				bool case_insensitive);
+
+extern void set_path_prefix(Path *path);
+extern uint64_t load_path_prefix(const char *path, size_t length);
 
 extern size_t substitute_path_prefix(char path[PATH_MAX], size_t old_prefix_length,
 				const char *new_prefix, size_t new_prefix_length);
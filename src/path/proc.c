@@ -20,16 +20,46 @@
  * 02110-1301 USA.
  */
 
-#include <stdio.h>   /* snprintf(3), */
+#include <stdio.h>   /* snprintf(3), fgets(3), */
 #include <string.h>  /* strcmp(3), */
 #include <stdlib.h>  /* atoi(3), strtol(3), */
 #include <errno.h>   /* E*, */
 #include <assert.h>  /* assert(3), */
+#include <fcntl.h>   /* open(2), O_*, */
+#include <unistd.h>  /* close(2), unlink(2), getpid(2), */
+#include <talloc.h>  /* talloc_*, */
 
 #include "path/proc.h"
 #include "tracee/tracee.h"
 #include "path/path.h"
 #include "path/binding.h"
+#include "path/temp.h"
+
+/* Number of times a "/proc" entry was [potentially] emulated so far;
+ * used by translate_path() to detect -- and not cache -- translations
+ * whose result depends on the tracee.  */
+uint64_t nb_proc_translations;
+
+/* Emulated links in "/proc/<PID>/", looked up by length first.  The
+ * content they substitute lives in the Tracee structure, hence the
+ * tag instead of a pointer.  */
+typedef enum {
+	LINK_EXE,
+	LINK_CWD,
+	LINK_ROOT,
+} ProcPidLink;
+
+typedef struct {
+	const char *name;
+	size_t length;
+	ProcPidLink link;
+} ProcPidLinkEntry;
+
+static const ProcPidLinkEntry proc_pid_links[] = {
+	{ "exe",  3, LINK_EXE  },
+	{ "cwd",  3, LINK_CWD  },
+	{ "root", 4, LINK_ROOT },
+};
 
 /**
  * This function emulates the @result of readlink("@base/@component")
@@ -45,12 +75,17 @@ Action readlink_proc(const Tracee *tracee, char result[PATH_MAX],
 			Comparison comparison)
 {
 	const Tracee *known_tracee;
-	char proc_path[64]; /* 64 > sizeof("/proc//fd/") + 2 * sizeof(#ULONG_MAX) */
+	size_t component_length;
+	const char *cursor;
+	char *end_ptr;
 	int status;
+	size_t i;
 	pid_t pid;
 
 	assert(comparison == compare_paths("/proc", base));
 
+	nb_proc_translations++;
+
 	/* Remember: comparison = compare_paths("/proc", base)  */
 	switch (comparison) {
 	case PATHS_ARE_EQUAL:
@@ -73,61 +108,62 @@ Action readlink_proc(const Tracee *tracee, char result[PATH_MAX],
 		return DEFAULT;
 	}
 
-	pid = atoi(base + strlen("/proc/"));
-	if (pid == 0)
+	/* Parse the <PID> part of "/proc/<PID>[/...]" once, instead
+	 * of re-printing it for each pattern below.  */
+	cursor = base + strlen("/proc/");
+	if (*cursor < '0' || *cursor > '9')
 		return DEFAULT;
 
-	/* Handle links in "/proc/<PID>/".  */
-	status = snprintf(proc_path, sizeof(proc_path), "/proc/%d", pid);
-	if (status < 0 || (size_t) status >= sizeof(proc_path))
-		return -EPERM;
+	errno = 0;
+	pid = strtol(cursor, &end_ptr, 10);
+	if (errno != 0 || pid == 0)
+		return DEFAULT;
+	cursor = end_ptr;
 
-	comparison = compare_paths(proc_path, base);
-	switch (comparison) {
-	case PATHS_ARE_EQUAL:
+	/* Handle links in "/proc/<PID>/".  */
+	if (cursor[0] == '\0') {
 		known_tracee = get_tracee(tracee, pid, false);
 		if (known_tracee == NULL)
 			return DEFAULT;
 
-#define SUBSTITUTE(name, string)				\
-		do {						\
-			if (strcmp(component, #name) != 0)	\
-				break;				\
-								\
-			status = strlen(string);		\
-			if (status >= PATH_MAX)			\
-				return -EPERM;			\
-								\
-			strncpy(result, string, status + 1);	\
-			return CANONICALIZE;			\
-		} while (0)
-
 		/* Substitute link "/proc/<PID>/???" with the content
 		 * of tracee->???.  */
-		SUBSTITUTE(exe, known_tracee->exe);
-		SUBSTITUTE(cwd, known_tracee->fs->cwd);
-		SUBSTITUTE(root, get_root(known_tracee));
-#undef SUBSTITUTE
-		return DEFAULT;
+		component_length = strlen(component);
+		for (i = 0; i < sizeof(proc_pid_links) / sizeof(ProcPidLinkEntry); i++) {
+			const ProcPidLinkEntry *entry = &proc_pid_links[i];
+			const char *string;
 
-	case PATH1_IS_PREFIX:
-		/* Handle "/proc/<PID>/???" below.  */
-		break;
+			if (   entry->length != component_length
+			    || memcmp(entry->name, component, component_length) != 0)
+				continue;
 
-	default:
+			switch (entry->link) {
+			case LINK_EXE:
+				string = known_tracee->exe;
+				break;
+			case LINK_CWD:
+				string = known_tracee->fs->cwd;
+				break;
+			case LINK_ROOT:
+				string = get_root(known_tracee);
+				break;
+			default:
+				assert(0);
+				return DEFAULT;
+			}
+
+			status = strlen(string);
+			if (status >= PATH_MAX)
+				return -EPERM;
+
+			memcpy(result, string, status + 1);
+			return CANONICALIZE;
+		}
 		return DEFAULT;
 	}
 
 	/* Handle links in "/proc/<PID>/fd/".  */
-	status = snprintf(proc_path, sizeof(proc_path), "/proc/%d/fd", pid);
-	if (status < 0 || (size_t) status >= sizeof(proc_path))
-		return -EPERM;
-
-	comparison = compare_paths(proc_path, base);
-	switch (comparison) {
-		char *end_ptr;
-
-	case PATHS_ARE_EQUAL:
+	if (strcmp(cursor, "/fd") == 0) {
 		/* Sanity check: a number is expected.  */
 		errno = 0;
 		(void) strtol(component, &end_ptr, 10);
@@ -147,9 +183,6 @@ Action readlink_proc(const Tracee *tracee, char result[PATH_MAX],
 			return -EPERM;
 
 		return DONT_CANONICALIZE;
-
-	default:
-		break;
 	}
 
 	return DEFAULT;
@@ -193,3 +226,183 @@ ssize_t readlink_proc2(const Tracee *tracee, char result[PATH_MAX], const char r
 	action = readlink_proc(tracee, result, base, component, PATH1_IS_PREFIX);
 	return (action == CANONICALIZE ? strlen(result) : 0);
 }
+
+/**
+ * Close the detranslated copy of a "maps" entry once the syscall that
+ * requested it is fully handled.
+ *
+ * Note: this is a Talloc destructor.
+ */
+static int close_maps_copy(FILE **file)
+{
+	fclose(*file);
+	return 0;
+}
+
+/**
+ * Rewrite @line -- one complete line of a "maps" or "smaps" entry --
+ * into @output, with its path column detranslated against @tracee's
+ * file-system name-space.  Lines without a path column, or whose path
+ * can't be detranslated, are copied verbatim.
+ */
+static void rewrite_maps_line(Tracee *tracee, char *line, FILE *output)
+{
+	char path[PATH_MAX];
+	char *cursor = line;
+	size_t length;
+	int status;
+	int field;
+
+	/* The path is the sixth column of a mapping line: "address
+	 * perms offset dev inode path".  The attribute lines of
+	 * "smaps" never get six columns with an absolute path in the
+	 * last one, so they fall through the check below.  */
+	for (field = 0; field < 5; field++) {
+		while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t')
+			cursor++;
+		while (*cursor == ' ' || *cursor == '\t')
+			cursor++;
+	}
+
+	if (*cursor != '/') {
+		fputs(line, output);
+		return;
+	}
+
+	/* The path column runs up to the end of the line; a possible
+	 * " (deleted)" suffix harmlessly tags along since only the
+	 * prefix of the path is substituted.  */
+	length = strcspn(cursor, "\n");
+	if (length >= PATH_MAX) {
+		fputs(line, output);
+		return;
+	}
+	memcpy(path, cursor, length);
+	path[length] = '\0';
+
+	status = detranslate_path(tracee, path, NULL);
+	if (status <= 0) {
+		/* Either no transformation was required or it
+		 * failed: the original line is the best guess.  */
+		fputs(line, output);
+		return;
+	}
+
+	cursor[0] = '\0';
+	fprintf(output, "%s%s\n", line, path);
+}
+
+/**
+ * If @host_path is the "maps" or "smaps" entry of a tracee, stream
+ * its content -- line by line, with bounded buffering -- into an
+ * anonymous temporary file with every path column detranslated, then
+ * replace @host_path with the "/proc/<proot pid>/fd/<fd>" path of
+ * this copy: the tracee re-opens the rewritten entry instead of the
+ * kernel's one.  The copy is discarded once the current syscall is
+ * fully handled, by when the tracee owns its own descriptor to it.
+ * When the entry can't be rewritten -- unknown pid, no temporary file
+ * available -- @host_path is left untouched since host paths are a
+ * better answer than no content at all.  This function returns 0, it
+ * never fails the translation.
+ */
+int rewrite_proc_maps(Tracee *tracee, char host_path[PATH_MAX])
+{
+	char line[PATH_MAX + 256];
+	bool copying_tail = false;
+	const char *component;
+	Tracee *target;
+	FILE **holder;
+	FILE *output;
+	FILE *input;
+	long pid;
+	char *end;
+	int status;
+	int fd;
+
+	if (strncmp(host_path, "/proc/", strlen("/proc/")) != 0)
+		return 0;
+
+	pid = strtol(host_path + strlen("/proc/"), &end, 10);
+	if (end == host_path + strlen("/proc/") || *end != '/')
+		return 0;
+
+	component = end + 1;
+	if (strcmp(component, "maps") != 0 && strcmp(component, "smaps") != 0)
+		return 0;
+
+	/* Only the entries of known tracees can be detranslated, and
+	 * only against their own file-system name-space.  */
+	target = get_tracee(tracee, (pid_t) pid, false);
+	if (target == NULL)
+		return 0;
+
+	input = fopen(host_path, "re");
+	if (input == NULL)
+		return 0;
+
+	fd = open_temp_anonymous_file();
+	if (fd < 0) {
+		/* No O_TMPFILE support: fall back to a named
+		 * temporary file, unlinked right away.  */
+		const char *name;
+
+		name = create_temp_file(tracee->ctx, tracee->tool_name);
+		if (name == NULL) {
+			fclose(input);
+			return 0;
+		}
+
+		fd = open(name, O_RDWR | O_CLOEXEC);
+		(void) unlink(name);
+		if (fd < 0) {
+			fclose(input);
+			return 0;
+		}
+	}
+
+	output = fdopen(fd, "w");
+	if (output == NULL) {
+		close(fd);
+		fclose(input);
+		return 0;
+	}
+
+	holder = talloc(tracee->ctx, FILE *);
+	if (holder == NULL) {
+		fclose(output);
+		fclose(input);
+		return 0;
+	}
+	*holder = output;
+	talloc_set_destructor(holder, close_maps_copy);
+
+	while (fgets(line, sizeof(line), input) != NULL) {
+		size_t length = strlen(line);
+		bool whole_line = (length > 0 && line[length - 1] == '\n');
+
+		/* An overly long line is copied verbatim, chunk by
+		 * chunk: its path column couldn't be extracted within
+		 * PATH_MAX bytes anyway.  */
+		if (copying_tail || !whole_line) {
+			fputs(line, output);
+			copying_tail = !whole_line;
+			continue;
+		}
+
+		rewrite_maps_line(target, line, output);
+	}
+
+	fclose(input);
+
+	/* The tracee reads the underlying file, not the stdio
+	 * buffers.  */
+	status = fflush(output);
+	if (status != 0)
+		return 0;
+
+	status = snprintf(host_path, PATH_MAX, "/proc/%d/fd/%d", getpid(), fileno(output));
+	if (status < 0 || status >= PATH_MAX)
+		return 0;
+
+	return 0;
+}
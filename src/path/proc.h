@@ -24,6 +24,7 @@
 #define PROC_H
 
 #include <limits.h>
+#include <stdint.h> /* uint64_t, */
 
 #include "tracee/tracee.h"
 #include "path/path.h"
@@ -41,4 +42,10 @@ extern Action readlink_proc(const Tracee *tracee, char result[PATH_MAX], const c
 
 extern ssize_t readlink_proc2(const Tracee *tracee, char result[PATH_MAX], const char path[PATH_MAX]);
 
+extern int rewrite_proc_maps(Tracee *tracee, char host_path[PATH_MAX]);
+
+/* Number of times a "/proc" entry was [potentially] emulated so far,
+ * see path/cache.c.  */
+extern uint64_t nb_proc_translations;
+
 #endif /* PROC_H */
@@ -1,50 +1,36 @@
-#include <sys/types.h>  /* stat(2), opendir(3), */
-#include <sys/stat.h>   /* stat(2), chmod(2), */
-#include <unistd.h>     /* stat(2), rmdir(2), unlink(2), readlink(2), */
+#include <sys/types.h>  /* opendir(3), */
+#include <sys/stat.h>   /* chmod(2), fchmodat(2), */
+#include <unistd.h>     /* rmdir(2), close(2), sysconf(3), */
 #include <errno.h>      /* errno(2), */
-#include <dirent.h>     /* readdir(3), opendir(3), */
-#include <string.h>     /* strcmp(3), */
+#include <fcntl.h>      /* open(2), openat(2), unlinkat(2), O_*, AT_*, */
+#include <dirent.h>     /* readdir(3), fdopendir(3), */
+#include <string.h>     /* strcmp(3), strdup(3), */
 #include <stdlib.h>     /* free(3), */
 #include <stdio.h>      /* P_tmpdir, */
+#include <sys/syscall.h> /* SYS_memfd_create, */
+#include <pthread.h>    /* pthread_*, */
 #include <talloc.h>     /* talloc(3), */
 
 #include "cli/note.h"
 
 /**
- * Remove recursively the content of the current working directory.
- * This latter has to lie in P_tmpdir (ie. "/tmp" on most systems).
- * This function returns -1 if a fatal error occured (ie. the
- * recursion must be stopped), the number of non-fatal errors
- * otherwise.
- *
- * WARNING: this function changes the current working directory for
- * the calling process.
+ * Remove recursively the content of the directory referred to by
+ * @dir_fd; this descriptor is consumed, ie. closed, by this function.
+ * Every operation is relative to @dir_fd -- openat(2)/unlinkat(2) --
+ * so the kernel resolves one component per entry instead of the whole
+ * path, and the current working directory is left untouched.  This
+ * function returns the number of errors.
  */
-static int clean_temp_cwd()
+static int clean_temp_dir_fd(int dir_fd)
 {
-	const size_t length_tmpdir = strlen(P_tmpdir);
-	char prefix[length_tmpdir];
 	int nb_errors = 0;
 	int status;
 	DIR *dir;
 
-	/* Sanity check: ensure the current directory lies in
-	 * "/tmp".  */
-	status = readlink("/proc/self/cwd", prefix, length_tmpdir);
-	if (status < 0) {
-		note(NULL, WARNING, SYSTEM, "can't readlink '/proc/self/cwd'");
-		return ++nb_errors;
-	}
-	if (strncmp(prefix, P_tmpdir, length_tmpdir) != 0) {
-		note(NULL, ERROR, INTERNAL,
-			"trying to remove a directory outside of '%s', "
-			"please report this error.\n", P_tmpdir);
-		return ++nb_errors;
-	}
-
-	dir = opendir(".");
+	dir = fdopendir(dir_fd);
 	if (dir == NULL) {
-		note(NULL, WARNING, SYSTEM, "can't open '.'");
+		note(NULL, WARNING, SYSTEM, "can't open temporary directory");
+		close(dir_fd);
 		return ++nb_errors;
 	}
 
@@ -60,113 +46,234 @@ static int clean_temp_cwd()
 		    || strcmp(entry->d_name, "..") == 0)
 			continue;
 
-		status = chmod(entry->d_name, 0700);
-		if (status < 0) {
-			note(NULL, WARNING, SYSTEM, "cant chmod '%s'", entry->d_name);
-			nb_errors++;
-			continue;
-		}
-
 		if (entry->d_type == DT_DIR) {
-			status = chdir(entry->d_name);
+			int fd;
+
+			/* Ensure the sub-directory can be read and
+			 * emptied.  */
+			status = fchmodat(dir_fd, entry->d_name, 0700, 0);
 			if (status < 0) {
-				note(NULL, WARNING, SYSTEM, "can't chdir '%s'", entry->d_name);
+				note(NULL, WARNING, SYSTEM, "can't chmod '%s'", entry->d_name);
 				nb_errors++;
 				continue;
 			}
 
-			/* Recurse.  */
-			status = clean_temp_cwd();
-			if (status < 0) {
-				nb_errors = -1;
-				goto end;
+			fd = openat(dir_fd, entry->d_name,
+				O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			if (fd < 0) {
+				note(NULL, WARNING, SYSTEM, "can't open '%s'", entry->d_name);
+				nb_errors++;
+				continue;
 			}
-			nb_errors += status;
 
-			status = chdir("..");
-			if (status < 0) {
-				note(NULL, ERROR, SYSTEM, "can't chdir to '..'");
-				nb_errors = -1;
-				goto end;
-			}
+			/* Recurse.  */
+			nb_errors += clean_temp_dir_fd(fd);
 
-			status = rmdir(entry->d_name);
-		}
-		else {
-			status = unlink(entry->d_name);
+			status = unlinkat(dir_fd, entry->d_name, AT_REMOVEDIR);
 		}
+		else
+			status = unlinkat(dir_fd, entry->d_name, 0);
+
 		if (status < 0) {
 			note(NULL, WARNING, SYSTEM, "can't remove '%s'", entry->d_name);
 			nb_errors++;
-			continue;
 		}
 	}
 	if (errno != 0) {
-		note(NULL, WARNING, SYSTEM, "can't readdir '.'");
+		note(NULL, WARNING, SYSTEM, "can't readdir temporary directory");
 		nb_errors++;
 	}
 
-end:
-	(void) closedir(dir);
+	(void) closedir(dir);  /* This also closes @dir_fd.  */
 	return nb_errors;
 }
 
+/* Top-level sub-directories of a temporary tree being removed,
+ * dispatched to a few worker threads when the tree is large; each one
+ * is an independent sub-tree so workers never step on each other.  */
+#define PARALLEL_REMOVAL_THRESHOLD 8
+#define MAX_REMOVAL_WORKERS 4
+
+typedef struct {
+	int root_fd;
+	char **subdirs;
+	size_t nb_subdirs;
+	size_t next;
+	pthread_mutex_t lock;
+	int nb_errors;
+} RemovalQueue;
+
+/**
+ * Pop sub-directories from @private (a RemovalQueue) and remove them,
+ * until none is left.
+ */
+static void *removal_worker(void *private)
+{
+	RemovalQueue *queue = private;
+
+	while (1) {
+		const char *name;
+		int nb_errors = 0;
+		int status;
+		int fd;
+
+		pthread_mutex_lock(&queue->lock);
+		if (queue->next == queue->nb_subdirs) {
+			pthread_mutex_unlock(&queue->lock);
+			return NULL;
+		}
+		name = queue->subdirs[queue->next++];
+		pthread_mutex_unlock(&queue->lock);
+
+		status = fchmodat(queue->root_fd, name, 0700, 0);
+		if (status < 0)
+			nb_errors++;
+
+		fd = openat(queue->root_fd, name,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (fd < 0) {
+			note(NULL, WARNING, SYSTEM, "can't open '%s'", name);
+			nb_errors++;
+		}
+		else {
+			nb_errors += clean_temp_dir_fd(fd);
+
+			status = unlinkat(queue->root_fd, name, AT_REMOVEDIR);
+			if (status < 0) {
+				note(NULL, WARNING, SYSTEM, "can't remove '%s'", name);
+				nb_errors++;
+			}
+		}
+
+		pthread_mutex_lock(&queue->lock);
+		queue->nb_errors += nb_errors;
+		pthread_mutex_unlock(&queue->lock);
+	}
+}
+
 /**
  * Remove recursively @path.  This latter has to be a directory lying
- * in P_tmpdir (ie. "/tmp" on most systems).  This function returns -1
- * on error, otherwise 0.
+ * in P_tmpdir (ie. "/tmp" on most systems).  Large trees -- big glue
+ * for instance -- are removed by a few threads working on distinct
+ * top-level sub-directories, since this happens on the exit path of
+ * every short session.  This function returns -1 on error, otherwise
+ * 0.
  */
 static int remove_temp_directory2(const char *path)
 {
-	int result;
+	RemovalQueue queue = { .lock = PTHREAD_MUTEX_INITIALIZER };
+	long nb_workers;
+	size_t i;
 	int status;
-	char *cwd;
+	DIR *dir;
 
-	cwd = get_current_dir_name();
+	/* Sanity check: ensure the directory lies in "/tmp".  */
+	if (strncmp(path, P_tmpdir, strlen(P_tmpdir)) != 0) {
+		note(NULL, ERROR, INTERNAL,
+			"trying to remove a directory outside of '%s', "
+			"please report this error.\n", P_tmpdir);
+		return -1;
+	}
 
 	status = chmod(path, 0700);
 	if (status < 0) {
 		note(NULL, ERROR, SYSTEM, "can't chmod '%s'", path);
-		result = -1;
-		goto end;
+		return -1;
 	}
 
-	status = chdir(path);
-	if (status < 0) {
-		note(NULL, ERROR, SYSTEM, "can't chdir to '%s'", path);
-		result = -1;
-		goto end;
+	queue.root_fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (queue.root_fd < 0) {
+		note(NULL, ERROR, SYSTEM, "can't open '%s'", path);
+		return -1;
 	}
 
-	status = clean_temp_cwd();
-	result = (status == 0 ? 0 : -1);
-
-	/* Try to remove path even if something went wrong.  */
-	status = chdir("..");
-	if (status < 0) {
-		note(NULL, ERROR, SYSTEM, "can't chdir to '..'");
-		result = -1;
-		goto end;
+	/* First pass: remove top-level files right away, and collect
+	 * the top-level sub-directories.  */
+	dir = fdopendir(dup(queue.root_fd));
+	if (dir == NULL) {
+		close(queue.root_fd);
+		note(NULL, ERROR, SYSTEM, "can't open '%s'", path);
+		return -1;
 	}
 
-	status = rmdir(path);
-	if (status < 0) {
-		note(NULL, ERROR, SYSTEM, "cant remove '%s'", path);
-		result = -1;
-		goto end;
+	while (1) {
+		struct dirent *entry;
+		char **subdirs;
+
+		errno = 0;
+		entry = readdir(dir);
+		if (entry == NULL)
+			break;
+
+		if (   strcmp(entry->d_name, ".")  == 0
+		    || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		if (entry->d_type != DT_DIR) {
+			status = unlinkat(queue.root_fd, entry->d_name, 0);
+			if (status < 0) {
+				note(NULL, WARNING, SYSTEM, "can't remove '%s'", entry->d_name);
+				queue.nb_errors++;
+			}
+			continue;
+		}
+
+		subdirs = realloc(queue.subdirs, (queue.nb_subdirs + 1) * sizeof(char *));
+		if (subdirs == NULL) {
+			queue.nb_errors++;
+			continue;
+		}
+		queue.subdirs = subdirs;
+
+		queue.subdirs[queue.nb_subdirs] = strdup(entry->d_name);
+		if (queue.subdirs[queue.nb_subdirs] == NULL) {
+			queue.nb_errors++;
+			continue;
+		}
+		queue.nb_subdirs++;
 	}
+	(void) closedir(dir);
 
-end:
-	if (cwd != NULL) {
-		status = chdir(cwd);
-		if (status < 0) {
-			result = -1;
-			note(NULL, ERROR, SYSTEM, "can't chdir to '%s'", cwd);
+	/* Second pass: remove the sub-trees, with a few workers when
+	 * there are enough of them to amortize the threads.  */
+	nb_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nb_workers > MAX_REMOVAL_WORKERS)
+		nb_workers = MAX_REMOVAL_WORKERS;
+
+	if (nb_workers > 1 && queue.nb_subdirs >= PARALLEL_REMOVAL_THRESHOLD) {
+		pthread_t workers[MAX_REMOVAL_WORKERS];
+		long nb_started = 0;
+
+		for (i = 0; i < (size_t) nb_workers; i++) {
+			status = pthread_create(&workers[i], NULL, removal_worker, &queue);
+			if (status != 0)
+				break;
+			nb_started++;
 		}
-		free(cwd);
+
+		/* The calling thread pitches in too -- and does all
+		 * the work if no thread could be started.  */
+		(void) removal_worker(&queue);
+
+		for (i = 0; i < (size_t) nb_started; i++)
+			pthread_join(workers[i], NULL);
 	}
+	else
+		(void) removal_worker(&queue);
+
+	for (i = 0; i < queue.nb_subdirs; i++)
+		free(queue.subdirs[i]);
+	free(queue.subdirs);
 
-	return result;
+	close(queue.root_fd);
+
+	status = rmdir(path);
+	if (status < 0) {
+		note(NULL, ERROR, SYSTEM, "can't remove '%s'", path);
+		return -1;
+	}
+
+	return (queue.nb_errors == 0 ? 0 : -1);
 }
 
 /**
@@ -303,3 +410,42 @@ error:
 	note(NULL, ERROR, SYSTEM, "can't create temporary file");
 	return NULL;
 }
+
+/* These flags were introduced in Linux 3.17 along with
+ * memfd_create(2), but older C libraries don't declare them.  */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC       0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+/**
+ * Create an anonymous temporary file: it has no name to unlink and
+ * vanishes once its last descriptor is closed, but it is still
+ * reachable -- and executable, given the right mode -- through
+ * "/proc/<pid>/fd/<fd>" meanwhile.  A memfd is preferred since it
+ * lives in anonymous memory -- its content never hits a file-system
+ * -- and since it can be sealed against further writes once filled;
+ * otherwise an unnamed file is created in P_tmpdir with O_TMPFILE.
+ * This function returns the open descriptor, or -1 if an error
+ * occurred or if the kernel supports neither mechanism.
+ */
+int open_temp_anonymous_file(void)
+{
+	int fd;
+
+#ifdef SYS_memfd_create
+	fd = syscall(SYS_memfd_create, "proot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0)
+		return fd;
+#endif
+
+#ifdef O_TMPFILE
+	fd = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0700);
+#else
+	errno = ENOSYS;
+	fd = -1;
+#endif
+	return fd;
+}
@@ -29,5 +29,6 @@ extern char *create_temp_name(TALLOC_CTX *context, const char *prefix);
 extern const char *create_temp_directory(TALLOC_CTX *context, const char *prefix);
 extern const char *create_temp_file(TALLOC_CTX *context, const char *prefix);
 extern FILE* open_temp_file(TALLOC_CTX *context, const char *prefix);
+extern int open_temp_anonymous_file(void);
 
 #endif /* TEMP_H */
@@ -0,0 +1,71 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <stdio.h>   /* fprintf(3), */
+#include <stdbool.h> /* bool, */
+#include <stdint.h>  /* uintmax_t, */
+
+#include "profile.h"
+
+ScopeProfile scope_profiles[NB_SCOPES];
+
+static const char *scope_names[NB_SCOPES] = {
+	[SCOPE_CANONICALIZE]       = "canonicalize",
+	[SCOPE_SUBSTITUTE_BINDING] = "substitute_binding",
+	[SCOPE_READ_DATA]          = "read_data",
+	[SCOPE_WRITE_DATA]         = "write_data",
+	[SCOPE_FETCH_REGS]         = "fetch_regs",
+	[SCOPE_PUSH_REGS]          = "push_regs",
+	[SCOPE_NOTIFY_EXTENSIONS]  = "notify_extensions",
+};
+
+/* Print on stderr the sampled per-scope totals; silent as long as
+ * nothing was profiled.  */
+void print_scope_profile(void)
+{
+	ProfiledScope scope;
+	bool empty = true;
+
+	for (scope = 0; scope < NB_SCOPES; scope++)
+		empty &= (scope_profiles[scope].nb_calls == 0);
+	if (empty)
+		return;
+
+	fprintf(stderr, "internal scope profile (1 call in %d sampled):\n",
+		SCOPE_SAMPLE_INTERVAL);
+
+	for (scope = 0; scope < NB_SCOPES; scope++) {
+		const ScopeProfile *profile = &scope_profiles[scope];
+
+		if (profile->nb_calls == 0)
+			continue;
+
+		fprintf(stderr, "\t%-20s %12ju calls, %12ju cycles over %ju samples"
+			" (avg %ju)\n",
+			scope_names[scope],
+			(uintmax_t) profile->nb_calls,
+			(uintmax_t) profile->cycles,
+			(uintmax_t) profile->nb_samples,
+			(uintmax_t) (profile->nb_samples > 0
+					? profile->cycles / profile->nb_samples : 0));
+	}
+}
@@ -0,0 +1,119 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#ifndef SCOPE_PROFILE_H
+#define SCOPE_PROFILE_H
+
+#include <stdint.h> /* uint64_t, */
+#if !defined(__x86_64__) && !defined(__i386__) && !defined(__aarch64__)
+#include <time.h>   /* clock_gettime(2), */
+#endif
+
+/* Always-on sampled profile of PRoot's own hot layers: every call is
+ * counted, one in SCOPE_SAMPLE_INTERVAL is timed with the cycle
+ * counter.  The overhead of the common (unsampled) call is one
+ * increment and one test, cheap enough to stay compiled in.  Totals
+ * are dumped on SIGUSR1/SIGUSR2 along with the other statistics, and
+ * once the event loop ends.  */
+
+typedef enum {
+	SCOPE_CANONICALIZE = 0,
+	SCOPE_SUBSTITUTE_BINDING,
+	SCOPE_READ_DATA,
+	SCOPE_WRITE_DATA,
+	SCOPE_FETCH_REGS,
+	SCOPE_PUSH_REGS,
+	SCOPE_NOTIFY_EXTENSIONS,
+	NB_SCOPES
+} ProfiledScope;
+
+/* Must be a power of two: the sampling test is a mere mask.  */
+#define SCOPE_SAMPLE_INTERVAL 64
+
+typedef struct {
+	uint64_t nb_calls;
+	uint64_t nb_samples;
+	uint64_t cycles;
+} ScopeProfile;
+
+extern ScopeProfile scope_profiles[NB_SCOPES];
+
+/**
+ * Return the per-CPU cycle counter; granularity doesn't matter much
+ * since only relative weights between scopes are looked at.
+ */
+static inline uint64_t read_cycle_counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t low, high;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+	return ((uint64_t) high << 32) | low;
+#elif defined(__aarch64__)
+	uint64_t counter;
+
+	__asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (counter));
+	return counter;
+#else
+	struct timespec now;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * UINT64_C(1000000000) + now.tv_nsec;
+#endif
+}
+
+/**
+ * Account one call to @scope.  This function returns 0 for the calls
+ * that are not sampled, otherwise a non-null start stamp to hand over
+ * to profile_scope_exit().
+ */
+static inline uint64_t profile_scope_enter(ProfiledScope scope)
+{
+	ScopeProfile *profile = &scope_profiles[scope];
+
+	profile->nb_calls++;
+	if ((profile->nb_calls & (SCOPE_SAMPLE_INTERVAL - 1)) != 0)
+		return 0;
+
+	/* "| 1" keeps a counter that reads zero distinguishable from
+	 * "not sampled".  */
+	return read_cycle_counter() | 1;
+}
+
+/**
+ * Close the scope opened by profile_scope_enter(); @start is the
+ * value it returned.
+ */
+static inline void profile_scope_exit(ProfiledScope scope, uint64_t start)
+{
+	ScopeProfile *profile = &scope_profiles[scope];
+
+	if (start == 0)
+		return;
+
+	profile->nb_samples++;
+	profile->cycles += read_cycle_counter() - start;
+}
+
+extern void print_scope_profile(void);
+
+#endif /* SCOPE_PROFILE_H */
@@ -28,6 +28,9 @@
 #include <sys/uio.h>    /* struct iovec, */
 #include <sys/param.h>  /* MIN(), MAX(), */
 #include <string.h>     /* memcpy(3), */
+#include <stdint.h>     /* uint8_t, */
+#include <limits.h>     /* IOV_MAX, INT_MAX, */
+#include <talloc.h>     /* talloc_*, */
 
 #include "ptrace/ptrace.h"
 #include "ptrace/user.h"
@@ -72,6 +75,9 @@ static const char *stringify_ptrace(enum __ptrace_request request)
 	CASE_STR(PTRACE_GETSIGINFO)	CASE_STR(PTRACE_SETSIGINFO)	CASE_STR(PTRACE_GETREGSET)
 	CASE_STR(PTRACE_SETREGSET)	CASE_STR(PTRACE_SEIZE)		CASE_STR(PTRACE_INTERRUPT)
 	CASE_STR(PTRACE_LISTEN)		CASE_STR(PTRACE_SET_SYSCALL)
+#if defined(PTRACE_GET_SYSCALL_INFO)
+	CASE_STR(PTRACE_GET_SYSCALL_INFO)
+#endif
 	CASE_STR(PTRACE_GET_THREAD_AREA)	CASE_STR(PTRACE_SET_THREAD_AREA)
 	CASE_STR(PTRACE_GETVFPREGS)	CASE_STR(PTRACE_SINGLEBLOCK)	CASE_STR(PTRACE_ARCH_PRCTL)
 	default: return "PTRACE_???"; }
@@ -94,11 +100,19 @@ int translate_ptrace_enter(Tracee *tracee)
  * Set @ptracee's tracer to @ptracer, and increment ptracees counter
  * of this later.
  */
+/* Whether at least one tracee ever became an emulated ptracer: a
+ * one-way latch used by event_loop() to select a dispatch variant
+ * without the ptrace emulation branches.  */
+bool ptrace_emulation_active = false;
+
 void attach_to_ptracer(Tracee *ptracee, Tracee *ptracer)
 {
+	ptrace_emulation_active = true;
+
 	bzero(&(PTRACEE), sizeof(PTRACEE));
 	PTRACEE.ptracer = ptracer;
 
+	LIST_INSERT_HEAD(&PTRACER.ptracees, ptracee, as_ptracee.sibling);
 	PTRACER.nb_ptracees++;
 }
 
@@ -111,11 +125,92 @@ void detach_from_ptracer(Tracee *ptracee)
 	Tracee *ptracer = PTRACEE.ptracer;
 
 	PTRACEE.ptracer = NULL;
+	LIST_REMOVE(ptracee, as_ptracee.sibling);
 
 	assert(PTRACER.nb_ptracees > 0);
 	PTRACER.nb_ptracees--;
 }
 
+/* Read-ahead buffer for the PEEKTEXT/PEEKDATA requests.  Debuggers
+ * dump large memory areas one word at a time; once a sequential
+ * pattern is detected, a whole page is fetched from the ptracee with
+ * a single bulk transfer and the next peeks are served from this
+ * buffer.  It is filled page-wise -- a mapped address guarantees the
+ * rest of its page is readable too -- and is invalidated as soon as
+ * the ptracee runs again (see restart_tracee()) or its memory is
+ * written to.  */
+#define PEEK_CACHE_SIZE 4096
+static struct {
+	pid_t pid;
+	word_t base;
+	size_t size;
+	word_t next_address;
+	uint8_t buffer[PEEK_CACHE_SIZE];
+} peek_cache;
+
+/**
+ * Forget the content of the peek cache if it belongs to @ptracee.
+ */
+void invalidate_peek_cache(const Tracee *ptracee)
+{
+	if (peek_cache.pid == ptracee->pid) {
+		peek_cache.pid  = 0;
+		peek_cache.size = 0;
+	}
+}
+
+/**
+ * Read the word at @address in @ptracee's memory, through the peek
+ * cache whenever possible.  This function returns -errno if an error
+ * occured, otherwise 0 and @result is updated.
+ */
+static int peek_ptracee_word(Tracee *ptracee, word_t address, word_t *result)
+{
+	int status;
+
+	/* Served from the read-ahead buffer?  */
+	if (peek_cache.pid == ptracee->pid
+	    && peek_cache.size > 0
+	    && address >= peek_cache.base
+	    && address + sizeof(word_t) <= peek_cache.base + peek_cache.size) {
+		memcpy(result, peek_cache.buffer + (address - peek_cache.base),
+			sizeof(word_t));
+		peek_cache.next_address = address + sizeof(word_t);
+		return 0;
+	}
+
+	/* Sequential pattern detected: fill the buffer up to the end
+	 * of the current page with one bulk transfer.  A failure is
+	 * not fatal, the peek below still stands a chance (and fails
+	 * with the expected errno otherwise).  */
+	if (peek_cache.pid == ptracee->pid && address == peek_cache.next_address) {
+		size_t size = PEEK_CACHE_SIZE - (address % PEEK_CACHE_SIZE);
+
+		if (size >= sizeof(word_t)) {
+			status = read_data(ptracee, peek_cache.buffer, address, size);
+			if (status == 0) {
+				peek_cache.base = address;
+				peek_cache.size = size;
+
+				memcpy(result, peek_cache.buffer, sizeof(word_t));
+				peek_cache.next_address = address + sizeof(word_t);
+				return 0;
+			}
+		}
+	}
+
+	errno = 0;
+	*result = (word_t) ptrace(PTRACE_PEEKDATA, ptracee->pid, address, NULL);
+	if (errno != 0)
+		return -errno;
+
+	peek_cache.pid = ptracee->pid;
+	peek_cache.size = 0;
+	peek_cache.next_address = address + sizeof(word_t);
+
+	return 0;
+}
+
 /**
  * Emulate the ptrace syscall made by @tracee.  This function returns
  * -errno if an error occured (unsupported request), otherwise 0.
@@ -279,9 +374,7 @@ int translate_ptrace_exit(Tracee *tracee)
 			if (address == (word_t) -1)
 				return -EIO;
 		}
-		/* Fall through.  */
-	case PTRACE_PEEKTEXT:
-	case PTRACE_PEEKDATA:
+
 		errno = 0;
 		result = (word_t) ptrace(request, pid, address, NULL);
 		if (errno != 0)
@@ -293,6 +386,18 @@ int translate_ptrace_exit(Tracee *tracee)
 
 		return 0;  /* Don't restart the ptracee.  */
 
+	case PTRACE_PEEKTEXT:
+	case PTRACE_PEEKDATA:
+		status = peek_ptracee_word(ptracee, address, &result);
+		if (status < 0)
+			return status;
+
+		poke_word(ptracer, data, result);
+		if (errno != 0)
+			return -errno;
+
+		return 0;  /* Don't restart the ptracee.  */
+
 	case PTRACE_POKEUSER:
 		if (is_32on64_mode(ptracer)) {
 			address = convert_user_offset(address);
@@ -308,6 +413,8 @@ int translate_ptrace_exit(Tracee *tracee)
 
 	case PTRACE_POKETEXT:
 	case PTRACE_POKEDATA:
+		invalidate_peek_cache(ptracee);
+
 		if (is_32on64_mode(ptracer)) {
 			word_t tmp;
 
@@ -325,6 +432,34 @@ int translate_ptrace_exit(Tracee *tracee)
 
 		return 0;  /* Don't restart the ptracee.  */
 
+#if defined(PTRACE_GET_SYSCALL_INFO)
+	case PTRACE_GET_SYSCALL_INFO: {
+		struct __ptrace_syscall_info info;
+		int status2;
+
+		/* PRoot really traces the ptracee, so the kernel's
+		 * answer -- stop type, architecture, syscall number,
+		 * arguments, result -- is exactly what this emulated
+		 * tracer should observe at the current stop; no need
+		 * to synthesize it from several GETREGSET calls.
+		 * Note @address holds the size of the destination
+		 * buffer for this request.  */
+		status = ptrace(request, pid, sizeof(info), &info);
+		if (status < 0)
+			return -errno;
+
+		status2 = write_data(ptracer, data,
+				&info, MIN((size_t) address,
+					MIN((size_t) status, sizeof(info))));
+		if (status2 < 0)
+			return status2;
+
+		/* Like the kernel: report how many bytes were
+		 * available, even if the buffer was smaller.  */
+		return status;  /* Don't restart the ptracee.  */
+	}
+#endif
+
 	case PTRACE_GETSIGINFO: {
 		siginfo_t siginfo;
 
@@ -654,3 +789,170 @@ int translate_ptrace_exit(Tracee *tracee)
 
 	return status;
 }
+
+/**
+ * Return the ptracee of @ptracer whose process id is @pid, or NULL if
+ * there's none (zombies don't count).
+ */
+static Tracee *get_ptracee_by_pid(Tracee *ptracer, pid_t pid)
+{
+	Tracee *ptracee;
+
+	LIST_FOREACH(ptracee, &PTRACER.ptracees, as_ptracee.sibling) {
+		if (ptracee->pid == pid && !PTRACEE.is_zombie)
+			return ptracee;
+	}
+
+	return NULL;
+}
+
+/**
+ * Translate the process_vm_readv(2) or process_vm_writev(2) syscall
+ * made by @tracee.  It is emulated only when it targets one of
+ * @tracee's own emulated ptracees: the kernel doesn't know about this
+ * tracing relationship, hence would likely deny the access.  This
+ * gives nested debuggers a bulk transfer path, instead of falling
+ * back to one PTRACE_PEEKDATA per word.
+ */
+int translate_process_vm_enter(Tracee *tracee)
+{
+	Tracee *ptracee;
+
+	ptracee = get_ptracee_by_pid(tracee, peek_reg(tracee, CURRENT, SYSARG_1));
+	if (ptracee == NULL)
+		return 0;  /* Not one of its ptracees: regular kernel path.  */
+
+	set_sysnum(tracee, PR_void);
+	return 0;
+}
+
+/* Size of the bounce buffer used to transfer data between a tracee
+ * and its emulated ptracee; larger transfers are simply split.  */
+#define PROCESS_VM_CHUNK 65536
+
+/**
+ * Emulate the process_vm_readv(2) or process_vm_writev(2) syscall
+ * made by @tracee, substituted during the enter stage (see
+ * translate_process_vm_enter()).  This function returns the number of
+ * bytes transferred, or -errno if nothing was transferred at all.
+ */
+int translate_process_vm_exit(Tracee *tracee)
+{
+	word_t local_iov, remote_iov;
+	size_t liovcnt, riovcnt;
+	word_t local_base = 0;
+	size_t local_size = 0;
+	size_t total = 0;
+	size_t li, ri;
+	Tracee *ptracee;
+	bool reading;
+	void *buffer;
+	int status;
+
+	reading = (get_sysnum(tracee, ORIGINAL) == PR_process_vm_readv);
+
+	ptracee = get_ptracee_by_pid(tracee, peek_reg(tracee, ORIGINAL, SYSARG_1));
+	if (ptracee == NULL)
+		return -ESRCH;
+
+	local_iov  = peek_reg(tracee, ORIGINAL, SYSARG_2);
+	liovcnt    = peek_reg(tracee, ORIGINAL, SYSARG_3);
+	remote_iov = peek_reg(tracee, ORIGINAL, SYSARG_4);
+	riovcnt    = peek_reg(tracee, ORIGINAL, SYSARG_5);
+
+	/* No flags are defined yet.  */
+	if (peek_reg(tracee, ORIGINAL, SYSARG_6) != 0)
+		return -EINVAL;
+
+	if (liovcnt > IOV_MAX || riovcnt > IOV_MAX)
+		return -EINVAL;
+
+	buffer = talloc_size(tracee->ctx, PROCESS_VM_CHUNK);
+	if (buffer == NULL)
+		return -ENOMEM;
+
+	if (!reading)
+		invalidate_peek_cache(ptracee);
+
+	/* Transfer the remote stream into the local one (or
+	 * conversely), as the kernel does: the iovec boundaries of
+	 * one side are not required to match the other side's.  */
+	status = 0;
+	li = 0;
+	for (ri = 0; ri < riovcnt; ri++) {
+		word_t remote_base;
+		size_t remote_size;
+
+		remote_base = peek_word(tracee, remote_iov + 2 * ri * sizeof_word(tracee));
+		if (errno != 0) {
+			status = -errno;
+			goto end;
+		}
+
+		remote_size = peek_word(tracee, remote_iov + (2 * ri + 1) * sizeof_word(tracee));
+		if (errno != 0) {
+			status = -errno;
+			goto end;
+		}
+
+		while (remote_size > 0) {
+			size_t size;
+
+			/* Pull the next non-empty local iovec.  */
+			while (local_size == 0) {
+				if (li >= liovcnt)
+					goto end;
+
+				local_base = peek_word(tracee,
+						local_iov + 2 * li * sizeof_word(tracee));
+				if (errno != 0) {
+					status = -errno;
+					goto end;
+				}
+
+				local_size = peek_word(tracee,
+						local_iov + (2 * li + 1) * sizeof_word(tracee));
+				if (errno != 0) {
+					status = -errno;
+					goto end;
+				}
+
+				li++;
+			}
+
+			size = MIN(remote_size, local_size);
+			size = MIN(size, PROCESS_VM_CHUNK);
+
+			if (reading) {
+				status = read_data(ptracee, buffer, remote_base, size);
+				if (status < 0)
+					goto end;
+
+				status = write_data(tracee, local_base, buffer, size);
+			}
+			else {
+				status = read_data(tracee, buffer, local_base, size);
+				if (status < 0)
+					goto end;
+
+				status = write_data(ptracee, remote_base, buffer, size);
+			}
+			if (status < 0)
+				goto end;
+
+			total       += size;
+			remote_base += size;
+			remote_size -= size;
+			local_base  += size;
+			local_size  -= size;
+		}
+	}
+
+end:
+	/* Like the kernel: report a partial transfer, the error is
+	 * returned only if nothing was transferred at all.  */
+	if (total > 0)
+		return (int) MIN(total, (size_t) INT_MAX);
+
+	return status;
+}
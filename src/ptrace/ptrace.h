@@ -27,8 +27,12 @@
 
 extern int translate_ptrace_enter(Tracee *tracee);
 extern int translate_ptrace_exit(Tracee *tracee);
+extern int translate_process_vm_enter(Tracee *tracee);
+extern int translate_process_vm_exit(Tracee *tracee);
 extern void attach_to_ptracer(Tracee *ptracee, Tracee *ptracer);
+extern bool ptrace_emulation_active;
 extern void detach_from_ptracer(Tracee *ptracee);
+extern void invalidate_peek_cache(const Tracee *ptracee);
 
 #define PTRACEE (ptracee->as_ptracee)
 #define PTRACER (ptracer->as_ptracer)
@@ -32,13 +32,40 @@
 #include "arch.h"
 
 struct chained_syscall {
-	Sysnum sysnum;
+	word_t sysnum;  /* architecture value, detranslated once.  */
 	word_t sysargs[6];
 	STAILQ_ENTRY(chained_syscall) link;
 };
 
 STAILQ_HEAD(chained_syscalls, chained_syscall);
 
+/* Number of chain entries preallocated per tracee; enough for the
+ * longest known chain (sockaddr fixups, emulated fd flags), longer
+ * chains simply fall back to the heap.  */
+#define NB_POOLED_SYSCALLS 8
+
+/* Per-tracee pool: issuing a chain of syscalls does no dynamic
+ * allocation, and the address of the original syscall trap --
+ * identical for every link of a chain -- is computed only once.  */
+struct syscall_chain_pool {
+	struct chained_syscalls syscalls;
+	struct chained_syscall entries[NB_POOLED_SYSCALLS];
+	size_t nb_used;
+
+	word_t trap_instr_pointer;
+	bool trap_instr_pointer_known;
+};
+
+/**
+ * Return true if @syscall belongs to @pool->entries.
+ */
+static bool is_pooled(const struct syscall_chain_pool *pool,
+		const struct chained_syscall *syscall)
+{
+	return (syscall >= &pool->entries[0]
+	     && syscall <  &pool->entries[NB_POOLED_SYSCALLS]);
+}
+
 /**
  * Append a new syscall (@sysnum, @sysarg_*) to the list of
  * "unrequested" syscalls for the given @tracee.  These new syscalls
@@ -51,21 +78,39 @@ int register_chained_syscall(Tracee *tracee, Sysnum sysnum,
 			word_t sysarg_1, word_t sysarg_2, word_t sysarg_3,
 			word_t sysarg_4, word_t sysarg_5, word_t sysarg_6)
 {
+	struct syscall_chain_pool *pool = tracee->chain.pool;
 	struct chained_syscall *syscall;
 
-	if (tracee->chain.syscalls == NULL) {
-		tracee->chain.syscalls = talloc_zero(tracee, struct chained_syscalls);
-		if (tracee->chain.syscalls == NULL)
+	/* The pool is allocated once then recycled from one chain to
+	 * the next.  */
+	if (pool == NULL) {
+		pool = talloc_zero(tracee, struct syscall_chain_pool);
+		if (pool == NULL)
 			return -ENOMEM;
 
-		STAILQ_INIT(tracee->chain.syscalls);
+		tracee->chain.pool = pool;
 	}
 
-	syscall = talloc_zero(tracee->chain.syscalls, struct chained_syscall);
-	if (syscall == NULL)
-		return -ENOMEM;
+	if (tracee->chain.syscalls == NULL) {
+		STAILQ_INIT(&pool->syscalls);
+		pool->nb_used = 0;
+		pool->trap_instr_pointer_known = false;
+
+		tracee->chain.syscalls = &pool->syscalls;
+	}
+
+	if (pool->nb_used < NB_POOLED_SYSCALLS)
+		syscall = &pool->entries[pool->nb_used++];
+	else {
+		/* Longer chains fall back to the heap.  */
+		syscall = talloc_zero(pool, struct chained_syscall);
+		if (syscall == NULL)
+			return -ENOMEM;
+	}
 
-	syscall->sysnum     = sysnum;
+	/* The ABI can't change before the chain is done: the
+	 * architecture value is computed right away.  */
+	syscall->sysnum     = detranslate_sysnum(get_abi(tracee), sysnum);
 	syscall->sysargs[0] = sysarg_1;
 	syscall->sysargs[1] = sysarg_2;
 	syscall->sysargs[2] = sysarg_3;
@@ -85,16 +130,17 @@ int register_chained_syscall(Tracee *tracee, Sysnum sysnum,
  */
 void chain_next_syscall(Tracee *tracee)
 {
+	struct syscall_chain_pool *pool = tracee->chain.pool;
 	struct chained_syscall *syscall;
-	word_t instr_pointer;
-	word_t sysnum;
 
 	assert(tracee->chain.syscalls != NULL);
+	assert(pool != NULL);
 
 	/* No more chained syscalls: force the result of the initial
-	 * syscall (the one explicitly requested by the tracee).  */
+	 * syscall (the one explicitly requested by the tracee).  The
+	 * pool is kept for the next chain.  */
 	if (STAILQ_EMPTY(tracee->chain.syscalls)) {
-		TALLOC_FREE(tracee->chain.syscalls);
+		tracee->chain.syscalls = NULL;
 
 		if (tracee->chain.force_final_result)
 			poke_reg(tracee, SYSARG_RESULT, tracee->chain.final_result);
@@ -113,6 +159,11 @@ void chain_next_syscall(Tracee *tracee)
 	syscall = STAILQ_FIRST(tracee->chain.syscalls);
 	STAILQ_REMOVE_HEAD(tracee->chain.syscalls, link);
 
+	/* The registers still cached from the previous link act as the
+	 * template: poke_reg() drops writes of values already held, so
+	 * only the per-link deltas end up in the dirty mask and
+	 * push_regs() transfers just those -- a glue mkdir(2) link
+	 * boils down to a couple of PTRACE_POKEUSER.  */
 	poke_reg(tracee, SYSARG_1, syscall->sysargs[0]);
 	poke_reg(tracee, SYSARG_2, syscall->sysargs[1]);
 	poke_reg(tracee, SYSARG_3, syscall->sysargs[2]);
@@ -120,12 +171,19 @@ void chain_next_syscall(Tracee *tracee)
 	poke_reg(tracee, SYSARG_5, syscall->sysargs[4]);
 	poke_reg(tracee, SYSARG_6, syscall->sysargs[5]);
 
-	sysnum = detranslate_sysnum(get_abi(tracee), syscall->sysnum);
-	poke_reg(tracee, SYSTRAP_NUM, sysnum);
+	poke_reg(tracee, SYSTRAP_NUM, syscall->sysnum);
+
+	/* Move the instruction pointer back to the original trap; its
+	 * address is the same for every link of the chain.  */
+	if (!pool->trap_instr_pointer_known) {
+		pool->trap_instr_pointer =
+			peek_reg(tracee, CURRENT, INSTR_POINTER) - SYSTRAP_SIZE;
+		pool->trap_instr_pointer_known = true;
+	}
+	poke_reg(tracee, INSTR_POINTER, pool->trap_instr_pointer);
 
-	/* Move the instruction pointer back to the original trap.  */
-	instr_pointer = peek_reg(tracee, CURRENT, INSTR_POINTER);
-	poke_reg(tracee, INSTR_POINTER, instr_pointer - SYSTRAP_SIZE);
+	if (!is_pooled(pool, syscall))
+		TALLOC_FREE(syscall);
 }
 
 /**
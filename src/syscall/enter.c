@@ -21,15 +21,21 @@
  */
 
 #include <errno.h>       /* errno(3), E* */
+#include <stdint.h>      /* uint32_t, */
+#include <string.h>      /* strcpy(3), */
+#include <stdlib.h>      /* getenv(3), */
 #include <talloc.h>      /* talloc_*, */
 #include <sys/un.h>      /* struct sockaddr_un, */
+#include <sys/stat.h>    /* lstat(2), S_IXUSR, */
+#include <sys/inotify.h> /* IN_DONT_FOLLOW, */
 #include <linux/net.h>   /* SYS_*, */
-#include <fcntl.h>       /* AT_FDCWD, */
+#include <fcntl.h>       /* AT_FDCWD, O_*, AT_*, */
 #include <limits.h>      /* PATH_MAX, */
 
 #include "syscall/syscall.h"
 #include "syscall/sysnum.h"
 #include "syscall/socket.h"
+#include "syscall/seccomp.h"
 #include "ptrace/ptrace.h"
 #include "ptrace/wait.h"
 #include "syscall/heap.h"
@@ -40,8 +46,11 @@
 #include "tracee/mem.h"
 #include "tracee/abi.h"
 #include "path/path.h"
+#include "path/cache.h"
 #include "path/canon.h"
+#include "path/proc.h"
 #include "arch.h"
+#include "attribute.h"
 
 /**
  * Translate @path and put the result in the @tracee's memory address
@@ -64,6 +73,11 @@ static int translate_path2(Tracee *tracee, int dir_fd, char path[PATH_MAX], Reg
 	if (status < 0)
 		return status;
 
+	/* No need to stage a new buffer in the tracee's memory when
+	 * the translation is the identity, as with "-r /".  */
+	if (strcmp(path, new_path) == 0)
+		return 0;
+
 	return set_sysarg_path(tracee, new_path, reg);
 }
 
@@ -83,487 +97,1139 @@ static int translate_sysarg(Tracee *tracee, Reg reg, Type type)
 	return translate_path2(tracee, AT_FDCWD, old_path, reg, type);
 }
 
+/* Lookaside over the whole enter handling of the one-path syscalls
+ * (stat, access, chmod, ...): keyed by the raw -- possibly relative
+ * -- path argument, it records the outcome of the last translation,
+ * either the host path to stage or "identity, no action", so shell
+ * loops that probe the same file again and again skip
+ * translate_path() entirely.  Recorded outcomes derive from path
+ * translations, hence they go stale at the very same flush points as
+ * the translation cache; a change of working directory or of
+ * file-system name-space recycles the whole table.  Like the other
+ * caches it is disabled as soon as an extension is enabled, see
+ * cacheable_tracee() in path/cache.c.  */
+
+#define NB_ENTER_LOOKASIDE_ENTRIES 64
+
+typedef struct {
+	/* Raw path argument, NULL when the slot is empty.  */
+	char *path;
+	bool deref_final;
+
+	/* Recorded outcome: the host path to stage, or NULL when the
+	 * translation was the identity.  */
+	char *host_path;
+} EnterLookasideEntry;
+
+typedef struct enter_lookaside {
+	/* Value of path_cache_generation() when the table was last
+	 * recycled.  */
+	uint64_t generation;
+
+	/* Name-space and working directory every recorded outcome is
+	 * relative to.  */
+	const FileSystemNameSpace *fs;
+	char cwd[PATH_MAX];
+
+	/* Direct-mapped: a new outcome simply evicts the previous one
+	 * from its slot.  */
+	EnterLookasideEntry entries[NB_ENTER_LOOKASIDE_ENTRIES];
+} EnterLookaside;
+
 /**
- * Translate the input arguments of the current @tracee's syscall in the
- * @tracee->pid process area. This function sets @tracee->status to
- * -errno if an error occured from the tracee's point-of-view (EFAULT
- * for instance), otherwise 0.
+ * Return the slot associated with (@path, @deref_final).
  */
-int translate_syscall_enter(Tracee *tracee)
+static EnterLookasideEntry *get_lookaside_slot(EnterLookaside *lookaside,
+					const char *path, bool deref_final)
 {
-	int flags;
-	int dirfd;
-	int olddirfd;
-	int newdirfd;
+	uint64_t hash = 5381;
 
-	int status;
-	int status2;
+	while (*path != '\0')
+		hash = hash * 33 + (unsigned char) *path++;
+	hash = hash * 33 + (deref_final ? 1 : 0);
+
+	return &lookaside->entries[hash % NB_ENTER_LOOKASIDE_ENTRIES];
+}
+
+/**
+ * Return @tracee's lookaside table, with every stale outcome flushed;
+ * NULL when the lookaside is not usable for this tracee.
+ */
+static EnterLookaside *get_enter_lookaside(Tracee *tracee)
+{
+	EnterLookaside *lookaside = tracee->enter_lookaside;
+
+	if (!cacheable_tracee(tracee) || tracee->fs->cwd == NULL)
+		return NULL;
+
+	if (lookaside == NULL) {
+		lookaside = talloc_zero(tracee, EnterLookaside);
+		if (lookaside == NULL)
+			return NULL;
+		tracee->enter_lookaside = lookaside;
+	}
+
+	/* Any mutating syscall, chdir(2), or name-space change makes
+	 * every recorded outcome stale: recycle the whole table.  */
+	if (   lookaside->generation != path_cache_generation()
+	    || lookaside->fs != tracee->fs
+	    || strcmp(lookaside->cwd, tracee->fs->cwd) != 0) {
+		size_t i;
+
+		for (i = 0; i < NB_ENTER_LOOKASIDE_ENTRIES; i++) {
+			TALLOC_FREE(lookaside->entries[i].path);
+			TALLOC_FREE(lookaside->entries[i].host_path);
+		}
 
+		lookaside->generation = path_cache_generation();
+		lookaside->fs = tracee->fs;
+		strcpy(lookaside->cwd, tracee->fs->cwd);
+	}
+
+	return lookaside;
+}
+
+/**
+ * Like translate_sysarg() but the outcome is memoized: on a hit the
+ * recorded action is applied directly, skipping translate_path()
+ * altogether.  This function returns -errno if an error occured,
+ * otherwise 0.
+ */
+static int enter_sysarg1_lookaside(Tracee *tracee, Type type)
+{
+	const bool deref_final = (type != SYMLINK);
+	EnterLookasideEntry *entry;
+	EnterLookaside *lookaside;
+	char new_path[PATH_MAX];
 	char path[PATH_MAX];
-	char oldpath[PATH_MAX];
-	char newpath[PATH_MAX];
+	int status;
 
-	word_t syscall_number;
-	bool special = false;
+	status = get_sysarg_path(tracee, path, SYSARG_1);
+	if (status < 0)
+		return status;
 
-	status = notify_extensions(tracee, SYSCALL_ENTER_START, 0, 0);
+	/* Special case where the argument was NULL. */
+	if (path[0] == '\0')
+		return 0;
+
+	lookaside = get_enter_lookaside(tracee);
+	if (lookaside == NULL)
+		return translate_path2(tracee, AT_FDCWD, path, SYSARG_1, type);
+
+	entry = get_lookaside_slot(lookaside, path, deref_final);
+
+	/* Hit: apply the recorded action directly.  */
+	if (   entry->path != NULL
+	    && entry->deref_final == deref_final
+	    && strcmp(entry->path, path) == 0) {
+		if (entry->host_path == NULL)
+			return 0;
+		return set_sysarg_path(tracee, entry->host_path, SYSARG_1);
+	}
+
+	status = translate_path(tracee, new_path, AT_FDCWD, path, deref_final);
 	if (status < 0)
-		goto end;
-	if (status > 0)
+		return status;
+
+	/* Record the outcome; allocation failures simply leave the
+	 * slot empty, this is just a cache.  */
+	TALLOC_FREE(entry->path);
+	TALLOC_FREE(entry->host_path);
+
+	entry->path = talloc_strdup(lookaside, path);
+	entry->deref_final = deref_final;
+
+	/* No need to stage a new buffer in the tracee's memory when
+	 * the translation is the identity, as with "-r /".  */
+	if (strcmp(path, new_path) == 0)
 		return 0;
 
-	/* Translate input arguments. */
-	syscall_number = get_sysnum(tracee, ORIGINAL);
-	switch (syscall_number) {
-	default:
-		/* Nothing to do. */
-		status = 0;
-		break;
+	if (entry->path != NULL) {
+		entry->host_path = talloc_strdup(lookaside, new_path);
+		if (entry->host_path == NULL)
+			TALLOC_FREE(entry->path);
+	}
 
-	case PR_execve:
-		status = translate_execve_enter(tracee);
-		break;
+	return set_sysarg_path(tracee, new_path, SYSARG_1);
+}
 
-	case PR_ptrace:
-		status = translate_ptrace_enter(tracee);
-		break;
+/* Flags of the per-sysnum descriptors below.  */
+#define SYSENTER_FLUSH_PATH_CACHE	(UINT32_C(1) << 0)
+#define SYSENTER_FLUSH_NEGATIVE_CACHE	(UINT32_C(1) << 1)
+#define SYSENTER_NEEDS_SYSEXIT		(UINT32_C(1) << 2)
 
-	case PR_wait4:
-	case PR_waitpid:
-		status = translate_wait_enter(tracee);
-		break;
+/* One path argument of a syscall: where it is, what anchors it, and
+ * how its final symbolic link is handled.  */
+typedef struct {
+	/* Register holding the path, 0 when the slot is unused.  */
+	uint8_t path;
 
-	case PR_brk:
-		status = translate_brk_enter(tracee);
-		break;
+	/* Register holding the anchor directory fd for "*at"
+	 * syscalls, 0 when the path is relative to the cwd.  */
+	uint8_t dirfd;
 
-	case PR_getcwd:
-		set_sysnum(tracee, PR_void);
-		status = 0;
-		break;
+	/* Type (REGULAR or SYMLINK) given to translate_path().  */
+	uint8_t type;
+} PathArg;
 
-	case PR_fchdir:
-	case PR_chdir: {
-		struct stat statl;
-		char *tmp;
+#define MAX_PATH_ARGS 2
 
-		/* The ending "." ensures an error will be reported if
-		 * path does not exist or if it is not a directory.  */
-		if (syscall_number == PR_chdir) {
-			status = get_sysarg_path(tracee, path, SYSARG_1);
-			if (status < 0)
-				break;
+typedef struct {
+	/* Handler called at the enter stage; NULL when @args below --
+	 * interpreted by enter_path_args() -- says it all, or when
+	 * there's nothing to do.  */
+	int (*handler)(Tracee *tracee, Sysnum sysnum);
 
-			status = join_paths(2, oldpath, path, ".");
-			if (status < 0)
-				break;
+	/* SYSENTER_* metadata.  */
+	uint32_t flags;
 
-			dirfd = AT_FDCWD;
-		}
-		else {
-			strcpy(oldpath, ".");
-			dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
-		}
+	/* Path arguments of this syscall, when they don't depend on
+	 * runtime flags.  */
+	PathArg args[MAX_PATH_ARGS];
+} SyscallDescriptor;
+
+/**
+ * Handler for execve(2) at the enter stage.
+ */
+static int enter_execve(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	return translate_execve_enter(tracee);
+}
+
+/**
+ * Handler for ptrace(2) at the enter stage.
+ */
+static int enter_ptrace(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	return translate_ptrace_enter(tracee);
+}
+
+/**
+ * Handler for process_vm_readv(2) and process_vm_writev(2) at the
+ * enter stage.
+ */
+static int enter_process_vm(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	return translate_process_vm_enter(tracee);
+}
+
+/**
+ * Handler for wait4(2) and waitpid(2) at the enter stage.
+ */
+static int enter_wait(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	return translate_wait_enter(tracee);
+}
+
+/**
+ * Handler for brk(2) at the enter stage.
+ */
+static int enter_brk(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	return translate_brk_enter(tracee);
+}
+
+/**
+ * Handler for getcwd(2) at the enter stage: the whole emulation is
+ * performed at the exit stage.
+ */
+static int enter_getcwd(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	set_sysnum(tracee, PR_void);
+	return 0;
+}
 
-		status = translate_path(tracee, path, dirfd, oldpath, true);
+/**
+ * Check whether $PROOT_FAST_CHDIR is set, ie. whether enter_chdir()
+ * trusts the kernel to validate the target instead of stat-ing it
+ * itself.
+ */
+static bool fast_chdir(void)
+{
+	static int enabled = -1;
+
+	if (enabled < 0)
+		enabled = (getenv("PROOT_FAST_CHDIR") != NULL);
+
+	return (enabled != 0);
+}
+
+/**
+ * Handler for chdir(2) and fchdir(2) at the enter stage.  By default
+ * these syscalls are fully emulated: the target is validated here and
+ * the new cwd is committed right away.  In fast mode the kernel
+ * performs the actual directory change -- on the translated path --
+ * and the new cwd, staged in @tracee->new_cwd, is committed at the
+ * exit stage iff the kernel accepted it; this spares one stat per
+ * directory change and reports errors with the kernel's own checks.
+ */
+static int enter_chdir(Tracee *tracee, Sysnum sysnum)
+{
+	char host_path[PATH_MAX];
+	char oldpath[PATH_MAX];
+	char path[PATH_MAX];
+	struct stat statl;
+	char *tmp;
+	int dirfd;
+	int status;
+
+	/* The ending "." ensures an error will be reported if path
+	 * does not exist or if it is not a directory.  */
+	if (sysnum == PR_chdir) {
+		status = get_sysarg_path(tracee, path, SYSARG_1);
 		if (status < 0)
-			break;
+			return status;
+
+		status = join_paths(2, oldpath, path, ".");
+		if (status < 0)
+			return status;
+
+		dirfd = AT_FDCWD;
+	}
+	else {
+		strcpy(oldpath, ".");
+		dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+	}
+
+	status = translate_path(tracee, path, dirfd, oldpath, true);
+	if (status < 0)
+		return status;
+
+	strcpy(host_path, path);
+	chop_finality(host_path);
 
+	if (!fast_chdir()) {
 		status = lstat(path, &statl);
 		if (status < 0)
-			break;
+			return status;
 
 		/* Check this directory is accessible.  */
 		if ((statl.st_mode & S_IXUSR) == 0)
 			return -EACCES;
-
-		/* Sadly this method doesn't detranslate statefully,
-		 * this means that there's an ambiguity when several
-		 * bindings are from the same host path:
-		 *
-		 *    $ proot -m /tmp:/a -m /tmp:/b fchdir_getcwd /a
-		 *    /b
-		 *
-		 *    $ proot -m /tmp:/b -m /tmp:/a fchdir_getcwd /a
-		 *    /a
-		 *
-		 * A solution would be to follow each file descriptor
-		 * just like it is done for cwd.
-		 */
-
-		status = detranslate_path(tracee, path, NULL);
+	}
+	else if (sysnum == PR_chdir) {
+		/* Let the kernel walk the translated path; the ending
+		 * "." still guarantees a non-directory target is
+		 * rejected.  Nothing to rewrite for fchdir(2): its
+		 * file descriptor already points to the host side.  */
+		status = set_sysarg_path(tracee, path, SYSARG_1);
 		if (status < 0)
-			break;
+			return status;
+	}
 
-		/* Remove the trailing "/" or "/.".  */
-		chop_finality(path);
+	/* Sadly this method doesn't detranslate statefully, this
+	 * means that there's an ambiguity when several bindings are
+	 * from the same host path:
+	 *
+	 *    $ proot -m /tmp:/a -m /tmp:/b fchdir_getcwd /a
+	 *    /b
+	 *
+	 *    $ proot -m /tmp:/b -m /tmp:/a fchdir_getcwd /a
+	 *    /a
+	 *
+	 * A solution would be to follow each file descriptor just
+	 * like it is done for cwd.
+	 */
+
+	status = detranslate_path(tracee, path, NULL);
+	if (status < 0)
+		return status;
 
-		tmp = talloc_strdup(tracee->fs, path);
-		if (tmp == NULL) {
-			status = -ENOMEM;
-			break;
+	/* Remove the trailing "/" or "/.".  */
+	chop_finality(path);
+
+	if (fast_chdir()) {
+		/* Stage the outcome; the exit stage commits it iff
+		 * the kernel accepted the directory change.  */
+		TALLOC_FREE(tracee->new_cwd);
+		TALLOC_FREE(tracee->new_host_cwd);
+
+		tracee->new_cwd = talloc_strdup(tracee, path);
+		tracee->new_host_cwd = talloc_strdup(tracee, host_path);
+		if (tracee->new_cwd == NULL || tracee->new_host_cwd == NULL) {
+			TALLOC_FREE(tracee->new_cwd);
+			TALLOC_FREE(tracee->new_host_cwd);
+			return -ENOMEM;
 		}
-		TALLOC_FREE(tracee->fs->cwd);
 
-		tracee->fs->cwd = tmp;
-		talloc_set_name_const(tracee->fs->cwd, "$cwd");
+		return 0;
+	}
 
-		set_sysnum(tracee, PR_void);
-		status = 0;
-		break;
+	/* The current working directory is about to change: get this
+	 * tracee out of any copy-on-write name-space sharing.  */
+	status = break_fs_cow(tracee);
+	if (status < 0)
+		return status;
+
+	tmp = talloc_strdup(tracee->fs, path);
+	if (tmp == NULL)
+		return -ENOMEM;
+	TALLOC_FREE(tracee->fs->cwd);
+
+	tracee->fs->cwd = tmp;
+	talloc_set_name_const(tracee->fs->cwd, "$cwd");
+
+	/* Cache the host form validated right above: getcwd(2) then
+	 * only has to check it still exists, instead of re-translating
+	 * the guest cwd on every call.  A failed allocation simply
+	 * leaves the cache empty.  */
+	TALLOC_FREE(tracee->fs->host_cwd);
+	tracee->fs->host_cwd = talloc_strdup(tracee->fs, host_path);
+
+	set_sysnum(tracee, PR_void);
+	return 0;
+}
+
+/**
+ * Handler for rename(2) and renameat(2) at the enter stage: translate
+ * both paths, then decide whether the exit stop is still required.
+ * The exit handler only has work to do when the renamed path is a
+ * prefix of the virtual cwd shared by the tracees of this file-system
+ * name-space, which almost never happens during the rename storms of
+ * package managers; every other rename completes without its exit
+ * stop under seccomp.
+ */
+static int enter_rename(Tracee *tracee, Sysnum sysnum)
+{
+	char old_path[PATH_MAX];
+	char host_path[PATH_MAX];
+	char new_path[PATH_MAX];
+	Comparison comparison;
+	int old_dirfd;
+	int new_dirfd;
+	Reg old_reg;
+	Reg new_reg;
+	int status;
+
+	if (sysnum == PR_rename) {
+		old_reg   = SYSARG_1;
+		new_reg   = SYSARG_2;
+		old_dirfd = AT_FDCWD;
+		new_dirfd = AT_FDCWD;
+	}
+	else {
+		old_reg   = SYSARG_2;
+		new_reg   = SYSARG_4;
+		old_dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+		new_dirfd = peek_reg(tracee, CURRENT, SYSARG_3);
 	}
 
-	case PR_bind:
-	case PR_connect: {
-		word_t address;
-		word_t size;
+	status = get_sysarg_path(tracee, old_path, old_reg);
+	if (status < 0)
+		return status;
 
-		address = peek_reg(tracee, CURRENT, SYSARG_2);
-		size    = peek_reg(tracee, CURRENT, SYSARG_3);
+	/* Same flow as translate_path2(), but the translated path is
+	 * kept around for the cwd check below.  */
+	if (old_path[0] != '\0') {
+		status = translate_path(tracee, host_path, old_dirfd, old_path, false);
+		if (status < 0)
+			return status;
 
-		status = translate_socketcall_enter(tracee, &address, size);
-		if (status <= 0)
-			break;
+		if (strcmp(old_path, host_path) != 0) {
+			status = set_sysarg_path(tracee, host_path, old_reg);
+			if (status < 0)
+				return status;
+		}
+	}
 
-		poke_reg(tracee, SYSARG_2, address);
-		poke_reg(tracee, SYSARG_3, sizeof(struct sockaddr_un));
+	status = get_sysarg_path(tracee, new_path, new_reg);
+	if (status < 0)
+		return status;
 
-		status = 0;
-		break;
+	status = translate_path2(tracee, new_dirfd, new_path, new_reg, SYMLINK);
+	if (status < 0)
+		return status;
+
+	/* Convert the renamed path to the same "point-of-view" as
+	 * tracee->fs->cwd (guest); on failure simply keep the exit
+	 * stop.  */
+	if (old_path[0] != '\0' && tracee->fs->cwd != NULL) {
+		status = detranslate_path(tracee, host_path, NULL);
+		if (status >= 0) {
+			comparison = compare_paths(host_path, tracee->fs->cwd);
+			if (comparison != PATH1_IS_PREFIX && comparison != PATHS_ARE_EQUAL)
+				tracee->sysexit_unneeded = true;
+		}
 	}
 
+	return 0;
+}
+
+/**
+ * Handler for bind(2) and connect(2) at the enter stage.
+ */
+static int enter_sockaddr(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	word_t address;
+	word_t size;
+	int status;
+
+	address = peek_reg(tracee, CURRENT, SYSARG_2);
+	size    = peek_reg(tracee, CURRENT, SYSARG_3);
+
+	status = translate_socketcall_enter(tracee, &address, size);
+	if (status <= 0)
+		return status;
+
+	poke_reg(tracee, SYSARG_2, address);
+	poke_reg(tracee, SYSARG_3, sizeof(struct sockaddr_un));
+
+	return 0;
+}
+
 #define SYSARG_ADDR(n) (args_addr + ((n) - 1) * sizeof_word(tracee))
 
 #define PEEK_WORD(addr, forced_errno)		\
 	peek_word(tracee, addr);		\
-	if (errno != 0) {			\
-		status = forced_errno ?: -errno; \
-		break;				\
-	}
+	if (errno != 0)				\
+		return (forced_errno) ?: -errno;
 
 #define POKE_WORD(addr, value)			\
 	poke_word(tracee, addr, value);		\
-	if (errno != 0) {			\
-		status = -errno;		\
-		break;				\
-	}
+	if (errno != 0)				\
+		return -errno;
 
+/**
+ * Handler for accept(2), accept4(2), getsockname(2) and
+ * getpeername(2) at the enter stage.
+ */
+static int enter_accept(Tracee *tracee, Sysnum sysnum)
+{
+	bool special = false;
+	int size;
+
+	switch (sysnum) {
 	case PR_accept:
 	case PR_accept4:
 		/* Nothing special to do if no sockaddr was specified.  */
-		if (peek_reg(tracee, ORIGINAL, SYSARG_2) == 0) {
-			status = 0;
-			break;
-		}
+		if (peek_reg(tracee, ORIGINAL, SYSARG_2) == 0)
+			return 0;
 		special = true;
-		/* Fall through.  */
-	case PR_getsockname:
-	case PR_getpeername:{
-		int size;
-
-		/* Remember: PEEK_WORD puts -errno in status and breaks if an
-		 * error occured.  */
-		size = (int) PEEK_WORD(peek_reg(tracee, ORIGINAL, SYSARG_3), special ? -EINVAL : 0);
-
-		/* The "size" argument is both used as an input parameter
-		 * (max. size) and as an output parameter (actual size).  The
-		 * exit stage needs to know the max. size to not overwrite
-		 * anything, that's why it is copied in the 6th argument
-		 * (unused) before the kernel updates it.  */
-		poke_reg(tracee, SYSARG_6, size);
+		break;
 
-		status = 0;
+	default:
 		break;
 	}
 
-	case PR_socketcall: {
-		word_t args_addr;
-		word_t sock_addr_saved;
-		word_t sock_addr;
-		word_t size_addr;
-		word_t size;
-
-		args_addr = peek_reg(tracee, CURRENT, SYSARG_2);
-
-		switch (peek_reg(tracee, CURRENT, SYSARG_1)) {
-		case SYS_BIND:
-		case SYS_CONNECT:
-			/* Handle these cases below.  */
-			status = 1;
-			break;
-
-		case SYS_ACCEPT:
-		case SYS_ACCEPT4:
-			/* Nothing special to do if no sockaddr was specified.  */
-			sock_addr = PEEK_WORD(SYSARG_ADDR(2), 0);
-			if (sock_addr == 0) {
-				status = 0;
-				break;
-			}
-			special = true;
-			/* Fall through.  */
-		case SYS_GETSOCKNAME:
-		case SYS_GETPEERNAME:
-			/* Remember: PEEK_WORD puts -errno in status and breaks
-			 * if an error occured.  */
-			size_addr =  PEEK_WORD(SYSARG_ADDR(3), 0);
-			size = (int) PEEK_WORD(size_addr, special ? -EINVAL : 0);
-
-			/* See case PR_accept for explanation.  */
-			poke_reg(tracee, SYSARG_6, size);
-			status = 0;
-			break;
-
-		default:
-			status = 0;
-			break;
-		}
-
-		/* An error occured or there's nothing else to do.  */
-		if (status <= 0)
-			break;
+	/* Remember: PEEK_WORD returns -errno if an error occured.  */
+	size = (int) PEEK_WORD(peek_reg(tracee, ORIGINAL, SYSARG_3), special ? -EINVAL : 0);
 
-		/* Remember: PEEK_WORD puts -errno in status and breaks if an
-		 * error occured.  */
-		sock_addr = PEEK_WORD(SYSARG_ADDR(2), 0);
-		size      = PEEK_WORD(SYSARG_ADDR(3), 0);
+	/* The "size" argument is both used as an input parameter
+	 * (max. size) and as an output parameter (actual size).  The
+	 * exit stage needs to know the max. size to not overwrite
+	 * anything, that's why it is copied in the 6th argument
+	 * (unused) before the kernel updates it.  */
+	poke_reg(tracee, SYSARG_6, size);
 
-		sock_addr_saved = sock_addr;
-		status = translate_socketcall_enter(tracee, &sock_addr, size);
-		if (status <= 0)
-			break;
+	return 0;
+}
 
-		/* These parameters are used/restored at the exit stage.  */
-		poke_reg(tracee, SYSARG_5, sock_addr_saved);
-		poke_reg(tracee, SYSARG_6, size);
+/**
+ * Handler for socketcall(2) at the enter stage.
+ */
+static int enter_socketcall(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	word_t args_addr;
+	word_t sock_addr_saved;
+	word_t sock_addr;
+	word_t size_addr;
+	word_t size;
+	bool special = false;
+	int status;
 
-		/* Remember: POKE_WORD puts -errno in status and breaks if an
-		 * error occured.  */
-		POKE_WORD(SYSARG_ADDR(2), sock_addr);
-		POKE_WORD(SYSARG_ADDR(3), sizeof(struct sockaddr_un));
+	args_addr = peek_reg(tracee, CURRENT, SYSARG_2);
 
-		status = 0;
+	switch (peek_reg(tracee, CURRENT, SYSARG_1)) {
+	case SYS_BIND:
+	case SYS_CONNECT:
+		/* Handle these cases below.  */
 		break;
+
+	case SYS_ACCEPT:
+	case SYS_ACCEPT4:
+		/* Nothing special to do if no sockaddr was specified.  */
+		sock_addr = PEEK_WORD(SYSARG_ADDR(2), 0);
+		if (sock_addr == 0)
+			return 0;
+		special = true;
+		/* Fall through.  */
+	case SYS_GETSOCKNAME:
+	case SYS_GETPEERNAME:
+		/* Remember: PEEK_WORD returns -errno if an error
+		 * occured.  */
+		size_addr = PEEK_WORD(SYSARG_ADDR(3), 0);
+		size = (int) PEEK_WORD(size_addr, special ? -EINVAL : 0);
+
+		/* See enter_accept() for explanation.  */
+		poke_reg(tracee, SYSARG_6, size);
+		return 0;
+
+	default:
+		/* Nothing to do.  */
+		return 0;
 	}
 
+	/* Remember: PEEK_WORD returns -errno if an error occured.  */
+	sock_addr = PEEK_WORD(SYSARG_ADDR(2), 0);
+	size      = PEEK_WORD(SYSARG_ADDR(3), 0);
+
+	sock_addr_saved = sock_addr;
+	status = translate_socketcall_enter(tracee, &sock_addr, size);
+	if (status <= 0)
+		return status;
+
+	/* These parameters are used/restored at the exit stage.  */
+	poke_reg(tracee, SYSARG_5, sock_addr_saved);
+	poke_reg(tracee, SYSARG_6, size);
+
+	/* Remember: POKE_WORD returns -errno if an error occured.  */
+	POKE_WORD(SYSARG_ADDR(2), sock_addr);
+	POKE_WORD(SYSARG_ADDR(3), sizeof(struct sockaddr_un));
+
+	return 0;
+}
+
 #undef SYSARG_ADDR
 #undef PEEK_WORD
 #undef POKE_WORD
 
-	case PR_access:
-	case PR_acct:
-	case PR_chmod:
-	case PR_chown:
-	case PR_chown32:
-	case PR_chroot:
-	case PR_getxattr:
-	case PR_listxattr:
-	case PR_mknod:
-	case PR_oldstat:
-	case PR_creat:
-	case PR_removexattr:
-	case PR_setxattr:
-	case PR_stat:
-	case PR_stat64:
-	case PR_statfs:
-	case PR_statfs64:
-	case PR_swapoff:
-	case PR_swapon:
-	case PR_truncate:
-	case PR_truncate64:
-	case PR_umount:
-	case PR_umount2:
-	case PR_uselib:
-	case PR_utime:
-	case PR_utimes:
-		status = translate_sysarg(tracee, SYSARG_1, REGULAR);
-		break;
+/**
+ * Generic enter handling for the syscalls fully described by the
+ * argument vector of their descriptor: each path argument is
+ * translated in place, anchored at its dirfd argument when the
+ * descriptor names one.  Syscalls whose path semantics depend on
+ * runtime flags -- openat(2), fchownat(2), ... -- have a dedicated
+ * handler instead.
+ */
+static int enter_path_args(Tracee *tracee, const SyscallDescriptor *descriptor)
+{
+	char path[PATH_MAX];
+	size_t i;
+	int status;
+	int dirfd;
 
-	case PR_open:
-		flags = peek_reg(tracee, CURRENT, SYSARG_2);
+	/* The common one-path case goes through the memoizing
+	 * lookaside.  */
+	if (descriptor->args[0].path == SYSARG_1
+	    && descriptor->args[0].dirfd == 0
+	    && descriptor->args[1].path == 0)
+		return enter_sysarg1_lookaside(tracee, descriptor->args[0].type);
 
-		if (   ((flags & O_NOFOLLOW) != 0)
-		    || ((flags & O_EXCL) != 0 && (flags & O_CREAT) != 0))
-			status = translate_sysarg(tracee, SYSARG_1, SYMLINK);
-		else
-			status = translate_sysarg(tracee, SYSARG_1, REGULAR);
-		break;
+	for (i = 0; i < MAX_PATH_ARGS && descriptor->args[i].path != 0; i++) {
+		const PathArg *arg = &descriptor->args[i];
 
-	case PR_fchownat:
-	case PR_fstatat64:
-	case PR_newfstatat:
-	case PR_utimensat:
-	case PR_name_to_handle_at:
-		dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+		if (arg->dirfd == 0) {
+			status = translate_sysarg(tracee, arg->path, arg->type);
+			if (status < 0)
+				return status;
+			continue;
+		}
 
-		status = get_sysarg_path(tracee, path, SYSARG_2);
+		dirfd = peek_reg(tracee, CURRENT, arg->dirfd);
+
+		status = get_sysarg_path(tracee, path, arg->path);
 		if (status < 0)
-			break;
+			return status;
 
-		flags = (  syscall_number == PR_fchownat
-			|| syscall_number == PR_name_to_handle_at)
-			? peek_reg(tracee, CURRENT, SYSARG_5)
-			: peek_reg(tracee, CURRENT, SYSARG_4);
+		status = translate_path2(tracee, dirfd, path, arg->path, arg->type);
+		if (status < 0)
+			return status;
+	}
 
-		if ((flags & AT_SYMLINK_NOFOLLOW) != 0)
-			status = translate_path2(tracee, dirfd, path, SYSARG_2, SYMLINK);
-		else
-			status = translate_path2(tracee, dirfd, path, SYSARG_2, REGULAR);
-		break;
+	return 0;
+}
 
-	case PR_fchmodat:
-	case PR_faccessat:
-	case PR_futimesat:
-	case PR_mknodat:
-		dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+/**
+ * Same as translate_path2() but for open(2)-like syscalls: when the
+ * translated path is the "maps" entry of a tracee and this latter is
+ * opened read-only, a detranslated copy is served instead (see
+ * rewrite_proc_maps()).
+ */
+static int translate_open_sysarg(Tracee *tracee, int dir_fd, char path[PATH_MAX],
+				Reg reg, Type type, int flags)
+{
+	char new_path[PATH_MAX];
+	int status;
 
-		status = get_sysarg_path(tracee, path, SYSARG_2);
+	/* Special case where the argument was NULL. */
+	if (path[0] == '\0')
+		return 0;
+
+	status = translate_path(tracee, new_path, dir_fd, path, type != SYMLINK);
+	if (status < 0)
+		return status;
+
+	/* Tools parsing their own memory map expect guest paths in
+	 * there.  */
+	if ((flags & O_ACCMODE) == O_RDONLY) {
+		status = rewrite_proc_maps(tracee, new_path);
 		if (status < 0)
-			break;
+			return status;
+	}
 
-		status = translate_path2(tracee, dirfd, path, SYSARG_2, REGULAR);
-		break;
+	/* No need to stage a new buffer in the tracee's memory when
+	 * the translation is the identity, as with "-r /".  */
+	if (strcmp(path, new_path) == 0)
+		return 0;
 
-	case PR_inotify_add_watch:
-		flags = peek_reg(tracee, CURRENT, SYSARG_3);
+	return set_sysarg_path(tracee, new_path, reg);
+}
 
-		if ((flags & IN_DONT_FOLLOW) != 0)
-			status = translate_sysarg(tracee, SYSARG_2, SYMLINK);
-		else
-			status = translate_sysarg(tracee, SYSARG_2, REGULAR);
-		break;
+/**
+ * Handler for open(2) at the enter stage.
+ */
+static int enter_open(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	char path[PATH_MAX];
+	int status;
+	int flags;
 
-	case PR_readlink:
-	case PR_lchown:
-	case PR_lchown32:
-	case PR_lgetxattr:
-	case PR_llistxattr:
-	case PR_lremovexattr:
-	case PR_lsetxattr:
-	case PR_lstat:
-	case PR_lstat64:
-	case PR_oldlstat:
-	case PR_unlink:
-	case PR_rmdir:
-	case PR_mkdir:
-		status = translate_sysarg(tracee, SYSARG_1, SYMLINK);
-		break;
+	flags = peek_reg(tracee, CURRENT, SYSARG_2);
 
-	case PR_pivot_root:
-		status = translate_sysarg(tracee, SYSARG_1, REGULAR);
-		if (status < 0)
-			break;
+	/* This syscall may create a path: negative lookups can't be
+	 * trusted anymore.  */
+	if ((flags & O_CREAT) != 0)
+		invalidate_negative_cache();
 
-		status = translate_sysarg(tracee, SYSARG_2, REGULAR);
-		break;
+	status = get_sysarg_path(tracee, path, SYSARG_1);
+	if (status < 0)
+		return status;
 
-	case PR_linkat:
-		olddirfd = peek_reg(tracee, CURRENT, SYSARG_1);
-		newdirfd = peek_reg(tracee, CURRENT, SYSARG_3);
-		flags    = peek_reg(tracee, CURRENT, SYSARG_5);
+	if (   ((flags & O_NOFOLLOW) != 0)
+	    || ((flags & O_EXCL) != 0 && (flags & O_CREAT) != 0))
+		return translate_open_sysarg(tracee, AT_FDCWD, path, SYSARG_1, SYMLINK, flags);
+	else
+		return translate_open_sysarg(tracee, AT_FDCWD, path, SYSARG_1, REGULAR, flags);
+}
 
-		status = get_sysarg_path(tracee, oldpath, SYSARG_2);
-		if (status < 0)
-			break;
+/**
+ * Handler for the "*at" syscalls that honour AT_SYMLINK_NOFOLLOW:
+ * fchownat(2), fstatat64(2), newfstatat(2), utimensat(2) and
+ * name_to_handle_at(2).
+ */
+static int enter_at_nofollow(Tracee *tracee, Sysnum sysnum)
+{
+	char path[PATH_MAX];
+	int status;
+	int dirfd;
+	int flags;
 
-		status = get_sysarg_path(tracee, newpath, SYSARG_4);
-		if (status < 0)
-			break;
+	dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
 
-		if ((flags & AT_SYMLINK_FOLLOW) != 0)
-			status = translate_path2(tracee, olddirfd, oldpath, SYSARG_2, REGULAR);
-		else
-			status = translate_path2(tracee, olddirfd, oldpath, SYSARG_2, SYMLINK);
-		if (status < 0)
-			break;
+	status = get_sysarg_path(tracee, path, SYSARG_2);
+	if (status < 0)
+		return status;
 
-		status = translate_path2(tracee, newdirfd, newpath, SYSARG_4, SYMLINK);
-		break;
+	flags = (  sysnum == PR_fchownat
+		|| sysnum == PR_name_to_handle_at)
+		? peek_reg(tracee, CURRENT, SYSARG_5)
+		: peek_reg(tracee, CURRENT, SYSARG_4);
 
-	case PR_mount:
-		status = get_sysarg_path(tracee, path, SYSARG_1);
-		if (status < 0)
-			break;
+	if ((flags & AT_SYMLINK_NOFOLLOW) != 0)
+		return translate_path2(tracee, dirfd, path, SYSARG_2, SYMLINK);
+	else
+		return translate_path2(tracee, dirfd, path, SYSARG_2, REGULAR);
+}
 
-		/* The following check covers only 90% of the cases. */
-		if (path[0] == '/' || path[0] == '.') {
-			status = translate_path2(tracee, AT_FDCWD, path, SYSARG_1, REGULAR);
-			if (status < 0)
-				break;
-		}
+/**
+ * Handler for statx(2), whose flags -- the third argument -- honour
+ * AT_SYMLINK_NOFOLLOW.  Modern libcs probe this syscall first; a
+ * first-class translation avoids the ENOSYS retry through the legacy
+ * stat family, which costs two stops per call otherwise.
+ */
+static int enter_statx(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	char path[PATH_MAX];
+	int status;
+	int dirfd;
+	int flags;
 
-		status = translate_sysarg(tracee, SYSARG_2, REGULAR);
-		break;
+	dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
 
-	case PR_openat:
-		dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
-		flags = peek_reg(tracee, CURRENT, SYSARG_3);
+	status = get_sysarg_path(tracee, path, SYSARG_2);
+	if (status < 0)
+		return status;
 
-		status = get_sysarg_path(tracee, path, SYSARG_2);
-		if (status < 0)
-			break;
+	flags = peek_reg(tracee, CURRENT, SYSARG_3);
 
-		if (   ((flags & O_NOFOLLOW) != 0)
-			|| ((flags & O_EXCL) != 0 && (flags & O_CREAT) != 0))
-			status = translate_path2(tracee, dirfd, path, SYSARG_2, SYMLINK);
-		else
-			status = translate_path2(tracee, dirfd, path, SYSARG_2, REGULAR);
-		break;
+	if ((flags & AT_SYMLINK_NOFOLLOW) != 0)
+		return translate_path2(tracee, dirfd, path, SYSARG_2, SYMLINK);
+	else
+		return translate_path2(tracee, dirfd, path, SYSARG_2, REGULAR);
+}
 
-	case PR_readlinkat:
-	case PR_unlinkat:
-	case PR_mkdirat:
-		dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+/**
+ * Handler for inotify_add_watch(2) at the enter stage.
+ */
+static int enter_inotify_add_watch(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	int flags;
 
-		status = get_sysarg_path(tracee, path, SYSARG_2);
-		if (status < 0)
-			break;
+	flags = peek_reg(tracee, CURRENT, SYSARG_3);
 
-		status = translate_path2(tracee, dirfd, path, SYSARG_2, SYMLINK);
-		break;
+	if ((flags & IN_DONT_FOLLOW) != 0)
+		return translate_sysarg(tracee, SYSARG_2, SYMLINK);
+	else
+		return translate_sysarg(tracee, SYSARG_2, REGULAR);
+}
 
-	case PR_link:
-	case PR_rename:
-		status = translate_sysarg(tracee, SYSARG_1, SYMLINK);
-		if (status < 0)
-			break;
+/**
+ * Handler for pivot_root(2) at the enter stage.
+ */
+static int enter_pivot_root(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	int status;
 
-		status = translate_sysarg(tracee, SYSARG_2, SYMLINK);
-		break;
+	status = translate_sysarg(tracee, SYSARG_1, REGULAR);
+	if (status < 0)
+		return status;
 
-	case PR_renameat:
-		olddirfd = peek_reg(tracee, CURRENT, SYSARG_1);
-		newdirfd = peek_reg(tracee, CURRENT, SYSARG_3);
+	return translate_sysarg(tracee, SYSARG_2, REGULAR);
+}
 
-		status = get_sysarg_path(tracee, oldpath, SYSARG_2);
-		if (status < 0)
-			break;
+/**
+ * Handler for linkat(2) at the enter stage.
+ */
+static int enter_linkat(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	char oldpath[PATH_MAX];
+	char newpath[PATH_MAX];
+	int olddirfd;
+	int newdirfd;
+	int status;
+	int flags;
 
-		status = get_sysarg_path(tracee, newpath, SYSARG_4);
-		if (status < 0)
-			break;
+	olddirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+	newdirfd = peek_reg(tracee, CURRENT, SYSARG_3);
+	flags    = peek_reg(tracee, CURRENT, SYSARG_5);
+
+	status = get_sysarg_path(tracee, oldpath, SYSARG_2);
+	if (status < 0)
+		return status;
 
+	status = get_sysarg_path(tracee, newpath, SYSARG_4);
+	if (status < 0)
+		return status;
+
+	if ((flags & AT_SYMLINK_FOLLOW) != 0)
+		status = translate_path2(tracee, olddirfd, oldpath, SYSARG_2, REGULAR);
+	else
 		status = translate_path2(tracee, olddirfd, oldpath, SYSARG_2, SYMLINK);
-		if (status < 0)
-			break;
+	if (status < 0)
+		return status;
 
-		status = translate_path2(tracee, newdirfd, newpath, SYSARG_4, SYMLINK);
-		break;
+	return translate_path2(tracee, newdirfd, newpath, SYSARG_4, SYMLINK);
+}
 
-	case PR_symlink:
-		status = translate_sysarg(tracee, SYSARG_2, SYMLINK);
-		break;
+/**
+ * Handler for mount(2) at the enter stage.
+ */
+static int enter_mount(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	char path[PATH_MAX];
+	int status;
 
-	case PR_symlinkat:
-		newdirfd = peek_reg(tracee, CURRENT, SYSARG_2);
+	status = get_sysarg_path(tracee, path, SYSARG_1);
+	if (status < 0)
+		return status;
 
-		status = get_sysarg_path(tracee, newpath, SYSARG_3);
+	/* The following check covers only 90% of the cases. */
+	if (path[0] == '/' || path[0] == '.') {
+		status = translate_path2(tracee, AT_FDCWD, path, SYSARG_1, REGULAR);
 		if (status < 0)
-			break;
+			return status;
+	}
 
-		status = translate_path2(tracee, newdirfd, newpath, SYSARG_3, SYMLINK);
-		break;
+	return translate_sysarg(tracee, SYSARG_2, REGULAR);
+}
+
+/**
+ * Handler for openat(2) at the enter stage.
+ */
+static int enter_openat(Tracee *tracee, Sysnum sysnum UNUSED)
+{
+	char path[PATH_MAX];
+	int status;
+	int dirfd;
+	int flags;
+
+	dirfd = peek_reg(tracee, CURRENT, SYSARG_1);
+	flags = peek_reg(tracee, CURRENT, SYSARG_3);
+
+	/* This syscall may create a path: negative lookups can't be
+	 * trusted anymore.  */
+	if ((flags & O_CREAT) != 0)
+		invalidate_negative_cache();
+
+	status = get_sysarg_path(tracee, path, SYSARG_2);
+	if (status < 0)
+		return status;
+
+	if (   ((flags & O_NOFOLLOW) != 0)
+	    || ((flags & O_EXCL) != 0 && (flags & O_CREAT) != 0))
+		return translate_open_sysarg(tracee, dirfd, path, SYSARG_2, SYMLINK, flags);
+	else
+		return translate_open_sysarg(tracee, dirfd, path, SYSARG_2, REGULAR, flags);
+}
+
+/* Per-sysnum descriptor table: the hot path of the enter stage is one
+ * indexed load and, when a handler or an argument vector is
+ * registered, one call.  The metadata tells which path caches a
+ * syscall invalidates -- a syscall about to create, remove, or rename
+ * a path makes cached path translations and/or negative lookups
+ * untrustworthy -- and whether its exit stage does real work (see
+ * sysnum_needs_sysexit()).  The seccomp filter is derived from this
+ * very table too, see proot_filtered_sysnums().  */
+static const SyscallDescriptor syscall_descriptors[PR_NB_SYSNUM] = {
+	[PR_accept]		= { enter_accept,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_accept4]		= { enter_accept,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_access]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_acct]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_bind]		= { enter_sockaddr,	0 },
+	[PR_brk]		= { enter_brk,		SYSENTER_NEEDS_SYSEXIT },
+	[PR_chdir]		= { enter_chdir,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_chmod]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_chown]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_chown32]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_chroot]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_connect]		= { enter_sockaddr,	0 },
+	[PR_creat]		= { NULL,			SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_execve]		= { enter_execve,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_faccessat]		= { NULL,			0,
+					{{ SYSARG_2, SYSARG_1, REGULAR }} },
+	[PR_faccessat2]		= { enter_at_nofollow,	0 },
+	[PR_fchdir]		= { enter_chdir,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_fchmodat]		= { NULL,			0,
+					{{ SYSARG_2, SYSARG_1, REGULAR }} },
+	[PR_fchownat]		= { enter_at_nofollow,	0 },
+	[PR_fstatat64]		= { enter_at_nofollow,	0 },
+	[PR_futimesat]		= { NULL,			0,
+					{{ SYSARG_2, SYSARG_1, REGULAR }} },
+	[PR_getcwd]		= { enter_getcwd,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_getpeername]	= { enter_accept,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_getsockname]	= { enter_accept,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_getxattr]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_inotify_add_watch]	= { enter_inotify_add_watch, 0 },
+	[PR_lchown]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_lchown32]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_lgetxattr]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_link]		= { NULL,			SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_1, 0, SYMLINK },
+					     { SYSARG_2, 0, SYMLINK }} },
+	[PR_linkat]		= { enter_linkat,	SYSENTER_FLUSH_NEGATIVE_CACHE },
+	[PR_listxattr]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_llistxattr]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_lremovexattr]	= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_lsetxattr]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_lstat]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_lstat64]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_mkdir]		= { NULL,			SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_mkdirat]		= { NULL,			SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_2, SYSARG_1, SYMLINK }} },
+	[PR_mknod]		= { NULL,			SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_mknodat]		= { NULL,			SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_2, SYSARG_1, REGULAR }} },
+	[PR_mount]		= { enter_mount,	SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE },
+	[PR_name_to_handle_at]	= { enter_at_nofollow,	0 },
+	[PR_newfstatat]		= { enter_at_nofollow,	0 },
+	[PR_oldlstat]		= { NULL,			0,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_oldstat]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_open]		= { enter_open,		0 },
+	[PR_openat]		= { enter_openat,	0 },
+	[PR_pivot_root]		= { enter_pivot_root,	SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE },
+	[PR_process_vm_readv]	= { enter_process_vm,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_process_vm_writev]	= { enter_process_vm,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_ptrace]		= { enter_ptrace,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_readlink]		= { NULL,			SYSENTER_NEEDS_SYSEXIT,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_readlinkat]		= { NULL,			SYSENTER_NEEDS_SYSEXIT,
+					{{ SYSARG_2, SYSARG_1, SYMLINK }} },
+	[PR_removexattr]	= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_rename]		= { enter_rename,	SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE
+						| SYSENTER_NEEDS_SYSEXIT },
+	[PR_renameat]		= { enter_rename,	SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE
+						| SYSENTER_NEEDS_SYSEXIT },
+	[PR_rmdir]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_setxattr]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_socketcall]		= { enter_socketcall,	SYSENTER_NEEDS_SYSEXIT },
+	[PR_stat]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_stat64]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_statfs]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_statfs64]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_statx]		= { enter_statx,	0 },
+	[PR_swapoff]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_swapon]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_symlink]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_2, 0, SYMLINK }} },
+	[PR_symlinkat]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_3, SYSARG_2, SYMLINK }} },
+	[PR_truncate]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_truncate64]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_umount]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_umount2]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE
+						| SYSENTER_FLUSH_NEGATIVE_CACHE,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_uname]		= { NULL,		SYSENTER_NEEDS_SYSEXIT },
+	[PR_unlink]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE,
+					{{ SYSARG_1, 0, SYMLINK }} },
+	[PR_unlinkat]		= { NULL,			SYSENTER_FLUSH_PATH_CACHE,
+					{{ SYSARG_2, SYSARG_1, SYMLINK }} },
+	[PR_uselib]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_utime]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_utimensat]		= { enter_at_nofollow,	0 },
+	[PR_utimes]		= { NULL,			0,
+					{{ SYSARG_1, 0, REGULAR }} },
+	[PR_wait4]		= { enter_wait,		SYSENTER_NEEDS_SYSEXIT },
+	[PR_waitpid]		= { enter_wait,		SYSENTER_NEEDS_SYSEXIT },
+};
+
+/**
+ * Return true if the exit stage of @sysnum does real work, that is,
+ * anything besides restoring the original register values.
+ */
+bool sysnum_needs_sysexit(Sysnum sysnum)
+{
+	return (sysnum < PR_NB_SYSNUM
+		&& (syscall_descriptors[sysnum].flags & SYSENTER_NEEDS_SYSEXIT) != 0);
+}
+
+/**
+ * Check whether PRoot pays no attention at all to @sysnum: no
+ * handler, no path argument, no flag.  Such syscalls only stop the
+ * tracee because PTRACE_SYSCALL traps everything; the spin-skip
+ * detection in translate_syscall() relies on this to let a tracee
+ * run free.
+ */
+bool sysnum_is_ignored(Sysnum sysnum)
+{
+	const SyscallDescriptor *descriptor;
+
+	/* Syscalls unknown to PRoot are never acted upon.  */
+	if (sysnum >= PR_NB_SYSNUM)
+		return true;
+
+	descriptor = &syscall_descriptors[sysnum];
+	return (descriptor->handler == NULL
+	     && descriptor->flags == 0
+	     && descriptor->args[0].path == 0);
+}
+
+/**
+ * Return the list of sysnums handled by PRoot, as expected by the
+ * seccomp filter builder.  It is derived -- once -- from the
+ * descriptor table above: a syscall is traced as soon as its
+ * descriptor says anything about it, and its exit stage is filtered
+ * in iff the descriptor requires one.  This keeps the seccomp filter
+ * and the dispatch in lock step, there's no parallel hand-maintained
+ * list to update.
+ */
+const FilteredSysnum *proot_filtered_sysnums(void)
+{
+	static FilteredSysnum filtered[PR_NB_SYSNUM + 1];
+	static bool initialized = false;
+	size_t count;
+	Sysnum sysnum;
+
+	if (initialized)
+		return filtered;
+
+	count = 0;
+	for (sysnum = 0; sysnum < PR_NB_SYSNUM; sysnum++) {
+		const SyscallDescriptor *descriptor = &syscall_descriptors[sysnum];
+
+		if (descriptor->handler == NULL
+		    && descriptor->flags == 0
+		    && descriptor->args[0].path == 0)
+			continue;
+
+		filtered[count].value = sysnum;
+		filtered[count].flags = sysnum_needs_sysexit(sysnum) ? FILTER_SYSEXIT : 0;
+		count++;
 	}
+	filtered[count] = (FilteredSysnum) FILTERED_SYSNUM_END;
+
+	initialized = true;
+	return filtered;
+}
+
+/**
+ * Translate the input arguments of the current @tracee's syscall in the
+ * @tracee->pid process area. This function sets @tracee->status to
+ * -errno if an error occured from the tracee's point-of-view (EFAULT
+ * for instance), otherwise 0.
+ */
+int translate_syscall_enter(Tracee *tracee)
+{
+	const SyscallDescriptor *entry;
+	Sysnum syscall_number;
+	int status;
+	int status2;
+
+	status = notify_extensions(tracee, SYSCALL_ENTER_START, 0, 0);
+	if (status < 0)
+		goto end;
+	if (status > 0)
+		return 0;
+
+	/* Translate input arguments. */
+	syscall_number = get_sysnum(tracee, ORIGINAL);
+	entry = &syscall_descriptors[syscall_number];
+
+	/* Note the caches are flushed even if the syscall ends up
+	 * failing, it is just a lost optimization opportunity.  */
+	if ((entry->flags & SYSENTER_FLUSH_PATH_CACHE) != 0)
+		invalidate_path_cache();
+	if ((entry->flags & SYSENTER_FLUSH_NEGATIVE_CACHE) != 0)
+		invalidate_negative_cache();
+
+	if (entry->handler != NULL)
+		status = entry->handler(tracee, syscall_number);
+	else if (entry->args[0].path != 0)
+		status = enter_path_args(tracee, entry);
+	else
+		status = 0;
 
 end:
 	status2 = notify_extensions(tracee, SYSCALL_ENTER_END, status, 0);
@@ -572,4 +1238,3 @@ end:
 
 	return status;
 }
-
@@ -22,6 +22,7 @@
 
 #include <errno.h>       /* errno(3), E* */
 #include <sys/utsname.h> /* struct utsname, */
+#include <stddef.h>     /* offsetof(), */
 #include <linux/net.h>   /* SYS_*, */
 #include <string.h>      /* strlen(3), */
 
@@ -36,6 +37,7 @@
 #include "tracee/mem.h"
 #include "tracee/abi.h"
 #include "path/path.h"
+#include "path/cache.h"
 #include "ptrace/ptrace.h"
 #include "ptrace/wait.h"
 #include "extension/extension.h"
@@ -91,10 +93,25 @@ void translate_syscall_exit(Tracee *tracee)
 			break;
 		}
 
-		/* Ensure cwd still exists.  */
-		status = translate_path(tracee, path, AT_FDCWD, ".", false);
-		if (status < 0)
-			break;
+		/* Ensure cwd still exists.  The host form cached at
+		 * chdir time spares the full re-translation; shells
+		 * call getcwd(2) incessantly.  */
+		if (tracee->fs->host_cwd != NULL) {
+			status = access(tracee->fs->host_cwd, F_OK);
+			if (status < 0) {
+				status = -errno;
+				break;
+			}
+		}
+		else {
+			status = translate_path(tracee, path, AT_FDCWD, ".", false);
+			if (status < 0)
+				break;
+
+			/* Populate the cache for the next calls.  */
+			chop_finality(path);
+			tracee->fs->host_cwd = talloc_strdup(tracee->fs, path);
+		}
 
 		new_size = strlen(tracee->fs->cwd) + 1;
 		if (size < new_size) {
@@ -102,9 +119,11 @@ void translate_syscall_exit(Tracee *tracee)
 			break;
 		}
 
-		/* Overwrite the path.  */
+		/* Overwrite the path.  The write is merely queued: it is
+		 * flushed -- combined with any other staged buffer --
+		 * right before the tracee is resumed.  */
 		output = peek_reg(tracee, ORIGINAL, SYSARG_1);
-		status = write_data(tracee, output, tracee->fs->cwd, new_size);
+		status = queue_write_data(tracee, output, tracee->fs->cwd, new_size);
 		if (status < 0)
 			break;
 
@@ -144,8 +163,10 @@ void translate_syscall_exit(Tracee *tracee)
 
 #define SYSARG_ADDR(n) (args_addr + ((n) - 1) * sizeof_word(tracee))
 
+/* Queued pokes are combined with the sockaddr write-back staged for
+ * the same stop, then flushed as a single vectored write.  */
 #define POKE_WORD(addr, value)			\
-	poke_word(tracee, addr, value);		\
+	queue_poke_word(tracee, addr, value);	\
 	if (errno != 0)	{			\
 		status = -errno;		\
 		break;				\
@@ -225,6 +246,44 @@ void translate_syscall_exit(Tracee *tracee)
 
 	case PR_fchdir:
 	case PR_chdir:
+		/* Fast mode: the kernel performed the actual directory
+		 * change, commit the cwd staged by enter_chdir() iff
+		 * it succeeded.  */
+		if (tracee->new_cwd != NULL) {
+			char *tmp;
+
+			if ((int) syscall_result < 0)
+				goto discard_new_cwd;
+
+			/* The current working directory is about to
+			 * change: get this tracee out of any
+			 * copy-on-write name-space sharing.  */
+			status = break_fs_cow(tracee);
+			if (status < 0)
+				break;
+
+			tmp = talloc_strdup(tracee->fs, tracee->new_cwd);
+			if (tmp == NULL) {
+				status = -ENOMEM;
+				break;
+			}
+			TALLOC_FREE(tracee->fs->cwd);
+
+			tracee->fs->cwd = tmp;
+			talloc_set_name_const(tracee->fs->cwd, "$cwd");
+
+			/* Cache the host form, see PR_getcwd above.  A
+			 * failed allocation simply leaves it empty.  */
+			TALLOC_FREE(tracee->fs->host_cwd);
+			tracee->fs->host_cwd = talloc_strdup(tracee->fs,
+							tracee->new_host_cwd);
+
+		discard_new_cwd:
+			TALLOC_FREE(tracee->new_cwd);
+			TALLOC_FREE(tracee->new_host_cwd);
+			goto end;
+		}
+
 		/* These syscalls are fully emulated, see enter.c for details
 		 * (like errors).  */
 		status = 0;
@@ -294,6 +353,12 @@ void translate_syscall_exit(Tracee *tracee)
 		/* Update the virtual current working directory.  */
 		substitute_path_prefix(old_path, old_length, new_path, new_length);
 
+		/* It is about to change: get this tracee out of any
+		 * copy-on-write name-space sharing.  */
+		status = break_fs_cow(tracee);
+		if (status < 0)
+			break;
+
 		tmp = talloc_strdup(tracee->fs, old_path);
 		if (tmp == NULL) {
 			status = -ENOMEM;
@@ -303,6 +368,10 @@ void translate_syscall_exit(Tracee *tracee)
 		TALLOC_FREE(tracee->fs->cwd);
 		tracee->fs->cwd = tmp;
 
+		/* The cached host form doesn't match the renamed cwd
+		 * anymore; it will be re-translated on demand.  */
+		TALLOC_FREE(tracee->fs->host_cwd);
+
 		status = 0;
 		break;
 	}
@@ -311,11 +380,14 @@ void translate_syscall_exit(Tracee *tracee)
 	case PR_readlinkat: {
 		char referee[PATH_MAX];
 		char referer[PATH_MAX];
+		char target[PATH_MAX];
 		size_t old_size;
 		size_t new_size;
 		size_t max_size;
 		word_t input;
 		word_t output;
+		ssize_t length;
+		bool cacheable;
 
 		/* Error reported by the kernel.  */
 		if ((int) syscall_result < 0)
@@ -359,9 +431,25 @@ void translate_syscall_exit(Tracee *tracee)
 			break;
 		}
 
-		status = detranslate_path(tracee, referee, referer);
-		if (status < 0)
-			break;
+		/* Stable targets are detranslated once then served from
+		 * the cache until the next path-cache flush.  Links
+		 * under "/proc" are left out: their emulated targets
+		 * are tracee-dependent.  */
+		cacheable = (compare_paths("/proc", referer) != PATH1_IS_PREFIX);
+		strcpy(target, referee);
+
+		if (cacheable && lookup_readlink_cache(tracee, referer, target,
+							referee, &length))
+			status = length;
+		else {
+			status = detranslate_path(tracee, referee, referer);
+			if (status < 0)
+				break;
+
+			if (cacheable)
+				cache_readlink_result(tracee, referer, target,
+						referee, status);
+		}
 
 		/* The original path doesn't require any transformation, i.e
 		 * it is a symetric binding.  */
@@ -376,11 +464,11 @@ void translate_syscall_exit(Tracee *tracee)
 		 * exposed by IDA Demo 6.3.  */
 		if ((size_t) status < max_size) {
 			new_size = status - 1;
-			status = write_data(tracee, output, referee, status);
+			status = queue_write_data(tracee, output, referee, status);
 		}
 		else {
 			new_size = max_size;
-			status = write_data(tracee, output, referee, max_size);
+			status = queue_write_data(tracee, output, referee, max_size);
 		}
 		if (status < 0)
 			break;
@@ -393,9 +481,13 @@ void translate_syscall_exit(Tracee *tracee)
 
 #if defined(ARCH_X86_64)
 	case PR_uname: {
-		struct utsname utsname;
+		/* Some 32-bit programs like package managers can be
+		 * confused when the kernel reports "x86_64".  The
+		 * kernel null-pads its fixed-size fields, so one write
+		 * of this constant block -- no read back -- is
+		 * enough.  */
+		static const char machine32[sizeof(((struct utsname *) NULL)->machine)] = "i686";
 		word_t address;
-		size_t size;
 
 		if (get_abi(tracee) != ABI_2)
 			goto end;
@@ -406,17 +498,8 @@ void translate_syscall_exit(Tracee *tracee)
 
 		address = peek_reg(tracee, ORIGINAL, SYSARG_1);
 
-		status = read_data(tracee, &utsname, address, sizeof(utsname));
-		if (status < 0)
-			break;
-
-		/* Some 32-bit programs like package managers can be
-		 * confused when the kernel reports "x86_64".  */
-		size = sizeof(utsname.machine);
-		strncpy(utsname.machine, "i686", size);
-		utsname.machine[size - 1] = '\0';
-
-		status = write_data(tracee, address, &utsname, sizeof(utsname));
+		status = write_data(tracee, address + offsetof(struct utsname, machine),
+				machine32, sizeof(machine32));
 		if (status < 0)
 			break;
 
@@ -433,6 +516,16 @@ void translate_syscall_exit(Tracee *tracee)
 		status = translate_ptrace_exit(tracee);
 		break;
 
+	case PR_process_vm_readv:
+	case PR_process_vm_writev:
+		/* Emulated only when targeting one of its own
+		 * emulated ptracees, see translate_process_vm_enter().  */
+		if (get_sysnum(tracee, MODIFIED) != PR_void)
+			goto end;
+
+		status = translate_process_vm_exit(tracee);
+		break;
+
 	case PR_wait4:
 	case PR_waitpid:
 		if (tracee->as_ptracer.waits_in != WAITS_IN_PROOT)
@@ -23,6 +23,7 @@
 #include <sys/mman.h>	/* PROT_*, MAP_*, */
 #include <assert.h>	/* assert(3),  */
 #include <string.h>     /* strerror(3), */
+#include <stdlib.h>     /* getenv(3), strtoul(3), */
 #include <unistd.h>     /* sysconf(3), */
 #include <sys/param.h>  /* MIN(), MAX(), */
 
@@ -43,6 +44,12 @@ static word_t heap_offset = 0;
 
 #define PREALLOCATED_HEAP_SIZE (16 * 1024 * 1024)
 
+/* The emulated heap is reserved by whole chunks: most brk(2) calls
+ * fit the space already reserved and are answered without any actual
+ * syscall.  Can be overridden with $PROOT_HEAP_CHUNK_SIZE.  */
+#define DEFAULT_HEAP_CHUNK_SIZE (4 * 1024 * 1024)
+static size_t heap_chunk_size = 0;
+
 /**
  * Emulate the brk(2) syscall with mmap(2) and/or mremap(2); this is
  * required to ensure a minimal heap size [1].  This function always
@@ -54,11 +61,12 @@ static word_t heap_offset = 0;
  *     issue can be reproduced when using a Ubuntu 12.04 x86_64 rootfs
  *     on RHEL 5 x86_64.
  */
-word_t translate_brk_enter(Tracee *tracee)
+int translate_brk_enter(Tracee *tracee)
 {
 	word_t new_brk_address;
 	size_t old_heap_size;
 	size_t new_heap_size;
+	size_t new_alloc_size;
 
 	if (tracee->heap->disabled)
 		return 0;
@@ -69,6 +77,17 @@ word_t translate_brk_enter(Tracee *tracee)
 			heap_offset = 0x1000;
 	}
 
+	if (heap_chunk_size == 0) {
+		const char *env = getenv("PROOT_HEAP_CHUNK_SIZE");
+		if (env != NULL)
+			heap_chunk_size = strtoul(env, NULL, 0);
+		if (heap_chunk_size == 0)
+			heap_chunk_size = DEFAULT_HEAP_CHUNK_SIZE;
+
+		/* The kernel deals with whole pages only.  */
+		heap_chunk_size += (heap_offset - heap_chunk_size % heap_offset) % heap_offset;
+	}
+
 	/* Non-fixed mmap pages might be placed right after the
 	 * emulated heap on some architectures.  A solution is to
 	 * preallocate some space to ensure a minimal heap size.  */
@@ -119,38 +138,55 @@ word_t translate_brk_enter(Tracee *tracee)
 	/* The size of the heap can't be negative.  */
 	if (new_brk_address < tracee->heap->base) {
 		set_sysnum(tracee, PR_void);
+		poke_reg(tracee, SYSARG_RESULT, tracee->heap->base + tracee->heap->size);
+		tracee->skip_sysexit = true;
 		return 0;
 	}
 
 	new_heap_size = new_brk_address - tracee->heap->base;
 	old_heap_size = tracee->heap->size;
 
-	/* Clear the released memory in preallocated space, so it will be
-	 * in the expected state next time it will be reallocated.  */
-	if (new_heap_size < old_heap_size && new_heap_size < tracee->heap->prealloc_size) {
+	/* Clear the released memory in the reserved space, so it will
+	 * be in the expected state next time it will be reallocated.  */
+	if (new_heap_size < old_heap_size && new_heap_size < tracee->heap->alloc_size) {
 		(void) clear_mem(tracee,
 				tracee->heap->base + new_heap_size,
-				MIN(old_heap_size, tracee->heap->prealloc_size) - new_heap_size);
+				MIN(old_heap_size, tracee->heap->alloc_size) - new_heap_size);
 	}
 
-	/* No need to use mremap when both old size and new size are
-	 * in the preallocated space.  */
-	if (   new_heap_size <= tracee->heap->prealloc_size
-	    && old_heap_size <= tracee->heap->prealloc_size) {
+	/* The space is reserved by whole chunks and the preallocated
+	 * space is never released.  */
+	new_alloc_size = heap_chunk_size
+		* ((new_heap_size + heap_chunk_size - 1) / heap_chunk_size);
+	new_alloc_size = MAX(new_alloc_size, tracee->heap->prealloc_size);
+
+	/* Shrink hysteresis: the reservation is kept as is until at
+	 * least two whole chunks would be released, so a tracee that
+	 * oscillates around a chunk boundary -- typically glibc's
+	 * malloc trimming -- doesn't mremap back and forth.  */
+	if (   new_alloc_size < tracee->heap->alloc_size
+	    && new_heap_size + 2 * heap_chunk_size > tracee->heap->alloc_size)
+		new_alloc_size = tracee->heap->alloc_size;
+
+	/* Most brk(2) calls land here: the new break fits the space
+	 * already reserved.  The answer is known right away, so the
+	 * result register is set from the enter stage: under seccomp
+	 * both the syscall and its exit stop are then skipped (see
+	 * translate_syscall()), without seccomp the exit stage pokes
+	 * the very same value again.  */
+	if (new_alloc_size == tracee->heap->alloc_size) {
 		tracee->heap->size = new_heap_size;
 		set_sysnum(tracee, PR_void);
+		poke_reg(tracee, SYSARG_RESULT, tracee->heap->base + new_heap_size);
+		tracee->skip_sysexit = true;
 		return 0;
 	}
 
-	/* Ensure the preallocated space will never be released.  */
-	new_heap_size = MAX(new_heap_size, tracee->heap->prealloc_size);
-	old_heap_size = MAX(old_heap_size, tracee->heap->prealloc_size);
-
 	/* Actually resizing.  */
 	set_sysnum(tracee, PR_mremap);
 	poke_reg(tracee, SYSARG_1 /* old_address */, tracee->heap->base - heap_offset);
-	poke_reg(tracee, SYSARG_2 /* old_size    */, old_heap_size + heap_offset);
-	poke_reg(tracee, SYSARG_3 /* new_size    */, new_heap_size + heap_offset);
+	poke_reg(tracee, SYSARG_2 /* old_size    */, tracee->heap->alloc_size + heap_offset);
+	poke_reg(tracee, SYSARG_3 /* new_size    */, new_alloc_size + heap_offset);
 	poke_reg(tracee, SYSARG_4 /* flags       */, 0);
 	poke_reg(tracee, SYSARG_5 /* new_address */, 0);
 
@@ -192,6 +228,7 @@ void translate_brk_exit(Tracee *tracee)
 
 		tracee->heap->base = result + heap_offset;
 		tracee->heap->size = 0;
+		tracee->heap->alloc_size = tracee->heap->prealloc_size;
 
 		poke_reg(tracee, SYSARG_RESULT, tracee->heap->base + tracee->heap->size);
 		break;
@@ -206,7 +243,11 @@ void translate_brk_exit(Tracee *tracee)
 			break;
 		}
 
-		tracee->heap->size = peek_reg(tracee, MODIFIED, SYSARG_3) - heap_offset;
+		/* The reservation and the break now differ: the former
+		 * is the (chunked) size given to mremap(2), the latter
+		 * is the address the tracee actually asked for.  */
+		tracee->heap->alloc_size = peek_reg(tracee, MODIFIED, SYSARG_3) - heap_offset;
+		tracee->heap->size = peek_reg(tracee, ORIGINAL, SYSARG_1) - tracee->heap->base;
 
 		poke_reg(tracee, SYSARG_RESULT, tracee->heap->base + tracee->heap->size);
 		break;
@@ -23,20 +23,29 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include <sys/param.h>  /* MAX(), */
+
 #include "tracee/tracee.h"
 
 extern int translate_brk_enter(Tracee *tracee);
 extern void translate_brk_exit(Tracee *tracee);
 
 /**
- * Check if the @address is in the @tracee's preallocated heap space.
- * This space is not supposed to be accessible.
+ * Check if the @address is in the @tracee's reserved heap space, that
+ * is, past the current break but still within the preallocated or
+ * chunked reservation.  This space is not supposed to be accessible.
  */
 static inline bool belongs_to_heap_prealloc(const Tracee *tracee, word_t address)
 {
-	return (tracee->heap != NULL && !tracee->heap->disabled
-		&& address >= tracee->heap->base + tracee->heap->size
-		&& address < tracee->heap->base + tracee->heap->prealloc_size);
+	size_t reserved;
+
+	if (tracee->heap == NULL || tracee->heap->disabled)
+		return false;
+
+	reserved = MAX(tracee->heap->prealloc_size, tracee->heap->alloc_size);
+
+	return (address >= tracee->heap->base + tracee->heap->size
+		&& address < tracee->heap->base + reserved);
 }
 
 #endif /* HEAP_H */
@@ -0,0 +1,481 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include "build.h"
+#include "arch.h"
+
+#if defined(HAVE_SECCOMP_FILTER)
+#include <sys/syscall.h>   /* SYS_seccomp, */
+#include <linux/seccomp.h> /* SECCOMP_*, struct seccomp_notif*, */
+#endif
+
+/* The user-notification engine needs Linux 5.0 headers at least
+ * (SECCOMP_FILTER_FLAG_NEW_LISTENER) and its support is probed at
+ * runtime anyway.  */
+#if defined(HAVE_SECCOMP_FILTER)			\
+ && defined(SECCOMP_FILTER_FLAG_NEW_LISTENER)		\
+ && defined(SECCOMP_IOCTL_NOTIF_RECV)			\
+ && defined(SYS_seccomp)
+#define HAVE_SECCOMP_NOTIF 1
+#endif
+
+#include "syscall/notif.h"
+
+bool seccomp_notif_wanted = false;
+
+#if defined(HAVE_SECCOMP_NOTIF)
+
+#include <sys/prctl.h>     /* prctl(2), PR_* */
+#include <sys/socket.h>    /* socketpair(2), CMSG_*, */
+#include <sys/ioctl.h>     /* ioctl(2), */
+#include <sys/stat.h>      /* stat(2), lstat(2), */
+#include <sys/vfs.h>       /* statfs(2), */
+#include <linux/filter.h>  /* struct sock_*, */
+#include <linux/audit.h>   /* AUDIT_, */
+#include <sys/queue.h>     /* LIST_FOREACH, */
+#include <unistd.h>        /* close(2), getpid(2), syscall(2), access(2), */
+#include <fcntl.h>         /* fcntl(2), AT_FDCWD, O_*, */
+#include <string.h>        /* memset(3), */
+#include <stddef.h>        /* offsetof(3), */
+#include <limits.h>        /* PATH_MAX, */
+#include <stdint.h>        /* UINT32_MAX, */
+#include <errno.h>         /* E*, */
+
+#include "syscall/sysnum.h"
+#include "syscall/seccomp.h"
+#include "extension/extension.h"
+#include "tracee/tracee.h"
+#include "tracee/mem.h"
+#include "tracee/abi.h"
+#include "path/path.h"
+#include "cli/note.h"
+
+#include "compat.h"
+#include "attribute.h"
+
+#ifndef SECCOMP_USER_NOTIF_FLAG_CONTINUE
+#define SECCOMP_USER_NOTIF_FLAG_CONTINUE (1UL << 0)
+#endif
+
+/* Syscalls emulated over user-notification: they read one path, they
+ * rewrite no register in the tracee, and their output -- if any -- is
+ * written straight into the tracee's memory.  */
+static const Sysnum notified_sysnums[] = { PR_stat, PR_lstat, PR_access, PR_statfs };
+#define NB_NOTIFIED_SYSNUMS (sizeof(notified_sysnums) / sizeof(Sysnum))
+
+/* Socket pair used to pass the listener file descriptor from the
+ * tracee -- where the filter has to be installed -- back to PRoot.  */
+static int channel_fds[2] = { -1, -1 };
+
+/* Listener file descriptor, -1 until it was received.  */
+static int notif_fd = -1;
+
+/**
+ * Create the socket pair used to pass the listener file descriptor
+ * back to PRoot; it has to exist before launch_process() forks.  This
+ * function returns -errno if an error occurred, otherwise 0.
+ */
+int create_notif_channel(void)
+{
+	int status;
+
+	if (!seccomp_notif_wanted)
+		return 0;
+
+	status = socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, channel_fds);
+	if (status < 0) {
+		note(NULL, WARNING, SYSTEM, "can't create the seccomp notification channel");
+		channel_fds[0] = channel_fds[1] = -1;
+		return -errno;
+	}
+
+	return 0;
+}
+
+/**
+ * Return true if one of the @tracee's extensions declared @sysnum in
+ * its filtered sysnums: such a syscall must stay on the ptrace engine
+ * since the extension alters its arguments or its result there.
+ */
+static bool filtered_by_extensions(const Tracee *tracee, Sysnum sysnum)
+{
+	Extension *extension;
+	size_t i;
+
+	if (tracee->extensions == NULL)
+		return false;
+
+	LIST_FOREACH(extension, tracee->extensions, link) {
+		const FilteredSysnum *sysnums = extension->filtered_sysnums;
+
+		if (sysnums == NULL)
+			continue;
+
+		for (i = 0; sysnums[i].value != PR_void; i++) {
+			if (sysnums[i].value == sysnum)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Send @fd through @socket_fd, à la SCM_RIGHTS.  This function
+ * returns -errno if an error occurred, otherwise 0.
+ */
+static int send_notif_fd(int socket_fd, int fd)
+{
+	char cmsg_buffer[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	char dummy = 0;
+	int status;
+
+	iov.iov_base = &dummy;
+	iov.iov_len  = sizeof(dummy);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = cmsg_buffer;
+	msg.msg_controllen = sizeof(cmsg_buffer);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type  = SCM_RIGHTS;
+	cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	status = sendmsg(socket_fd, &msg, 0);
+	if (status < 0)
+		return -errno;
+
+	return 0;
+}
+
+/**
+ * Install -- from within the tracee, before execve(2) -- the filter
+ * that reports the emulated syscalls through user-notification, then
+ * pass the listener file descriptor back to PRoot.  This function
+ * returns -errno if an error occurred, otherwise 0.
+ */
+int enable_syscall_notif(const Tracee *tracee)
+{
+	SeccompArch seccomp_archs[] = SECCOMP_ARCHS;
+	size_t nb_archs = sizeof(seccomp_archs) / sizeof(SeccompArch);
+
+	struct sock_filter statements[4 + 2 * NB_NOTIFIED_SYSNUMS + 1];
+	struct sock_fprog program;
+	size_t nb_notified;
+	size_t length;
+	word_t sysnum;
+	int status;
+	int fd;
+	size_t i;
+
+	if (!seccomp_notif_wanted || channel_fds[1] < 0)
+		return 0;
+
+	/* The first entry of SECCOMP_ARCHS is the native
+	 * architecture.  */
+	if (nb_archs == 0)
+		return -ENOSYS;
+
+	/* Check the current architecture first: a syscall made
+	 * through another ABI -- whose structure layouts likely
+	 * differ -- falls through to the regular ptrace engine.  */
+	length = 0;
+	statements[length++] = (struct sock_filter)
+		BPF_STMT(BPF_LD + BPF_W + BPF_ABS, offsetof(struct seccomp_data, arch));
+	statements[length++] = (struct sock_filter)
+		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, seccomp_archs[0].value, 1, 0);
+	statements[length++] = (struct sock_filter)
+		BPF_STMT(BPF_RET + BPF_K, SECCOMP_RET_ALLOW);
+	statements[length++] = (struct sock_filter)
+		BPF_STMT(BPF_LD + BPF_W + BPF_ABS, offsetof(struct seccomp_data, nr));
+
+	nb_notified = 0;
+	for (i = 0; i < NB_NOTIFIED_SYSNUMS; i++) {
+		/* A syscall an extension cares about stays on the
+		 * ptrace engine, where the extension is notified.  */
+		if (filtered_by_extensions(tracee, notified_sysnums[i]))
+			continue;
+
+		sysnum = detranslate_sysnum(ABI_DEFAULT, notified_sysnums[i]);
+		if (sysnum == SYSCALL_AVOIDER || sysnum > UINT32_MAX)
+			continue;
+
+		statements[length++] = (struct sock_filter)
+			BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, sysnum, 0, 1);
+		statements[length++] = (struct sock_filter)
+			BPF_STMT(BPF_RET + BPF_K, SECCOMP_RET_USER_NOTIF);
+		nb_notified++;
+	}
+
+	statements[length++] = (struct sock_filter)
+		BPF_STMT(BPF_RET + BPF_K, SECCOMP_RET_ALLOW);
+
+	/* Nothing left to notify?  */
+	if (nb_notified == 0)
+		return 0;
+
+	program.len    = length;
+	program.filter = statements;
+
+	/* Already done by enable_syscall_filtering(), unless the
+	 * regular filter was explicitly disabled.  */
+	status = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+	if (status < 0)
+		return -errno;
+
+	fd = syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER,
+		SECCOMP_FILTER_FLAG_NEW_LISTENER, &program);
+	if (fd < 0) {
+		note(tracee, WARNING, SYSTEM,
+			"can't install the seccomp user-notification filter");
+		return -errno;
+	}
+
+	status = send_notif_fd(channel_fds[1], fd);
+	if (status < 0)
+		note(tracee, WARNING, SYSTEM, "can't pass the seccomp listener to PRoot");
+
+	close(fd);
+	close(channel_fds[0]);
+	close(channel_fds[1]);
+
+	return status;
+}
+
+/**
+ * Try to receive the listener file descriptor sent by
+ * enable_syscall_notif(), without blocking.  This function returns
+ * -errno if an error occurred, otherwise 0.
+ */
+static int receive_notif_fd(void)
+{
+	char cmsg_buffer[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	char dummy;
+	int status;
+
+	iov.iov_base = &dummy;
+	iov.iov_len  = sizeof(dummy);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = cmsg_buffer;
+	msg.msg_controllen = sizeof(cmsg_buffer);
+
+	status = recvmsg(channel_fds[0], &msg, MSG_DONTWAIT);
+	if (status < 0)
+		return -errno;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (   cmsg == NULL
+	    || cmsg->cmsg_level != SOL_SOCKET
+	    || cmsg->cmsg_type  != SCM_RIGHTS)
+		return -EINVAL;
+
+	memcpy(&notif_fd, CMSG_DATA(cmsg), sizeof(int));
+
+	close(channel_fds[0]);
+	close(channel_fds[1]);
+	channel_fds[0] = channel_fds[1] = -1;
+
+	/* A SIGIO is raised whenever a notification is pending, in
+	 * order to interrupt waitpid(2) in event_loop().  */
+	(void) fcntl(notif_fd, F_SETOWN, getpid());
+	status = fcntl(notif_fd, F_GETFL);
+	if (status >= 0)
+		(void) fcntl(notif_fd, F_SETFL, status | O_ASYNC | O_NONBLOCK);
+
+	VERBOSE(NULL, 1, "seccomp user-notification engine enabled");
+
+	return 0;
+}
+
+/**
+ * Emulate -- on behalf of @tracee -- the syscall described by @req,
+ * and put its result in @result.  This function returns -errno if an
+ * error occurred from the tracee's point-of-view, otherwise 0.
+ */
+static int emulate_notified_syscall(Tracee *tracee, const struct seccomp_notif *req,
+				word_t *result)
+{
+	char guest_path[PATH_MAX];
+	char host_path[PATH_MAX];
+	struct statfs statfsl;
+	struct stat statl;
+	word_t nr;
+	int status;
+
+	nr = req->data.nr;
+	*result = 0;
+
+	/* Only native syscall numbers can pass the filter installed
+	 * by enable_syscall_notif(), so the structures laid out below
+	 * match what this tracee expects.  */
+
+	status = read_string(tracee, guest_path, req->data.args[0], PATH_MAX);
+	if (status < 0)
+		return status;
+	if (status >= PATH_MAX)
+		return -ENAMETOOLONG;
+
+	/* The tracee may have been killed -- and its pid reused --
+	 * while its memory was being read: discard what was read if
+	 * this notification is not valid anymore.  */
+	status = ioctl(notif_fd, SECCOMP_IOCTL_NOTIF_ID_VALID, &req->id);
+	if (status < 0)
+		return -ENOENT;
+
+	if (   nr == detranslate_sysnum(ABI_DEFAULT, PR_stat)
+	    || nr == detranslate_sysnum(ABI_DEFAULT, PR_lstat)) {
+		const bool dereference = (nr == detranslate_sysnum(ABI_DEFAULT, PR_stat));
+
+		status = translate_path(tracee, host_path, AT_FDCWD, guest_path, dereference);
+		if (status < 0)
+			return status;
+
+		status = dereference
+			? stat(host_path, &statl)
+			: lstat(host_path, &statl);
+		if (status < 0)
+			return -errno;
+
+		return write_data(tracee, req->data.args[1], &statl, sizeof(statl));
+	}
+
+	if (nr == detranslate_sysnum(ABI_DEFAULT, PR_access)) {
+		status = translate_path(tracee, host_path, AT_FDCWD, guest_path, true);
+		if (status < 0)
+			return status;
+
+		status = access(host_path, req->data.args[1]);
+		if (status < 0)
+			return -errno;
+
+		return 0;
+	}
+
+	if (nr == detranslate_sysnum(ABI_DEFAULT, PR_statfs)) {
+		status = translate_path(tracee, host_path, AT_FDCWD, guest_path, true);
+		if (status < 0)
+			return status;
+
+		status = statfs(host_path, &statfsl);
+		if (status < 0)
+			return -errno;
+
+		return write_data(tracee, req->data.args[1], &statfsl, sizeof(statfsl));
+	}
+
+	/* Should never happen: the filter only reports the syscalls
+	 * handled above.  */
+	return -ENOSYS;
+}
+
+/**
+ * Receive then handle all pending user-notifications, without
+ * blocking.  This function is called by event_loop() between two
+ * ptrace events and whenever a SIGIO interrupted waitpid(2).
+ */
+void handle_syscall_notif(void)
+{
+	struct seccomp_notif_resp resp;
+	struct seccomp_notif req;
+	Tracee *tracee;
+	word_t result;
+	int status;
+
+	if (!seccomp_notif_wanted)
+		return;
+
+	/* The listener is received asynchronously since the tracee
+	 * sends it only once the event loop resumed it.  */
+	if (notif_fd < 0) {
+		if (channel_fds[0] < 0 || receive_notif_fd() < 0)
+			return;
+	}
+
+	while (1) {
+		memset(&req, 0, sizeof(req));
+
+		status = ioctl(notif_fd, SECCOMP_IOCTL_NOTIF_RECV, &req);
+		if (status < 0)
+			return;  /* No pending notification (EAGAIN), or EINTR.  */
+
+		memset(&resp, 0, sizeof(resp));
+		resp.id = req.id;
+
+		tracee = get_tracee(NULL, req.pid, false);
+		if (tracee == NULL) {
+			/* This process is not known yet -- its clone
+			 * event was not seen so far -- so its syscall
+			 * can't be translated: let the kernel run it
+			 * as-is, as for a tracee that would have
+			 * raced PRoot at startup.  */
+			resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+		}
+		else {
+			status = emulate_notified_syscall(tracee, &req, &result);
+			resp.error = (status < 0 ? status : 0);
+			resp.val   = result;
+		}
+
+		/* ENOENT simply means the tracee was killed in the
+		 * meantime.  */
+		(void) ioctl(notif_fd, SECCOMP_IOCTL_NOTIF_SEND, &resp);
+	}
+}
+
+#else /* defined(HAVE_SECCOMP_NOTIF) */
+
+#include <errno.h>  /* ENOSYS, */
+
+#include "cli/note.h"
+#include "attribute.h"
+
+int create_notif_channel(void)
+{
+	if (seccomp_notif_wanted)
+		note(NULL, WARNING, USER,
+			"seccomp user-notification is not supported on this system");
+	return -ENOSYS;
+}
+
+int enable_syscall_notif(const Tracee *tracee UNUSED)
+{
+	return -ENOSYS;
+}
+
+void handle_syscall_notif(void)
+{
+}
+
+#endif /* defined(HAVE_SECCOMP_NOTIF) */
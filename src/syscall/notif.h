@@ -0,0 +1,38 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#ifndef NOTIF_H
+#define NOTIF_H
+
+#include <stdbool.h>
+
+#include "tracee/tracee.h"
+
+/* Set from the command-line when the seccomp user-notification
+ * engine was requested.  */
+extern bool seccomp_notif_wanted;
+
+extern int create_notif_channel(void);
+extern int enable_syscall_notif(const Tracee *tracee);
+extern void handle_syscall_notif(void);
+
+#endif /* NOTIF_H */
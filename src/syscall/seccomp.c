@@ -37,6 +37,10 @@
 #include <string.h>        /* memcpy(3), */
 #include <stddef.h>        /* offsetof(3), */
 #include <stdint.h>        /* uint*_t, UINT*_MAX, */
+#include <stdlib.h>        /* qsort(3), getenv(3), */
+#include <fcntl.h>         /* AT_FDCWD, open(2), */
+#include <unistd.h>        /* read(2), write(2), close(2), unlink(2), */
+#include <limits.h>        /* USHRT_MAX, */
 #include <assert.h>        /* assert(3), */
 
 #include "syscall/seccomp.h"
@@ -51,6 +55,142 @@
 
 #define DEBUG_FILTER(...) /* fprintf(stderr, __VA_ARGS__) */
 
+/* The compiled BPF program can be cached across PRoot invocations,
+ * see the --session-cache option.  The file records a digest of the
+ * inputs the program was compiled from (filtered sysnums, handled
+ * architectures, dirfd trust) and is rebuilt as a whole when this
+ * digest does not match the current one.  */
+
+#define SECCOMP_CACHE_MAGIC   0x53424646	/* "SBFF" */
+#define SECCOMP_CACHE_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t digest;
+	uint32_t nb_statements;
+	uint32_t padding;
+} SeccompCacheHeader;
+
+/* Path to the compiled seccomp program cache, specified with
+ * --session-cache; see set_seccomp_filters().  */
+static const char *seccomp_cache_path;
+
+/**
+ * Remember @path as the compiled seccomp program cache file.  The
+ * string is not copied, it has to remain valid for the whole session.
+ */
+void set_seccomp_cache(const char *path)
+{
+	seccomp_cache_path = path;
+}
+
+/**
+ * Return the FNV-1a digest of everything the BPF program below is
+ * compiled from: a cached program is only valid for the exact same
+ * @sysnums, architectures, and @trust_dirfds.
+ */
+static uint64_t seccomp_cache_digest(const FilteredSysnum *sysnums, bool trust_dirfds)
+{
+	SeccompArch seccomp_archs[] = SECCOMP_ARCHS;
+	uint64_t digest = UINT64_C(0xCBF29CE484222325);
+	size_t i;
+
+#define MIX(value) do {						\
+	digest ^= (uint64_t) (value);				\
+	digest *= UINT64_C(0x100000001B3);			\
+} while (0)
+
+	MIX(trust_dirfds);
+	for (i = 0; i < sizeof(seccomp_archs) / sizeof(SeccompArch); i++)
+		MIX(seccomp_archs[i].value);
+	for (i = 0; sysnums[i].value != PR_void; i++) {
+		MIX(sysnums[i].value);
+		MIX(sysnums[i].flags);
+	}
+#undef MIX
+
+	return digest;
+}
+
+/**
+ * Load into @program the cached BPF program compiled by a previous
+ * invocation, if its recorded digest matches @digest.  This function
+ * returns -errno if an error occurred (the cache is then simply
+ * rebuilt), otherwise 0.
+ */
+static int load_cached_program(uint64_t digest, struct sock_fprog *program)
+{
+	SeccompCacheHeader header;
+	struct sock_filter *filter;
+	ssize_t status;
+	size_t size;
+	int fd;
+
+	fd = open(seccomp_cache_path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	status = read(fd, &header, sizeof(header));
+	if (status != sizeof(header)
+	    || header.magic != SECCOMP_CACHE_MAGIC
+	    || header.version != SECCOMP_CACHE_VERSION
+	    || header.digest != digest
+	    || header.nb_statements == 0
+	    || header.nb_statements > USHRT_MAX) {
+		(void) close(fd);
+		return -EINVAL;
+	}
+
+	filter = talloc_array(NULL, struct sock_filter, header.nb_statements);
+	if (filter == NULL) {
+		(void) close(fd);
+		return -ENOMEM;
+	}
+
+	size = header.nb_statements * sizeof(struct sock_filter);
+	status = read(fd, filter, size);
+	(void) close(fd);
+	if (status != (ssize_t) size) {
+		TALLOC_FREE(filter);
+		return -EINVAL;
+	}
+
+	program->filter = filter;
+	program->len = header.nb_statements;
+
+	return 0;
+}
+
+/**
+ * Write @program -- compiled from inputs whose digest is @digest --
+ * into the cache file.  Errors only disable the cache for the next
+ * invocation, so they are not reported to the caller.
+ */
+static void store_cached_program(uint64_t digest, const struct sock_fprog *program)
+{
+	SeccompCacheHeader header;
+	size_t size;
+	int fd;
+
+	bzero(&header, sizeof(header));
+	header.magic         = SECCOMP_CACHE_MAGIC;
+	header.version       = SECCOMP_CACHE_VERSION;
+	header.digest        = digest;
+	header.nb_statements = program->len;
+
+	fd = open(seccomp_cache_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+
+	size = program->len * sizeof(struct sock_filter);
+	if (write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)
+	    || write(fd, program->filter, size) != (ssize_t) size)
+		(void) unlink(seccomp_cache_path);
+
+	(void) close(fd);
+}
+
 /**
  * Allocate an empty @program->filter.  This function returns -errno
  * if an error occurred, otherwise 0.
@@ -89,45 +229,220 @@ static int add_statements(struct sock_fprog *program, size_t nb_statements,
 	return 0;
 }
 
+/* Architecture specific syscall traced in the current filter section,
+ * with its FILTER_* flags.  */
+typedef struct {
+	word_t value;
+	int flags;
+} TracedSyscall;
+
+/* Number of syscalls below which a sub-tree is emitted as a linear
+ * chain of equality tests instead of being split further.  */
+#define LEAF_NB_SYSCALLS 4
+
 /**
- * Append to @program->filter the statements required to notify PRoot
- * about the given @syscall made by a tracee, with the given @flag.
- * This function returns -errno if an error occurred, otherwise 0.
+ * Return whether the only PRoot-relevant argument of @sysnum is a
+ * path anchored at the directory fd held in its first argument.
+ * These are the candidates for the $PROOT_TRUST_DIRFDS pre-filter:
+ * when their dirfd is a real fd -- it was returned by an already
+ * translated syscall, so it points to the host side -- the kernel can
+ * resolve the relative path natively.  Syscalls that create or remove
+ * paths are excluded: they have to trap so the path caches get
+ * invalidated.
+ */
+static bool single_dirfd_sysnum(Sysnum sysnum)
+{
+	switch (sysnum) {
+	case PR_faccessat:
+	case PR_faccessat2:
+	case PR_fchmodat:
+	case PR_fchownat:
+	case PR_fstatat64:
+	case PR_futimesat:
+	case PR_name_to_handle_at:
+	case PR_newfstatat:
+	case PR_openat:
+	case PR_readlinkat:
+	case PR_statx:
+	case PR_utimensat:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Return the number of BPF statements of the leaf generated for
+ * @syscall by add_search_tree().
+ */
+static size_t leaf_length(const TracedSyscall *syscall)
+{
+	return ((syscall->flags & FILTER_TRUSTED_DIRFD) != 0 ? 5 : 2);
+}
+
+/**
+ * Compare two TracedSyscall entries by their syscall numbers, à la
+ * qsort(3).
+ */
+static int compare_traced_syscalls(const void *a, const void *b)
+{
+	word_t value_a = ((const TracedSyscall *) a)->value;
+	word_t value_b = ((const TracedSyscall *) b)->value;
+
+	return value_a < value_b ? -1
+	     : value_a > value_b ?  1
+	     : 0;
+}
+
+/**
+ * Return the number of BPF statements generated by add_search_tree()
+ * for @nb_syscalls entries.
  */
-static int add_trace_syscall(struct sock_fprog *program, word_t syscall, int flag)
+static size_t search_tree_length(const TracedSyscall *syscalls, size_t nb_syscalls)
 {
+	size_t nb_left;
+	size_t length;
+	size_t i;
+
+	if (nb_syscalls <= LEAF_NB_SYSCALLS) {
+		length = 1;
+		for (i = 0; i < nb_syscalls; i++)
+			length += leaf_length(&syscalls[i]);
+		return length;
+	}
+
+	nb_left = nb_syscalls / 2;
+	return 2 + search_tree_length(syscalls, nb_left)
+		 + search_tree_length(syscalls + nb_left, nb_syscalls - nb_left);
+}
+
+/**
+ * Append to @program->filter a binary search tree over the *sorted*
+ * @syscalls (@nb_syscalls items): a traced syscall ends up on a
+ * "notify the tracer" statement, any other syscall on the "allow"
+ * statement expected at the absolute index @allow_index.  This way a
+ * tracee pays O(log N) comparisons per syscall instead of O(N).  This
+ * function returns -errno if an error occurred, otherwise 0.
+ */
+static int add_search_tree(struct sock_fprog *program, const TracedSyscall *syscalls,
+			size_t nb_syscalls, size_t allow_index)
+{
+	size_t nb_left;
+	size_t index;
 	int status;
+	size_t i;
+
+	if (nb_syscalls <= LEAF_NB_SYSCALLS) {
+		for (i = 0; i < nb_syscalls; i++) {
+			const int trace_flags = syscalls[i].flags & FILTER_SYSEXIT;
+
+			/* Sanity check.  */
+			if (syscalls[i].value > UINT32_MAX)
+				return -ERANGE;
+
+			if ((syscalls[i].flags & FILTER_TRUSTED_DIRFD) != 0) {
+				/* The low word is checked only: the
+				 * kernel itself compares dirfds as
+				 * 32-bit values, and every supported
+				 * SECCOMP_ARCHS runs little-endian.  */
+				struct sock_filter leaf[] = {
+					/* Not this syscall: skip the
+					 * whole leaf.  */
+					BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K,
+						syscalls[i].value, 0, 4),
+
+					/* Load its dirfd.  */
+					BPF_STMT(BPF_LD + BPF_W + BPF_ABS,
+						offsetof(struct seccomp_data, args[0])),
+
+					/* Anything but AT_FDCWD was
+					 * returned by an already
+					 * translated syscall: let the
+					 * kernel resolve it.  */
+					BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K,
+						(uint32_t) AT_FDCWD, 1, 0),
+					BPF_STMT(BPF_RET + BPF_K, SECCOMP_RET_ALLOW),
+
+					/* Notify the tracer.  */
+					BPF_STMT(BPF_RET + BPF_K,
+						SECCOMP_RET_TRACE + trace_flags)
+				};
+
+				DEBUG_FILTER("FILTER:     trace if syscall == %ld"
+					" and dirfd == AT_FDCWD\n", syscalls[i].value);
+
+				status = add_statements(program, 5, leaf);
+				if (status < 0)
+					return status;
+
+				continue;
+			}
+
+			struct sock_filter leaf[] = {
+				/* Compare the accumulator with the
+				 * expected syscall: skip the next
+				 * statement if not equal.  */
+				BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, syscalls[i].value, 0, 1),
+
+				/* Notify the tracer.  */
+				BPF_STMT(BPF_RET + BPF_K, SECCOMP_RET_TRACE + trace_flags)
+			};
+
+			DEBUG_FILTER("FILTER:     trace if syscall == %ld\n",
+				syscalls[i].value);
+
+			status = add_statements(program, 2, leaf);
+			if (status < 0)
+				return status;
+		}
+
+		/* None of these syscalls matched: jump to the "allow"
+		 * statement that ends this architecture section.  */
+		index = talloc_array_length(program->filter);
+
+		struct sock_filter epilogue[] = {
+			BPF_STMT(BPF_JMP + BPF_JA + BPF_K, allow_index - index - 1)
+		};
+
+		return add_statements(program, 1, epilogue);
+	}
 
 	/* Sanity check.  */
-	if (syscall > UINT32_MAX)
+	nb_left = nb_syscalls / 2;
+	if (syscalls[nb_left].value > UINT32_MAX)
 		return -ERANGE;
 
-	#define LENGTH_TRACE_SYSCALL 2
-	struct sock_filter statements[LENGTH_TRACE_SYSCALL] = {
-		/* Compare the accumulator with the expected syscall:
-		 * skip the next statement if not equal.  */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, syscall, 0, 1),
-
-		/* Notify the tracer.  */
-		BPF_STMT(BPF_RET + BPF_K, SECCOMP_RET_TRACE + flag)
+	/* The left sub-tree -- which handles the first half -- comes
+	 * right after the dichotomy, then the right sub-tree.  The
+	 * unconditional jump gives a 32-bit reach to the right
+	 * sub-tree; the 8-bit conditional offset could not span a
+	 * large left sub-tree.  */
+	struct sock_filter dichotomy[] = {
+		BPF_JUMP(BPF_JMP + BPF_JGE + BPF_K, syscalls[nb_left].value, 0, 1),
+		BPF_STMT(BPF_JMP + BPF_JA + BPF_K, search_tree_length(syscalls, nb_left))
 	};
 
-	DEBUG_FILTER("FILTER:     trace if syscall == %ld\n", syscall);
+	DEBUG_FILTER("FILTER:     dichotomy: syscall >= %ld?\n", syscalls[nb_left].value);
 
-	status = add_statements(program, LENGTH_TRACE_SYSCALL, statements);
+	status = add_statements(program, 2, dichotomy);
 	if (status < 0)
 		return status;
 
-	return 0;
+	status = add_search_tree(program, syscalls, nb_left, allow_index);
+	if (status < 0)
+		return status;
+
+	return add_search_tree(program, syscalls + nb_left, nb_syscalls - nb_left, allow_index);
 }
 
 /**
  * Append to @program->filter the statements that allow anything (if
- * unfiltered).  Note that @nb_traced_syscalls is used to make a
- * sanity check.  This function returns -errno if an error occurred,
+ * unfiltered).  Note that @tree_length is used to make a sanity
+ * check.  This function returns -errno if an error occurred,
  * otherwise 0.
  */
-static int end_arch_section(struct sock_fprog *program, size_t nb_traced_syscalls)
+static int end_arch_section(struct sock_fprog *program, size_t tree_length)
 {
 	int status;
 
@@ -144,7 +459,7 @@ static int end_arch_section(struct sock_fprog *program, size_t nb_traced_syscall
 
 	/* Sanity check, see start_arch_section().  */
 	if (   talloc_array_length(program->filter) - program->len
-	    != LENGTH_END_SECTION + nb_traced_syscalls * LENGTH_TRACE_SYSCALL)
+	    != LENGTH_END_SECTION + tree_length)
 		return -ERANGE;
 
 	return 0;
@@ -152,16 +467,15 @@ static int end_arch_section(struct sock_fprog *program, size_t nb_traced_syscall
 
 /**
  * Append to @program->filter the statements that check the current
- * @architecture.  Note that @nb_traced_syscalls is used to make a
- * sanity check.  This function returns -errno if an error occurred,
- * otherwise 0.
+ * @architecture.  Note that @tree_length -- the exact size of the
+ * upcoming search tree -- is used to locate the end of this section.
+ * This function returns -errno if an error occurred, otherwise 0.
  */
-static int start_arch_section(struct sock_fprog *program, uint32_t arch, size_t nb_traced_syscalls)
+static int start_arch_section(struct sock_fprog *program, uint32_t arch, size_t tree_length)
 {
 	const size_t arch_offset    = offsetof(struct seccomp_data, arch);
 	const size_t syscall_offset = offsetof(struct seccomp_data, nr);
-	const size_t section_length = LENGTH_END_SECTION +
-					nb_traced_syscalls * LENGTH_TRACE_SYSCALL;
+	const size_t section_length = LENGTH_END_SECTION + tree_length;
 	int status;
 
 	/* Sanity checks.  */
@@ -191,7 +505,7 @@ static int start_arch_section(struct sock_fprog *program, uint32_t arch, size_t
 	};
 
 	DEBUG_FILTER("FILTER: if arch == %ld, up to %zdth statement\n",
-		arch, nb_traced_syscalls);
+		arch, tree_length);
 
 	status = add_statements(program, LENGTH_START_SECTION, statements);
 	if (status < 0)
@@ -243,7 +557,7 @@ static void free_program_filter(struct sock_fprog *program)
  * all of its future children:
  *
  *     for each handled architectures
- *         for each filtered syscall
+ *         binary search over the filtered syscalls
  *             trace
  *         allow
  *     kill
@@ -255,11 +569,30 @@ static int set_seccomp_filters(const FilteredSysnum *sysnums)
 	SeccompArch seccomp_archs[] = SECCOMP_ARCHS;
 	size_t nb_archs = sizeof(seccomp_archs) / sizeof(SeccompArch);
 
+	/* Opt-in: "*at" syscalls anchored at a real dirfd run
+	 * natively, only AT_FDCWD anchored ones trap.  This is unsound
+	 * when a path escapes the directory of its dirfd -- an
+	 * absolute path or symbolic link, ".." -- and lands under a
+	 * non-identity binding, hence not the default.  */
+	const bool trust_dirfds = (getenv("PROOT_TRUST_DIRFDS") != NULL);
+
 	struct sock_fprog program = { .len = 0, .filter = NULL };
+	TracedSyscall *traced_syscalls = NULL;
 	size_t nb_traced_syscalls;
+	uint64_t digest = 0;
+	size_t tree_length;
 	size_t i, j, k;
 	int status;
 
+	/* Adopt the program compiled by a previous invocation with
+	 * the very same inputs, if any; see the --session-cache
+	 * option.  */
+	if (seccomp_cache_path != NULL) {
+		digest = seccomp_cache_digest(sysnums, trust_dirfds);
+		if (load_cached_program(digest, &program) == 0)
+			goto install;
+	}
+
 	status = new_program_filter(&program);
 	if (status < 0)
 		goto end;
@@ -270,36 +603,65 @@ static int set_seccomp_filters(const FilteredSysnum *sysnums)
 
 		nb_traced_syscalls = 0;
 
-		/* Pre-compute the number of traced syscalls for this architecture.  */
+		/* Collect the traced syscalls for this architecture,
+		 * all its ABIs included.  */
 		for (j = 0; j < seccomp_archs[i].nb_abis; j++) {
 			for (k = 0; sysnums[k].value != PR_void; k++) {
-				syscall = detranslate_sysnum(seccomp_archs[i].abis[j], sysnums[k].value);
-				if (syscall != SYSCALL_AVOIDER)
-					nb_traced_syscalls++;
-			}
-		}
-
-		/* Filter: if handled architecture */
-		status = start_arch_section(&program, seccomp_archs[i].value, nb_traced_syscalls);
-		if (status < 0)
-			goto end;
+				int flags;
+				size_t l;
 
-		for (j = 0; j < seccomp_archs[i].nb_abis; j++) {
-			for (k = 0; sysnums[k].value != PR_void; k++) {
 				/* Get the architecture specific syscall number.  */
 				syscall = detranslate_sysnum(seccomp_archs[i].abis[j], sysnums[k].value);
 				if (syscall == SYSCALL_AVOIDER)
 					continue;
 
-				/* Filter: trace if handled syscall */
-				status = add_trace_syscall(&program, syscall, sysnums[k].flags);
-				if (status < 0)
+				flags = sysnums[k].flags;
+				if (trust_dirfds && single_dirfd_sysnum(sysnums[k].value))
+					flags |= FILTER_TRUSTED_DIRFD;
+
+				/* Merge the flags if this syscall was
+				 * already collected; the search tree
+				 * requires unique entries.  */
+				for (l = 0; l < nb_traced_syscalls
+					 && traced_syscalls[l].value != syscall; l++)
+					;
+				if (l < nb_traced_syscalls) {
+					traced_syscalls[l].flags |= flags;
+					continue;
+				}
+
+				traced_syscalls = talloc_realloc(NULL, traced_syscalls,
+							TracedSyscall, nb_traced_syscalls + 1);
+				if (traced_syscalls == NULL) {
+					status = -ENOMEM;
 					goto end;
+				}
+
+				traced_syscalls[nb_traced_syscalls].value = syscall;
+				traced_syscalls[nb_traced_syscalls].flags = flags;
+				nb_traced_syscalls++;
 			}
 		}
 
+		/* The search tree expects sorted syscall numbers.  */
+		qsort(traced_syscalls, nb_traced_syscalls, sizeof(TracedSyscall),
+			compare_traced_syscalls);
+
+		tree_length = search_tree_length(traced_syscalls, nb_traced_syscalls);
+
+		/* Filter: if handled architecture */
+		status = start_arch_section(&program, seccomp_archs[i].value, tree_length);
+		if (status < 0)
+			goto end;
+
+		/* Filter: binary search over the traced syscalls */
+		status = add_search_tree(&program, traced_syscalls, nb_traced_syscalls,
+					talloc_array_length(program.filter) + tree_length);
+		if (status < 0)
+			goto end;
+
 		/* Filter: allow untraced syscalls for this architecture */
-		status = end_arch_section(&program, nb_traced_syscalls);
+		status = end_arch_section(&program, tree_length);
 		if (status < 0)
 			goto end;
 	}
@@ -308,6 +670,10 @@ static int set_seccomp_filters(const FilteredSysnum *sysnums)
 	if (status < 0)
 		goto end;
 
+	if (seccomp_cache_path != NULL)
+		store_cached_program(digest, &program);
+
+install:
 	status = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
 	if (status < 0)
 		goto end;
@@ -323,92 +689,11 @@ static int set_seccomp_filters(const FilteredSysnum *sysnums)
 
 	status = 0;
 end:
+	TALLOC_FREE(traced_syscalls);
 	free_program_filter(&program);
 	return status;
 }
 
-/* List of sysnums handled by PRoot.  */
-static FilteredSysnum proot_sysnums[] = {
-	{ PR_accept,		FILTER_SYSEXIT },
-	{ PR_accept4,		FILTER_SYSEXIT },
-	{ PR_access,		0 },
-	{ PR_acct,		0 },
-	{ PR_bind,		0 },
-	{ PR_brk,		FILTER_SYSEXIT },
-	{ PR_chdir,		FILTER_SYSEXIT },
-	{ PR_chmod,		0 },
-	{ PR_chown,		0 },
-	{ PR_chown32,		0 },
-	{ PR_chroot,		0 },
-	{ PR_connect,		0 },
-	{ PR_creat,		0 },
-	{ PR_execve,		FILTER_SYSEXIT },
-	{ PR_faccessat,		0 },
-	{ PR_fchdir,		FILTER_SYSEXIT },
-	{ PR_fchmodat,		0 },
-	{ PR_fchownat,		0 },
-	{ PR_fstatat64,		0 },
-	{ PR_futimesat,		0 },
-	{ PR_getcwd,		FILTER_SYSEXIT },
-	{ PR_getpeername,	FILTER_SYSEXIT },
-	{ PR_getsockname,	FILTER_SYSEXIT },
-	{ PR_getxattr,		0 },
-	{ PR_inotify_add_watch,	0 },
-	{ PR_lchown,		0 },
-	{ PR_lchown32,		0 },
-	{ PR_lgetxattr,		0 },
-	{ PR_link,		0 },
-	{ PR_linkat,		0 },
-	{ PR_listxattr,		0 },
-	{ PR_llistxattr,	0 },
-	{ PR_lremovexattr,	0 },
-	{ PR_lsetxattr,		0 },
-	{ PR_lstat,		0 },
-	{ PR_lstat64,		0 },
-	{ PR_mkdir,		0 },
-	{ PR_mkdirat,		0 },
-	{ PR_mknod,		0 },
-	{ PR_mknodat,		0 },
-	{ PR_mount,		0 },
-	{ PR_name_to_handle_at,	0 },
-	{ PR_newfstatat,	0 },
-	{ PR_oldlstat,		0 },
-	{ PR_oldstat,		0 },
-	{ PR_open,		0 },
-	{ PR_openat,		0 },
-	{ PR_pivot_root,	0 },
-	{ PR_ptrace,		FILTER_SYSEXIT },
-	{ PR_readlink,		FILTER_SYSEXIT },
-	{ PR_readlinkat,	FILTER_SYSEXIT },
-	{ PR_removexattr,	0 },
-	{ PR_rename,		FILTER_SYSEXIT },
-	{ PR_renameat,		FILTER_SYSEXIT },
-	{ PR_rmdir,		0 },
-	{ PR_setxattr,		0 },
-	{ PR_socketcall,	FILTER_SYSEXIT },
-	{ PR_stat,		0 },
-	{ PR_stat64,		0 },
-	{ PR_statfs,		0 },
-	{ PR_statfs64,		0 },
-	{ PR_swapoff,		0 },
-	{ PR_swapon,		0 },
-	{ PR_symlink,		0 },
-	{ PR_symlinkat,		0 },
-	{ PR_truncate,		0 },
-	{ PR_truncate64,	0 },
-	{ PR_umount,		0 },
-	{ PR_umount2,		0 },
-	{ PR_uname,		FILTER_SYSEXIT },
-	{ PR_unlink,		0 },
-	{ PR_unlinkat,		0 },
-	{ PR_uselib,		0 },
-	{ PR_utime,		0 },
-	{ PR_utimensat,		0 },
-	{ PR_utimes,		0 },
-	{ PR_wait4,		FILTER_SYSEXIT },
-	{ PR_waitpid,		FILTER_SYSEXIT },
-	FILTERED_SYSNUM_END,
-};
 
 /**
  * Add the @new_sysnums to the list of filtered @sysnums, using the
@@ -473,7 +758,8 @@ int enable_syscall_filtering(const Tracee *tracee)
 
 	/* Add the sysnums required by PRoot to the list of filtered
 	 * sysnums.  TODO: only if path translation is required.  */
-	status = merge_filtered_sysnums(tracee->ctx, &filtered_sysnums, proot_sysnums);
+	status = merge_filtered_sysnums(tracee->ctx, &filtered_sysnums,
+					proot_filtered_sysnums());
 	if (status < 0)
 		return status;
 
@@ -491,6 +777,26 @@ int enable_syscall_filtering(const Tracee *tracee)
 		}
 	}
 
+	/* Deferred extensions contribute their filtered sysnums
+	 * without being activated (see
+	 * snapshot_deferred_filtered_sysnums()): a seccomp filter can
+	 * never be widened once installed, so their syscalls have to
+	 * be trapped from the start even if the extension never
+	 * triggers.  */
+	if (tracee->deferred_extensions != NULL) {
+		DeferredExtension *deferred;
+
+		STAILQ_FOREACH(deferred, tracee->deferred_extensions, link) {
+			if (deferred->filtered_sysnums == NULL)
+				continue;
+
+			status = merge_filtered_sysnums(tracee->ctx, &filtered_sysnums,
+							deferred->filtered_sysnums);
+			if (status < 0)
+				return status;
+		}
+	}
+
 	status = set_seccomp_filters(filtered_sysnums);
 	if (status < 0)
 		return status;
@@ -503,6 +809,10 @@ int enable_syscall_filtering(const Tracee *tracee)
 #include "tracee/tracee.h"
 #include "attribute.h"
 
+void set_seccomp_cache(const char *path UNUSED)
+{
+}
+
 int enable_syscall_filtering(const Tracee *tracee UNUSED)
 {
 	return 0;
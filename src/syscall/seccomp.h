@@ -43,6 +43,15 @@ typedef struct {
 
 #define FILTER_SYSEXIT  0x1
 
+/* Internal to the BPF builder: emit a dirfd pre-check for this
+ * syscall (see $PROOT_TRUST_DIRFDS), never part of the RET data.  */
+#define FILTER_TRUSTED_DIRFD  0x2
+
 extern int enable_syscall_filtering(const Tracee *tracee);
+extern void set_seccomp_cache(const char *path);
+
+/* Implemented in syscall/enter.c, where the per-sysnum descriptor
+ * table this list is derived from lives.  */
+extern const FilteredSysnum *proot_filtered_sysnums(void);
 
 #endif /* SECCOMP_H */
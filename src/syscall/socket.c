@@ -22,7 +22,8 @@
 
 #include <stddef.h>      /* offsetof(3), */
 #include <strings.h>     /* bzero(3), */
-#include <string.h>      /* strncpy(3), strlen(3), */
+#include <string.h>      /* strncpy(3), strlen(3), memcmp(3), */
+#include <stdint.h>      /* uint64_t, */
 #include <assert.h>      /* assert(3), */
 #include <errno.h>       /* E*, */
 #include <sys/socket.h>  /* struct sockaddr_un, AF_UNIX, */
@@ -34,6 +35,7 @@
 #include "tracee/mem.h"
 #include "path/binding.h"
 #include "path/temp.h"
+#include "path/cache.h"
 #include "path/path.h"
 #include "arch.h"
 
@@ -45,6 +47,60 @@ static const off_t offsetof_path = offsetof(struct sockaddr_un, sun_path);
 extern struct sockaddr_un sockaddr_un__;
 static const size_t sizeof_path  = sizeof(sockaddr_un__.sun_path);
 
+/* Cache of sockaddr_un translations: services that reconnect to the
+ * same local socket over and over skip the path translation of every
+ * bind(2)/connect(2) but the first one.  Entries are keyed by the
+ * original sockaddr bytes and the file-system name-space they were
+ * translated in; they record the translation cache generation so
+ * they go stale at the same flush points (see path/cache.c).  */
+
+typedef struct {
+	/* Key.  */
+	const FileSystemNameSpace *fs;
+	struct sockaddr_un original;
+	int size;
+
+	/* Translated sockaddr, ready to be staged as is.  */
+	struct sockaddr_un translated;
+
+	uint64_t generation;
+} SockaddrCacheEntry;
+
+/* The cache is direct-mapped: a new entry simply evicts the previous
+ * one from its slot.  */
+#define NB_SOCKADDR_CACHE_ENTRIES 64
+static SockaddrCacheEntry sockaddr_entries[NB_SOCKADDR_CACHE_ENTRIES];
+
+/**
+ * Return the slot associated with the @size first bytes of
+ * @sockaddr.
+ */
+static SockaddrCacheEntry *get_sockaddr_slot(const struct sockaddr_un *sockaddr, int size)
+{
+	const unsigned char *bytes = (const unsigned char *) sockaddr;
+	uint64_t hash = 5381;
+	int i;
+
+	for (i = 0; i < size; i++)
+		hash = hash * 33 + bytes[i];
+
+	return &sockaddr_entries[hash % NB_SOCKADDR_CACHE_ENTRIES];
+}
+
+/**
+ * Check whether the sockaddr cache is usable for @tracee; same
+ * restrictions as the translation cache (see cacheable_tracee() in
+ * path/cache.c): extensions have side effects during a translation
+ * that a cache hit would skip.
+ */
+static bool sockaddr_cacheable(const Tracee *tracee)
+{
+	return (tracee != NULL
+		&& tracee->extensions == NULL
+		&& tracee->glue_type == 0
+		&& tracee->fs != NULL);
+}
+
 /**
  * Copy in @sockaddr the struct sockaddr_un stored in the @tracee
  * memory at the given @address.  Also, its pathname is copied to the
@@ -93,9 +149,11 @@ static int read_sockaddr_un(Tracee *tracee, struct sockaddr_un *sockaddr, word_t
  */
 int translate_socketcall_enter(Tracee *tracee, word_t *address, int size)
 {
+	SockaddrCacheEntry *entry;
 	struct sockaddr_un sockaddr;
 	char user_path[PATH_MAX];
 	char host_path[PATH_MAX];
+	bool cacheable;
 	int status;
 
 	if (*address == 0)
@@ -105,6 +163,20 @@ int translate_socketcall_enter(Tracee *tracee, word_t *address, int size)
 	if (status <= 0)
 		return status;
 
+	/* Reuse the previous translation of this very sockaddr, if
+	 * any.  Note: read_sockaddr_un() zeroed the bytes beyond
+	 * @size, so comparing whole structures is deterministic.  */
+	cacheable = sockaddr_cacheable(tracee);
+	entry = get_sockaddr_slot(&sockaddr, size);
+	if (   cacheable
+	    && entry->generation == path_cache_generation()
+	    && entry->fs == tracee->fs
+	    && entry->size == size
+	    && memcmp(&entry->original, &sockaddr, sizeof(sockaddr)) == 0) {
+		memcpy(&sockaddr, &entry->translated, sizeof(sockaddr));
+		goto stage;
+	}
+
 	status = translate_path(tracee, host_path, AT_FDCWD, user_path, true);
 	if (status < 0)
 		return status;
@@ -143,15 +215,31 @@ int translate_socketcall_enter(Tracee *tracee, word_t *address, int size)
 
 		/* Let's use this shorter path now.  */
 		strcpy(host_path, shorter_host_path);
+
+		/* The shorter path relies on a binding whose life span
+		 * is hard to track from here: don't cache it.  */
+		cacheable = false;
+	}
+
+	if (cacheable) {
+		entry->fs = tracee->fs;
+		memcpy(&entry->original, &sockaddr, sizeof(sockaddr));
+		entry->size = size;
+		entry->generation = path_cache_generation();
 	}
+
 	strncpy(sockaddr.sun_path, host_path, sizeof_path);
 
+	if (cacheable)
+		memcpy(&entry->translated, &sockaddr, sizeof(sockaddr));
+
+stage:
 	/* Push the updated sockaddr to a newly allocated space.  */
 	*address = alloc_mem(tracee, sizeof(sockaddr));
 	if (*address == 0)
 		return -EFAULT;
 
-	status = write_data(tracee, *address, &sockaddr, sizeof(sockaddr));
+	status = queue_write_data(tracee, *address, &sockaddr, sizeof(sockaddr));
 	if (status < 0)
 		return status;
 
@@ -170,6 +258,7 @@ int translate_socketcall_exit(Tracee *tracee, word_t sock_addr, word_t size_addr
 	struct sockaddr_un sockaddr;
 	bool is_truncated = false;
 	char path[PATH_MAX];
+	int32_t size32;
 	int status;
 	int size;
 
@@ -197,8 +286,10 @@ int translate_socketcall_exit(Tracee *tracee, word_t sock_addr, word_t size_addr
 	}
 	strncpy(sockaddr.sun_path, path, sizeof_path);
 
-	/* Overwrite the sockaddr and socklen parameters.  */
-	status = write_data(tracee, sock_addr, &sockaddr, size);
+	/* Overwrite the sockaddr and socklen parameters.  The write
+	 * is merely queued: it gets combined with the socklen poke
+	 * made by the caller.  */
+	status = queue_write_data(tracee, sock_addr, &sockaddr, size);
 	if (status < 0)
 		return status;
 
@@ -208,9 +299,12 @@ int translate_socketcall_exit(Tracee *tracee, word_t sock_addr, word_t size_addr
 	if (is_truncated)
 		size = max_size + 1;
 
-	poke_int32(tracee, size_addr, size);
-	if (errno != 0)
-		return -errno;
+	/* Queued as well: the sockaddr and its length reach the tracee
+	 * in the same vectored write.  */
+	size32 = size;
+	status = queue_write_data(tracee, size_addr, &size32, sizeof(size32));
+	if (status < 0)
+		return status;
 
 	return 0;
 }
@@ -22,15 +22,177 @@
 
 #include <assert.h>      /* assert(3), */
 #include <limits.h>      /* PATH_MAX, */
-#include <string.h>      /* strlen(3), */
+#include <stdint.h>      /* uint64_t, uintmax_t, */
+#include <stdlib.h>      /* getenv(3), qsort(3), */
+#include <stdio.h>       /* fprintf(3), */
+#include <string.h>      /* strlen(3), memcpy(3), */
 #include <errno.h>       /* errno(3), E* */
+#include <time.h>        /* clock_gettime(2), */
+#include <sys/mman.h>    /* PROT_*, MAP_*, */
 
 #include "syscall/syscall.h"
 #include "syscall/chain.h"
+#include "syscall/sysnum.h"
+#include "syscall/seccomp.h"
 #include "extension/extension.h"
 #include "tracee/tracee.h"
+#include "tracee/abi.h"
 #include "tracee/reg.h"
 #include "tracee/mem.h"
+#include "tracee/event.h"
+
+/* Strings already fetched by get_sysarg_path() during the current
+ * syscall stop: the core handler and each extension (fake_id0, CARE)
+ * may re-read the same path argument, each paying a tracee-memory
+ * read otherwise.  Entries are keyed by the fetched address so a
+ * register redirected to a freshly staged buffer simply misses.  */
+#define NB_SYSARG_PATH_CACHE 4
+
+static struct {
+	const Tracee *tracee;
+	uint64_t stop;
+	word_t address;
+	int size;
+	char path[PATH_MAX];
+} sysarg_path_cache[NB_SYSARG_PATH_CACHE];
+
+static uint64_t current_stop;
+
+/* Per-sysnum profile of the work done by PRoot itself, enabled with
+ * $PROOT_PROFILE_SYSCALLS: number of stops, time spent in
+ * translate_syscall(), and tracee-memory bytes moved on behalf of
+ * each syscall.  Dumped on SIGUSR1/SIGUSR2 along with the other
+ * statistics (see print_talloc_hierarchy() in tracee/event.c), and
+ * once the event loop ends.  */
+
+typedef struct {
+	uint64_t nb_enters;
+	uint64_t nb_exits;
+	uint64_t nsecs;
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+} SyscallProfile;
+
+static SyscallProfile syscall_profiles[PR_NB_SYSNUM];
+
+/* -1: $PROOT_PROFILE_SYSCALLS not checked yet.  */
+static int syscall_profiling = -1;
+
+/* -1: $PROOT_SPIN_SKIP not checked yet.  */
+static int spin_skip_enabled = -1;
+
+/* Number of identical consecutive stops before a tracee is let run
+ * free, see enter_spin_skip().  */
+#define SPIN_SKIP_THRESHOLD 32
+
+/**
+ * Track how many times in a row @tracee entered the very same
+ * syscall with the very same arguments.  Interpreter runtimes spin
+ * like this on failing futex(2)/poll(2) loops; on the non-seccomp
+ * path each iteration costs two useless stops.
+ */
+static void update_spin_signature(Tracee *tracee)
+{
+	word_t signature[7];
+	size_t i;
+
+	if (spin_skip_enabled < 0)
+		spin_skip_enabled = (getenv("PROOT_SPIN_SKIP") != NULL);
+	if (!spin_skip_enabled || tracee->seccomp == ENABLED)
+		return;
+
+	signature[0] = peek_reg(tracee, ORIGINAL, SYSARG_NUM);
+	for (i = 0; i < 6; i++)
+		signature[i + 1] = peek_reg(tracee, ORIGINAL, SYSARG_1 + i);
+
+	if (memcmp(signature, tracee->spin_signature, sizeof(signature)) == 0) {
+		if (tracee->nb_identical_stops < SPIN_SKIP_THRESHOLD)
+			tracee->nb_identical_stops++;
+		return;
+	}
+
+	memcpy(tracee->spin_signature, signature, sizeof(signature));
+	tracee->nb_identical_stops = 1;
+}
+
+/**
+ * Account the current stop of @tracee -- started at @start with the
+ * given memory transfer counters -- to its original sysnum.  Chained
+ * syscalls are charged to the syscall that chained them.
+ */
+static void account_syscall_stop(const Tracee *tracee, bool is_enter_stage,
+				const struct timespec *start,
+				uint64_t bytes_read, uint64_t bytes_written)
+{
+	Sysnum sysnum = get_sysnum(tracee, ORIGINAL);
+	SyscallProfile *profile;
+	struct timespec end;
+
+	if (sysnum >= PR_NB_SYSNUM)
+		return;
+	profile = &syscall_profiles[sysnum];
+
+	if (is_enter_stage)
+		profile->nb_enters++;
+	else
+		profile->nb_exits++;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &end);
+	profile->nsecs += (end.tv_sec - start->tv_sec) * UINT64_C(1000000000)
+			+ (end.tv_nsec - start->tv_nsec);
+
+	profile->bytes_read    += tracee->mem_stats.bytes_read    - bytes_read;
+	profile->bytes_written += tracee->mem_stats.bytes_written - bytes_written;
+}
+
+/**
+ * Compare two profiled sysnums, most expensive first.
+ */
+static int compare_profiles(const void *a, const void *b)
+{
+	uint64_t nsecs_a = syscall_profiles[*(const Sysnum *) a].nsecs;
+	uint64_t nsecs_b = syscall_profiles[*(const Sysnum *) b].nsecs;
+
+	return (nsecs_a < nsecs_b) - (nsecs_a > nsecs_b);
+}
+
+/* Print on stderr the per-sysnum profile, most expensive syscall
+ * first.  No-op unless $PROOT_PROFILE_SYSCALLS is set.  */
+void print_syscall_profile(void)
+{
+	Sysnum sysnums[PR_NB_SYSNUM];
+	size_t nb_sysnums = 0;
+	Sysnum sysnum;
+	size_t i;
+
+	if (syscall_profiling <= 0)
+		return;
+
+	for (sysnum = 0; sysnum < PR_NB_SYSNUM; sysnum++) {
+		if (syscall_profiles[sysnum].nb_enters != 0
+		    || syscall_profiles[sysnum].nb_exits != 0)
+			sysnums[nb_sysnums++] = sysnum;
+	}
+	qsort(sysnums, nb_sysnums, sizeof(Sysnum), compare_profiles);
+
+	fprintf(stderr, "per-syscall profile:\n");
+
+	for (i = 0; i < nb_sysnums; i++) {
+		const SyscallProfile *profile = &syscall_profiles[sysnums[i]];
+
+		fprintf(stderr, "\t%-20s %ju.%06ju s, "
+			"%ju stops (enter: %ju, exit: %ju), "
+			"bytes read: %ju, written: %ju\n",
+			stringify_sysnum(sysnums[i]),
+			(uintmax_t) (profile->nsecs / 1000000000),
+			(uintmax_t) (profile->nsecs % 1000000000) / 1000,
+			(uintmax_t) (profile->nb_enters + profile->nb_exits),
+			(uintmax_t) profile->nb_enters,
+			(uintmax_t) profile->nb_exits,
+			(uintmax_t) profile->bytes_read,
+			(uintmax_t) profile->bytes_written);
+	}
+}
 
 /**
  * Copy in @path a C string (PATH_MAX bytes max.) from the @tracee's
@@ -40,8 +202,10 @@
  */
 int get_sysarg_path(const Tracee *tracee, char path[PATH_MAX], Reg reg)
 {
+	static size_t next_slot;
 	int size;
 	word_t src;
+	size_t i;
 
 	src = peek_reg(tracee, CURRENT, reg);
 
@@ -53,12 +217,31 @@ int get_sysarg_path(const Tracee *tracee, char path[PATH_MAX], Reg reg)
 		return 0;
 	}
 
+	/* Already fetched during this syscall stop?  */
+	for (i = 0; i < NB_SYSARG_PATH_CACHE; i++) {
+		if (   sysarg_path_cache[i].tracee == tracee
+		    && sysarg_path_cache[i].stop == current_stop
+		    && sysarg_path_cache[i].address == src) {
+			size = sysarg_path_cache[i].size;
+			memcpy(path, sysarg_path_cache[i].path, size + 1);
+			return size;
+		}
+	}
+
 	/* Get the path from the tracee's memory space. */
 	size = read_path(tracee, path, src);
 	if (size < 0)
 		return size;
 
 	path[size] = '\0';
+
+	sysarg_path_cache[next_slot].tracee  = tracee;
+	sysarg_path_cache[next_slot].stop    = current_stop;
+	sysarg_path_cache[next_slot].address = src;
+	sysarg_path_cache[next_slot].size    = size;
+	memcpy(sysarg_path_cache[next_slot].path, path, size + 1);
+	next_slot = (next_slot + 1) % NB_SYSARG_PATH_CACHE;
+
 	return size;
 }
 
@@ -78,8 +261,11 @@ static int set_sysarg_data(Tracee *tracee, const void *tracer_ptr, word_t size,
 	if (tracee_ptr == 0)
 		return -EFAULT;
 
-	/* Copy the new data into the previously allocated space. */
-	status = write_data(tracee, tracee_ptr, tracer_ptr, size);
+	/* Copy the new data into the previously allocated space.  The
+	 * transfer is merely queued: buffers staged for the same
+	 * syscall are flushed in one batch, right before the tracee is
+	 * resumed.  */
+	status = queue_write_data(tracee, tracee_ptr, tracer_ptr, size);
 	if (status < 0)
 		return status;
 
@@ -99,14 +285,127 @@ int set_sysarg_path(Tracee *tracee, const char path[PATH_MAX], Reg reg)
 	return set_sysarg_data(tracee, path, strlen(path) + 1, reg);
 }
 
+/* Size of the scratch arena alloc_mem() bump-allocates from: enough
+ * for a couple of translated paths plus smaller staged buffers.  */
+#define SCRATCH_ARENA_SIZE (4 * PATH_MAX)
+
+/**
+ * Map the scratch arena of @tracee by chaining an anonymous mmap(2)
+ * to the syscall that just completed, then -- on a later call --
+ * grab the address returned by this chained mmap(2).  This has to be
+ * called at the end of the sysexit stage, before chain_next_syscall().
+ */
+static void handle_scratch_arena(Tracee *tracee)
+{
+	Sysnum sysnum;
+	word_t result;
+	int status;
+
+	/* Grab the address returned by the chained mmap(2).  */
+	if (tracee->scratch.pending) {
+		assert(tracee->chain.syscalls != NULL);
+
+		tracee->scratch.pending = false;
+
+		result = peek_reg(tracee, CURRENT, SYSARG_RESULT);
+		if (result != 0 && result < (word_t) -4096) {
+			tracee->scratch.base = result;
+			tracee->scratch.size = SCRATCH_ARENA_SIZE;
+			tracee->scratch.offset = 0;
+		}
+		return;
+	}
+
+	/* Nothing to do if no syscall ever staged data, or if the
+	 * arena is already mapped.  */
+	if (!tracee->scratch.wanted || tracee->scratch.base != 0)
+		return;
+
+	/* Don't pile onto an existing syscall chain, and never chain
+	 * anything right after execve(2): this window belongs to
+	 * PRoot's loader.  */
+	if (   tracee->chain.syscalls != NULL
+	    || get_sysnum(tracee, ORIGINAL) == PR_execve)
+		return;
+
+	/* Same quirk as for the emulated heap: prefer mmap2(2)
+	 * whenever this ABI provides it.  */
+	sysnum = detranslate_sysnum(get_abi(tracee), PR_mmap2) != SYSCALL_AVOIDER
+		? PR_mmap2
+		: PR_mmap;
+
+	status = register_chained_syscall(tracee, sysnum,
+					0, SCRATCH_ARENA_SIZE, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, (word_t) -1, 0);
+	if (status < 0)
+		return;
+
+	tracee->scratch.pending = true;
+
+	/* The tracee shall see the result of its own syscall, not the
+	 * chained mmap(2)'s one.  */
+	if (!tracee->chain.force_final_result)
+		force_chain_final_result(tracee, peek_reg(tracee, CURRENT, SYSARG_RESULT));
+}
+
+/**
+ * Return true if one of the @tracee's extensions requires the exit
+ * stage of @sysnum to be traced, as declared through its filtered
+ * sysnums.
+ */
+static bool extensions_need_sysexit(const Tracee *tracee, Sysnum sysnum)
+{
+	Extension *extension;
+	size_t i;
+
+	if (tracee->extensions == NULL)
+		return false;
+
+	LIST_FOREACH(extension, tracee->extensions, link) {
+		const FilteredSysnum *sysnums = extension->filtered_sysnums;
+
+		if (sysnums == NULL)
+			continue;
+
+		for (i = 0; sysnums[i].value != PR_void; i++) {
+			if (sysnums[i].value == sysnum
+			    && (sysnums[i].flags & FILTER_SYSEXIT) != 0)
+				return true;
+		}
+	}
+
+	return false;
+}
+
 void translate_syscall(Tracee *tracee)
 {
 	const bool is_enter_stage = IS_IN_SYSENTER(tracee);
+	struct timespec profile_start;
+	uint64_t profile_reads = 0;
+	uint64_t profile_writes = 0;
 	int status;
 
+	/* Strings cached by get_sysarg_path() don't outlive a stop.  */
+	current_stop++;
+
+	if (syscall_profiling < 0)
+		syscall_profiling = (getenv("PROOT_PROFILE_SYSCALLS") != NULL);
+	if (syscall_profiling) {
+		(void) clock_gettime(CLOCK_MONOTONIC, &profile_start);
+		profile_reads  = tracee->mem_stats.bytes_read;
+		profile_writes = tracee->mem_stats.bytes_written;
+	}
+
 	assert(tracee->exe != NULL);
 
-	status = fetch_regs(tracee);
+	/* An execve(2) sysexit may flip the tracee's architecture and
+	 * is dominated by register writes anyway: fetch the full bank
+	 * there.  Everything else starts with the light copy and gets
+	 * upgraded by poke_reg() only when a write is needed.  */
+	if (is_enter_stage || get_sysnum(tracee, ORIGINAL) != PR_execve)
+		status = fetch_light_regs(tracee);
+	else
+		status = fetch_regs(tracee);
 	if (status < 0)
 		return;
 
@@ -114,6 +413,8 @@ void translate_syscall(Tracee *tracee)
 		/* Never restore original register values at the end
 		 * of this stage.  */
 		tracee->restore_original_regs = false;
+		tracee->skip_sysexit = false;
+		tracee->sysexit_unneeded = false;
 
 		print_current_regs(tracee, 3, "sysenter start");
 
@@ -121,7 +422,13 @@ void translate_syscall(Tracee *tracee)
 		 * requested by the tracee, it is not a syscall
 		 * chained by PRoot.  */
 		if (tracee->chain.syscalls == NULL) {
+			/* The scratch arena is recycled for each
+			 * syscall; chained syscalls keep on
+			 * allocating after the initial one.  */
+			tracee->scratch.offset = 0;
+
 			save_current_regs(tracee, ORIGINAL);
+			update_spin_signature(tracee);
 			status = translate_syscall_enter(tracee);
 			save_current_regs(tracee, MODIFIED);
 		}
@@ -141,6 +448,31 @@ void translate_syscall(Tracee *tracee)
 		else
 			tracee->status = 1;
 
+		/* The exit stage of this syscall would only restore
+		 * register values, and seccomp will notify the next
+		 * sysenter stage anyway: skip the exit stop
+		 * altogether.  Emulated ptracers are left out since
+		 * they may legitimately expect this stop.  */
+		if (   tracee->restart_how == PTRACE_SYSCALL
+		    && tracee->seccomp == ENABLED
+		    && tracee->status > 0
+		    && tracee->chain.syscalls == NULL
+		    && tracee->as_ptracee.ptracer == NULL
+		    && (   tracee->skip_sysexit
+		        || tracee->sysexit_unneeded
+		        || !sysnum_needs_sysexit(get_sysnum(tracee, ORIGINAL)))
+		    && !extensions_need_sysexit(tracee, get_sysnum(tracee, ORIGINAL))) {
+			tracee->restart_how = PTRACE_CONT;
+			tracee->sysexit_pending = false;
+
+			/* The enter handler already poked the final result;
+			 * have the kernel skip the syscall -- number -1 is
+			 * never executed and leaves the result register
+			 * alone -- so it is not clobbered with -ENOSYS.  */
+			if (tracee->skip_sysexit)
+				poke_reg(tracee, SYSARG_NUM, (word_t) -1);
+		}
+
 		/* Restore tracee's stack pointer now if it won't hit
 		 * the sysexit stage (i.e. when seccomp is enabled and
 		 * there's nothing else to do).  */
@@ -164,16 +496,38 @@ void translate_syscall(Tracee *tracee)
 		else
 			(void) notify_extensions(tracee, SYSCALL_CHAINED_EXIT, 0, 0);
 
+		handle_scratch_arena(tracee);
+
 		/* Reset the tracee's status. */
 		tracee->status = 0;
 
 		/* Insert the next chained syscall, if any.  */
 		if (tracee->chain.syscalls != NULL)
 			chain_next_syscall(tracee);
+
+		/* The tracee keeps re-entering the very same syscall
+		 * PRoot pays no attention to: stop paying two stops
+		 * per iteration and let it run free until the next
+		 * re-sync, see enter_spin_skip().  */
+		if (   tracee->nb_identical_stops >= SPIN_SKIP_THRESHOLD
+		    && tracee->restart_how == PTRACE_SYSCALL
+		    && tracee->seccomp == DISABLED
+		    && tracee->chain.syscalls == NULL
+		    && tracee->extensions == NULL
+		    && tracee->as_ptracee.ptracer == NULL
+		    && sysnum_is_ignored(get_sysnum(tracee, ORIGINAL)))
+			enter_spin_skip(tracee);
 	}
 
+	/* Transfer the data staged for this syscall in one batch.  */
+	(void) flush_queued_writes(tracee);
+
 	(void) push_regs(tracee);
 
+	if (syscall_profiling)
+		account_syscall_stop(tracee, is_enter_stage, &profile_start,
+				profile_reads, profile_writes);
+
 	if (is_enter_stage)
 		print_current_regs(tracee, 5, "sysenter end" );
 	else
@@ -27,6 +27,10 @@
 
 #include "tracee/tracee.h"
 #include "tracee/reg.h"
+#include "syscall/sysnum.h"
+
+extern bool sysnum_needs_sysexit(Sysnum sysnum);
+extern bool sysnum_is_ignored(Sysnum sysnum);
 
 extern int get_sysarg_path(const Tracee *tracee, char path[PATH_MAX], Reg reg);
 extern int set_sysarg_path(Tracee *tracee, const char path[PATH_MAX], Reg reg);
@@ -35,4 +39,6 @@ extern void translate_syscall(Tracee *tracee);
 extern int  translate_syscall_enter(Tracee *tracee);
 extern void translate_syscall_exit(Tracee *tracee);
 
+extern void print_syscall_profile(void);
+
 #endif /* SYSCALL_H */
@@ -92,34 +92,68 @@ static Sysnum translate_sysnum(Abi abi, word_t sysnum)
 	index = sysnum - sysnums.offset;
 
 	/* Sanity checks.  */
-	if (index > sysnums.length)
+	if (index >= sysnums.length)
 		return PR_void;
 
 	return sysnums.table[index];
 }
 
+/* Architecture syscall number for each neutral Sysnum, that is, the
+ * dense reverse of the per-ABI tables above.  Each table is derived
+ * once on first use; SYSCALL_AVOIDER fills the holes, as for syscalls
+ * that don't exist on the given ABI.  */
+static word_t reverse_sysnums[NB_MAX_ABIS][PR_NB_SYSNUM];
+static bool reverse_sysnums_filled[NB_MAX_ABIS];
+
 /**
- * Return the architecture value of @sysnum for the given @abi.
+ * Return the reverse sysnum table for the given @abi, building it on
+ * first use.
  */
-word_t detranslate_sysnum(Abi abi, Sysnum sysnum)
+static const word_t *get_reverse_sysnums(Abi abi)
 {
 	Sysnums sysnums;
-	size_t i;
+	word_t i;
 
-	/* Very special case.  */
-	if (sysnum == PR_void)
-		return SYSCALL_AVOIDER;
+	assert(abi < NB_MAX_ABIS);
 
-	get_sysnums(abi, &sysnums);
+	if (!reverse_sysnums_filled[abi]) {
+		get_sysnums(abi, &sysnums);
 
-	for (i = 0; i < sysnums.length; i++) {
-		if (sysnums.table[i] != sysnum)
-			continue;
+		for (i = 0; i < PR_NB_SYSNUM; i++)
+			reverse_sysnums[abi][i] = SYSCALL_AVOIDER;
 
-		return i + sysnums.offset;
+		for (i = 0; i < sysnums.length; i++) {
+			Sysnum sysnum = sysnums.table[i];
+
+			if (sysnum == PR_void)
+				continue;
+
+			/* Keep the first entry, like the former
+			 * linear search did.  */
+			if (reverse_sysnums[abi][sysnum] == SYSCALL_AVOIDER)
+				reverse_sysnums[abi][sysnum] = i + sysnums.offset;
+		}
+
+		reverse_sysnums_filled[abi] = true;
 	}
 
-	return SYSCALL_AVOIDER;
+	return reverse_sysnums[abi];
+}
+
+/**
+ * Return the architecture value of @sysnum for the given @abi.
+ */
+word_t detranslate_sysnum(Abi abi, Sysnum sysnum)
+{
+	/* Very special case.  */
+	if (sysnum == PR_void)
+		return SYSCALL_AVOIDER;
+
+	/* Sanity checks.  */
+	if (sysnum >= PR_NB_SYSNUM)
+		return SYSCALL_AVOIDER;
+
+	return get_reverse_sysnums(abi)[sysnum];
 }
 
 /**
@@ -335,4 +335,8 @@ static const Sysnum sysnums_arm[] = {
 	[ 375 ] = PR_setns,
 	[ 376 ] = PR_process_vm_readv,
 	[ 377 ] = PR_process_vm_writev,
+	[ 391 ] = PR_copy_file_range,
+	[ 397 ] = PR_statx,
+	[ 436 ] = PR_close_range,
+	[ 439 ] = PR_faccessat2,
 };
@@ -260,4 +260,8 @@ static const Sysnum sysnums_arm64[] = {
 	[ 271 ] = PR_process_vm_writev,
 	[ 272 ] = PR_kcmp,
 	[ 273 ] = PR_syscalls,
+	[ 285 ] = PR_copy_file_range,
+	[ 291 ] = PR_statx,
+	[ 436 ] = PR_close_range,
+	[ 439 ] = PR_faccessat2,
 };
@@ -347,4 +347,8 @@ static const Sysnum sysnums_i386[] = {
 	[ 347 ] = PR_process_vm_readv,
 	[ 348 ] = PR_process_vm_writev,
 	[ 349 ] = PR_kcmp,
+	[ 377 ] = PR_copy_file_range,
+	[ 383 ] = PR_statx,
+	[ 436 ] = PR_close_range,
+	[ 439 ] = PR_faccessat2,
 };
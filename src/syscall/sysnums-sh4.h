@@ -339,4 +339,8 @@ static const Sysnum sysnums_sh4[] = {
 	[ 364 ] = PR_setns,
 	[ 365 ] = PR_process_vm_readv,
 	[ 366 ] = PR_process_vm_writev,
+	[ 380 ] = PR_copy_file_range,
+	[ 383 ] = PR_statx,
+	[ 436 ] = PR_close_range,
+	[ 439 ] = PR_faccessat2,
 };
@@ -303,4 +303,8 @@ static const Sysnum sysnums_x32[] = {
 	[ 540 ] = PR_process_vm_writev,
 	[ 541 ] = PR_setsockopt,
 	[ 542 ] = PR_getsockopt,
+	[ 326 ] = PR_copy_file_range,
+	[ 332 ] = PR_statx,
+	[ 436 ] = PR_close_range,
+	[ 439 ] = PR_faccessat2,
 };
@@ -314,4 +314,8 @@ static const Sysnum sysnums_x86_64[] = {
 	[ 310 ] = PR_process_vm_readv,
 	[ 311 ] = PR_process_vm_writev,
 	[ 312 ] = PR_kcmp,
+	[ 326 ] = PR_copy_file_range,
+	[ 332 ] = PR_statx,
+	[ 436 ] = PR_close_range,
+	[ 439 ] = PR_faccessat2,
 };
@@ -26,20 +26,31 @@
 #include <sys/types.h>  /* waitpid(2), */
 #include <sys/wait.h>   /* waitpid(2), */
 #include <sys/utsname.h> /* uname(2), */
+#include <sys/prctl.h>  /* prctl(2), PR_SET_CHILD_SUBREAPER, */
 #include <unistd.h>     /* fork(2), chdir(2), getpid(2), */
 #include <string.h>     /* strcmp(3), */
 #include <errno.h>      /* errno(3), */
 #include <stdbool.h>    /* bool, true, false, */
 #include <assert.h>     /* assert(3), */
 #include <stdlib.h>     /* atexit(3), getenv(3), */
+#include <stdint.h>     /* uint64_t, uintmax_t, */
+#include <malloc.h>     /* mallopt(3), M_*, */
+#include <limits.h>     /* INT_MAX, */
+#include <time.h>       /* clock_gettime(2), struct timespec, */
+#include <sys/time.h>   /* setitimer(2), struct itimerval, */
 #include <talloc.h>     /* talloc_*, */
 
 #include "tracee/event.h"
+#include "tracee/mem.h"
 #include "cli/note.h"
 #include "path/path.h"
 #include "path/binding.h"
 #include "syscall/syscall.h"
 #include "syscall/seccomp.h"
+#include "syscall/notif.h"
+#include "ptrace/ptrace.h"
+#include "execve/profile.h"
+#include "profile.h"
 #include "ptrace/wait.h"
 #include "extension/extension.h"
 #include "execve/elf.h"
@@ -47,6 +58,11 @@
 #include "attribute.h"
 #include "compat.h"
 
+/* Whether the tracer was pinned to dedicated CPUs (--cpus): the
+ * traced tree must not inherit this mask, launch_process() resets it
+ * in the child.  */
+bool tracer_cpus_pinned = false;
+
 /**
  * Start @tracee->exe with the given @argv[].  This function
  * returns -errno if an error occurred, otherwise 0.
@@ -62,6 +78,32 @@ int launch_process(Tracee *tracee, char *const argv[])
 	if (tracee->verbose > 0)
 		list_open_fd(tracee);
 
+	/* The seccomp filter installed below snapshots the filtered
+	 * sysnums of every extension, the deferred ones included:
+	 * their syscalls have to be trapped from the start since a
+	 * filter can never be widened afterwards.  They only report
+	 * their filter here, though -- activation still waits until
+	 * the first delivered event.  */
+	if (getenv("PROOT_NO_SECCOMP") == NULL)
+		snapshot_deferred_filtered_sysnums(tracee);
+
+	/* The channel used to pass the seccomp listener back has to
+	 * exist on both sides of the fork.  */
+	(void) create_notif_channel();
+
+#ifdef PR_SET_CHILD_SUBREAPER
+	/* Become the sub-reaper of the whole traced tree: when an
+	 * intermediate process dies -- daemons double-fork for
+	 * instance -- the kernel re-parents its orphans to PRoot
+	 * instead of init, so they stay in the scope of the batched
+	 * waitpid(-1) drain of event_loop() and remove_tracee()
+	 * doesn't have to synthesize anything on their behalf.  A
+	 * failure (kernel < 3.4) simply keeps the old behavior.  */
+	status = prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0);
+	if (status < 0)
+		note(tracee, WARNING, SYSTEM, "prctl(PR_SET_CHILD_SUBREAPER)");
+#endif
+
 	pid = fork();
 	switch(pid) {
 	case -1:
@@ -69,6 +111,19 @@ int launch_process(Tracee *tracee, char *const argv[])
 		return -errno;
 
 	case 0: /* child */
+		/* The --cpus pinning is meant for the tracer only:
+		 * give the traced tree back the whole machine.  The
+		 * kernel clamps this mask to the allowed CPUs.  */
+		if (tracer_cpus_pinned) {
+			cpu_set_t all_cpus;
+			int cpu;
+
+			CPU_ZERO(&all_cpus);
+			for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+				CPU_SET(cpu, &all_cpus);
+			(void) sched_setaffinity(0, sizeof(all_cpus), &all_cpus);
+		}
+
 		/* Declare myself as ptraceable before executing the
 		 * requested program. */
 		status = ptrace(PTRACE_TRACEME, 0, NULL, NULL);
@@ -89,6 +144,10 @@ int launch_process(Tracee *tracee, char *const argv[])
 		if (getenv("PROOT_NO_SECCOMP") == NULL)
 			(void) enable_syscall_filtering(tracee);
 
+		/* Hand over the read-only path syscalls to the
+		 * user-notification engine, if requested.  */
+		(void) enable_syscall_notif(tracee);
+
 		/* Now process is ptraced, so the current rootfs is already the
 		 * guest rootfs.  Note: Valgrind can't handle execve(2) on
 		 * "foreign" binaries (ENOEXEC) but can handle execvp(3) on such
@@ -98,7 +157,7 @@ int launch_process(Tracee *tracee, char *const argv[])
 
 	default: /* parent */
 		/* We know the pid of the first tracee now.  */
-		tracee->pid = pid;
+		set_tracee_pid(tracee, pid);
 		return 0;
 	}
 
@@ -106,10 +165,26 @@ int launch_process(Tracee *tracee, char *const argv[])
 	return -ENOSYS;
 }
 
+/* A seccomp user-notification is pending; the handler itself does
+ * nothing: the notification is processed by the event loop once
+ * waitpid(2) was interrupted.  */
+static void handle_sigio(int signum UNUSED, siginfo_t *siginfo UNUSED, void *ucontext UNUSED)
+{
+}
+
+/* A SIGHUP asks for the bindings file to be re-read; the actual swap
+ * is deferred to the event loop, in between two tracee stops.  */
+static void handle_sighup(int signum UNUSED, siginfo_t *siginfo UNUSED, void *ucontext UNUSED)
+{
+	request_bindings_reload();
+}
+
 /* Send the KILL signal to all tracees when PRoot has received a fatal
  * signal.  */
 static void kill_all_tracees2(int signum, siginfo_t *siginfo UNUSED, void *ucontext UNUSED)
 {
+	note_enter_signal_handler();
+
 	note(NULL, WARNING, INTERNAL, "signal %d received from process %d",
 		signum, siginfo->si_pid);
 	kill_all_tracees();
@@ -119,6 +194,204 @@ static void kill_all_tracees2(int signum, siginfo_t *siginfo UNUSED, void *ucont
 	 * the event loop.  */
 	if (signum != SIGQUIT)
 		_exit(EXIT_FAILURE);
+
+	note_leave_signal_handler();
+}
+
+/* Per-stop-type counters, plus a histogram of the time spent
+ * servicing one event -- from waitpid(2) return to the tracee being
+ * restarted.  Printed on SIGUSR1/SIGUSR2 along with the talloc
+ * hierarchy; together with the per-sysnum profiler this tells where
+ * the tracing overhead actually goes.  */
+#define NB_LATENCY_BUCKETS 10
+static struct {
+	uint64_t nb_syscall_stops;
+	uint64_t nb_seccomp_stops;
+	uint64_t nb_fork_events;
+	uint64_t nb_exec_events;
+	uint64_t nb_signal_stops;
+	uint64_t nb_terminations;
+	uint64_t latency_buckets[NB_LATENCY_BUCKETS];
+
+	/* Saturation gauges: total time spent servicing events --
+	 * against the wall time since @loop_start -- and the number of
+	 * events already queued when the loop re-entered waitpid(2),
+	 * see account_backlog().  A busy ratio close to 100% means
+	 * every tracee is slowed down uniformly.  */
+	uint64_t busy_nsecs;
+	uint64_t nb_wakeups;
+	uint64_t backlog_last;
+	uint64_t backlog_max;
+} event_stats;
+
+static struct timespec loop_start;
+
+/* Overload detector: when $PROOT_OVERLOAD_THRESHOLD is set to a
+ * percentage, the busy ratio is evaluated over one-second windows and
+ * the transitions in and out of overload are logged, see
+ * account_event_latency().  */
+#define OVERLOAD_WINDOW_NSECS UINT64_C(1000000000)
+static struct {
+	uint64_t threshold;	/* percent, 0 means disabled.  */
+	bool window_started;
+	bool overloaded;
+	struct timespec window_start;
+	uint64_t window_busy_nsecs;
+} overload_detector;
+
+/**
+ * Account the type of @tracee_status, as reported by waitpid(2).
+ */
+static void account_tracee_event(int tracee_status)
+{
+	if (WIFEXITED(tracee_status) || WIFSIGNALED(tracee_status)) {
+		event_stats.nb_terminations++;
+		return;
+	}
+
+	if (!WIFSTOPPED(tracee_status))
+		return;
+
+	switch ((tracee_status & 0xfff00) >> 8) {
+	case SIGTRAP | 0x80:
+		event_stats.nb_syscall_stops++;
+		break;
+
+	case SIGTRAP | PTRACE_EVENT_SECCOMP2 << 8:
+	case SIGTRAP | PTRACE_EVENT_SECCOMP << 8:
+		event_stats.nb_seccomp_stops++;
+		break;
+
+	case SIGTRAP | PTRACE_EVENT_FORK  << 8:
+	case SIGTRAP | PTRACE_EVENT_VFORK << 8:
+	case SIGTRAP | PTRACE_EVENT_CLONE << 8:
+		event_stats.nb_fork_events++;
+		break;
+
+	case SIGTRAP | PTRACE_EVENT_EXEC << 8:
+		event_stats.nb_exec_events++;
+		break;
+
+	default:
+		/* Plain signal deliveries, and the few remaining
+		 * PTRACE_EVENT_* (vfork-done, exit).  */
+		event_stats.nb_signal_stops++;
+		break;
+	}
+}
+
+/**
+ * Account the time elapsed since @start, the moment waitpid(2)
+ * reported the event being serviced.
+ */
+static void account_event_latency(const struct timespec *start)
+{
+	struct timespec end;
+	uint64_t nsecs;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	nsecs = (end.tv_sec - start->tv_sec) * UINT64_C(1000000000)
+		+ (end.tv_nsec - start->tv_nsec);
+
+	/* Buckets: <= 1us, <= 4us, <= 16us, ...  */
+	for (i = 0; i < NB_LATENCY_BUCKETS - 1; i++) {
+		if (nsecs <= UINT64_C(1000) << (2 * i))
+			break;
+	}
+	event_stats.latency_buckets[i]++;
+
+	event_stats.busy_nsecs += nsecs;
+
+	if (overload_detector.threshold == 0)
+		return;
+
+	if (!overload_detector.window_started) {
+		overload_detector.window_start = end;
+		overload_detector.window_started = true;
+		return;
+	}
+
+	overload_detector.window_busy_nsecs += nsecs;
+
+	nsecs = (end.tv_sec - overload_detector.window_start.tv_sec) * UINT64_C(1000000000)
+		+ (end.tv_nsec - overload_detector.window_start.tv_nsec);
+	if (nsecs < OVERLOAD_WINDOW_NSECS)
+		return;
+
+	/* The window elapsed: compare its busy ratio against the
+	 * threshold, then log the state transition, if any.  */
+	if ((100 * overload_detector.window_busy_nsecs >= overload_detector.threshold * nsecs)
+	    != overload_detector.overloaded) {
+		overload_detector.overloaded = !overload_detector.overloaded;
+		note(NULL, WARNING, INTERNAL,
+			"event loop %s: %ju%% busy over the last %jums (backlog: %ju)",
+			overload_detector.overloaded ? "overloaded" : "recovered",
+			(uintmax_t) (100 * overload_detector.window_busy_nsecs / nsecs),
+			(uintmax_t) (nsecs / 1000000),
+			(uintmax_t) event_stats.backlog_last);
+	}
+
+	overload_detector.window_start = end;
+	overload_detector.window_busy_nsecs = 0;
+}
+
+/**
+ * Account one waitpid(2) wakeup that drained @nb_events events:
+ * everything beyond the event that woke the loop up was already
+ * pending, i.e. the loop was late by that much.
+ */
+static void account_backlog(uint64_t nb_events)
+{
+	if (nb_events == 0)
+		return;
+
+	event_stats.nb_wakeups++;
+	event_stats.backlog_last = nb_events - 1;
+	if (event_stats.backlog_last > event_stats.backlog_max)
+		event_stats.backlog_max = event_stats.backlog_last;
+}
+
+/**
+ * Print the event-loop statistics on stderr.
+ */
+static void print_event_stats(void)
+{
+	struct timespec now;
+	uint64_t wall_nsecs;
+	size_t i;
+
+	fprintf(stderr, "event loop:\n");
+	fprintf(stderr, "\tsyscall stops: %ju, seccomp stops: %ju, fork events: %ju, "
+		"exec events: %ju, signal stops: %ju, terminations: %ju\n",
+		(uintmax_t) event_stats.nb_syscall_stops,
+		(uintmax_t) event_stats.nb_seccomp_stops,
+		(uintmax_t) event_stats.nb_fork_events,
+		(uintmax_t) event_stats.nb_exec_events,
+		(uintmax_t) event_stats.nb_signal_stops,
+		(uintmax_t) event_stats.nb_terminations);
+
+	fprintf(stderr, "\tservice latencies:");
+	for (i = 0; i < NB_LATENCY_BUCKETS - 1; i++)
+		fprintf(stderr, " <=%juus: %ju,", (uintmax_t) 1 << (2 * i),
+			(uintmax_t) event_stats.latency_buckets[i]);
+	fprintf(stderr, " above: %ju\n",
+		(uintmax_t) event_stats.latency_buckets[NB_LATENCY_BUCKETS - 1]);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wall_nsecs = (now.tv_sec - loop_start.tv_sec) * UINT64_C(1000000000)
+		+ (now.tv_nsec - loop_start.tv_nsec);
+	if (wall_nsecs == 0)
+		wall_nsecs = 1;
+
+	fprintf(stderr, "\tbusy: %ju%% of wall time (%jums / %jums), "
+		"backlog: last %ju, max %ju (%ju wakeups)\n",
+		(uintmax_t) (100 * event_stats.busy_nsecs / wall_nsecs),
+		(uintmax_t) (event_stats.busy_nsecs / 1000000),
+		(uintmax_t) (wall_nsecs / 1000000),
+		(uintmax_t) event_stats.backlog_last,
+		(uintmax_t) event_stats.backlog_max,
+		(uintmax_t) event_stats.nb_wakeups);
 }
 
 /**
@@ -161,8 +434,14 @@ static void print_talloc_chunk(const void *ptr, int depth, int max_depth UNUSED,
 			fprintf(stderr, ")");
 		}
 		else if (strcmp(name, "Tracee") == 0) {
-			fprintf(stderr, "\t(pid = %d, parent = %p)",
-				((Tracee *)ptr)->pid, ((Tracee *)ptr)->parent);
+			const Tracee *tracee = (Tracee *)ptr;
+			fprintf(stderr, "\t(pid = %d, parent = %p, "
+				"mem reads = %ju (%ju bytes), mem writes = %ju (%ju bytes))",
+				tracee->pid, tracee->parent,
+				(uintmax_t) tracee->mem_stats.nb_reads,
+				(uintmax_t) tracee->mem_stats.bytes_read,
+				(uintmax_t) tracee->mem_stats.nb_writes,
+				(uintmax_t) tracee->mem_stats.bytes_written);
 		}
 		else if (strcmp(name, "Bindings") == 0) {
 			Tracee *tracee;
@@ -200,6 +479,12 @@ static void print_talloc_hierarchy(int signum, siginfo_t *siginfo UNUSED, void *
 	default:
 		break;
 	}
+
+	print_event_stats();
+	print_mem_transfer_stats();
+	print_syscall_profile();
+	print_exec_profile();
+	print_scope_profile();
 }
 
 static int last_exit_status = -1;
@@ -221,10 +506,9 @@ static void check_architecture(Tracee *tracee)
 	if (status < 0)
 		return;
 
-	status = open_elf(path, &elf_header);
+	status = read_elf_header(path, &elf_header);
 	if (status < 0)
 		return;
-	close(status);
 
 	if (!IS_CLASS64(elf_header) || sizeof(word_t) == sizeof(uint64_t))
 		return;
@@ -245,10 +529,238 @@ static void check_architecture(Tracee *tracee)
 		"http://static.proot.me/proot-x86_64");
 }
 
+/**
+ * Check whether @tracee_status is a plain job-control signal delivery
+ * that can be forwarded to @tracee as-is: no PTRACE_EVENT_* bits, no
+ * ptracer to notify, no extension to call, and past the initial
+ * SIGSTOP handshake.  Interactive shells suspending and resuming
+ * their jobs produce streams of such stops; each one then costs a
+ * single ptrace(2) restart, without any register access.
+ */
+static bool fast_stop_signal(const Tracee *tracee, int tracee_status)
+{
+	int signal;
+
+	if (!WIFSTOPPED(tracee_status))
+		return false;
+
+	/* Don't use WSTOPSIG() since it would clear the
+	 * PTRACE_EVENT_* bits, see handle_tracee_event().  */
+	signal = (tracee_status & 0xfff00) >> 8;
+
+	switch (signal) {
+	case SIGTSTP:
+	case SIGTTIN:
+	case SIGTTOU:
+	case SIGCONT:
+		break;
+
+	case SIGSTOP:
+		/* The initial SIGSTOP handshake is handled by the
+		 * regular path.  */
+		if (tracee->sigstop != SIGSTOP_ALLOWED)
+			return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	/* Spin-skip bookkeeping (see leave_spin_skip()) belongs to
+	 * the regular path.  */
+	return (tracee->exe != NULL
+		&& tracee->extensions == NULL
+		&& tracee->as_ptracee.ptracer == NULL
+		&& tracee->restart_how == 0
+		&& !tracee->spin_skip);
+}
+
 /**
  * Wait then handle any event from any tracee.  This function returns
  * the exit status of the last terminated program.
  */
+/* Number of tracees currently running free in spin-skip mode
+ * ($PROOT_SPIN_SKIP); the re-sync timer is armed while it is not
+ * zero.  */
+static size_t nb_spinning_tracees;
+
+/* Set by handle_sigalrm(): time to interrupt the spinning tracees. */
+static volatile sig_atomic_t spin_resync_pending;
+
+static void handle_sigalrm(int signum UNUSED, siginfo_t *siginfo UNUSED, void *ucontext UNUSED)
+{
+	spin_resync_pending = 1;
+}
+
+/* Spin-skip re-sync quantum: how long a tracee may run free before
+ * it is interrupted and put back under PTRACE_SYSCALL.  */
+#define SPIN_RESYNC_QUANTUM_USEC 50000
+
+/**
+ * Let @tracee run free -- PTRACE_CONT, no syscall stops -- until the
+ * next re-sync: it keeps spinning on a syscall PRoot pays no
+ * attention to, see translate_syscall().
+ */
+void enter_spin_skip(Tracee *tracee)
+{
+	struct itimerval timer;
+
+	tracee->spin_skip = true;
+	tracee->restart_how = PTRACE_CONT;
+
+	nb_spinning_tracees++;
+	if (nb_spinning_tracees > 1)
+		return;
+
+	bzero(&timer, sizeof(timer));
+	timer.it_interval.tv_usec = SPIN_RESYNC_QUANTUM_USEC;
+	timer.it_value = timer.it_interval;
+	(void) setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+/**
+ * Put @tracee back under PTRACE_SYSCALL accounting; called on its
+ * first stop -- re-sync or not -- after enter_spin_skip().
+ */
+void leave_spin_skip(Tracee *tracee)
+{
+	struct itimerval timer;
+
+	assert(tracee->spin_skip);
+	tracee->spin_skip = false;
+	tracee->nb_identical_stops = 0;
+
+	assert(nb_spinning_tracees > 0);
+	nb_spinning_tracees--;
+	if (nb_spinning_tracees > 0)
+		return;
+
+	bzero(&timer, sizeof(timer));
+	(void) setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+/* Restarts deferred until the current drain of event_loop() is fully
+ * handled, then issued back-to-back: the handling code and the ptrace
+ * restarts each stay hot in cache, and a tracee whose state changed
+ * several times during the batch -- its emulated ptracer resumed it
+ * mid-drain, say -- is reconciled once instead of per event.  */
+#define RESTART_BATCH_SIZE 256
+typedef struct {
+	Tracee *tracees[RESTART_BATCH_SIZE];
+	size_t nb_tracees;
+} RestartBatch;
+
+/**
+ * Issue the restarts deferred into @batch by defer_restart().  Tracee
+ * pointers are stable during a drain -- free_terminated_tracees() only
+ * runs between two wakeups -- but a batched tracee may have been
+ * restarted, then possibly terminated, by the handling of a later
+ * event (emulated ptrace, vfork completion...); such a restart
+ * consumed @restart_how, so these stale entries are skipped.
+ */
+static void flush_restart_batch(RestartBatch *batch)
+{
+	size_t i;
+
+	for (i = 0; i < batch->nb_tracees; i++) {
+		Tracee *tracee = batch->tracees[i];
+
+		tracee->restart_deferred = false;
+
+		if (tracee->running || tracee->terminated || tracee->restart_how == 0)
+			continue;
+
+		(void) restart_tracee(tracee, tracee->deferred_signal);
+	}
+
+	batch->nb_tracees = 0;
+}
+
+/**
+ * Remove @tracee from @batch; called right before the one untimely
+ * free -- pid reuse in the middle of a drain -- so that
+ * flush_restart_batch() never touches a freed entry.
+ */
+static void forget_deferred_restart(RestartBatch *batch, Tracee *tracee)
+{
+	size_t i;
+
+	for (i = 0; i < batch->nb_tracees; i++) {
+		if (batch->tracees[i] != tracee)
+			continue;
+
+		batch->tracees[i] = batch->tracees[--batch->nb_tracees];
+		return;
+	}
+}
+
+/**
+ * Record into @batch that @tracee has to be restarted with @signal
+ * once the current drain is fully handled.  A tracee that stopped
+ * twice during the very same drain keeps the latest signal only.
+ */
+static void defer_restart(RestartBatch *batch, Tracee *tracee, int signal)
+{
+	if (tracee->restart_deferred) {
+		tracee->deferred_signal = signal;
+		return;
+	}
+
+	if (batch->nb_tracees == RESTART_BATCH_SIZE)
+		flush_restart_batch(batch);
+
+	tracee->restart_deferred = true;
+	tracee->deferred_signal = signal;
+	batch->tracees[batch->nb_tracees++] = tracee;
+}
+
+/**
+ * Expand to a specialized variant of the per-event dispatch used by
+ * event_loop(): the extension notification and ptrace emulation
+ * branches are compiled out when the corresponding parameter is
+ * false, so a session that uses neither runs a branch-minimal loop.
+ * The parameters are compile-time constants, the compiler folds the
+ * dead branches away.
+ */
+#define DEFINE_DISPATCH_EVENT(name, has_extensions, emulates_ptrace)	\
+static void name(Tracee *tracee, int tracee_status,			\
+		const struct timespec *event_start, RestartBatch *batch) \
+{									\
+	int signal;							\
+									\
+	/* Plain job-control signal with nobody to notify: forward	\
+	 * it straight away, skipping the extension and ptrace		\
+	 * emulation machinery.  */					\
+	if (fast_stop_signal(tracee, tracee_status)) {			\
+		account_tracee_event(tracee_status);			\
+		tracee->restart_how =					\
+			(tracee->seccomp == ENABLED && !tracee->sysexit_pending) \
+			? PTRACE_CONT : PTRACE_SYSCALL;			\
+		defer_restart(batch, tracee, (tracee_status & 0xfff00) >> 8); \
+		account_event_latency(event_start);			\
+		return;							\
+	}								\
+									\
+	if (has_extensions						\
+	    && notify_extensions(tracee, NEW_STATUS, tracee_status, 0) != 0) { \
+		account_event_latency(event_start);			\
+		return;							\
+	}								\
+									\
+	if (emulates_ptrace && tracee->as_ptracee.ptracer != NULL	\
+	    && handle_ptracee_event(tracee, tracee_status)) {		\
+		account_event_latency(event_start);			\
+		return;							\
+	}								\
+									\
+	signal = handle_tracee_event(tracee, tracee_status);		\
+	defer_restart(batch, tracee, signal);				\
+	account_event_latency(event_start);				\
+}
+
+DEFINE_DISPATCH_EVENT(dispatch_event_full, true, true)
+DEFINE_DISPATCH_EVENT(dispatch_event_lean, false, false)
+
 int event_loop()
 {
 	struct sigaction signal_action;
@@ -260,6 +772,19 @@ int event_loop()
 	if (status != 0)
 		note(NULL, WARNING, INTERNAL, "atexit() failed");
 
+	/* When $PROOT_HUGE_HEAP is set, keep PRoot's own hot
+	 * structures -- Tracee hierarchies, collector pools, path
+	 * caches -- in one contiguous main arena that khugepaged can
+	 * collapse into transparent hugepages: never trim the heap
+	 * (shrinking splits the extent and shoots down TLBs each time
+	 * a fork storm recedes) and don't divert large allocations to
+	 * discrete mmap(2)s.  Opt-in since it trades resident memory
+	 * for TLB reach.  */
+	if (getenv("PROOT_HUGE_HEAP") != NULL) {
+		(void) mallopt(M_TRIM_THRESHOLD, INT_MAX);
+		(void) mallopt(M_MMAP_THRESHOLD, INT_MAX);
+	}
+
 	/* All signals are blocked when the signal handler is called.
 	 * SIGINFO is used to know which process has signaled us and
 	 * RESTART is used to restart waitpid(2) seamlessly.  */
@@ -290,6 +815,12 @@ int event_loop()
 			signal_action.sa_sigaction = print_talloc_hierarchy;
 			break;
 
+		case SIGHUP:
+			/* Re-read the bindings file, see
+			 * handle_bindings_reload().  */
+			signal_action.sa_sigaction = handle_sighup;
+			break;
+
 		case SIGCHLD:
 		case SIGCONT:
 		case SIGSTOP:
@@ -312,44 +843,140 @@ int event_loop()
 			note(NULL, WARNING, SYSTEM, "sigaction(%d)", signum);
 	}
 
+	/* SIGIO announces a pending seccomp user-notification; its
+	 * only purpose is to interrupt waitpid(2), hence no
+	 * SA_RESTART for this one.  */
+	signal_action.sa_flags = SA_SIGINFO;
+	signal_action.sa_sigaction = handle_sigio;
+	status = sigaction(SIGIO, &signal_action, NULL);
+	if (status < 0)
+		note(NULL, WARNING, SYSTEM, "sigaction(SIGIO)");
+
+	/* SIGALRM paces the spin-skip re-sync; like SIGIO its only
+	 * purpose is to interrupt waitpid(2).  */
+	signal_action.sa_sigaction = handle_sigalrm;
+	status = sigaction(SIGALRM, &signal_action, NULL);
+	if (status < 0)
+		note(NULL, WARNING, SYSTEM, "sigaction(SIGALRM)");
+
+	/* $PROOT_OVERLOAD_THRESHOLD arms the overload detector, see
+	 * account_event_latency().  */
+	if (getenv("PROOT_OVERLOAD_THRESHOLD") != NULL)
+		overload_detector.threshold =
+			strtoul(getenv("PROOT_OVERLOAD_THRESHOLD"), NULL, 10);
+
+	clock_gettime(CLOCK_MONOTONIC, &loop_start);
+
 	while (1) {
+		struct timespec event_start;
+		RestartBatch restart_batch;
+		uint64_t nb_drained = 0;
 		int tracee_status;
 		Tracee *tracee;
-		int signal;
+		bool blocking;
 		pid_t pid;
 
+		restart_batch.nb_tracees = 0;
+
 		/* This is the only safe place to free tracees.  */
 		free_terminated_tracees();
 
-		/* Wait for the next tracee's stop. */
-		pid = waitpid(-1, &tracee_status, __WALL);
-		if (pid < 0) {
-			if (errno != ECHILD) {
-				note(NULL, ERROR, SYSTEM, "waitpid()");
-				return EXIT_FAILURE;
-			}
-			break;
+		/* Handle any pending seccomp user-notification.  */
+		handle_syscall_notif();
+
+		/* Interrupt the tracees that run free in spin-skip
+		 * mode, so they fall back to the common flow.  */
+		if (spin_resync_pending) {
+			spin_resync_pending = 0;
+			resync_spinning_tracees();
 		}
 
-		/* Get information about this tracee. */
-		tracee = get_tracee(NULL, pid, true);
-		assert(tracee != NULL);
 
-		tracee->running = false;
+		/* Block until a tracee stops, then drain all the
+		 * events already queued: under fork storms hundreds
+		 * of stops are pending, handling them back-to-back
+		 * pays the bookkeeping above once per wakeup instead
+		 * of once per event.  Restarts are deferred to the
+		 * end of the drain, see flush_restart_batch().  */
+		for (blocking = true; ; blocking = false) {
+			pid = waitpid(-1, &tracee_status,
+				__WALL | (blocking ? 0 : WNOHANG));
 
-		status = notify_extensions(tracee, NEW_STATUS, tracee_status, 0);
-		if (status != 0)
-			continue;
+			/* Everything queued was drained.  */
+			if (pid == 0)
+				break;
+
+			if (pid < 0) {
+				/* A SIGIO announced a user-notification.  */
+				if (errno == EINTR)
+					break;
+				if (errno != ECHILD) {
+					note(NULL, ERROR, SYSTEM, "waitpid()");
+					return EXIT_FAILURE;
+				}
+				flush_restart_batch(&restart_batch);
+				goto end;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &event_start);
+			nb_drained++;
+
+			/* Get information about this tracee. */
+			tracee = get_tracee(NULL, pid, true);
+			assert(tracee != NULL);
+
+			/* This pid was released by an exit event
+			 * reaped earlier during this very drain, then
+			 * reused by the kernel.  Freeing between two
+			 * events is safe: nothing refers to this dead
+			 * entry anymore.  */
+			if (tracee->terminated) {
+				if (tracee->restart_deferred)
+					forget_deferred_restart(&restart_batch, tracee);
+				TALLOC_FREE(tracee);
+				tracee = get_tracee(NULL, pid, true);
+				assert(tracee != NULL);
+			}
 
-		if (tracee->as_ptracee.ptracer != NULL) {
-			bool keep_stopped = handle_ptracee_event(tracee, tracee_status);
-			if (keep_stopped)
-				continue;
+			tracee->running = false;
+
+			/* Safe point to swap binding snapshots: this
+			 * tracee is stopped and no translation is in
+			 * progress.  */
+			handle_bindings_reload(tracee);
+
+			/* Both conditions are one-way latches -- an
+			 * extension or an emulated ptracer never goes
+			 * back to "never used" -- so the common
+			 * session takes the lean variant from the
+			 * first event on and this branch is perfectly
+			 * predicted; checking per event rather than
+			 * per wakeup covers a tracee calling
+			 * ptrace(2) in the middle of a drain.  */
+			if (extensions_in_use || ptrace_emulation_active)
+				dispatch_event_full(tracee, tracee_status, &event_start,
+						&restart_batch);
+			else
+				dispatch_event_lean(tracee, tracee_status, &event_start,
+						&restart_batch);
 		}
 
-		signal = handle_tracee_event(tracee, tracee_status);
-		(void) restart_tracee(tracee, signal);
+		flush_restart_batch(&restart_batch);
+		account_backlog(nb_drained);
 	}
+end:
+
+	/* No-op unless $PROOT_PROFILE_SYSCALLS is set.  Scope samples
+	 * are collected unconditionally -- they are part of the
+	 * SIGUSR dump, see print_talloc_hierarchy() -- but their
+	 * end-of-run report is opt-in like the others.  */
+	print_syscall_profile();
+	print_exec_profile();
+	if (getenv("PROOT_PROFILE_SYSCALLS") != NULL)
+		print_scope_profile();
+
+	/* No-op unless --analyze-bindings was specified.  */
+	print_binding_profile();
 
 	return last_exit_status;
 }
@@ -358,6 +985,11 @@ int event_loop()
  * Handle the current event (@tracee_status) of the given @tracee.
  * This function returns the "computed" signal that should be used to
  * restart the given @tracee.
+ *
+ * Stops are classified from @tracee_status alone: registers are only
+ * fetched by the handlers that consume them -- translate_syscall()
+ * and new_child() -- so forwarding a plain signal delivery costs no
+ * register traffic at all.
  */
 int handle_tracee_event(Tracee *tracee, int tracee_status)
 {
@@ -366,6 +998,14 @@ int handle_tracee_event(Tracee *tracee, int tracee_status)
 	long status;
 	int signal;
 
+	/* Any stop ends the free-running spin-skip window; remember
+	 * it to discard the re-sync SIGSTOP below.  */
+	const bool was_spinning = tracee->spin_skip;
+	if (was_spinning)
+		leave_spin_skip(tracee);
+
+	account_tracee_event(tracee_status);
+
 	/* Don't overwrite restart_how if it is explicitly set
 	 * elsewhere, i.e in the ptrace emulation when single
 	 * stepping.  */
@@ -389,13 +1029,13 @@ int handle_tracee_event(Tracee *tracee, int tracee_status)
 	if (WIFEXITED(tracee_status)) {
 		last_exit_status = WEXITSTATUS(tracee_status);
 		VERBOSE(tracee, 1, "pid %d: exited with status %d", pid, last_exit_status);
-		tracee->terminated = true;
+		terminate_tracee(tracee);
 	}
 	else if (WIFSIGNALED(tracee_status)) {
 		check_architecture(tracee);
 		VERBOSE(tracee, (int) (last_exit_status != -1),
 			"pid %d: terminated with signal %d", pid, WTERMSIG(tracee_status));
-		tracee->terminated = true;
+		terminate_tracee(tracee);
 	}
 	else if (WIFSTOPPED(tracee_status)) {
 		/* Don't use WSTOPSIG() to extract the signal
@@ -549,6 +1189,15 @@ int handle_tracee_event(Tracee *tracee, int tracee_status)
 			break;
 
 		case SIGSTOP:
+			/* A spin-skip re-sync interrupt, not a real
+			 * job-control stop: discard it, the switch
+			 * back to PTRACE_SYSCALL already happened
+			 * above.  */
+			if (was_spinning) {
+				signal = 0;
+				break;
+			}
+
 			/* Stop this tracee until PRoot has received
 			 * the EVENT_*FORK|CLONE notification.  */
 			if (tracee->exe == NULL) {
@@ -598,5 +1247,9 @@ bool restart_tracee(Tracee *tracee, int signal)
 	tracee->restart_how = 0;
 	tracee->running = true;
 
+	/* Its memory might change from now on.  */
+	invalidate_peek_cache(tracee);
+	invalidate_read_ahead(tracee);
+
 	return true;
 }
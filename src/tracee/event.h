@@ -27,9 +27,14 @@
 
 #include "tracee/tracee.h"
 
+/* Set by the --cpus option, see launch_process().  */
+extern bool tracer_cpus_pinned;
+
 extern int launch_process(Tracee *tracee, char *const argv[]);
 extern int event_loop();
 extern int handle_tracee_event(Tracee *tracee, int tracee_status);
 extern bool restart_tracee(Tracee *tracee, int signal);
+extern void enter_spin_skip(Tracee *tracee);
+extern void leave_spin_skip(Tracee *tracee);
 
 #endif /* TRACEE_EVENT_H */
@@ -22,24 +22,30 @@
 
 #include <sys/ptrace.h> /* ptrace(2), PTRACE_*, */
 #include <sys/types.h>  /* pid_t, size_t, */
+#include <stdio.h>      /* snprintf(3), */
+#include <fcntl.h>      /* open(2), O_*, */
 #include <stdlib.h>     /* NULL, */
 #include <stddef.h>     /* offsetof(), */
 #include <sys/user.h>   /* struct user*, */
 #include <errno.h>      /* errno, */
 #include <assert.h>     /* assert(3), */
 #include <sys/wait.h>   /* waitpid(2), */
+#include <sys/param.h>  /* MIN(), */
 #include <string.h>     /* memcpy(3), */
 #include <stdint.h>     /* uint*_t, */
 #include <sys/uio.h>    /* process_vm_*, struct iovec, */
 #include <unistd.h>     /* sysconf(3), */
 #include <sys/mman.h>   /* mmap(2), munmap(2), MAP_*, */
+#include <talloc.h>     /* talloc_*, */
 
 #include "tracee/mem.h"
 #include "tracee/abi.h"
 #include "syscall/heap.h"
 #include "arch.h"            /* word_t, NO_MISALIGNED_ACCESS */
+#include "attribute.h"       /* UNUSED, */
 #include "build.h"           /* HAVE_PROCESS_VM,  */
 #include "cli/note.h"
+#include "profile.h"
 
 /**
  * Load the word at the given @address, potentially *not* aligned.
@@ -75,13 +81,347 @@ static inline void store_word(void *address, word_t value)
 #endif
 }
 
+/**
+ * Return the "/proc/<pid>/mem" file descriptor of @tracee, opened on
+ * first use then kept until the tracee is removed.  This function
+ * returns -1 when this fd is not usable.  pread(2)/pwrite(2) on it
+ * moves an arbitrary amount of data per syscall, whereas the
+ * PTRACE_PEEKDATA/POKEDATA last resort moves one word each.
+ */
+static int get_mem_fd(const Tracee *tracee_)
+{
+	Tracee *tracee = (Tracee *) tracee_; /* Memoization only.  */
+	char path[32]; /* 32 > sizeof("/proc//mem") + sizeof(#ULONG_MAX) */
+	int status;
+
+	if (tracee->mem_fd != -1)
+		return (tracee->mem_fd >= 0 ? tracee->mem_fd : -1);
+
+	status = snprintf(path, sizeof(path), "/proc/%d/mem", tracee->pid);
+	if (status < 0 || (size_t) status >= sizeof(path)) {
+		tracee->mem_fd = -2;
+		return -1;
+	}
+
+	tracee->mem_fd = open(path, O_RDWR | O_CLOEXEC);
+	if (tracee->mem_fd < 0) {
+		/* Don't retry on each transfer.  */
+		tracee->mem_fd = -2;
+		return -1;
+	}
+
+	return tracee->mem_fd;
+}
+
+/* Statistics about tracee-memory transfers, one record per entry
+ * point.  They quantify how often each transfer mechanism is used --
+ * process_vm_{readv,writev}(2), pread(2)/pwrite(2) on
+ * "/proc/<pid>/mem", or the PTRACE_PEEKDATA/POKEDATA last resort --
+ * and how large the transfers are.  They are printed on
+ * SIGUSR1/SIGUSR2 along with the talloc hierarchy (see
+ * print_talloc_hierarchy() in tracee/event.c).  */
+#define NB_SIZE_BUCKETS 8
+
+typedef struct {
+	const char *name;
+	uint64_t nb_calls;
+	uint64_t nb_process_vm;
+	uint64_t nb_mem_fd;
+	uint64_t nb_ptrace;
+	uint64_t nb_read_ahead;
+	uint64_t nb_failures;
+
+	/* Number of calls per transfer size, in power-of-four buckets:
+	 * <= 4 bytes, <= 16, <= 64, ..., then everything above.  */
+	uint64_t size_buckets[NB_SIZE_BUCKETS];
+} MemStats;
+
+static MemStats read_stats   = { .name = "read_data" };
+static MemStats write_stats  = { .name = "write_data" };
+static MemStats string_stats = { .name = "read_string" };
+static MemStats peek_stats   = { .name = "peek_word" };
+static MemStats poke_stats   = { .name = "poke_word" };
+
+/**
+ * Account one transfer of @size bytes in @stats, and in the
+ * per-tracee counters of @tracee_ (@is_write tells the direction).
+ */
+static void account_transfer(MemStats *stats, const Tracee *tracee_, size_t size, bool is_write)
+{
+	Tracee *tracee = (Tracee *) tracee_; /* Statistics only.  */
+	size_t bucket;
+
+	stats->nb_calls++;
+
+	for (bucket = 0; bucket < NB_SIZE_BUCKETS - 1 && size > (4UL << (2 * bucket)); bucket++)
+		;
+	stats->size_buckets[bucket]++;
+
+	if (is_write) {
+		tracee->mem_stats.nb_writes++;
+		tracee->mem_stats.bytes_written += size;
+	}
+	else {
+		tracee->mem_stats.nb_reads++;
+		tracee->mem_stats.bytes_read += size;
+	}
+}
+
+/* Print on stderr the global tracee-memory transfer statistics.  */
+void print_mem_transfer_stats(void)
+{
+	static MemStats *const all_stats[] = {
+		&read_stats, &write_stats, &string_stats, &peek_stats, &poke_stats };
+	size_t i, j;
+
+	fprintf(stderr, "tracee-memory transfers:\n");
+
+	for (i = 0; i < sizeof(all_stats) / sizeof(all_stats[0]); i++) {
+		const MemStats *stats = all_stats[i];
+
+		fprintf(stderr, "\t%-12s %ju calls "
+			"(process_vm: %ju, mem fd: %ju, ptrace: %ju, "
+			"read-ahead: %ju, failed: %ju)\n",
+			stats->name,
+			(uintmax_t) stats->nb_calls,
+			(uintmax_t) stats->nb_process_vm,
+			(uintmax_t) stats->nb_mem_fd,
+			(uintmax_t) stats->nb_ptrace,
+			(uintmax_t) stats->nb_read_ahead,
+			(uintmax_t) stats->nb_failures);
+
+		fprintf(stderr, "\t\tsizes:");
+		for (j = 0; j < NB_SIZE_BUCKETS - 1; j++)
+			fprintf(stderr, " <=%zu: %ju,", (size_t) 4 << (2 * j),
+				(uintmax_t) stats->size_buckets[j]);
+		fprintf(stderr, " above: %ju\n",
+			(uintmax_t) stats->size_buckets[NB_SIZE_BUCKETS - 1]);
+	}
+}
+
+/* Writes queued against a tracee's memory, flushed as a single
+ * scatter-gather process_vm_writev(2) before the tracee resumes, or
+ * before anything is read back from its memory.  A single intercepted
+ * syscall often stages several small buffers (translated paths,
+ * sockaddr); batching them saves one syscall round trip each.  */
+#define NB_QUEUED_WRITES 8
+
+typedef struct {
+	word_t dest;
+	void *data;
+	size_t size;
+} QueuedWrite;
+
+static const Tracee *write_queue_owner;
+static QueuedWrite write_queue[NB_QUEUED_WRITES];
+static size_t nb_queued_writes;
+
+/**
+ * Flush all writes previously queued with queue_write_data(),
+ * preferably as one process_vm_writev(2) call.  This function returns
+ * -errno if an error occured, otherwise 0.
+ */
+int flush_queued_writes(const Tracee *tracee UNUSED)
+{
+	const Tracee *owner = write_queue_owner;
+	size_t count = nb_queued_writes;
+	int status = 0;
+	size_t i;
+
+	if (count == 0)
+		return 0;
+
+	/* Reset the queue *before* the transfers: write_data() is
+	 * re-entered below and must not flush recursively.  */
+	write_queue_owner = NULL;
+	nb_queued_writes = 0;
+
+#if defined(HAVE_PROCESS_VM)
+	struct iovec local[NB_QUEUED_WRITES];
+	struct iovec remote[NB_QUEUED_WRITES];
+	size_t total_size;
+	long transferred;
+
+	for (i = 0, total_size = 0; i < count; i++) {
+		local[i].iov_base = write_queue[i].data;
+		local[i].iov_len  = write_queue[i].size;
+
+		remote[i].iov_base = (void *) write_queue[i].dest;
+		remote[i].iov_len  = write_queue[i].size;
+
+		total_size += write_queue[i].size;
+	}
+
+	transferred = process_vm_writev(owner->pid, local, count, remote, count, 0);
+	if ((size_t) transferred == total_size)
+		goto end;
+	/* Fallback to iterative writes if something went wrong.  */
+#endif /* HAVE_PROCESS_VM */
+
+	for (i = 0; i < count; i++) {
+		int status2 = write_data(owner, write_queue[i].dest,
+					write_queue[i].data, write_queue[i].size);
+		if (status2 < 0 && status == 0)
+			status = status2;
+	}
+
+#if defined(HAVE_PROCESS_VM)
+end:
+#endif
+	for (i = 0; i < count; i++)
+		TALLOC_FREE(write_queue[i].data);
+
+	return status;
+}
+
+/* Read-ahead window over the memory of the lastly read tracee.
+ * Sequential scans -- ELF notes, auxiliary vectors, extension file
+ * checks -- often follow a sizeable read_data() with an adjacent one:
+ * transfers above READ_AHEAD_THRESHOLD over-read up to the end of
+ * their last page -- mapped for sure -- and the immediately-following
+ * reads covered by the window are served from tracer memory.  Like
+ * the peek cache (see ptrace/ptrace.c), the window is dropped as soon
+ * as its owner runs again (see restart_tracee()) or its memory is
+ * written to.  */
+#define READ_AHEAD_THRESHOLD 256
+#define READ_AHEAD_SIZE 8192
+
+static struct {
+	pid_t pid;
+	word_t base;
+	size_t size;
+	uint8_t window[READ_AHEAD_SIZE];
+} read_ahead;
+
+/**
+ * Forget the content of the read-ahead window if it belongs to
+ * @tracee.
+ */
+void invalidate_read_ahead(const Tracee *tracee)
+{
+	if (read_ahead.pid == tracee->pid) {
+		read_ahead.pid  = 0;
+		read_ahead.size = 0;
+	}
+}
+
+/**
+ * Fill the read-ahead window with @span bytes read at @src_tracee in
+ * @tracee's memory.  Only the cheap bulk mechanisms are tried: an
+ * over-read is speculative, it's not worth a word-by-word ptrace
+ * fallback.  This function returns -1 when the window couldn't be
+ * filled, otherwise 0.
+ */
+static int fill_read_ahead(const Tracee *tracee, word_t src_tracee, size_t span)
+{
+	ssize_t transferred = -1;
+
+	assert(span <= READ_AHEAD_SIZE);
+
+#if defined(HAVE_PROCESS_VM)
+	{
+		struct iovec local;
+		struct iovec remote;
+
+		local.iov_base = read_ahead.window;
+		local.iov_len  = span;
+
+		remote.iov_base = (void *) src_tracee;
+		remote.iov_len  = span;
+
+		transferred = process_vm_readv(tracee->pid, &local, 1, &remote, 1, 0);
+		if ((size_t) transferred == span)
+			read_stats.nb_process_vm++;
+		else
+			transferred = -1;
+	}
+#endif /* HAVE_PROCESS_VM */
+
+	if (transferred < 0) {
+		int mem_fd = get_mem_fd(tracee);
+		if (mem_fd < 0)
+			return -1;
+
+		transferred = pread(mem_fd, read_ahead.window, span, (off_t) src_tracee);
+		if ((size_t) transferred != span)
+			return -1;
+		read_stats.nb_mem_fd++;
+	}
+
+	read_ahead.pid  = tracee->pid;
+	read_ahead.base = src_tracee;
+	read_ahead.size = span;
+
+	return 0;
+}
+
+/**
+ * Same as write_data() except the transfer is delayed until
+ * flush_queued_writes() -- which is also called implicitly before any
+ * read from the @tracee's memory.
+ */
+int queue_write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer, word_t size)
+{
+	QueuedWrite *entry;
+	int status;
+
+	if (belongs_to_heap_prealloc(tracee, dest_tracee))
+		return -EFAULT;
+
+	invalidate_read_ahead(tracee);
+
+	/* The queue handles one tracee at a time: PRoot processes a
+	 * single ptrace stop at once.  */
+	if (   (write_queue_owner != tracee && nb_queued_writes > 0)
+	    || nb_queued_writes == NB_QUEUED_WRITES) {
+		status = flush_queued_writes(write_queue_owner);
+		if (status < 0)
+			return status;
+	}
+
+	entry = &write_queue[nb_queued_writes];
+	entry->data = talloc_memdup(NULL, src_tracer, size);
+	if (entry->data == NULL)
+		return write_data(tracee, dest_tracee, src_tracer, size);
+
+	entry->dest = dest_tracee;
+	entry->size = size;
+
+	write_queue_owner = tracee;
+	nb_queued_writes++;
+
+	return 0;
+}
+
+/**
+ * Same as poke_word() except the transfer may be delayed until
+ * flush_queued_writes(): adjacent words and buffers staged for the
+ * same stop are then combined into one vectored write.  The caller
+ * must test errno to check if an error occured -- a transfer failure
+ * at flush time is beyond reach, like a process_vm_writev(2) partial
+ * write.
+ */
+void queue_poke_word(const Tracee *tracee, word_t address, word_t value)
+{
+	int status;
+
+	/* Note: &value points to the 32 LSB on 64-bit little-endian
+	 * architecture.  */
+	status = queue_write_data(tracee, address, &value, sizeof_word(tracee));
+	errno = (status < 0 ? -status : 0);
+}
+
 /**
  * Copy @size bytes from the buffer @src_tracer to the address
  * @dest_tracee within the memory space of the @tracee process. It
  * returns -errno if an error occured, otherwise 0.
  */
-int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer, word_t size)
+static int write_data2(const Tracee *tracee, word_t dest_tracee, const void *src_tracer, word_t size)
 {
+	/* Preserve ordering with respect to queued writes.  */
+	if (nb_queued_writes > 0)
+		(void) flush_queued_writes(write_queue_owner);
+
 	word_t *src  = (word_t *)src_tracer;
 	word_t *dest = (word_t *)dest_tracee;
 
@@ -96,6 +436,10 @@ int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer,
 	if (belongs_to_heap_prealloc(tracee, dest_tracee))
 		return -EFAULT;
 
+	invalidate_read_ahead(tracee);
+
+	account_transfer(&write_stats, tracee, size, true);
+
 #if defined(HAVE_PROCESS_VM)
 	struct iovec local;
 	struct iovec remote;
@@ -107,12 +451,29 @@ int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer,
 	remote.iov_len  = size;
 
 	status = process_vm_writev(tracee->pid, &local, 1, &remote, 1, 0);
-	if ((size_t) status == size)
+	if ((size_t) status == size) {
+		write_stats.nb_process_vm++;
 		return 0;
-	/* Fallback to ptrace if something went wrong.  */
+	}
+	/* Fallback to "/proc/<pid>/mem" then ptrace if something went
+	 * wrong.  */
 
 #endif /* HAVE_PROCESS_VM */
 
+	{
+		int mem_fd = get_mem_fd(tracee);
+		if (mem_fd >= 0) {
+			status = pwrite(mem_fd, src_tracer, size, (off_t) dest_tracee);
+			if ((size_t) status == size) {
+				write_stats.nb_mem_fd++;
+				return 0;
+			}
+			/* Fallback to ptrace if something went wrong.  */
+		}
+	}
+
+	write_stats.nb_ptrace++;
+
 	nb_trailing_bytes = size % sizeof(word_t);
 	nb_full_words     = (size - nb_trailing_bytes) / sizeof(word_t);
 
@@ -121,6 +482,7 @@ int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer,
 		status = ptrace(PTRACE_POKEDATA, tracee->pid, dest + i, load_word(&src[i]));
 		if (status < 0) {
 			note(tracee, WARNING, SYSTEM, "ptrace(POKEDATA)");
+			write_stats.nb_failures++;
 			return -EFAULT;
 		}
 	}
@@ -134,6 +496,7 @@ int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer,
 	word = ptrace(PTRACE_PEEKDATA, tracee->pid, dest + i, NULL);
 	if (errno != 0) {
 		note(tracee, WARNING, SYSTEM, "ptrace(PEEKDATA)");
+		write_stats.nb_failures++;
 		return -EFAULT;
 	}
 
@@ -146,12 +509,28 @@ int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer,
 	status = ptrace(PTRACE_POKEDATA, tracee->pid, dest + i, word);
 	if (status < 0) {
 		note(tracee, WARNING, SYSTEM, "ptrace(POKEDATA)");
+		write_stats.nb_failures++;
 		return -EFAULT;
 	}
 
 	return 0;
 }
 
+/**
+ * Sampled-profile shell of write_data2(), see above.
+ */
+int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer, word_t size)
+{
+	uint64_t profile_start;
+	int status;
+
+	profile_start = profile_scope_enter(SCOPE_WRITE_DATA);
+	status = write_data2(tracee, dest_tracee, src_tracer, size);
+	profile_scope_exit(SCOPE_WRITE_DATA, profile_start);
+
+	return status;
+}
+
 /**
  * Gather the @src_tracer_count buffers pointed to by @src_tracer to
  * the address @dest_tracee within the memory space of the @tracee
@@ -160,6 +539,10 @@ int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer,
  */
 int writev_data(const Tracee *tracee, word_t dest_tracee, const struct iovec *src_tracer, int src_tracer_count)
 {
+	/* Preserve ordering with respect to queued writes.  */
+	if (nb_queued_writes > 0)
+		(void) flush_queued_writes(write_queue_owner);
+
 	size_t size;
 	int status;
 	int i;
@@ -167,6 +550,8 @@ int writev_data(const Tracee *tracee, word_t dest_tracee, const struct iovec *sr
 	if (belongs_to_heap_prealloc(tracee, dest_tracee))
 		return -EFAULT;
 
+	invalidate_read_ahead(tracee);
+
 #if defined(HAVE_PROCESS_VM)
 	struct iovec remote;
 
@@ -200,8 +585,12 @@ int writev_data(const Tracee *tracee, word_t dest_tracee, const struct iovec *sr
  * @src_tracee within the memory space of the @tracee process. It
  * returns -errno if an error occured, otherwise 0.
  */
-int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t size)
+static int read_data2(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t size)
 {
+	/* Preserve ordering with respect to queued writes.  */
+	if (nb_queued_writes > 0)
+		(void) flush_queued_writes(write_queue_owner);
+
 	word_t *src  = (word_t *)src_tracee;
 	word_t *dest = (word_t *)dest_tracer;
 
@@ -215,6 +604,32 @@ int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t
 	if (belongs_to_heap_prealloc(tracee, src_tracee))
 		return -EFAULT;
 
+	account_transfer(&read_stats, tracee, size, false);
+
+	/* Served from the read-ahead window?  */
+	if (   read_ahead.pid == tracee->pid
+	    && read_ahead.size > 0
+	    && src_tracee >= read_ahead.base
+	    && size <= read_ahead.size
+	    && src_tracee - read_ahead.base <= read_ahead.size - size) {
+		memcpy(dest_tracer, read_ahead.window + (src_tracee - read_ahead.base), size);
+		read_stats.nb_read_ahead++;
+		return 0;
+	}
+
+	/* Large transfers over-read up to the end of their last page
+	 * -- mapped for sure since the requested bytes lie in it -- so
+	 * the next adjacent reads are served locally.  */
+	if (size >= READ_AHEAD_THRESHOLD) {
+		size_t span = size + (4096 - ((src_tracee + size) % 4096)) % 4096;
+
+		if (span > size && span <= READ_AHEAD_SIZE
+		    && fill_read_ahead(tracee, src_tracee, span) == 0) {
+			memcpy(dest_tracer, read_ahead.window, size);
+			return 0;
+		}
+	}
+
 #if defined(HAVE_PROCESS_VM)
 	long status;
 	struct iovec local;
@@ -227,12 +642,31 @@ int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t
 	remote.iov_len  = size;
 
 	status = process_vm_readv(tracee->pid, &local, 1, &remote, 1, 0);
-	if ((size_t) status == size)
+	if ((size_t) status == size) {
+		read_stats.nb_process_vm++;
 		return 0;
-	/* Fallback to ptrace if something went wrong.  */
+	}
+	/* Fallback to "/proc/<pid>/mem" then ptrace if something went
+	 * wrong.  */
 
 #endif /* HAVE_PROCESS_VM */
 
+	{
+		int mem_fd = get_mem_fd(tracee);
+		if (mem_fd >= 0) {
+			ssize_t transferred;
+
+			transferred = pread(mem_fd, dest_tracer, size, (off_t) src_tracee);
+			if ((size_t) transferred == size) {
+				read_stats.nb_mem_fd++;
+				return 0;
+			}
+			/* Fallback to ptrace if something went wrong.  */
+		}
+	}
+
+	read_stats.nb_ptrace++;
+
 	nb_trailing_bytes = size % sizeof(word_t);
 	nb_full_words     = (size - nb_trailing_bytes) / sizeof(word_t);
 
@@ -241,6 +675,7 @@ int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t
 		word = ptrace(PTRACE_PEEKDATA, tracee->pid, src + i, NULL);
 		if (errno != 0) {
 			note(tracee, WARNING, SYSTEM, "ptrace(PEEKDATA)");
+			read_stats.nb_failures++;
 			return -EFAULT;
 		}
 		store_word(&dest[i], word);
@@ -255,6 +690,7 @@ int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t
 	word = ptrace(PTRACE_PEEKDATA, tracee->pid, src + i, NULL);
 	if (errno != 0) {
 		note(tracee, WARNING, SYSTEM, "ptrace(PEEKDATA)");
+		read_stats.nb_failures++;
 		return -EFAULT;
 	}
 
@@ -267,6 +703,34 @@ int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t
 	return 0;
 }
 
+/**
+ * Sampled-profile shell of read_data2(), see above.
+ */
+int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t size)
+{
+	uint64_t profile_start;
+	int status;
+
+	profile_start = profile_scope_enter(SCOPE_READ_DATA);
+	status = read_data2(tracee, dest_tracer, src_tracee, size);
+	profile_scope_exit(SCOPE_READ_DATA, profile_start);
+
+	return status;
+}
+
+/**
+ * Return true if @word contains a NUL byte -- the classic "haszero"
+ * bit trick: subtracting 1 from each byte borrows into its high bit
+ * only when the byte was zero.
+ */
+static inline bool has_nul_byte(word_t word)
+{
+	const word_t ones  = (word_t) -1 / 0xFF;  /* 0x0101...01 */
+	const word_t highs = ones << 7;           /* 0x8080...80 */
+
+	return ((word - ones) & ~word & highs) != 0;
+}
+
 /**
  * Copy to @dest_tracer at most @max_size bytes from the string
  * pointed to by @src_tracee within the memory space of the @tracee
@@ -276,6 +740,10 @@ int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t
  */
 int read_string(const Tracee *tracee, char *dest_tracer, word_t src_tracee, word_t max_size)
 {
+	/* Preserve ordering with respect to queued writes.  */
+	if (nb_queued_writes > 0)
+		(void) flush_queued_writes(write_queue_owner);
+
 	word_t *src  = (word_t *)src_tracee;
 	word_t *dest = (word_t *)dest_tracer;
 
@@ -289,6 +757,10 @@ int read_string(const Tracee *tracee, char *dest_tracer, word_t src_tracee, word
 	if (belongs_to_heap_prealloc(tracee, src_tracee))
 		return -EFAULT;
 
+	/* The histogram records @max_size: the actual string length is
+	 * not known until the transfer completes.  */
+	account_transfer(&string_stats, tracee, max_size, false);
+
 #if defined(HAVE_PROCESS_VM)
 	/* [process_vm] system calls do not check the memory regions
 	 * in the remote process until just before doing the
@@ -320,10 +792,13 @@ int read_string(const Tracee *tracee, char *dest_tracer, word_t src_tracee, word
 	static size_t chunk_size = 0;
 	static uintptr_t chunk_mask;
 
-	/* A chunk shall not cross a page boundary.  */
+	/* A chunk shall not cross a page boundary, but it covers the
+	 * whole distance up to it: strings nearly never straddle
+	 * pages, so the first call usually gets everything and the
+	 * syscall round trip is what actually costs.  */
 	if (chunk_size == 0) {
-		chunk_size = sysconf(_SC_PAGESIZE);
-		chunk_size = (chunk_size > 0 && chunk_size < 1024 ? chunk_size : 1024);
+		long result = sysconf(_SC_PAGESIZE);
+		chunk_size = (result > 0 ? (size_t) result : 4096);
 		chunk_mask = ~(chunk_size - 1);
 	}
 
@@ -352,6 +827,7 @@ int read_string(const Tracee *tracee, char *dest_tracer, word_t src_tracee, word
 		if ((size_t) status < size) {
 			size = offset + status + 1;
 			assert(size <= max_size);
+			string_stats.nb_process_vm++;
 			return size;
 		}
 
@@ -359,34 +835,85 @@ int read_string(const Tracee *tracee, char *dest_tracer, word_t src_tracee, word
 	} while (offset < max_size);
 	assert(offset == max_size);
 
-	/* Fallback to ptrace if something went wrong.  */
+	/* Fallback to "/proc/<pid>/mem" then ptrace if something went
+	 * wrong.  */
 fallback:
 #endif /* HAVE_PROCESS_VM */
 
+	{
+		static size_t mem_chunk_size = 0;
+		int mem_fd = get_mem_fd(tracee);
+		ssize_t transferred;
+		size_t chunk;
+		size_t off;
+
+		if (mem_fd < 0)
+			goto last_resort;
+
+		/* Same page-bounded chunking as for process_vm_readv(2):
+		 * the string may end close to an unmapped page.  */
+		if (mem_chunk_size == 0) {
+			long result = sysconf(_SC_PAGESIZE);
+			mem_chunk_size = (result > 0 ? (size_t) result : 4096);
+		}
+
+		off = 0;
+		do {
+			chunk = mem_chunk_size - ((src_tracee + off) % mem_chunk_size);
+			chunk = (chunk < max_size - off ? chunk : max_size - off);
+
+			transferred = pread(mem_fd, (uint8_t *) dest_tracer + off,
+					chunk, (off_t) (src_tracee + off));
+			if ((size_t) transferred != chunk)
+				goto last_resort;
+
+			transferred = strnlen((char *) dest_tracer + off, chunk);
+			if ((size_t) transferred < chunk) {
+				string_stats.nb_mem_fd++;
+				return off + transferred + 1;
+			}
+
+			off += chunk;
+		} while (off < max_size);
+		/* No end-of-string found: same last resort as when
+		 * process_vm_readv(2) stops short.  */
+	}
+
+last_resort:
+	string_stats.nb_ptrace++;
+
 	nb_trailing_bytes = max_size % sizeof(word_t);
 	nb_full_words     = (max_size - nb_trailing_bytes) / sizeof(word_t);
 
 	/* Copy one word by one word, except for the last one. */
 	for (i = 0; i < nb_full_words; i++) {
 		word = ptrace(PTRACE_PEEKDATA, tracee->pid, src + i, NULL);
-		if (errno != 0)
+		if (errno != 0) {
+			string_stats.nb_failures++;
 			return -EFAULT;
+		}
 
 		store_word(&dest[i], word);
 
-		/* Stop once an end-of-string is detected. */
-		src_word = (uint8_t *)&word;
-		for (j = 0; j < sizeof(word_t); j++)
-			if (src_word[j] == '\0')
-				return i * sizeof(word_t) + j + 1;
+		/* Stop once an end-of-string is detected; each fetched
+		 * word is tested at once, bytes are only looked at in
+		 * the single word that holds the terminator.  */
+		if (has_nul_byte(word)) {
+			src_word = (uint8_t *)&word;
+			for (j = 0; j < sizeof(word_t); j++)
+				if (src_word[j] == '\0')
+					return i * sizeof(word_t) + j + 1;
+		}
 	}
 
 	/* Copy the bytes from the last word carefully since we have
 	 * to not overwrite the bytes lying beyond @dest_tracer. */
 
 	word = ptrace(PTRACE_PEEKDATA, tracee->pid, src + i, NULL);
-	if (errno != 0)
+	if (errno != 0) {
+		string_stats.nb_failures++;
 		return -EFAULT;
+	}
 
 	dest_word = (uint8_t *)&dest[i];
 	src_word  = (uint8_t *)&word;
@@ -407,6 +934,10 @@ fallback:
  */
 word_t peek_word(const Tracee *tracee, word_t address)
 {
+	/* Preserve ordering with respect to queued writes.  */
+	if (nb_queued_writes > 0)
+		(void) flush_queued_writes(write_queue_owner);
+
 	word_t result = 0;
 
 	if (belongs_to_heap_prealloc(tracee, address)) {
@@ -414,6 +945,8 @@ word_t peek_word(const Tracee *tracee, word_t address)
 		return 0;
 	}
 
+	account_transfer(&peek_stats, tracee, sizeof_word(tracee), false);
+
 #if defined(HAVE_PROCESS_VM)
 	int status;
 	struct iovec local;
@@ -427,10 +960,31 @@ word_t peek_word(const Tracee *tracee, word_t address)
 
 	errno = 0;
 	status = process_vm_readv(tracee->pid, &local, 1, &remote, 1, 0);
-	if (status > 0)
+	if (status > 0) {
+		peek_stats.nb_process_vm++;
 		return result;
-	/* Fallback to ptrace if something went wrong.  */
+	}
+	/* Fallback to "/proc/<pid>/mem" then ptrace if something went
+	 * wrong.  */
 #endif
+	{
+		int mem_fd = get_mem_fd(tracee);
+		if (mem_fd >= 0) {
+			ssize_t transferred;
+
+			errno = 0;
+			transferred = pread(mem_fd, &result, sizeof_word(tracee),
+					(off_t) address);
+			if ((size_t) transferred == sizeof_word(tracee)) {
+				peek_stats.nb_mem_fd++;
+				return result;
+			}
+			/* Fallback to ptrace if something went wrong.  */
+		}
+	}
+
+	peek_stats.nb_ptrace++;
+
 	errno = 0;
 	result = (word_t) ptrace(PTRACE_PEEKDATA, tracee->pid, address, NULL);
 
@@ -440,6 +994,9 @@ word_t peek_word(const Tracee *tracee, word_t address)
 	if (errno == EIO)
 		errno = EFAULT;
 
+	if (errno != 0)
+		peek_stats.nb_failures++;
+
 	/* Use only the 32 LSB when running a 32-bit process on a
 	 * 64-bit kernel. */
 	if (is_32on64_mode(tracee))
@@ -455,6 +1012,10 @@ word_t peek_word(const Tracee *tracee, word_t address)
  */
 void poke_word(const Tracee *tracee, word_t address, word_t value)
 {
+	/* Preserve ordering with respect to queued writes.  */
+	if (nb_queued_writes > 0)
+		(void) flush_queued_writes(write_queue_owner);
+
 	word_t tmp;
 
 	if (belongs_to_heap_prealloc(tracee, address)) {
@@ -462,6 +1023,10 @@ void poke_word(const Tracee *tracee, word_t address, word_t value)
 		return;
 	}
 
+	invalidate_read_ahead(tracee);
+
+	account_transfer(&poke_stats, tracee, sizeof_word(tracee), true);
+
 #if defined(HAVE_PROCESS_VM)
 	int status;
 	struct iovec local;
@@ -477,17 +1042,44 @@ void poke_word(const Tracee *tracee, word_t address, word_t value)
 
 	errno = 0;
 	status = process_vm_writev(tracee->pid, &local, 1, &remote, 1, 0);
-	if (status > 0)
+	if (status > 0) {
+		poke_stats.nb_process_vm++;
 		return;
-	/* Fallback to ptrace if something went wrong.  */
+	}
+	/* Fallback to "/proc/<pid>/mem" then ptrace if something went
+	 * wrong.  */
 #endif
+	{
+		int mem_fd = get_mem_fd(tracee);
+		if (mem_fd >= 0) {
+			ssize_t transferred;
+
+			/* Like process_vm_writev(2), only
+			 * sizeof_word(tracee) bytes are written: the
+			 * 32 MSB are preserved for a 32-bit process
+			 * on a 64-bit kernel.  */
+			errno = 0;
+			transferred = pwrite(mem_fd, &value, sizeof_word(tracee),
+					(off_t) address);
+			if ((size_t) transferred == sizeof_word(tracee)) {
+				poke_stats.nb_mem_fd++;
+				return;
+			}
+			/* Fallback to ptrace if something went wrong.  */
+		}
+	}
+
+	poke_stats.nb_ptrace++;
+
 	/* Don't overwrite the 32 MSB when running a 32-bit process on
 	 * a 64-bit kernel. */
 	if (is_32on64_mode(tracee)) {
 		errno = 0;
 		tmp = (word_t) ptrace(PTRACE_PEEKDATA, tracee->pid, address, NULL);
-		if (errno != 0)
+		if (errno != 0) {
+			poke_stats.nb_failures++;
 			return;
+		}
 
 		value |= (tmp & 0xFFFFFFFF00000000ULL);
 	}
@@ -501,6 +1093,9 @@ void poke_word(const Tracee *tracee, word_t address, word_t value)
 	if (errno == EIO)
 		errno = EFAULT;
 
+	if (errno != 0)
+		poke_stats.nb_failures++;
+
 	return;
 }
 
@@ -508,6 +1103,12 @@ void poke_word(const Tracee *tracee, word_t address, word_t value)
  * Allocate @size bytes in the @tracee's memory space.  This function
  * returns the address of the allocated memory in the @tracee's memory
  * space, otherwise 0 if an error occured.
+ *
+ * The reservation is made once per stop: successive calls for the
+ * same syscall -- as issued by the two-path syscalls like renameat(2)
+ * or linkat(2) -- sub-allocate within the scratch arena with mere
+ * pointer arithmetic, and the stack fallback only moves the *cached*
+ * stack pointer, which is pushed back to the tracee in one go.
  */
 word_t alloc_mem(Tracee *tracee, ssize_t size)
 {
@@ -520,6 +1121,25 @@ word_t alloc_mem(Tracee *tracee, ssize_t size)
 	 * process to retrieve argc, argv, envp, and auxv).  */
 	assert(IS_IN_SYSENTER(tracee));
 
+	/* Prefer the dedicated scratch arena once it is mapped: it
+	 * doesn't constrain the stack pointer, and several buffers
+	 * can be staged cheaply for the same syscall.  The arena is
+	 * reset at each syscall entry.  */
+	if (tracee->scratch.base != 0 && size > 0) {
+		size_t aligned = ((size_t) size + sizeof(word_t) - 1)
+					& ~(sizeof(word_t) - 1);
+
+		if (aligned <= tracee->scratch.size - tracee->scratch.offset) {
+			word_t result = tracee->scratch.base + tracee->scratch.offset;
+			tracee->scratch.offset += aligned;
+			return result;
+		}
+		/* Arena exhausted: fall back to the stack.  */
+	}
+
+	/* Have an arena mapped at the end of the current syscall.  */
+	tracee->scratch.wanted = true;
+
 	/* Get the current value of the stack pointer from the tracee's
 	 * USER area. */
 	stack_pointer = peek_reg(tracee, CURRENT, STACK_POINTER);
@@ -554,17 +1174,32 @@ word_t alloc_mem(Tracee *tracee, ssize_t size)
  */
 int clear_mem(const Tracee *tracee, word_t address, size_t size)
 {
+	/* A static zero page, repeated in the iovec array: no
+	 * allocation sized to the request anymore.  */
+	static const uint8_t zeros[4096];
+	struct iovec src[32];
 	int status;
-	void *zeros;
 
 	if (belongs_to_heap_prealloc(tracee, address))
 		return -EFAULT;
 
-	zeros = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (zeros == MAP_FAILED)
-		return -errno;
+	while (size > 0) {
+		size_t chunk;
+		size_t nb;
 
-	status = write_data(tracee, address, zeros, size);
-	munmap(zeros, size);
-	return status;
+		for (nb = 0, chunk = 0; nb < sizeof(src) / sizeof(src[0]) && chunk < size; nb++) {
+			src[nb].iov_base = (void *) zeros;
+			src[nb].iov_len  = MIN(sizeof(zeros), size - chunk);
+			chunk += src[nb].iov_len;
+		}
+
+		status = writev_data(tracee, address, src, nb);
+		if (status < 0)
+			return status;
+
+		address += chunk;
+		size -= chunk;
+	}
+
+	return 0;
 }
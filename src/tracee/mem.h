@@ -33,12 +33,17 @@
 #include "tracee/tracee.h"
 
 extern int write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer, word_t size);
+extern int queue_write_data(const Tracee *tracee, word_t dest_tracee, const void *src_tracer, word_t size);
+extern int flush_queued_writes(const Tracee *tracee);
 extern int writev_data(const Tracee *tracee, word_t dest_tracee, const struct iovec *src_tracer, int src_tracer_count);
 extern int read_data(const Tracee *tracee, void *dest_tracer, word_t src_tracee, word_t size);
+extern void invalidate_read_ahead(const Tracee *tracee);
 extern int read_string(const Tracee *tracee, char *dest_tracer, word_t src_tracee, word_t max_size);
 extern word_t peek_word(const Tracee *tracee, word_t address);
 extern void poke_word(const Tracee *tracee, word_t address, word_t value);
+extern void queue_poke_word(const Tracee *tracee, word_t address, word_t value);
 extern word_t alloc_mem(Tracee *tracee, ssize_t size);
+extern void print_mem_transfer_stats(void);
 extern int clear_mem(const Tracee *tracee, word_t address, size_t size);
 
 /**
@@ -37,10 +37,19 @@
 #include <linux/elf.h>  /* NT_PRSTATUS */
 #endif
 
+#if defined(PTRACE_GET_SYSCALL_INFO) && defined(ARCH_X86_64)
+#include <linux/audit.h> /* AUDIT_ARCH_*, */
+#ifndef __X32_SYSCALL_BIT
+#define __X32_SYSCALL_BIT 0x40000000
+#endif
+#endif
+
 #include "syscall/sysnum.h"
 #include "tracee/reg.h"
 #include "tracee/abi.h"
+#include "tracee/trace.h"
 #include "cli/note.h"
+#include "profile.h"
 #include "compat.h"
 
 /**
@@ -169,6 +178,18 @@
 
 #endif
 
+/* Offset in the USER area of the register @index, honouring the same
+ * ABI selection as REG().  */
+#if defined(ARCH_X86_64)
+    #define REG_OFFSET(tracee, index)					\
+	(tracee->_regs[CURRENT].cs == 0x23				\
+		? reg_offset_x86[index] : reg_offset[index])
+#else
+    #define REG_OFFSET(tracee, index) (reg_offset[index])
+#endif
+
+static void materialize_regs(Tracee *tracee);
+
 /**
  * Return the *cached* value of the given @tracees' @reg.
  */
@@ -178,6 +199,11 @@ word_t peek_reg(const Tracee *tracee, RegVersion version, Reg reg)
 
 	assert(version < NB_REG_VERSION);
 
+	/* A bank whose copy is still deferred reads as CURRENT.  */
+	if (   version != CURRENT
+	    && (tracee->_regs_synced & (UINT32_C(1) << version)) != 0)
+		version = CURRENT;
+
 	result = REG(tracee, version, reg);
 
 	/* Use only the 32 least significant bits (LSB) when running
@@ -193,11 +219,24 @@ word_t peek_reg(const Tracee *tracee, RegVersion version, Reg reg)
  */
 void poke_reg(Tracee *tracee, Reg reg, word_t value)
 {
+	/* A light register bank can not be modified: push_regs()
+	 * writes the full set back, so the full set has to be known.
+	 * Note fetch_regs() doesn't disturb anything here since no
+	 * register was changed so far (the first change goes through
+	 * this very function).  */
+	if (tracee->_regs_are_light)
+		(void) fetch_regs(tracee);
+
 	if (peek_reg(tracee, CURRENT, reg) == value)
 		return;
 
+	/* The CURRENT bank is about to diverge from the banks whose
+	 * save was deferred: copy them for real now.  */
+	materialize_regs(tracee);
+
 	REG(tracee, CURRENT, reg) = value;
 	tracee->_regs_were_changed = true;
+	tracee->_regs_dirty |= (UINT32_C(1) << reg);
 }
 
 /**
@@ -206,6 +245,19 @@ void poke_reg(Tracee *tracee, Reg reg, word_t value)
  */
 void print_current_regs(Tracee *tracee, int verbose_level, const char *message)
 {
+	/* A binary trace replaces the text output entirely: the
+	 * formatting below is what it is meant to avoid.  */
+	if (global_regs_trace_fd >= 0) {
+		RegsTraceEvent event =
+			strcmp(message, "sysenter start") == 0 ? REGS_TRACE_SYSENTER_START :
+			strcmp(message, "sysenter end")   == 0 ? REGS_TRACE_SYSENTER_END :
+			strcmp(message, "sysexit start")  == 0 ? REGS_TRACE_SYSEXIT_START :
+			strcmp(message, "sysexit end")    == 0 ? REGS_TRACE_SYSEXIT_END :
+			REGS_TRACE_OTHER;
+		record_regs_trace(tracee, event);
+		return;
+	}
+
 	if (tracee->verbose < verbose_level)
 		return;
 
@@ -221,18 +273,55 @@ void print_current_regs(Tracee *tracee, int verbose_level, const char *message)
 		get_abi(tracee));
 }
 
+/**
+ * Materialize the register banks whose copy was deferred by
+ * save_current_regs().  This must be called right before the CURRENT
+ * bank diverges from them, either through poke_reg() or through a
+ * re-fetch.
+ */
+static void materialize_regs(Tracee *tracee)
+{
+	RegVersion version;
+
+	if (tracee->_regs_synced == 0)
+		return;
+
+	for (version = ORIGINAL; version < NB_REG_VERSION; version++) {
+		if ((tracee->_regs_synced & (UINT32_C(1) << version)) == 0)
+			continue;
+
+		memcpy(&tracee->_regs[version], &tracee->_regs[CURRENT],
+			sizeof(tracee->_regs[CURRENT]));
+	}
+
+	tracee->_regs_synced = 0;
+}
+
 /**
  * Save the @tracee's current register bank into the @version register
- * bank.
+ * bank.  The actual copy is deferred until the banks diverge: most
+ * stops never modify a register, so most saves cost nothing.
  */
 void save_current_regs(Tracee *tracee, RegVersion version)
 {
+	assert(version != CURRENT && version < NB_REG_VERSION);
+
 	/* Optimization: don't restore original register values if
 	 * they were never changed.  */
-	if (version == ORIGINAL)
+	if (version == ORIGINAL) {
 		tracee->_regs_were_changed = false;
+		tracee->_regs_dirty = 0;
+	}
 
-	memcpy(&tracee->_regs[version], &tracee->_regs[CURRENT], sizeof(tracee->_regs[CURRENT]));
+#if defined(ARCH_X86_64)
+	/* get_abi() and the REG() accessors read the segment
+	 * registers straight from the saved bank, without going
+	 * through peek_reg(): keep them eagerly in sync.  */
+	tracee->_regs[version].cs = tracee->_regs[CURRENT].cs;
+	tracee->_regs[version].ds = tracee->_regs[CURRENT].ds;
+#endif
+
+	tracee->_regs_synced |= (UINT32_C(1) << version);
 }
 
 /**
@@ -240,10 +329,16 @@ void save_current_regs(Tracee *tracee, RegVersion version)
  * cache.  This function returns -errno if an error occured, 0
  * otherwise.
  */
-int fetch_regs(Tracee *tracee)
+static int fetch_regs2(Tracee *tracee)
 {
 	int status;
 
+	/* The fetch overwrites the CURRENT bank: deferred saves have
+	 * to be copied for real beforehand.  */
+	materialize_regs(tracee);
+
+	tracee->_regs_are_light = false;
+
 #if defined(ARCH_ARM64)
 	struct iovec regs;
 
@@ -260,68 +355,238 @@ int fetch_regs(Tracee *tracee)
 	return 0;
 }
 
+/**
+ * Sampled-profile shell of fetch_regs2(), see above.
+ */
+int fetch_regs(Tracee *tracee)
+{
+	uint64_t profile_start;
+	int status;
+
+	profile_start = profile_scope_enter(SCOPE_FETCH_REGS);
+	status = fetch_regs2(tracee);
+	profile_scope_exit(SCOPE_FETCH_REGS, profile_start);
+
+	return status;
+}
+
+/**
+ * Same as fetch_regs() except only the registers reported by
+ * PTRACE_GET_SYSCALL_INFO are copied into the CURRENT bank: syscall
+ * number, arguments, result, stack and instruction pointers -- that
+ * is, the registers syscall handlers actually read.  This single
+ * ptrace call moves much less data than a full PTRACE_GETREGS, and it
+ * is sufficient for stops where no register ends up modified; the
+ * full bank is re-fetched transparently by poke_reg() before the
+ * first modification.  This function falls back to fetch_regs() when
+ * PTRACE_GET_SYSCALL_INFO is not supported or the stop is not a
+ * syscall stop.  It returns -errno if an error occured, 0 otherwise.
+ */
+int fetch_light_regs(Tracee *tracee)
+{
+#if defined(PTRACE_GET_SYSCALL_INFO)
+	static int supported = -1;
+	struct __ptrace_syscall_info info;
+	long status;
+	size_t i;
+
+	/* The fetch overwrites the CURRENT bank: deferred saves have
+	 * to be copied for real beforehand.  */
+	materialize_regs(tracee);
+
+	if (supported == 0)
+		return fetch_regs(tracee);
+
+	status = ptrace(PTRACE_GET_SYSCALL_INFO, tracee->pid, sizeof(info), &info);
+	if (status <= 0) {
+		if (supported < 0)
+			supported = 0;
+		return fetch_regs(tracee);
+	}
+	supported = 1;
+
+	switch (info.op) {
+	case PTRACE_SYSCALL_INFO_ENTRY:
+	case PTRACE_SYSCALL_INFO_SECCOMP:
+#if defined(ARCH_X86_64)
+		/* The REG() accessors and get_abi() are driven by the
+		 * segment registers, which are not part of the
+		 * report: infer them from the reported architecture.
+		 * Set them *before* using REG() below.  */
+		if (info.arch == AUDIT_ARCH_I386)
+			tracee->_regs[CURRENT].cs = 0x23;
+		else {
+			tracee->_regs[CURRENT].cs = 0x33;
+			tracee->_regs[CURRENT].ds =
+				((info.entry.nr & __X32_SYSCALL_BIT) != 0 ? 0x2B : 0);
+		}
+#endif
+		REG(tracee, CURRENT, SYSARG_NUM) = info.entry.nr;
+		for (i = 0; i < 6; i++)
+			REG(tracee, CURRENT, SYSARG_1 + i) = info.entry.args[i];
+		break;
+
+	case PTRACE_SYSCALL_INFO_EXIT:
+		/* The arguments are not reported at exit stops.  The
+		 * values pushed at the end of the enter stage are
+		 * still cached in the CURRENT bank, and they are
+		 * exactly what the kernel preserved; same for the
+		 * segment registers, which only change during
+		 * execve(2) -- a stop that gets a full fetch (see
+		 * translate_syscall()).  */
+		REG(tracee, CURRENT, SYSARG_RESULT) = (word_t) info.exit.rval;
+		break;
+
+	default:
+		/* Not a syscall stop.  */
+		return fetch_regs(tracee);
+	}
+
+	REG(tracee, CURRENT, STACK_POINTER) = info.stack_pointer;
+	REG(tracee, CURRENT, INSTR_POINTER) = info.instruction_pointer;
+
+	tracee->_regs_are_light = true;
+	return 0;
+#else
+	return fetch_regs(tracee);
+#endif
+}
+
 /**
  * Copy the cached values of all @tracee's general purpose registers
  * back to the process, if necessary.  This function returns -errno if
  * an error occured, 0 otherwise.
  */
-int push_regs(Tracee *tracee)
+static int push_regs2(Tracee *tracee)
 {
+	uint32_t dirty;
 	int status;
-
-	if (tracee->_regs_were_changed) {
-		/* At the very end of a syscall, with regard to the
-		 * entry, only the result register can be modified by
-		 * PRoot.  */
-		if (tracee->restore_original_regs) {
-			/* Restore the sysarg register only if it is
-			 * not the same as the result register.  Note:
-			 * it's never the case on x86 architectures,
-			 * so don't make this check, otherwise it
-			 * would introduce useless complexity because
-			 * of the multiple ABI support.  */
+	Reg reg;
+
+	if (!tracee->_regs_were_changed)
+		return 0;
+
+	/* At the very end of a syscall, with regard to the entry,
+	 * only the result register can be modified by PRoot.  */
+	if (tracee->restore_original_regs) {
+		/* Restore the sysarg register only if it is not the
+		 * same as the result register.  Note: it's never the
+		 * case on x86 architectures, so don't make this
+		 * check, otherwise it would introduce useless
+		 * complexity because of the multiple ABI support.
+		 * Registers whose value never actually moved are not
+		 * marked dirty: a typical sysexit then only has to
+		 * write the result register back.  */
 #if defined(ARCH_X86) || defined(ARCH_X86_64)
-#    define		RESTORE(sysarg)	(REG(tracee, CURRENT, sysarg) = REG(tracee, ORIGINAL, sysarg))
+#    define	RESTORE(sysarg) do {					\
+			if (REG(tracee, CURRENT, sysarg) != REG(tracee, ORIGINAL, sysarg)) { \
+				REG(tracee, CURRENT, sysarg) = REG(tracee, ORIGINAL, sysarg); \
+				tracee->_regs_dirty |= (UINT32_C(1) << sysarg); \
+			}						\
+		} while (0)
 #else
-#    define	 	RESTORE(sysarg) (void) (reg_offset[SYSARG_RESULT] != reg_offset[sysarg] && \
-				(REG(tracee, CURRENT, sysarg) = REG(tracee, ORIGINAL, sysarg)))
+#    define	RESTORE(sysarg) do {					\
+			if (   reg_offset[SYSARG_RESULT] != reg_offset[sysarg] \
+			    && REG(tracee, CURRENT, sysarg) != REG(tracee, ORIGINAL, sysarg)) { \
+				REG(tracee, CURRENT, sysarg) = REG(tracee, ORIGINAL, sysarg); \
+				tracee->_regs_dirty |= (UINT32_C(1) << sysarg); \
+			}						\
+		} while (0)
 #endif
 
-			RESTORE(SYSARG_NUM);
-			RESTORE(SYSARG_1);
-			RESTORE(SYSARG_2);
-			RESTORE(SYSARG_3);
-			RESTORE(SYSARG_4);
-			RESTORE(SYSARG_5);
-			RESTORE(SYSARG_6);
-			RESTORE(STACK_POINTER);
-		}
+		RESTORE(SYSARG_NUM);
+		RESTORE(SYSARG_1);
+		RESTORE(SYSARG_2);
+		RESTORE(SYSARG_3);
+		RESTORE(SYSARG_4);
+		RESTORE(SYSARG_5);
+		RESTORE(SYSARG_6);
+		RESTORE(STACK_POINTER);
+	}
+
+	/* The kernel already holds the value of every register that
+	 * is not marked dirty: they were either never changed or
+	 * written back at a previous stage of this stop.  */
+	dirty = tracee->_regs_dirty;
+	tracee->_regs_dirty = 0;
+
+	if (dirty == 0)
+		return 0;
 
 #if defined(ARCH_ARM64)
-		struct iovec regs;
+	struct iovec regs;
+
+	/* A leading subset of NT_PRSTATUS can be written alone:
+	 * shrink the transfer down to the highest dirty register.  */
+	regs.iov_base = &tracee->_regs[CURRENT];
+	regs.iov_len  = 0;
 
-		regs.iov_base = &tracee->_regs[CURRENT];
-		regs.iov_len  = sizeof(tracee->_regs[CURRENT]);
+	for (reg = 0; reg <= USERARG_1; reg++)
+		if (   (dirty & (UINT32_C(1) << reg)) != 0
+		    && (size_t) reg_offset[reg] + sizeof(word_t) > regs.iov_len)
+			regs.iov_len = reg_offset[reg] + sizeof(word_t);
 
-		status = ptrace(PTRACE_SETREGSET, tracee->pid, NT_PRSTATUS, &regs);
+	status = ptrace(PTRACE_SETREGSET, tracee->pid, NT_PRSTATUS, &regs);
+	if (status < 0)
+		return status;
 #else
+	size_t nb_dirty;
+
 #    if defined(ARCH_ARM_EABI)
-		/* On ARM, a special ptrace request is required to
-		 * change effectively the syscall number during a
-		 * ptrace-stop.  */
-		word_t current_sysnum = REG(tracee, CURRENT, SYSARG_NUM);
-		if (current_sysnum != REG(tracee, ORIGINAL, SYSARG_NUM)) {
-			status = ptrace(PTRACE_SET_SYSCALL, tracee->pid, 0, current_sysnum);
+	/* On ARM, a special ptrace request is required to change
+	 * effectively the syscall number during a ptrace-stop.  */
+	word_t current_sysnum = REG(tracee, CURRENT, SYSARG_NUM);
+	if (current_sysnum != REG(tracee, ORIGINAL, SYSARG_NUM)) {
+		status = ptrace(PTRACE_SET_SYSCALL, tracee->pid, 0, current_sysnum);
+		if (status < 0)
+			note(tracee, WARNING, SYSTEM, "can't set the syscall number");
+	}
+#    endif
+
+	for (reg = 0, nb_dirty = 0; reg <= USERARG_1; reg++)
+		if ((dirty & (UINT32_C(1) << reg)) != 0)
+			nb_dirty++;
+
+	/* For a few registers, a couple of PTRACE_POKEUSER writes
+	 * move much less data than a full PTRACE_SETREGS; the typical
+	 * sysexit -- only SYSARG_RESULT changed -- boils down to one.
+	 * Note that a length-trimmed PTRACE_SETREGSET is not an option
+	 * here: unlike the user area, the NT_PRSTATUS regset exposes
+	 * the 32-bit layout for 32-bit tracees.  */
+	if (nb_dirty <= 3) {
+		for (reg = 0; reg <= USERARG_1; reg++) {
+			if ((dirty & (UINT32_C(1) << reg)) == 0)
+				continue;
+
+			status = ptrace(PTRACE_POKEUSER, tracee->pid,
+					REG_OFFSET(tracee, reg),
+					REG(tracee, CURRENT, reg));
 			if (status < 0)
-				note(tracee, WARNING, SYSTEM, "can't set the syscall number");
+				goto full_write; /* Not supported?  */
 		}
-#    endif
+		return 0;
+	}
 
-		status = ptrace(PTRACE_SETREGS, tracee->pid, NULL, &tracee->_regs[CURRENT]);
+full_write:
+	status = ptrace(PTRACE_SETREGS, tracee->pid, NULL, &tracee->_regs[CURRENT]);
+	if (status < 0)
+		return status;
 #endif
-		if (status < 0)
-			return status;
-	}
 
 	return 0;
 }
+
+/**
+ * Sampled-profile shell of push_regs2(), see above.
+ */
+int push_regs(Tracee *tracee)
+{
+	uint64_t profile_start;
+	int status;
+
+	profile_start = profile_scope_enter(SCOPE_PUSH_REGS);
+	status = push_regs2(tracee);
+	profile_scope_exit(SCOPE_PUSH_REGS, profile_start);
+
+	return status;
+}
@@ -0,0 +1,95 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+/* Off-line pretty-printer for binary traces recorded with
+ * "-v binary:<file>", see tracee/trace.h for the layout.  The output
+ * mimics print_current_regs().  Build it with "make trace-reader".  */
+
+#include <stdio.h>      /* printf(3), fopen(3), fread(3), */
+#include <string.h>     /* memcmp(3), */
+#include <inttypes.h>   /* PRI*, */
+
+#include "tracee/trace.h"
+
+#define SYSNUM(item) #item,
+static const char *sysnum_names[] = {
+	"void",
+	#include "syscall/sysnums.list"
+};
+#undef SYSNUM
+
+static const char *event_names[] = {
+	[REGS_TRACE_OTHER]          = "other",
+	[REGS_TRACE_SYSENTER_START] = "sysenter start",
+	[REGS_TRACE_SYSENTER_END]   = "sysenter end",
+	[REGS_TRACE_SYSEXIT_START]  = "sysexit start",
+	[REGS_TRACE_SYSEXIT_END]    = "sysexit end",
+};
+
+int main(int argc, char *argv[])
+{
+	RegsTraceHeader header;
+	RegsTraceRecord record;
+	FILE *file;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <binary trace>\n", argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[1], "rb");
+	if (file == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1
+	    || memcmp(header.magic, REGS_TRACE_MAGIC, sizeof(header.magic)) != 0
+	    || header.version != REGS_TRACE_VERSION) {
+		fprintf(stderr, "%s: not a PRoot binary trace\n", argv[1]);
+		fclose(file);
+		return 1;
+	}
+
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		const char *sysnum_name = "";
+		const char *event_name = "?";
+
+		if (record.sysnum < sizeof(sysnum_names) / sizeof(sysnum_names[0]))
+			sysnum_name = sysnum_names[record.sysnum];
+
+		if (record.event < sizeof(event_names) / sizeof(event_names[0]))
+			event_name = event_names[record.event];
+
+		printf("pid %" PRIu32 ": %s: %s(0x%" PRIx64 ", 0x%" PRIx64
+			", 0x%" PRIx64 ", 0x%" PRIx64 ", 0x%" PRIx64
+			", 0x%" PRIx64 ") = 0x%" PRIx64 " [0x%" PRIx64
+			", %" PRIu16 "]\n",
+			record.pid, event_name, sysnum_name,
+			record.args[0], record.args[1], record.args[2],
+			record.args[3], record.args[4], record.args[5],
+			record.result, record.stack_pointer, record.abi);
+	}
+
+	fclose(file);
+	return 0;
+}
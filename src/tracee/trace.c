@@ -0,0 +1,111 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#include <sys/types.h>  /* open(2), */
+#include <sys/stat.h>   /* open(2), */
+#include <fcntl.h>      /* open(2), */
+#include <unistd.h>     /* write(2), close(2), */
+#include <string.h>     /* memcpy(3), */
+#include <strings.h>    /* bzero(3), */
+#include <stdlib.h>     /* atexit(3), */
+#include <errno.h>      /* errno, */
+
+#include "tracee/trace.h"
+#include "tracee/reg.h"
+#include "tracee/abi.h"
+#include "syscall/sysnum.h"
+
+int global_regs_trace_fd = -1;
+
+/* Records are batched so a traced stop costs a structure fill, not a
+ * write(2).  */
+#define REGS_TRACE_BUFFER_NB_RECORDS 512
+static RegsTraceRecord trace_buffer[REGS_TRACE_BUFFER_NB_RECORDS];
+static size_t nb_buffered_records;
+
+/**
+ * Write the buffered records to the trace file.
+ */
+static void flush_regs_trace(void)
+{
+	if (nb_buffered_records == 0)
+		return;
+
+	(void) write(global_regs_trace_fd, trace_buffer,
+		nb_buffered_records * sizeof(RegsTraceRecord));
+	nb_buffered_records = 0;
+}
+
+/**
+ * Open the binary trace file @path, truncating it if it already
+ * exists.  This function returns -errno if an error occurred,
+ * otherwise 0.
+ */
+int open_regs_trace(const char *path)
+{
+	RegsTraceHeader header;
+	int fd;
+
+	fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP);
+	if (fd < 0)
+		return -errno;
+
+	bzero(&header, sizeof(header));
+	memcpy(header.magic, REGS_TRACE_MAGIC, sizeof(header.magic));
+	header.version = REGS_TRACE_VERSION;
+
+	if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+		(void) close(fd);
+		return -errno;
+	}
+
+	global_regs_trace_fd = fd;
+	atexit(flush_regs_trace);
+
+	return 0;
+}
+
+/**
+ * Append a snapshot of the current @tracee's registers, tagged with
+ * @event, to the binary trace.
+ */
+void record_regs_trace(Tracee *tracee, RegsTraceEvent event)
+{
+	RegsTraceRecord *record;
+	int i;
+
+	record = &trace_buffer[nb_buffered_records++];
+
+	record->pid    = tracee->pid;
+	record->event  = event;
+	record->abi    = get_abi(tracee);
+	record->sysnum = get_sysnum(tracee, CURRENT);
+
+	for (i = 0; i < 6; i++)
+		record->args[i] = peek_reg(tracee, CURRENT, SYSARG_1 + i);
+
+	record->result        = peek_reg(tracee, CURRENT, SYSARG_RESULT);
+	record->stack_pointer = peek_reg(tracee, CURRENT, STACK_POINTER);
+
+	if (nb_buffered_records == REGS_TRACE_BUFFER_NB_RECORDS)
+		flush_regs_trace();
+}
@@ -0,0 +1,69 @@
+/* -*- c-set-style: "K&R"; c-basic-offset: 8 -*-
+ *
+ * This file is part of PRoot.
+ *
+ * Copyright (C) 2014 STMicroelectronics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ */
+
+#ifndef REGS_TRACE_H
+#define REGS_TRACE_H
+
+#include <stdint.h>
+
+#include "tracee/tracee.h"
+
+/* Layout of a binary trace ("-v binary:<file>"): a RegsTraceHeader
+ * followed by fixed-size RegsTraceRecords, filled straight from the
+ * register structures; text formatting is left to the off-line
+ * trace-reader tool.  */
+
+#define REGS_TRACE_MAGIC "PRoot-trace"
+#define REGS_TRACE_VERSION 1
+
+typedef struct {
+	char magic[12];
+	uint32_t version;
+} RegsTraceHeader;
+
+typedef enum {
+	REGS_TRACE_OTHER          = 0,
+	REGS_TRACE_SYSENTER_START = 1,
+	REGS_TRACE_SYSENTER_END   = 2,
+	REGS_TRACE_SYSEXIT_START  = 3,
+	REGS_TRACE_SYSEXIT_END    = 4,
+} RegsTraceEvent;
+
+/* Note: @sysnum is PRoot's ABI-neutral Sysnum, ie. one plus the
+ * index into "syscall/sysnums.list" (0 is PR_void).  */
+typedef struct {
+	uint32_t pid;
+	uint16_t event;
+	uint16_t abi;
+	uint64_t sysnum;
+	uint64_t args[6];
+	uint64_t result;
+	uint64_t stack_pointer;
+} RegsTraceRecord;
+
+extern int open_regs_trace(const char *path);
+extern void record_regs_trace(Tracee *tracee, RegsTraceEvent event);
+
+/* -1 when no binary trace was requested.  */
+extern int global_regs_trace_fd;
+
+#endif /* REGS_TRACE_H */
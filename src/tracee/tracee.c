@@ -28,8 +28,11 @@
 #include <stdbool.h>    /* bool, true, false, */
 #include <sys/queue.h>  /* LIST_*,  */
 #include <talloc.h>     /* talloc_*, */
-#include <signal.h>     /* kill(2), SIGKILL, */
+#include <signal.h>     /* kill(2), SIGKILL, siginfo_t, */
 #include <sys/ptrace.h> /* ptrace(2), PTRACE_*, */
+#include <sys/wait.h>   /* waitid(2), P_PIDFD, */
+#include <sys/syscall.h>/* SYS_pidfd_*, */
+#include <unistd.h>     /* syscall(2), close(2), */
 #include <errno.h>      /* E*, */
 
 #include "tracee/tracee.h"
@@ -47,6 +50,42 @@
 typedef LIST_HEAD(tracees, tracee) Tracees;
 static Tracees tracees;
 
+/* Hash table for the pid → tracee lookup made by get_tracee() on
+ * every single event: with thousands of live tracees the walk of
+ * @tracees above costs more than the event handling itself.  Each
+ * bucket is a list chained through @pid_link; @tracees keeps being
+ * the list to iterate over all tracees.  */
+#define NB_PID_BUCKETS 1024
+static Tracees pid_buckets[NB_PID_BUCKETS];
+
+/* Tracees marked as terminated but not freed yet, chained through
+ * @terminated_link: free_terminated_tracees() only touches dead
+ * entries instead of sweeping the whole @tracees list.  */
+static Tracees terminated_tracees;
+
+static Tracees *get_pid_bucket(pid_t pid)
+{
+	return &pid_buckets[(unsigned int) pid % NB_PID_BUCKETS];
+}
+
+/**
+ * Open a pidfd for @tracee, releasing the previous one if any.  A
+ * failure (kernel too old) is not an error: users simply fall back
+ * to plain pids.
+ */
+static void open_tracee_pidfd(Tracee *tracee)
+{
+	if (tracee->pidfd >= 0)
+		close(tracee->pidfd);
+
+	tracee->pidfd = (int) syscall(SYS_pidfd_open, tracee->pid, 0);
+}
+
+/* Size of the arena that backs a tracee's memory collector; large
+ * enough for the temporaries of a typical intercepted syscall (a
+ * handful of PATH_MAX buffers).  */
+#define MEMORY_COLLECTOR_POOL_SIZE (64 * 1024)
+
 
 /**
  * Remove @zombie from its parent's list of zombies.  Note: this is a
@@ -55,9 +94,24 @@ static Tracees tracees;
 static int remove_zombie(Tracee *zombie)
 {
 	LIST_REMOVE(zombie, link);
+
+	if (zombie->parent != NULL)
+		LIST_REMOVE(zombie, child_link);
+
 	return 0;
 }
 
+/**
+ * Declare @parent as the parent of @child, and chain the latter into
+ * the former's list of children.
+ */
+static void set_parent(Tracee *child, Tracee *parent)
+{
+	child->parent = parent;
+	if (parent != NULL)
+		LIST_INSERT_HEAD(&parent->children, child, child_link);
+}
+
 /**
  * Perform some specific treatments against @pointer according to its
  * type, before it gets unlinked from @tracee_->life_context.
@@ -85,38 +139,68 @@ static int remove_tracee(Tracee *tracee)
 {
 	Tracee *relative;
 	Tracee *ptracer;
+	Tracee *next;
 	int event;
 
 	LIST_REMOVE(tracee, link);
+	LIST_REMOVE(tracee, pid_link);
+
+	if (tracee->parent != NULL)
+		LIST_REMOVE(tracee, child_link);
+
+	if (tracee->terminated)
+		LIST_REMOVE(tracee, terminated_link);
+
+	if (tracee->fs_is_cow)
+		LIST_REMOVE(tracee, fs_cow_link);
+
+	if (tracee->mem_fd >= 0) {
+		close(tracee->mem_fd);
+		tracee->mem_fd = -1;
+	}
+
+	if (tracee->pidfd >= 0) {
+		close(tracee->pidfd);
+		tracee->pidfd = -1;
+	}
 
 	/* Clean objects that are linked to this tracee's life
 	 * span.  */
 	talloc_report_depth_cb(tracee->life_context, 0, 100, clean_life_span_object, tracee);
 
-	/* This could be optimize by using a dedicated list of
-	 * children and ptracees.  */
-	LIST_FOREACH(relative, &tracees, link) {
-		/* Its children are now orphan.  */
-		if (relative->parent == tracee)
-			relative->parent = NULL;
-
-		/* Its tracees are now free.  */
-		if (relative->as_ptracee.ptracer == tracee) {
-			/* Release the pending event, if any.  */
-			relative->as_ptracee.ptracer = NULL;
-
-			if (relative->as_ptracee.event4.proot.pending) {
-				event = handle_tracee_event(relative,
-							relative->as_ptracee.event4.proot.value);
-				(void) restart_tracee(relative, event);
-			}
-			else if (relative->as_ptracee.event4.ptracer.pending) {
-				event = relative->as_ptracee.event4.proot.value;
-				(void) restart_tracee(relative, event);
-			}
-
-			bzero(&relative->as_ptracee, sizeof(relative->as_ptracee));
+	/* Its children are now orphan.  Under the subreaper mode set
+	 * by launch_process() the kernel re-parents their processes
+	 * to PRoot itself, so nothing has to be replayed here: only
+	 * the stale back-pointers are cleared, one dedicated list
+	 * instead of a scan of all tracees.  */
+	while ((relative = LIST_FIRST(&tracee->children)) != NULL) {
+		LIST_REMOVE(relative, child_link);
+		relative->parent = NULL;
+	}
+
+	/* Its ptracees are now free.  Zombies are skipped: they are
+	 * talloc children of this ptracer, thus freed with it.  */
+	for (relative = LIST_FIRST(&tracee->as_ptracer.ptracees); relative != NULL;
+	     relative = next) {
+		next = LIST_NEXT(relative, as_ptracee.sibling);
+
+		if (relative->as_ptracee.is_zombie)
+			continue;
+
+		/* Release the pending event, if any.  */
+		relative->as_ptracee.ptracer = NULL;
+
+		if (relative->as_ptracee.event4.proot.pending) {
+			event = handle_tracee_event(relative,
+						relative->as_ptracee.event4.proot.value);
+			(void) restart_tracee(relative, event);
+		}
+		else if (relative->as_ptracee.event4.ptracer.pending) {
+			event = relative->as_ptracee.event4.proot.value;
+			(void) restart_tracee(relative, event);
 		}
+
+		bzero(&relative->as_ptracee, sizeof(relative->as_ptracee));
 	}
 
 	/* Nothing else to do if it's not a ptracee.  */
@@ -136,7 +220,7 @@ static int remove_tracee(Tracee *tracee)
 			LIST_INSERT_HEAD(&PTRACER.zombies, zombie, link);
 			talloc_set_destructor(zombie, remove_zombie);
 
-			zombie->parent = tracee->parent;
+			set_parent(zombie, tracee->parent);
 			zombie->clone = tracee->clone;
 			zombie->pid = tracee->pid;
 
@@ -180,12 +264,24 @@ Tracee *new_dummy_tracee(TALLOC_CTX *context)
 {
 	Tracee *tracee;
 
+	/* A Tracee is a whole talloc hierarchy -- collector pool,
+	 * name-space, heap, destructors -- so its shell can't be
+	 * recycled through a freelist without breaking the ownership
+	 * model.  Allocator pressure under fork storms is handled one
+	 * level down instead: the hot per-stop allocations come from
+	 * the pooled collector below, and malloc(3) itself recycles
+	 * these same-sized hierarchies from its bins.  */
 	tracee = talloc_zero(context, Tracee);
 	if (tracee == NULL)
 		return NULL;
 
-	/* Allocate a memory collector.  */
-	tracee->ctx = talloc_new(tracee);
+	/* Allocate a memory collector.  It is backed by a talloc pool:
+	 * the per-syscall temporaries sub-allocated from it boil down
+	 * to pointer arithmetic in a recycled arena, and flushing it
+	 * between two stops doesn't return the arena to the system.
+	 * Allocations that don't fit transparently fall back to the
+	 * regular heap.  */
+	tracee->ctx = talloc_pool(tracee, MEMORY_COLLECTOR_POOL_SIZE);
 	if (tracee->ctx == NULL)
 		goto no_mem;
 
@@ -196,6 +292,12 @@ Tracee *new_dummy_tracee(TALLOC_CTX *context)
 	if (tracee->fs == NULL || tracee->heap == NULL)
 		goto no_mem;
 
+	/* "/proc/<pid>/mem" is opened on demand only.  */
+	tracee->mem_fd = -1;
+
+	/* No process to point to yet.  */
+	tracee->pidfd = -1;
+
 	return tracee;
 
 no_mem:
@@ -221,6 +323,9 @@ static Tracee *new_tracee(pid_t pid)
 
 	tracee->pid = pid;
 	LIST_INSERT_HEAD(&tracees, tracee, link);
+	LIST_INSERT_HEAD(get_pid_bucket(pid), tracee, pid_link);
+
+	open_tracee_pidfd(tracee);
 
 	tracee->life_context = talloc_new(tracee);
 
@@ -252,13 +357,41 @@ static Tracee *get_ptracee(const Tracee *ptracer, pid_t pid, bool only_stopped,
 		return ptracee;
 	}
 
-	LIST_FOREACH(ptracee, &tracees, link) {
+	/* A specific pid resolves through the hash table.  */
+	if (pid != -1) {
+		LIST_FOREACH(ptracee, get_pid_bucket(pid), pid_link) {
+			if (ptracee->pid == pid)
+				break;
+		}
+
 		/* Discard tracees that don't have this ptracer.  */
-		if (PTRACEE.ptracer != ptracer)
-			continue;
+		if (ptracee == NULL || PTRACEE.ptracer != ptracer)
+			return NULL;
 
-		/* Not the ptracee you're looking for?  */
-		if (pid != ptracee->pid && pid != -1)
+		/* Not the expected kind of cloned process?  */
+		if (!EXPECTED_WAIT_CLONE(wait_options, ptracee))
+			return NULL;
+
+		/* No need to do more checks if its stopped state
+		 * doesn't matter.  Be careful when using such
+		 * maybe-running tracee.  */
+		if (!only_stopped)
+			return ptracee;
+
+		/* Is this tracee in the stopped state, with a
+		 * pending event for its ptracer?  */
+		if (!ptracee->running
+		    && (PTRACEE.event4.ptracer.pending || !only_with_pevent))
+			return ptracee;
+
+		return NULL;
+	}
+
+	/* Otherwise, only this ptracer's own ptracees are walked,
+	 * not the global list of tracees.  */
+	LIST_FOREACH(ptracee, &PTRACER.ptracees, as_ptracee.sibling) {
+		/* Zombies were already considered above.  */
+		if (PTRACEE.is_zombie)
 			continue;
 
 		/* Not the expected kind of cloned process?  */
@@ -278,11 +411,6 @@ static Tracee *get_ptracee(const Tracee *ptracer, pid_t pid, bool only_stopped,
 		/* Has a pending event for its ptracer?  */
 		if (PTRACEE.event4.ptracer.pending || !only_with_pevent)
 			return ptracee;
-
-		/* No need to go further if the specific tracee isn't
-		 * in the expected state?  */
-		if (pid == ptracee->pid)
-			return NULL;
 	}
 
 	return NULL;
@@ -322,11 +450,13 @@ Tracee *get_tracee(const Tracee *current_tracee, pid_t pid, bool create)
 	if (current_tracee != NULL && current_tracee->pid == pid)
 		return (Tracee *)current_tracee;
 
-	LIST_FOREACH(tracee, &tracees, link) {
+	LIST_FOREACH(tracee, get_pid_bucket(pid), pid_link) {
 		if (tracee->pid == pid) {
-			/* Flush then allocate a new memory collector.  */
-			TALLOC_FREE(tracee->ctx);
-			tracee->ctx = talloc_new(tracee);
+			/* Flush the memory collector.  This resets
+			 * the underlying pool for reuse instead of
+			 * tearing the whole context down and
+			 * allocating it again.  */
+			talloc_free_children(tracee->ctx);
 
 			return tracee;
 		}
@@ -335,22 +465,127 @@ Tracee *get_tracee(const Tracee *current_tracee, pid_t pid, bool create)
 	return (create ? new_tracee(pid) : NULL);
 }
 
+/**
+ * Change the pid of @tracee to @pid, and move it to its new hash
+ * bucket accordingly.  This must be used instead of a plain
+ * assignment for any tracee returned by get_tracee().
+ */
+void set_tracee_pid(Tracee *tracee, pid_t pid)
+{
+	LIST_REMOVE(tracee, pid_link);
+	tracee->pid = pid;
+	LIST_INSERT_HEAD(get_pid_bucket(pid), tracee, pid_link);
+
+	open_tracee_pidfd(tracee);
+}
+
+/**
+ * Mark @tracee as terminated, i.e. ready to be freed by the next
+ * call to free_terminated_tracees().
+ */
+void terminate_tracee(Tracee *tracee)
+{
+	if (tracee->terminated)
+		return;
+
+	tracee->terminated = true;
+	LIST_INSERT_HEAD(&terminated_tracees, tracee, terminated_link);
+}
+
+/**
+ * Interrupt every tracee that runs free in spin-skip mode (see
+ * enter_spin_skip()): the SIGSTOP stop puts it back into the common
+ * PTRACE_SYSCALL flow, where the signal itself is discarded.
+ */
+void resync_spinning_tracees(void)
+{
+	Tracee *tracee;
+
+	LIST_FOREACH(tracee, &tracees, link) {
+		if (tracee->spin_skip && tracee->running)
+			(void) kill(tracee->pid, SIGSTOP);
+	}
+}
+
 /**
  * Free all tracees marked as terminated.
  */
 void free_terminated_tracees()
 {
-	Tracee *next;
+	Tracee *tracee;
+
+	/* The destructor unchains the tracee from this list.  */
+	while ((tracee = terminated_tracees.lh_first) != NULL)
+		TALLOC_FREE(tracee);
+}
+
+/**
+ * Give @tracee its own copy of the file-system name-space it
+ * currently borrows copy-on-write.  This function returns -errno if
+ * an error occurred, otherwise 0.
+ */
+static int unshare_fs(Tracee *tracee)
+{
+	FileSystemNameSpace *fs;
+
+	assert(tracee->fs_is_cow);
+
+	fs = talloc_zero(tracee, FileSystemNameSpace);
+	if (fs == NULL)
+		return -ENOMEM;
+
+	fs->cwd = talloc_strdup(fs, tracee->fs->cwd);
+	if (fs->cwd == NULL) {
+		TALLOC_FREE(fs);
+		return -ENOMEM;
+	}
+	talloc_set_name_const(fs->cwd, "$cwd");
+
+	if (tracee->fs->host_cwd != NULL) {
+		fs->host_cwd = talloc_strdup(fs, tracee->fs->host_cwd);
+		if (fs->host_cwd == NULL) {
+			TALLOC_FREE(fs);
+			return -ENOMEM;
+		}
+	}
+
+	/* Bindings are shared across file-system name-spaces, see
+	 * new_child().  */
+	fs->bindings.guest = talloc_reference(fs, tracee->fs->bindings.guest);
+	fs->bindings.host  = talloc_reference(fs, tracee->fs->bindings.host);
 
-	/* Items can't be deleted when using LIST_FOREACH.  */
-	next = tracees.lh_first;
-	while (next != NULL) {
-		Tracee *tracee = next;
-		next = tracee->link.le_next;
+	LIST_REMOVE(tracee, fs_cow_link);
+	talloc_unlink(tracee, tracee->fs);
 
-		if (tracee->terminated)
-			TALLOC_FREE(tracee);
+	tracee->fs = fs;
+	tracee->fs_is_cow = false;
+
+	return 0;
+}
+
+/**
+ * Ensure @tracee's file-system name-space is not involved in any
+ * copy-on-write sharing anymore: @tracee gets its own copy if it is
+ * a borrower, and every borrower of @tracee's name-space gets its
+ * own copy otherwise.  This must be called before any modification
+ * of that name-space.  This function returns -errno if an error
+ * occurred, otherwise 0.
+ */
+int break_fs_cow(Tracee *tracee)
+{
+	Tracee *sharer;
+	int status;
+
+	if (tracee->fs_is_cow)
+		return unshare_fs(tracee);
+
+	while ((sharer = tracee->fs->cow_sharers.lh_first) != NULL) {
+		status = unshare_fs(sharer);
+		if (status < 0)
+			return status;
 	}
+
+	return 0;
 }
 
 /**
@@ -439,9 +674,9 @@ int new_child(Tracee *parent, word_t clone_flags)
 	 * -- clone(2) man-page
 	 */
 	if ((clone_flags & CLONE_PARENT) != 0)
-		child->parent = parent->parent;
+		set_parent(child, parent->parent);
 	else
-		child->parent = parent;
+		set_parent(child, parent);
 
 	/* Remember if this child belongs to the same thread group as
 	 * its parent.  This is currently useful for ptrace emulation
@@ -490,26 +725,27 @@ int new_child(Tracee *parent, word_t clone_flags)
 	 */
 	TALLOC_FREE(child->fs);
 	if ((clone_flags & CLONE_FS) != 0) {
+		/* A borrowed name-space can't back a semantic share:
+		 * materialize the parent's own copy first.  */
+		if (parent->fs_is_cow) {
+			status = break_fs_cow(parent);
+			if (status < 0)
+				return status;
+		}
+
 		/* File-system name-space is shared.  */
 		child->fs = talloc_reference(child, parent->fs);
 	}
 	else {
-		/* File-system name-space is copied.  */
-		child->fs = talloc_zero(child, FileSystemNameSpace);
-		if (child->fs == NULL)
-			return -ENOMEM;
-
-		child->fs->cwd = talloc_strdup(child->fs, parent->fs->cwd);
-		if (child->fs->cwd == NULL)
-			return -ENOMEM;
-		talloc_set_name_const(child->fs->cwd, "$cwd");
-
-		/* Bindings are shared across file-system name-spaces since a
-		 * "mount --bind" made by a process affects all other processes
-		 * under Linux.  Actually they are copied when a sub
-		 * reconfiguration occured (nested proot or chroot(2)).  */
-		child->fs->bindings.guest = talloc_reference(child->fs, parent->fs->bindings.guest);
-		child->fs->bindings.host  = talloc_reference(child->fs, parent->fs->bindings.host);
+		/* File-system name-space is conceptually copied --
+		 * bindings are shared across name-spaces anyway,
+		 * since a "mount --bind" made by a process affects
+		 * all other processes under Linux -- but the actual
+		 * copy of the rest (cwd) is deferred until one side
+		 * modifies it: forks cost a reference bump only.  */
+		child->fs = talloc_reference(child, parent->fs);
+		child->fs_is_cow = true;
+		LIST_INSERT_HEAD(&parent->fs->cow_sharers, child, fs_cow_link);
 	}
 
 	/* The path to the executable is unshared only once the child
@@ -581,6 +817,16 @@ static void reparent_config(Tracee *new_parent, Tracee *old_parent)
 int swap_config(Tracee *tracee1, Tracee *tracee2)
 {
 	Tracee *tmp;
+	int status;
+
+	/* Name-spaces about to move between tracees can't stay in a
+	 * copy-on-write sharing.  */
+	status = break_fs_cow(tracee1);
+	if (status < 0)
+		return status;
+	status = break_fs_cow(tracee2);
+	if (status < 0)
+		return status;
 
 	tmp = talloc_zero(tracee1->ctx, Tracee);
 	if (tmp == NULL)
@@ -593,11 +839,30 @@ int swap_config(Tracee *tracee1, Tracee *tracee2)
 	return 0;
 }
 
-/* Send the KILL signal to all tracees.  */
+/* Send the KILL signal to all tracees, then reap them.  */
 void kill_all_tracees()
 {
 	Tracee *tracee;
 
-	LIST_FOREACH(tracee, &tracees, link)
+	/* First pass: signal everybody -- through the pidfd when one
+	 * is available, which is immune to pid reuse -- so the whole
+	 * tree dies in parallel.  */
+	LIST_FOREACH(tracee, &tracees, link) {
+		if (tracee->pidfd >= 0
+		    && syscall(SYS_pidfd_send_signal, tracee->pidfd,
+				SIGKILL, NULL, 0) == 0)
+			continue;
+
 		kill(tracee->pid, SIGKILL);
+	}
+
+	/* Second pass: reap them, so tearing a large build tree down
+	 * doesn't leave a zombie storm behind.  Tracees already
+	 * reaped by the event loop simply fail with ECHILD.  */
+	LIST_FOREACH(tracee, &tracees, link) {
+		siginfo_t info;
+
+		if (tracee->pidfd >= 0)
+			(void) waitid(P_PIDFD, tracee->pidfd, &info, WEXITED);
+	}
 }
@@ -25,6 +25,7 @@
 
 #include <sys/types.h> /* pid_t, size_t, */
 #include <sys/user.h>  /* struct user*, */
+#include <stdint.h>    /* uint64_t, */
 #include <stdbool.h>   /* bool,  */
 #include <sys/queue.h> /* LIST_*, */
 #include <sys/ptrace.h>/* enum __ptrace_request */
@@ -43,7 +44,10 @@ typedef enum {
 struct bindings;
 struct load_info;
 struct extensions;
+struct deferred_extensions;
+struct enter_lookaside;
 struct chained_syscalls;
+struct syscall_chain_pool;
 
 /* Information related to a file-system name-space.  */
 typedef struct {
@@ -60,12 +64,25 @@ typedef struct {
 
 	/* Current working directory, à la /proc/self/pwd.  */
 	char *cwd;
+
+	/* Host form of @cwd, cached when this latter was last
+	 * validated; NULL when it has to be re-translated.  */
+	char *host_cwd;
+
+	/* Tracees borrowing this name-space copy-on-write, chained
+	 * through their @fs_cow_link; they get their own copy before
+	 * any modification, from either side (see break_fs_cow()).  */
+	LIST_HEAD(fs_cow_sharers, tracee) cow_sharers;
 } FileSystemNameSpace;
 
-/* Virtual heap, emulated with a regular memory mapping.  */
+/* Virtual heap, emulated with a regular memory mapping.  The
+ * mapping is resized by whole chunks with a shrink hysteresis, thus
+ * @alloc_size -- the space actually reserved -- is most of the time
+ * larger than @size, the current brk(2) level.  */
 typedef struct {
 	word_t base;
 	size_t size;
+	size_t alloc_size;
 	size_t prealloc_size;
 	bool disabled;
 } Heap;
@@ -79,25 +96,67 @@ typedef struct tracee {
 	/* Link for the list of all tracees.  */
 	LIST_ENTRY(tracee) link;
 
+	/* Link for the pid-keyed hash table used by get_tracee();
+	 * only tracees with an actual pid are in there, dummies and
+	 * zombies are not.  */
+	LIST_ENTRY(tracee) pid_link;
+
 	/* Process identifier. */
 	pid_t pid;
 
+	/* Lazily opened "/proc/<pid>/mem" file descriptor, used to
+	 * transfer data when process_vm_readv(2)/writev(2) is
+	 * unavailable; -1 until the first use, -2 once known to be
+	 * unusable.  */
+	int mem_fd;
+
+	/* Pidfd for this process, opened as soon as its pid is
+	 * known; -1 when unavailable (old kernel).  Used by
+	 * kill_all_tracees() to signal and reap without pid-reuse
+	 * races.  */
+	int pidfd;
+
 	/* Is it currently running or not?  */
 	bool running;
 
-	/* Is this tracee ready to be freed?  TODO: move to a list
-	 * dedicated to terminated tracees instead.  */
+	/* Deferred ptrace restart: the per-event dispatch of
+	 * event_loop() only records the signal to deliver, the whole
+	 * drained batch is restarted back-to-back once fully handled;
+	 * @deferred_signal is valid only while @restart_deferred is
+	 * set.  See flush_restart_batch() in event.c.  */
+	bool restart_deferred;
+	int deferred_signal;
+
+	/* Is this tracee ready to be freed?  Set by
+	 * terminate_tracee(), which also chains the tracee -- through
+	 * @terminated_link -- into the list swept by
+	 * free_terminated_tracees().  */
 	bool terminated;
+	LIST_ENTRY(tracee) terminated_link;
 
 	/* Parent of this tracee, NULL if none.  */
 	struct tracee *parent;
 
+	/* Children of this tracee -- the entries whose @parent points
+	 * back here -- chained through their @child_link:
+	 * remove_tracee() releases its orphans without scanning the
+	 * whole list of tracees.  */
+	LIST_HEAD(children_list, tracee) children;
+	LIST_ENTRY(tracee) child_link;
+
 	/* Is it a "clone", i.e has the same parent as its creator.  */
 	bool clone;
 
 	/* Support for ptrace emulation (tracer side).  */
 	struct {
 		size_t nb_ptracees;
+
+		/* All the ptracees of this ptracer -- zombies
+		 * included -- chained through their
+		 * @as_ptracee.sibling: emulated wait4(2) doesn't have
+		 * to scan the global list of tracees.  */
+		LIST_HEAD(ptracees_list, tracee) ptracees;
+
 		LIST_HEAD(zombies, tracee) zombies;
 
 		pid_t wait_pid;
@@ -114,6 +173,9 @@ typedef struct tracee {
 	struct {
 		struct tracee *ptracer;
 
+		/* Link for the ptracer's list of ptracees.  */
+		LIST_ENTRY(tracee) sibling;
+
 		struct {
 			#define STRUCT_EVENT struct { int value; bool pending; }
 
@@ -147,6 +209,23 @@ typedef struct tracee {
 	bool _regs_were_changed;
 	bool restore_original_regs;
 
+	/* One bit per Reg index modified since the last write-back,
+	 * maintained by poke_reg(): push_regs() uses it to write only
+	 * the registers that actually changed.  */
+	uint32_t _regs_dirty;
+
+	/* One bit per RegVersion: the bank is known to be identical
+	 * to CURRENT, its copy was deferred by save_current_regs()
+	 * until the banks actually diverge -- through poke_reg() or a
+	 * re-fetch (see materialize_regs() in tracee/reg.c).  */
+	uint32_t _regs_synced;
+
+	/* The CURRENT register bank holds only the registers reported
+	 * by PTRACE_GET_SYSCALL_INFO, not the full set: it must be
+	 * re-fetched before any register is modified (see
+	 * fetch_light_regs() in tracee/reg.c).  */
+	bool _regs_are_light;
+
 	/* State for the special handling of SIGSTOP.  */
 	enum {
 		SIGSTOP_IGNORED = 0,  /* Ignore SIGSTOP (once the parent is known).  */
@@ -166,8 +245,10 @@ typedef struct tracee {
 	 * "life_context" in "life_span".  */
 
 	/* Specify the type of the final component during the
-	 * initialization of a binding.  This variable is first
-	 * defined in bind_path() then used in build_glue().  */
+	 * initialization of a binding.  This variable is set -- then
+	 * reset -- in initialize_binding() and used in build_glue();
+	 * it is zero the rest of the time, which guarantees run-time
+	 * canonicalizations never fall into the glue construction.  */
 	mode_t glue_type;
 
 	/* During a sub-reconfiguration, the new setup is relatively
@@ -180,9 +261,12 @@ typedef struct tracee {
 	} reconf;
 
 	/* Unrequested syscalls inserted by PRoot after an actual
-	 * syscall.  */
+	 * syscall.  @syscalls points into @pool when a chain is in
+	 * progress, NULL otherwise; the pool is allocated once and
+	 * recycled from one chain to the next.  */
 	struct {
 		struct chained_syscalls *syscalls;
+		struct syscall_chain_pool *pool;
 		bool force_final_result;
 		word_t final_result;
 	} chain;
@@ -205,6 +289,51 @@ typedef struct tracee {
 	/* Ensure the sysexit stage is always hit under seccomp.  */
 	bool sysexit_pending;
 
+	/* The enter handler fully answered the current syscall -- the
+	 * result register is already set -- so the sysexit stage has
+	 * nothing left to do and can be skipped under seccomp, along
+	 * with the syscall itself (see translate_syscall()).  */
+	bool skip_sysexit;
+
+	/* The enter handler proved the exit handler of the current
+	 * syscall has nothing to do -- rename(2) not touching the
+	 * virtual cwd for instance -- so its exit stop can be skipped
+	 * under seccomp.  Unlike @skip_sysexit the syscall itself
+	 * still executes.  */
+	bool sysexit_unneeded;
+
+	/* Spin-skip detection, only on the non-seccomp path and when
+	 * $PROOT_SPIN_SKIP is set: number and arguments of the last
+	 * syscall seen at the enter stage, how many identical stops
+	 * arrived in a row, and whether this tracee currently runs
+	 * free under PTRACE_CONT until the next re-sync.  See
+	 * update_spin_signature() and enter_spin_skip().  */
+	word_t spin_signature[7];
+	unsigned int nb_identical_stops;
+	bool spin_skip;
+
+	/* Scratch arena mapped once into this tracee's address space,
+	 * used by alloc_mem() to stage data without moving the stack
+	 * pointer.  It is bump-allocated and reset at each syscall
+	 * entry; it does not survive execve(2).  */
+	struct {
+		word_t base;
+		size_t size;
+		size_t offset;
+		bool wanted;
+		bool pending;
+	} scratch;
+
+	/* Number of transfers performed against this tracee's memory,
+	 * and their cumulated sizes.  Printed on SIGUSR1/SIGUSR2 along
+	 * with the talloc hierarchy.  */
+	struct {
+		uint64_t nb_reads;
+		uint64_t nb_writes;
+		uint64_t bytes_read;
+		uint64_t bytes_written;
+	} mem_stats;
+
 
 	/**********************************************************************
 	 * Shared or private resources, depending on the CLONE_FS/VM flags.   *
@@ -213,6 +342,24 @@ typedef struct tracee {
 	/* Information related to a file-system name-space.  */
 	FileSystemNameSpace *fs;
 
+	/* True when @fs is borrowed copy-on-write from another
+	 * tracee: a fork without CLONE_FS costs a reference bump
+	 * only, the actual copy is deferred until a modification (see
+	 * break_fs_cow()).  */
+	bool fs_is_cow;
+	LIST_ENTRY(tracee) fs_cow_link;
+
+	/* Guest and host forms of the cwd staged by enter_chdir() in
+	 * fast mode ($PROOT_FAST_CHDIR), committed to @fs at the exit
+	 * stage iff the kernel accepted the directory change.  */
+	char *new_cwd;
+	char *new_host_cwd;
+
+	/* Memoized outcomes of the enter handling of one-path
+	 * syscalls, see enter_sysarg1_lookaside() in
+	 * syscall/enter.c.  */
+	struct enter_lookaside *enter_lookaside;
+
 	/* Virtual heap, emulated with a regular memory mapping.  */
 	Heap *heap;
 
@@ -239,6 +386,10 @@ typedef struct tracee {
 	/* List of extensions enabled for this tracee.  */
 	struct extensions *extensions;
 
+	/* Extensions whose activation was deferred, see
+	 * initialize_extension_deferred().  */
+	struct deferred_extensions *deferred_extensions;
+
 
 	/**********************************************************************
 	 * Shared but read-only resources                                     *
@@ -261,11 +412,15 @@ typedef struct tracee {
 #define TRACEE(a) talloc_get_type_abort(talloc_parent(talloc_parent(a)), Tracee)
 
 extern Tracee *get_tracee(const Tracee *tracee, pid_t pid, bool create);
+extern void set_tracee_pid(Tracee *tracee, pid_t pid);
 extern Tracee *get_stopped_ptracee(const Tracee *ptracer, pid_t pid,
 				bool only_with_pevent, word_t wait_options);
 extern bool has_ptracees(const Tracee *ptracer, pid_t pid, word_t wait_options);
 extern int new_child(Tracee *parent, word_t clone_flags);
+extern int break_fs_cow(Tracee *tracee);
 extern Tracee *new_dummy_tracee(TALLOC_CTX *context);
+extern void terminate_tracee(Tracee *tracee);
+extern void resync_spinning_tracees(void);
 extern void free_terminated_tracees();
 extern int swap_config(Tracee *tracee1, Tracee *tracee2);
 extern void kill_all_tracees();
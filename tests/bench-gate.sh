@@ -0,0 +1,39 @@
+# Regression gate over the syscall-stop overhead, driven by "make
+# bench-gate".  Unlike bench.sh -- which only reports numbers -- this
+# driver runs each workload from bench-syscalls.c natively then under
+# PRoot and fails when the per-operation overhead exceeds the ceiling
+# of its syscall class, so a commit that slows the hot loop down is
+# caught here rather than in production.  The whole run takes a few
+# seconds.
+#
+# The default ceilings are deliberately generous: they are meant to
+# catch regressions of an order of magnitude, not scheduling noise.
+# Tighten them per machine with BENCH_CEILING_<workload>, in µs.
+
+if [ ! -x "${PROOT}" ] || [ -z "$(which awk)" ] || [ ! -x ./bench-syscalls ]; then
+    exit 125;
+fi
+
+printf '%-10s %12s %12s %12s  %s\n' workload 'native µs' 'proot µs' 'overhead µs' ceiling
+
+status=0
+for spec in getpid:50000:250 stat:20000:500 statmiss:20000:500 open:20000:500 \
+            fork:200:10000 exec:100:50000 crawl:1000:5000; do
+    workload=${spec%%:*}
+    nb_ops=$(echo ${spec} | cut -d : -f 2)
+    ceiling=$(echo ${spec} | cut -d : -f 3)
+    ceiling=$(eval echo \${BENCH_CEILING_${workload}:-${ceiling}})
+
+    native=$(./bench-syscalls ${workload} ${nb_ops}) || { status=1; continue; }
+    proot=$(${PROOT} ./bench-syscalls ${workload} ${nb_ops}) || { status=1; continue; }
+
+    overhead=$(awk "BEGIN { printf \"%.3f\", ${proot} - ${native} }")
+    verdict=$(awk "BEGIN { print (${overhead} > ${ceiling}) ? \"EXCEEDED\" : \"ok\" }")
+
+    printf '%-10s %12s %12s %12s  %s (%s)\n' ${workload} ${native} ${proot} \
+        ${overhead} ${ceiling} ${verdict}
+
+    [ "${verdict}" = "ok" ] || status=1
+done
+
+exit ${status}
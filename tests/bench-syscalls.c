@@ -0,0 +1,147 @@
+/* Workloads for the syscall-overhead benchmark suite, see bench.sh.
+ *
+ * Usage: bench-syscalls <workload> <nb-ops>
+ *
+ * It runs the given workload -- a getpid/stat/statmiss/open loop, a
+ * fork storm, an exec storm or a deep-directory crawl -- @nb-ops times and
+ * prints the cost of one operation in µs on stdout, nothing else, so
+ * the driver can diff a native run against a PRoot one.
+ */
+
+#include <stdio.h>     /* printf(3), */
+#include <stdlib.h>    /* exit(3), strtoul(3), mkdtemp(3), */
+#include <string.h>    /* strcmp(3), strcat(3), */
+#include <unistd.h>    /* fork(2), execl(3), syscall(2), rmdir(2), */
+#include <fcntl.h>     /* open(2), */
+#include <time.h>      /* clock_gettime(2), */
+#include <sys/stat.h>  /* stat(2), mkdir(2), */
+#include <sys/types.h> /* wait(2), */
+#include <sys/wait.h>  /* wait(2), */
+#include <sys/syscall.h> /* SYS_getpid, */
+
+#define CRAWL_DEPTH 64
+
+static double now_usecs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+int main(int argc, char *argv[])
+{
+	char path[4096];
+	const char *workload;
+	unsigned long nb_ops;
+	unsigned long i;
+	double start;
+	int status;
+
+	/* Target of the exec storm, see below.  */
+	if (argc == 2 && strcmp(argv[1], "exit") == 0)
+		exit(EXIT_SUCCESS);
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <workload> <nb-ops>\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	workload = argv[1];
+	nb_ops   = strtoul(argv[2], NULL, 0);
+	if (nb_ops == 0)
+		exit(EXIT_FAILURE);
+
+	if (strcmp(workload, "getpid") == 0) {
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++)
+			(void) syscall(SYS_getpid);
+	}
+	else if (strcmp(workload, "stat") == 0) {
+		struct stat statl;
+
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++)
+			(void) stat("/", &statl);
+	}
+	else if (strcmp(workload, "statmiss") == 0) {
+		struct stat statl;
+
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++)
+			(void) stat("/nonexistent/bench/path", &statl);
+	}
+	else if (strcmp(workload, "open") == 0) {
+		int fd;
+
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++) {
+			fd = open("/", O_RDONLY);
+			if (fd >= 0)
+				close(fd);
+		}
+	}
+	else if (strcmp(workload, "fork") == 0) {
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++) {
+			switch (fork()) {
+			case -1:
+				exit(EXIT_FAILURE);
+			case 0:
+				exit(EXIT_SUCCESS);
+			default:
+				(void) wait(&status);
+			}
+		}
+	}
+	else if (strcmp(workload, "exec") == 0) {
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++) {
+			switch (fork()) {
+			case -1:
+				exit(EXIT_FAILURE);
+			case 0:
+				execl(argv[0], argv[0], "exit", (char *) NULL);
+				exit(EXIT_FAILURE);
+			default:
+				(void) wait(&status);
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+					exit(EXIT_FAILURE);
+			}
+		}
+	}
+	else if (strcmp(workload, "crawl") == 0) {
+		struct stat statl;
+		size_t depth;
+
+		strcpy(path, "/tmp/bench-crawl-XXXXXX");
+		if (mkdtemp(path) == NULL)
+			exit(EXIT_FAILURE);
+
+		for (depth = 0; depth < CRAWL_DEPTH; depth++) {
+			strcat(path, "/d");
+			if (mkdir(path, 0700) < 0)
+				exit(EXIT_FAILURE);
+		}
+
+		start = now_usecs();
+		for (i = 0; i < nb_ops; i++)
+			(void) stat(path, &statl);
+
+		/* Don't account the cleanup.  */
+		printf("%.3f\n", (now_usecs() - start) / nb_ops);
+
+		for (depth = 0; depth <= CRAWL_DEPTH; depth++) {
+			(void) rmdir(path);
+			*strrchr(path, '/') = '\0';
+		}
+		exit(EXIT_SUCCESS);
+	}
+	else {
+		fprintf(stderr, "%s: unknown workload '%s'\n", argv[0], workload);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%.3f\n", (now_usecs() - start) / nb_ops);
+	exit(EXIT_SUCCESS);
+}
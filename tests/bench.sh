@@ -0,0 +1,25 @@
+# Syscall-overhead benchmark suite, driven by "make bench".  Each
+# workload from bench-syscalls.c is run natively then under PRoot, and
+# the per-operation overhead is reported in µs.  Track these numbers
+# per release: a regression here means every traced syscall got
+# slower, which is only visible in production otherwise.
+
+if [ ! -x "${PROOT}" ] || [ -z "$(which awk)" ] || [ ! -x ./bench-syscalls ]; then
+    exit 125;
+fi
+
+printf '%-10s %12s %12s %12s\n' workload 'native µs' 'proot µs' 'overhead µs'
+
+status=0
+for spec in getpid:100000 stat:50000 open:50000 fork:500 exec:200 crawl:2000; do
+    workload=${spec%:*}
+    nb_ops=${spec#*:}
+
+    native=$(./bench-syscalls ${workload} ${nb_ops}) || { status=1; continue; }
+    proot=$(${PROOT} ./bench-syscalls ${workload} ${nb_ops}) || { status=1; continue; }
+
+    printf '%-10s %12s %12s %12s\n' ${workload} ${native} ${proot} \
+        $(awk "BEGIN { printf \"%.3f\", ${proot} - ${native} }")
+done
+
+exit ${status}
@@ -0,0 +1,25 @@
+if [ -z `which mcookie` ] || [ -z `which mkdir` ] || [ -z `which ln` ] || [ -z `which rm` ] || [ ! -x ${ROOTFS}/bin/cat ] || [ ! -x ${ROOTFS}/bin/chdir_getcwd ]; then
+    exit 125;
+fi
+
+TMP=/tmp/$(mcookie)
+
+mkdir -p ${TMP}/Foo/Bar
+echo OK > ${TMP}/Foo/Bar/File
+ln -s ${TMP}/Foo ${TMP}/link
+
+# Translation: paths below a --bind-ci binding are matched without
+# case, exact matches still work.
+${PROOT} -v -1 --bind-ci=${TMP}:/ci -r ${ROOTFS} cat /ci/foo/bAR/fILE | grep '^OK$'
+${PROOT} -v -1 --bind-ci=${TMP}:/ci -r ${ROOTFS} cat /ci/Foo/Bar/File | grep '^OK$'
+
+# Detranslation: getcwd(2) goes back through the binding, with the
+# actual case of the host entries.
+${PROOT} -v -1 --bind-ci=${TMP}:/ci -r ${ROOTFS} chdir_getcwd /ci/foo/bar | grep '^/ci/Foo/Bar$'
+
+# Host paths of other bindings -- here a symlink -- still get
+# canonicalized before detranslation, even though --bind-ci disables
+# the sorted binding index.
+${PROOT} -v -1 --bind-ci=${TMP}:/ci -b ${TMP}/link:/lnk -r ${ROOTFS} chdir_getcwd /lnk | grep '^/lnk$'
+
+rm -rf ${TMP}